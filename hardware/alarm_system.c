@@ -14,6 +14,7 @@
 /* USER CODE END Header */
 
 #include "alarm_system.h"
+#include "thresholds.h"
 #include "stm32_interface.h"
 #include "main.h"
 #include <string.h>
@@ -27,7 +28,6 @@ static uint8_t history_count = 0;
 static uint8_t history_index = 0;
 static bool alarm_enabled[MAX_ALARMS];
 static uint8_t alarm_severity[MAX_ALARMS];
-static uint32_t alarm_threshold[MAX_ALARMS];
 
 /* Private function prototypes -----------------------------------------------*/
 static void add_to_history(uint32_t alarm_id, uint8_t severity, uint8_t action);
@@ -52,7 +52,6 @@ void alarm_system_init(void) {
     for (int i = 0; i < MAX_ALARMS; i++) {
         alarm_enabled[i] = true;
         alarm_severity[i] = ALARM_SEVERITY_WARNING;
-        alarm_threshold[i] = 0;
     }
     
     // Set specific alarm severities
@@ -70,13 +69,7 @@ void alarm_system_init(void) {
     alarm_severity[ALARM_ID_SYSTEM_FAULT - 1000] = ALARM_SEVERITY_EMERGENCY;
     alarm_severity[ALARM_ID_MAINTENANCE - 1000] = ALARM_SEVERITY_INFO;
     
-    // Set thresholds
-    alarm_threshold[ALARM_ID_VOLTAGE_LOW - 1000] = 45000;  // 45V
-    alarm_threshold[ALARM_ID_VOLTAGE_HIGH - 1000] = 55000; // 55V
-    alarm_threshold[ALARM_ID_CURRENT_HIGH - 1000] = 50000; // 50A
-    alarm_threshold[ALARM_ID_TEMP_HIGH - 1000] = 60;       // 60°C
-    alarm_threshold[ALARM_ID_POWER_OVERLOAD - 1000] = 2400000; // 2.4kW
-    alarm_threshold[ALARM_ID_BATTERY_LOW - 1000] = 10000;  // 10V
+    // Thresholds live in the shared configuration (thresholds.h)
 }
 
 /**
@@ -235,11 +228,13 @@ void alarm_system_get_alarm_history(alarm_history_t* history, uint8_t* count) {
  * @brief Check power module alarms
  */
 void alarm_system_check_power_alarms(stm32_power_module_data_t* modules, uint8_t count) {
+    // One configuration for the whole pass, even if a new one is published
+    const thresholds_t* t = thresholds_current();
     for (int i = 0; i < count; i++) {
         stm32_power_module_data_t* module = &modules[i];
         
         // Voltage alarms
-        if (module->voltage < alarm_threshold[ALARM_ID_VOLTAGE_LOW - 1000]) {
+        if (module->voltage < t->alarm_voltage_low_mv) {
             if (!alarm_system_is_alarm_active(ALARM_ID_VOLTAGE_LOW + i)) {
                 char message[8];
                 snprintf(message, sizeof(message), "V_LOW_%d", i + 1);
@@ -251,7 +246,7 @@ void alarm_system_check_power_alarms(stm32_power_module_data_t* modules, uint8_t
             }
         }
         
-        if (module->voltage > alarm_threshold[ALARM_ID_VOLTAGE_HIGH - 1000]) {
+        if (module->voltage > t->alarm_voltage_high_mv) {
             if (!alarm_system_is_alarm_active(ALARM_ID_VOLTAGE_HIGH + i)) {
                 char message[8];
                 snprintf(message, sizeof(message), "V_HIGH_%d", i + 1);
@@ -264,7 +259,7 @@ void alarm_system_check_power_alarms(stm32_power_module_data_t* modules, uint8_t
         }
         
         // Current alarms
-        if (module->current > alarm_threshold[ALARM_ID_CURRENT_HIGH - 1000]) {
+        if (module->current > t->alarm_current_high_ma) {
             if (!alarm_system_is_alarm_active(ALARM_ID_CURRENT_HIGH + i)) {
                 char message[8];
                 snprintf(message, sizeof(message), "I_HIGH_%d", i + 1);
@@ -277,7 +272,7 @@ void alarm_system_check_power_alarms(stm32_power_module_data_t* modules, uint8_t
         }
         
         // Temperature alarms
-        if (module->temperature > alarm_threshold[ALARM_ID_TEMP_HIGH - 1000]) {
+        if (module->temperature > t->alarm_temperature_high_c) {
             if (!alarm_system_is_alarm_active(ALARM_ID_TEMP_HIGH + i)) {
                 char message[8];
                 snprintf(message, sizeof(message), "T_HIGH_%d", i + 1);
@@ -290,7 +285,7 @@ void alarm_system_check_power_alarms(stm32_power_module_data_t* modules, uint8_t
         }
         
         // Power overload alarms
-        if (module->power > alarm_threshold[ALARM_ID_POWER_OVERLOAD - 1000]) {
+        if (module->power > t->alarm_power_overload_mw) {
             if (!alarm_system_is_alarm_active(ALARM_ID_POWER_OVERLOAD + i)) {
                 char message[8];
                 snprintf(message, sizeof(message), "P_OVER_%d", i + 1);
@@ -308,11 +303,12 @@ void alarm_system_check_power_alarms(stm32_power_module_data_t* modules, uint8_t
  * @brief Check battery alarms
  */
 void alarm_system_check_battery_alarms(stm32_battery_data_t* batteries, uint8_t count) {
+    const thresholds_t* t = thresholds_current();
     for (int i = 0; i < count; i++) {
         stm32_battery_data_t* battery = &batteries[i];
         
         // Battery low voltage
-        if (battery->voltage < alarm_threshold[ALARM_ID_BATTERY_LOW - 1000]) {
+        if (battery->voltage < t->alarm_battery_low_mv) {
             if (!alarm_system_is_alarm_active(ALARM_ID_BATTERY_LOW + i)) {
                 char message[8];
                 snprintf(message, sizeof(message), "BAT_LOW_%d", i + 1);
@@ -430,12 +426,29 @@ void alarm_system_set_alarm_severity(uint32_t alarm_id, uint8_t severity) {
     }
 }
 
+/**
+ * @brief Threshold key of an alarm, 0 if the alarm has none
+ */
+static uint8_t alarm_threshold_key(uint32_t alarm_id) {
+    switch (alarm_id) {
+        case ALARM_ID_VOLTAGE_LOW:    return STM32_THRESHOLD_ALARM_VOLTAGE_LOW;
+        case ALARM_ID_VOLTAGE_HIGH:   return STM32_THRESHOLD_ALARM_VOLTAGE_HIGH;
+        case ALARM_ID_CURRENT_HIGH:   return STM32_THRESHOLD_ALARM_CURRENT_HIGH;
+        case ALARM_ID_TEMP_HIGH:      return STM32_THRESHOLD_ALARM_TEMP_HIGH;
+        case ALARM_ID_POWER_OVERLOAD: return STM32_THRESHOLD_ALARM_POWER_OVERLOAD;
+        case ALARM_ID_BATTERY_LOW:    return STM32_THRESHOLD_ALARM_BATTERY_LOW;
+        default:                      return 0;
+    }
+}
+
 /**
  * @brief Set alarm threshold
+ * @note  Publishes a new configuration; main loop only (see thresholds.h)
  */
 void alarm_system_set_alarm_threshold(uint32_t alarm_id, uint32_t threshold) {
-    if (alarm_id >= 1000 && alarm_id < 1000 + MAX_ALARMS) {
-        alarm_threshold[alarm_id - 1000] = threshold;
+    thresholds_t next = *thresholds_current();
+    if (thresholds_set(&next, alarm_threshold_key(alarm_id), 0, threshold)) {
+        thresholds_publish(&next);
     }
 }
 
@@ -463,10 +476,16 @@ uint8_t alarm_system_get_alarm_severity(uint32_t alarm_id) {
  * @brief Get alarm threshold
  */
 uint32_t alarm_system_get_alarm_threshold(uint32_t alarm_id) {
-    if (alarm_id >= 1000 && alarm_id < 1000 + MAX_ALARMS) {
-        return alarm_threshold[alarm_id - 1000];
+    const thresholds_t* t = thresholds_current();
+    switch (alarm_id) {
+        case ALARM_ID_VOLTAGE_LOW:    return t->alarm_voltage_low_mv;
+        case ALARM_ID_VOLTAGE_HIGH:   return t->alarm_voltage_high_mv;
+        case ALARM_ID_CURRENT_HIGH:   return t->alarm_current_high_ma;
+        case ALARM_ID_TEMP_HIGH:      return t->alarm_temperature_high_c;
+        case ALARM_ID_POWER_OVERLOAD: return t->alarm_power_overload_mw;
+        case ALARM_ID_BATTERY_LOW:    return t->alarm_battery_low_mv;
+        default:                      return 0;
     }
-    return 0;
 }
 
 /**
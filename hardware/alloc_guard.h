@@ -0,0 +1,34 @@
+#ifndef ALLOC_GUARD_H
+#define ALLOC_GUARD_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Heap allocation guard for proving a path allocation-free (glibc only).
+//
+// Linking alloc_guard.o into a program interposes malloc, calloc, realloc,
+// posix_memalign, aligned_alloc and memalign for every thread and library
+// in the process, zlib and libc included. Disarmed, calls only pass
+// through. Between alloc_guard_arm() and alloc_guard_disarm() every call
+// is counted; with fatal set the first one prints its size and aborts,
+// so a debugger or core dump shows who allocated. Threads that may
+// allocate by design (a test's own bookkeeping, load generators) call
+// alloc_guard_exempt_thread() and are never counted.
+//
+// Not part of any library; the test and benchmark programs link it.
+
+void alloc_guard_arm(bool fatal);
+// Allocations counted since alloc_guard_arm()
+uint64_t alloc_guard_disarm(void);
+uint64_t alloc_guard_count(void);
+void alloc_guard_exempt_thread(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ALLOC_GUARD_H
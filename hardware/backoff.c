@@ -0,0 +1,39 @@
+#include "backoff.h"
+
+// xorshift32; rand() is shared global state and not thread-safe
+static uint32_t next_random(uint32_t* state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+void backoff_init(backoff_t* backoff, uint32_t initial_ms, uint32_t max_ms, uint32_t seed) {
+    if (!backoff) return;
+
+    backoff->initial_ms = initial_ms ? initial_ms : 1;
+    backoff->max_ms = max_ms > backoff->initial_ms ? max_ms : backoff->initial_ms;
+    backoff->seed = seed ? seed : 0x9E3779B9u;
+    backoff_reset(backoff);
+}
+
+uint32_t backoff_next(backoff_t* backoff) {
+    if (!backoff) return 0;
+
+    uint32_t window = backoff->window_ms;
+    uint32_t half = window / 2;
+    uint32_t delay = half + next_random(&backoff->seed) % (window - half + 1);
+
+    backoff->attempts++;
+    backoff->window_ms = window >= backoff->max_ms / 2 ? backoff->max_ms : window * 2;
+    return delay;
+}
+
+void backoff_reset(backoff_t* backoff) {
+    if (!backoff) return;
+
+    backoff->window_ms = backoff->initial_ms;
+    backoff->attempts = 0;
+}
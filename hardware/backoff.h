@@ -0,0 +1,32 @@
+#ifndef BACKOFF_H
+#define BACKOFF_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+// Jittered exponential backoff for link reconnects.
+//
+// The first retry comes after roughly initial_ms so a short link blip
+// recovers in milliseconds; each further failure doubles the window up to
+// max_ms. Delays are drawn from [window/2, window] so that many links lost
+// at once do not reconnect in lockstep. Not thread-safe; one per link.
+typedef struct {
+    uint32_t initial_ms;
+    uint32_t max_ms;
+    uint32_t window_ms;
+    uint32_t attempts;
+    uint32_t seed;
+} backoff_t;
+
+void backoff_init(backoff_t* backoff, uint32_t initial_ms, uint32_t max_ms, uint32_t seed);
+uint32_t backoff_next(backoff_t* backoff);
+void backoff_reset(backoff_t* backoff);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BACKOFF_H
@@ -0,0 +1,369 @@
+// hardware/bench_ingest.c
+// Gateway ingest benchmark: N fake controllers stream over loopback into a
+// gateway with the TCP output stream and WebSocket clients (JSON, binary,
+// deflate) attached. After a warm-up, every heap allocation in the process
+// is counted and ingest-to-sink latency is recorded per frame, first on a
+// quiet machine and then with threads hammering malloc/free, to show the
+// ingest path neither allocates nor waits on the allocator.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gateway.h"
+#include "gateway_stream.h"
+#include "gateway_http.h"
+#include "alloc_guard.h"
+
+#define FRAMES_PER_ROUND    18      // 4 power + 4 battery + 3 AC + 6 DC + 1 status
+#define MAX_DEVICES         1024
+#define MAX_NOISE           64
+#define DRAINS              4       // Stream consumer, JSON, binary and deflate WebSocket
+
+// Latency histogram: 8 buckets per power of two of nanoseconds
+#define SUB_BITS            3
+#define BUCKETS             (64 << SUB_BITS)
+
+enum { PHASE_WARMUP, PHASE_QUIET, PHASE_CONTENDED, PHASE_COUNT };
+static const char* phase_names[PHASE_COUNT] = {"warm-up", "quiet", "contended"};
+
+// One per gateway worker; only the owner writes
+typedef struct {
+    _Alignas(64) uint64_t buckets[PHASE_COUNT][BUCKETS];
+    uint64_t max[PHASE_COUNT];
+} latency_slot_t;
+
+static latency_slot_t slots[GW_MAX_THREADS];
+static atomic_uint slots_claimed;
+static _Thread_local int local_slot = -1;
+static atomic_int phase = PHASE_WARMUP;
+static atomic_bool running = true;
+static atomic_bool noisy = false;
+
+typedef struct {
+    int listen_fd;
+    uint16_t port;
+    uint16_t device_id;
+    uint32_t rounds_per_second;
+    pthread_t thread;
+} device_t;
+
+static uint32_t bucket_of(uint64_t ns) {
+    if (ns < (1u << SUB_BITS)) return (uint32_t)ns;
+    int exponent = 63 - __builtin_clzll(ns);
+    uint32_t sub = (uint32_t)(ns >> (exponent - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+    return (uint32_t)(exponent - SUB_BITS + 1) * (1u << SUB_BITS) + sub;
+}
+
+// Upper edge of a bucket
+static uint64_t bucket_ns(uint32_t bucket) {
+    if (bucket < (1u << SUB_BITS)) return bucket;
+    int exponent = (int)(bucket >> SUB_BITS) + SUB_BITS - 1;
+    uint64_t sub = bucket & ((1u << SUB_BITS) - 1);
+    return (((1ull << SUB_BITS) + sub + 1) << (exponent - SUB_BITS)) - 1;
+}
+
+static void latency_sink(const gw_tagged_frame_t* frame, void* user_data) {
+    (void)user_data;
+    uint64_t latency = gw_monotonic_ns() - frame->ingest_ns;
+    if (local_slot < 0) {
+        unsigned slot = atomic_fetch_add(&slots_claimed, 1);
+        local_slot = slot < GW_MAX_THREADS ? (int)slot : GW_MAX_THREADS - 1;
+    }
+    latency_slot_t* s = &slots[local_slot];
+    int p = atomic_load_explicit(&phase, memory_order_relaxed);
+    s->buckets[p][bucket_of(latency)]++;
+    if (latency > s->max[p]) s->max[p] = latency;
+}
+
+static uint64_t percentile(const uint64_t* merged, uint64_t total, double q) {
+    uint64_t rank = (uint64_t)(q * (double)total), seen = 0;
+    for (uint32_t i = 0; i < BUCKETS; i++) {
+        seen += merged[i];
+        if (seen > rank) return bucket_ns(i);
+    }
+    return 0;
+}
+
+static size_t build_round(uint16_t device_id, uint8_t* out) {
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    size_t n = 0;
+    for (int i = 0; i < 4; i++) {
+        power_module_t m = {(uint8_t)(i + 1), 53.5f, 45.0f + device_id % 10, 0, 42.0f, true, false};
+        n += stm32_encode_frame(PACKET_TYPE_POWER_MODULE, data, stm32_encode_power_module(&m, data), out + n);
+    }
+    for (int i = 0; i < 4; i++) {
+        battery_info_t b = {(uint8_t)(i + 1), 12.6f, 0.1f, 24.0f, 85, false, false};
+        n += stm32_encode_frame(PACKET_TYPE_BATTERY, data, stm32_encode_battery(&b, data), out + n);
+    }
+    for (int i = 0; i < 3; i++) {
+        ac_phase_t p = {(uint8_t)(i + 1), 230.5f, 12.3f, 50.0f, 2.8f, true};
+        n += stm32_encode_frame(PACKET_TYPE_AC_INPUT, data, stm32_encode_ac_input(&p, data), out + n);
+    }
+    for (int i = 0; i < 6; i++) {
+        dc_circuit_t c = {(uint8_t)(i + 1), 53.5f, 6.0f, 321.0f, i < 4, "Load"};
+        n += stm32_encode_frame(PACKET_TYPE_DC_OUTPUT, data, stm32_encode_dc_output(&c, data), out + n);
+    }
+    system_status_t st = {true, true, false, 0, 75.0f, 1000};
+    n += stm32_encode_frame(PACKET_TYPE_SYSTEM_STATUS, data, stm32_encode_system_status(&st, data), out + n);
+    return n;
+}
+
+// Sends one round per period on an absolute clock, so a slow gateway does
+// not slow the offered load down
+static void* device_main(void* arg) {
+    device_t* dev = arg;
+    int fd = accept(dev->listen_fd, NULL, NULL);
+    if (fd < 0) return NULL;
+
+    uint8_t round[FRAMES_PER_ROUND * STM32_MAX_PACKET_SIZE];
+    size_t len = build_round(dev->device_id, round);
+    uint64_t period_ns = 1000000000ull / dev->rounds_per_second;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (atomic_load_explicit(&running, memory_order_relaxed)) {
+        if (send(fd, round, len, MSG_NOSIGNAL) < 0) break;
+        next.tv_nsec += (long)period_ns;
+        while (next.tv_nsec >= 1000000000L) {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    close(fd);
+    return NULL;
+}
+
+static void* drain_main(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    static _Thread_local uint8_t buffer[1 << 16];
+    while (atomic_load_explicit(&running, memory_order_relaxed) &&
+           recv(fd, buffer, sizeof(buffer), 0) != 0) {
+    }
+    return NULL;
+}
+
+// Allocator contention: mixed sizes, freed out of order, while noisy is set
+static void* noise_main(void* arg) {
+    (void)arg;
+    alloc_guard_exempt_thread();
+    void* held[256] = {0};
+    uint32_t x = (uint32_t)(uintptr_t)&held | 1;
+    while (atomic_load_explicit(&running, memory_order_relaxed)) {
+        if (!atomic_load_explicit(&noisy, memory_order_relaxed)) {
+            usleep(1000);
+            continue;
+        }
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        uint32_t i = x & 255;
+        free(held[i]);
+        held[i] = malloc(16 + (x >> 8) % 4096);
+    }
+    for (int i = 0; i < 256; i++) free(held[i]);
+    return NULL;
+}
+
+static int open_listener(uint16_t* port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) return -1;
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &len);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+static int connect_loopback(uint16_t port, const char* request) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    struct timeval tv = {0, 200000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        (request && send(fd, request, strlen(request), MSG_NOSIGNAL) < 0)) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Runs one measured phase; returns the allocations it counted
+static uint64_t run_phase(int p, gateway_t* gw, unsigned seconds, bool strict, uint64_t* frames) {
+    gw_stats_t before, after;
+    gateway_get_stats(gw, &before);
+    atomic_store(&phase, p);
+    alloc_guard_arm(strict);
+    sleep(seconds);
+    uint64_t allocations = alloc_guard_disarm();
+    gateway_get_stats(gw, &after);
+    *frames = after.frames_in - before.frames_in;
+    return allocations;
+}
+
+static void report_phase(int p, unsigned seconds, uint64_t frames, uint64_t allocations) {
+    static uint64_t merged[BUCKETS];
+    memset(merged, 0, sizeof(merged));
+    uint64_t total = 0, max = 0;
+    for (int s = 0; s < GW_MAX_THREADS; s++) {
+        for (uint32_t i = 0; i < BUCKETS; i++) {
+            merged[i] += slots[s].buckets[p][i];
+            total += slots[s].buckets[p][i];
+        }
+        if (slots[s].max[p] > max) max = slots[s].max[p];
+    }
+    printf("%-10s %9.0f frames/s  %llu allocs (%.6f/frame)  p50 %5.1f us  p99 %6.1f us  p99.9 %6.1f us  max %7.1f us\n",
+           phase_names[p], (double)frames / seconds, (unsigned long long)allocations,
+           frames ? (double)allocations / (double)frames : 0.0,
+           total ? percentile(merged, total, 0.50) / 1000.0 : 0.0,
+           total ? percentile(merged, total, 0.99) / 1000.0 : 0.0,
+           total ? percentile(merged, total, 0.999) / 1000.0 : 0.0, max / 1000.0);
+}
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  -d <n>      Fake controllers (default 32)\n");
+    printf("  -r <n>      Rounds of %d frames per second per controller (default 500)\n", FRAMES_PER_ROUND);
+    printf("  -t <n>      Gateway event-loop threads (default 4)\n");
+    printf("  -w <sec>    Warm-up before counting (default 2)\n");
+    printf("  -s <sec>    Length of each measured phase (default 5)\n");
+    printf("  -n <n>      malloc/free threads in the contended phase (default 4)\n");
+    printf("  -S          Strict: abort on the first heap allocation after warm-up\n");
+}
+
+int main(int argc, char* argv[]) {
+    unsigned device_count = 32, rounds_per_second = 500, warmup = 2, seconds = 5, noise_count = 4;
+    bool strict = false;
+    gw_config_t config;
+    gateway_default_config(&config);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:r:t:w:s:n:Sh")) != -1) {
+        switch (opt) {
+            case 'd': device_count = (unsigned)atoi(optarg); break;
+            case 'r': rounds_per_second = (unsigned)atoi(optarg); break;
+            case 't': config.thread_count = (uint32_t)atoi(optarg); break;
+            case 'w': warmup = (unsigned)atoi(optarg); break;
+            case 's': seconds = (unsigned)atoi(optarg); break;
+            case 'n': noise_count = (unsigned)atoi(optarg); break;
+            case 'S': strict = true; break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (device_count == 0 || device_count > MAX_DEVICES || rounds_per_second == 0 ||
+        seconds == 0 || noise_count > MAX_NOISE) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    // The driver's own setup and reporting may allocate
+    alloc_guard_exempt_thread();
+
+    gateway_t* gw = gateway_create(&config);
+    static device_t devices[MAX_DEVICES];
+    for (unsigned i = 0; i < device_count; i++) {
+        devices[i].device_id = (uint16_t)(i + 1);
+        devices[i].rounds_per_second = rounds_per_second;
+        devices[i].listen_fd = open_listener(&devices[i].port);
+        if (devices[i].listen_fd < 0) {
+            perror("listen");
+            return 1;
+        }
+        pthread_create(&devices[i].thread, NULL, device_main, &devices[i]);
+
+        gw_device_config_t dev;
+        memset(&dev, 0, sizeof(dev));
+        dev.device_id = devices[i].device_id;
+        dev.link_type = GW_LINK_TCP;
+        strcpy(dev.address, "127.0.0.1");
+        dev.port = devices[i].port;
+        gateway_add_device(gw, &dev);
+    }
+
+    gw_stream_server_t* stream = gw_stream_create(0);
+    gw_http_server_t* http = gw_http_create(gw, 0);
+    if (!stream || !http || gw_stream_start(stream) != HW_STATUS_OK || gw_http_start(http) != HW_STATUS_OK) {
+        fprintf(stderr, "Cannot start the outputs\n");
+        return 1;
+    }
+    gateway_add_sink(gw, latency_sink, NULL);
+    gateway_add_sink(gw, gw_stream_sink, stream);
+    gateway_add_sink(gw, gw_http_sink, http);
+
+    int fds[DRAINS];
+    pthread_t drains[DRAINS];
+    fds[0] = connect_loopback(gw_stream_port(stream), NULL);
+    const char* extras[] = {"", "", "Sec-WebSocket-Extensions: permessage-deflate\r\n"};
+    const char* targets[] = {"/ws", "/ws?format=binary", "/ws"};
+    for (int i = 1; i < DRAINS; i++) {
+        char request[512];
+        snprintf(request, sizeof(request),
+                 "GET %s HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n%s\r\n",
+                 targets[i - 1], extras[i - 1]);
+        fds[i] = connect_loopback(gw_http_port(http), request);
+    }
+    for (int i = 0; i < DRAINS; i++) {
+        if (fds[i] < 0) {
+            fprintf(stderr, "Cannot connect output client %d\n", i);
+            return 1;
+        }
+        pthread_create(&drains[i], NULL, drain_main, (void*)(intptr_t)fds[i]);
+    }
+    pthread_t noise[MAX_NOISE];
+    for (unsigned i = 0; i < noise_count; i++) pthread_create(&noise[i], NULL, noise_main, NULL);
+
+    printf("NetMon gateway ingest benchmark: %u controllers x %u frames/s, %u threads\n", device_count,
+           rounds_per_second * FRAMES_PER_ROUND, config.thread_count);
+    if (gateway_start(gw) != HW_STATUS_OK) {
+        fprintf(stderr, "Gateway failed to start\n");
+        return 1;
+    }
+    sleep(warmup);
+
+    uint64_t frames[PHASE_COUNT] = {0}, allocations[PHASE_COUNT] = {0};
+    allocations[PHASE_QUIET] = run_phase(PHASE_QUIET, gw, seconds, strict, &frames[PHASE_QUIET]);
+    atomic_store(&noisy, noise_count > 0);
+    allocations[PHASE_CONTENDED] = run_phase(PHASE_CONTENDED, gw, seconds, strict, &frames[PHASE_CONTENDED]);
+    atomic_store(&noisy, false);
+
+    gw_stats_t stats;
+    gw_http_stats_t http_stats;
+    gateway_get_stats(gw, &stats);
+    gw_http_get_stats(http, &http_stats);
+    report_phase(PHASE_QUIET, seconds, frames[PHASE_QUIET], allocations[PHASE_QUIET]);
+    if (noise_count > 0) {
+        report_phase(PHASE_CONTENDED, seconds, frames[PHASE_CONTENDED], allocations[PHASE_CONTENDED]);
+    }
+    printf("connected %u/%u, checksum errors %llu, WebSocket messages %llu (%llu from the heap)\n",
+           stats.devices_connected, device_count, (unsigned long long)stats.checksum_errors,
+           (unsigned long long)http_stats.messages_sent, (unsigned long long)http_stats.heap_messages);
+
+    atomic_store(&running, false);
+    for (unsigned i = 0; i < device_count; i++) pthread_join(devices[i].thread, NULL);
+    for (unsigned i = 0; i < noise_count; i++) pthread_join(noise[i], NULL);
+    for (int i = 0; i < DRAINS; i++) pthread_join(drains[i], NULL);
+    gateway_destroy(gw);
+    gw_http_destroy(http);
+    gw_stream_destroy(stream);
+    for (int i = 0; i < DRAINS; i++) close(fds[i]);
+    for (unsigned i = 0; i < device_count; i++) close(devices[i].listen_fd);
+
+    uint64_t counted = allocations[PHASE_QUIET] + allocations[PHASE_CONTENDED];
+    return counted == 0 ? 0 : 2;
+}
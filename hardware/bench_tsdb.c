@@ -0,0 +1,282 @@
+// hardware/bench_tsdb.c
+// History store benchmark: logs days of 1 s samples of typical site
+// readings into a tsdb directory and compares it with raw columnar storage
+// (4-byte timestamp + 4-byte float per point): bytes per point per
+// parameter, append rate, full-range read rate, a 1000-point chart of the
+// whole range from the rollups, and the bare Gorilla decoder against a
+// memcpy of raw columns. Ends with what a year of the same data costs for
+// a fleet of sites.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "tsdb.h"
+#include "gorilla.h"
+
+#define KINDS           8
+#define BLOCK_POINTS    TSDB_DEFAULT_BLOCK_POINTS
+#define DAY             86400u
+
+static const char* kind_names[KINDS] = {
+    "dc_voltage", "load_current", "dc_power", "ac_voltage",
+    "battery_temp", "battery_soc", "rectifier_mode", "door_open",
+};
+
+static uint32_t rng = 0x12345678u;
+
+static float noise(float amplitude) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return amplitude * ((float)(rng % 2001) / 1000.0f - 1.0f);
+}
+
+// Readings as the controller reports them: fixed-point counts scaled to
+// floats, so most change in the last digit or not at all
+static float quantize(float value, float step) {
+    return roundf(value / step) * step;
+}
+
+static void sample(uint32_t t, float out[KINDS]) {
+    float voltage = quantize(53.5f + 0.2f * sinf(t / 3600.0f) + noise(0.004f), 0.001f);
+    float current = quantize(42.0f + 5.0f * sinf(t / 7200.0f) + noise(0.05f), 0.01f);
+    out[0] = voltage;
+    out[1] = current;
+    out[2] = voltage * current;
+    out[3] = quantize(230.0f + noise(0.6f), 0.1f);
+    out[4] = quantize(25.0f + 3.0f * sinf(t / 43200.0f), 0.1f);
+    out[5] = quantize(100.0f - 2.0f * (1.0f + sinf(t / 20000.0f)), 0.1f);
+    out[6] = 1.0f;
+    out[7] = (t % 40000) < 300 ? 1.0f : 0.0f;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Bare codec: the day of one parameter as 1024-point streams, decoded over
+// and over, against copying the same points out of raw columns
+static void bench_codec(const float* values, const uint32_t* times, uint32_t points) {
+    uint32_t blocks = (points + BLOCK_POINTS - 1) / BLOCK_POINTS;
+    size_t stride = (size_t)BLOCK_POINTS * 11 + GORILLA_POINT_ROOM;
+    uint8_t* streams = calloc(blocks, stride);
+    size_t* bytes = calloc(blocks, sizeof(size_t));
+    uint32_t* out_times = malloc(points * sizeof(uint32_t));
+    float* out_values = malloc(points * sizeof(float));
+    if (!streams || !bytes || !out_times || !out_values) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    for (uint32_t b = 0; b < blocks; b++) {
+        gorilla_encoder_t encoder;
+        gorilla_init(&encoder);
+        for (uint32_t i = b * BLOCK_POINTS; i < points && i < (b + 1) * BLOCK_POINTS; i++) {
+            gorilla_append(&encoder, streams + b * stride, times[i], values[i]);
+        }
+        bytes[b] = gorilla_bytes(&encoder);
+    }
+
+    uint64_t decoded = 0;
+    double t0 = now_s(), elapsed;
+    do {
+        for (uint32_t b = 0; b < blocks; b++) {
+            uint32_t first = b * BLOCK_POINTS;
+            uint32_t count = points - first < BLOCK_POINTS ? points - first : BLOCK_POINTS;
+            decoded += gorilla_decode(streams + b * stride, bytes[b], count, 0, UINT32_MAX,
+                                      out_times + first, out_values + first, count);
+        }
+    } while ((elapsed = now_s() - t0) < 0.5);
+    if (memcmp(out_values, values, points * sizeof(float)) != 0) {
+        fprintf(stderr, "Decoded values differ\n");
+        exit(1);
+    }
+    double decode_rate = decoded / elapsed;
+
+    uint64_t copied = 0;
+    t0 = now_s();
+    do {
+        memcpy(out_times, times, points * sizeof(uint32_t));
+        memcpy(out_values, values, points * sizeof(float));
+        copied += points;
+        __asm__ __volatile__("" : : "r"(out_values) : "memory");
+    } while ((elapsed = now_s() - t0) < 0.5);
+
+    printf("Gorilla decode (%s):  %.0f M points/s\n", kind_names[0], decode_rate / 1e6);
+    printf("Raw column copy:                %.0f M points/s\n", copied / elapsed / 1e6);
+    free(streams);
+    free(bytes);
+    free(out_times);
+    free(out_values);
+}
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  -d <n>      Days of 1 s samples per parameter (default 7)\n");
+    printf("  -S <n>      Sites in the yearly projection (default 2000)\n");
+    printf("  -o <dir>    Store directory, kept afterwards (default: a temporary one)\n");
+}
+
+int main(int argc, char* argv[]) {
+    unsigned days = 7, sites = 2000;
+    const char* directory = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "d:S:o:h")) != -1) {
+        switch (opt) {
+            case 'd': days = (unsigned)atoi(optarg); break;
+            case 'S': sites = (unsigned)atoi(optarg); break;
+            case 'o': directory = optarg; break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (days == 0 || days > 366 || sites == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    char temporary[] = "/tmp/netmon_bench_tsdb_XXXXXX";
+    if (!directory) {
+        if (!mkdtemp(temporary)) {
+            perror("mkdtemp");
+            return 1;
+        }
+    }
+    tsdb_config_t config;
+    tsdb_default_config(&config, directory ? directory : temporary);
+
+    // Generated up front so only storing is timed
+    uint32_t points = days * DAY;
+    const uint32_t base = 1700000000u - 1700000000u % DAY;
+    uint32_t* times = malloc(points * sizeof(uint32_t));
+    float* values[KINDS];
+    for (int k = 0; k < KINDS; k++) values[k] = malloc(points * sizeof(float));
+    for (uint32_t i = 0; i < points; i++) {
+        float row[KINDS];
+        times[i] = base + i;
+        sample(times[i], row);
+        for (int k = 0; k < KINDS; k++) values[k][i] = row[k];
+    }
+
+    // Raw columnar storage, as the store kept points before compression
+    uint32_t* raw_times = malloc((size_t)points * KINDS * sizeof(uint32_t));
+    float* raw_values = malloc((size_t)points * KINDS * sizeof(float));
+    if (!times || !raw_times || !raw_values) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    double t0 = now_s();
+    for (int k = 0; k < KINDS; k++) {
+        for (uint32_t i = 0; i < points; i++) {
+            raw_times[(size_t)k * points + i] = times[i];
+            raw_values[(size_t)k * points + i] = values[k][i];
+        }
+    }
+    double raw_append = now_s() - t0;
+
+    tsdb_t* db = tsdb_open(&config);
+    if (!db) {
+        fprintf(stderr, "Cannot open the store\n");
+        return 1;
+    }
+    uint64_t stored[KINDS];
+    double append = 0;
+    for (int k = 0; k < KINDS; k++) {
+        tsdb_stats_t before, after;
+        tsdb_get_stats(db, &before);
+        t0 = now_s();
+        for (uint32_t i = 0; i < points; i++) {
+            if (tsdb_append(db, kind_names[k], times[i], values[k][i]) != HW_STATUS_OK) {
+                fprintf(stderr, "Append failed\n");
+                return 1;
+            }
+        }
+        append += now_s() - t0;
+        tsdb_get_stats(db, &after);
+        stored[k] = after.bytes_stored - before.bytes_stored;
+    }
+    tsdb_close(db);
+
+    printf("%u days of 1 s samples, %u points per parameter\n\n", days, points);
+    printf("%-16s %12s %12s %8s\n", "parameter", "bytes/point", "raw", "ratio");
+    double site_bytes = 0;
+    for (int k = 0; k < KINDS; k++) {
+        double per_point = (double)stored[k] / points;
+        site_bytes += per_point;
+        printf("%-16s %12.3f %12.3f %7.1fx\n", kind_names[k], per_point, 8.0, 8.0 / per_point);
+    }
+    printf("%-16s %12.3f %12.3f %7.1fx\n\n", "all", site_bytes / KINDS, 8.0, 8.0 * KINDS / site_bytes);
+
+    // Reads from a fresh open, so older partitions are mapped per read
+    db = tsdb_open(&config);
+    float* out = malloc(points * sizeof(float));
+    uint64_t read = 0;
+    t0 = now_s();
+    for (int k = 0; k < KINDS; k++) {
+        uint32_t count = points;
+        tsdb_query(db, kind_names[k], base, base + points - 1, NULL, out, &count);
+        if (count != points || memcmp(out, values[k], points * sizeof(float)) != 0) {
+            fprintf(stderr, "%s read back wrong: %u points\n", kind_names[k], count);
+            return 1;
+        }
+        read += count;
+    }
+    double query = now_s() - t0;
+    t0 = now_s();
+    for (int k = 0; k < KINDS; k++) {
+        memcpy(out, raw_values + (size_t)k * points, points * sizeof(float));
+        __asm__ __volatile__("" : : "r"(out) : "memory");
+    }
+    double raw_query = now_s() - t0;
+
+    // A dashboard chart of the whole range, from the rollups
+    static hw_history_bucket_t buckets[1000];
+    uint32_t charted = 0, width = 0;
+    t0 = now_s();
+    for (int k = 0; k < KINDS; k++) {
+        uint32_t count = 1000;
+        tsdb_query_summary(db, kind_names[k], base, base + points - 1, buckets, &count, &width);
+        charted += count;
+    }
+    double chart = (now_s() - t0) / KINDS;
+    tsdb_close(db);
+
+    uint64_t total = (uint64_t)points * KINDS;
+    printf("Append:    %.1f M points/s (raw columns %.1f M points/s)\n", total / append / 1e6,
+           total / raw_append / 1e6);
+    printf("Full read: %.1f M points/s (raw columns %.1f M points/s)\n", read / query / 1e6,
+           total / raw_query / 1e6);
+    printf("Chart:     %u buckets of %u s in %.3f ms per parameter (reading the points: %.1f ms)\n",
+           charted / KINDS, width, chart * 1e3, query / KINDS * 1e3);
+    bench_codec(values[0], times, points);
+
+    double year = 365.0 * DAY * sites;
+    printf("\nOne year, %u sites x %d parameters at 1 s:\n", sites, KINDS);
+    printf("  compressed %.2f TB, raw %.2f TB\n", year * site_bytes / 1e12, year * 8.0 * KINDS / 1e12);
+    printf("  per parameter: compressed %.2f TB, raw %.2f TB\n", year * site_bytes / KINDS / 1e12,
+           year * 8.0 / 1e12);
+    // One 32-byte record per bucket of each rollup
+    double rollup_bytes = 32.0 * (1.0 / 60 + 1.0 / 900 + 1.0 / 3600 + 1.0 / DAY);
+    printf("  rollups add %.2f TB\n", year * rollup_bytes * KINDS / 1e12);
+
+    if (!directory) {
+        char command[64];
+        snprintf(command, sizeof(command), "rm -rf %s", temporary);
+        if (system(command) != 0) {
+            // Leftovers only take space in /tmp
+        }
+    }
+    for (int k = 0; k < KINDS; k++) free(values[k]);
+    free(times);
+    free(raw_times);
+    free(raw_values);
+    free(out);
+    return 0;
+}
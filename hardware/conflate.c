@@ -0,0 +1,217 @@
+#include "conflate.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define CONFLATE_NONE   UINT32_MAX
+
+typedef struct {
+    uint64_t key;
+    uint32_t next;           // FIFO order, or the free list
+    uint32_t hash_next;
+    uint32_t epoch;          // Lossless pushes seen when queued
+    uint32_t length;
+    bool lossless;
+    bool hashed;             // Reachable by key; false once superseded
+} conflate_entry_t;
+
+struct conflate_queue {
+    uint32_t max_keys;
+    uint32_t max_lossless;
+    uint32_t max_record;
+    uint32_t entry_count;
+    conflate_entry_t* entries;
+    uint8_t* records;        // entry_count slots of max_record bytes
+    uint32_t* buckets;
+    uint32_t bucket_mask;
+
+    uint32_t head;
+    uint32_t tail;
+    uint32_t free_list;
+    uint32_t epoch;
+    uint32_t hashed_count;
+    conflate_stats_t stats;
+};
+
+static uint32_t hash_key(const conflate_queue_t* q, uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return (uint32_t)key & q->bucket_mask;
+}
+
+static uint32_t find_key(const conflate_queue_t* q, uint64_t key) {
+    uint32_t i = q->buckets[hash_key(q, key)];
+    while (i != CONFLATE_NONE && q->entries[i].key != key) i = q->entries[i].hash_next;
+    return i;
+}
+
+static void unhash(conflate_queue_t* q, uint32_t index) {
+    uint32_t* link = &q->buckets[hash_key(q, q->entries[index].key)];
+    while (*link != index) link = &q->entries[*link].hash_next;
+    *link = q->entries[index].hash_next;
+    q->entries[index].hashed = false;
+    q->hashed_count--;
+}
+
+static void reset(conflate_queue_t* q) {
+    for (uint32_t i = 0; i <= q->bucket_mask; i++) q->buckets[i] = CONFLATE_NONE;
+    for (uint32_t i = 0; i < q->entry_count; i++) {
+        q->entries[i].next = i + 1 < q->entry_count ? i + 1 : CONFLATE_NONE;
+    }
+    q->free_list = 0;
+    q->head = CONFLATE_NONE;
+    q->tail = CONFLATE_NONE;
+    q->hashed_count = 0;
+    q->stats.depth = 0;
+    q->stats.lossless_depth = 0;
+}
+
+conflate_queue_t* conflate_create(uint32_t max_keys, uint32_t max_lossless, uint32_t max_record) {
+    if (max_keys == 0 || max_record == 0) return NULL;
+
+    conflate_queue_t* q = calloc(1, sizeof(conflate_queue_t));
+    if (!q) return NULL;
+
+    // Every key can have one value superseded behind a lossless record
+    // besides its live one
+    q->max_keys = max_keys;
+    q->max_lossless = max_lossless;
+    q->max_record = max_record;
+    q->entry_count = max_keys * 2 + max_lossless;
+
+    uint32_t buckets = 16;
+    while (buckets < max_keys * 2) buckets <<= 1;
+    q->bucket_mask = buckets - 1;
+
+    q->entries = calloc(q->entry_count, sizeof(conflate_entry_t));
+    q->records = malloc((size_t)q->entry_count * max_record);
+    q->buckets = malloc(buckets * sizeof(uint32_t));
+    if (!q->entries || !q->records || !q->buckets) {
+        conflate_destroy(q);
+        return NULL;
+    }
+    reset(q);
+    return q;
+}
+
+void conflate_destroy(conflate_queue_t* q) {
+    if (!q) return;
+    free(q->entries);
+    free(q->records);
+    free(q->buckets);
+    free(q);
+}
+
+static uint32_t append_entry(conflate_queue_t* q, uint64_t key, bool lossless, const uint8_t* data, uint32_t length) {
+    uint32_t index = q->free_list;
+    if (index == CONFLATE_NONE) return CONFLATE_NONE;
+    conflate_entry_t* e = &q->entries[index];
+    q->free_list = e->next;
+
+    e->key = key;
+    e->next = CONFLATE_NONE;
+    e->hash_next = CONFLATE_NONE;
+    e->epoch = q->epoch;
+    e->length = length;
+    e->lossless = lossless;
+    e->hashed = false;
+    memcpy(q->records + (size_t)index * q->max_record, data, length);
+
+    if (q->tail == CONFLATE_NONE) {
+        q->head = index;
+    } else {
+        q->entries[q->tail].next = index;
+    }
+    q->tail = index;
+    q->stats.depth++;
+    return index;
+}
+
+static void replace_entry(conflate_queue_t* q, uint32_t index, const uint8_t* data, uint32_t length) {
+    memcpy(q->records + (size_t)index * q->max_record, data, length);
+    q->entries[index].length = length;
+    q->stats.pushed++;
+    q->stats.conflated++;
+}
+
+hw_status_t conflate_push(conflate_queue_t* q, uint64_t key, bool lossless, const uint8_t* data, uint32_t length) {
+    if (!q || !data || length > q->max_record) return HW_STATUS_INVALID_PARAM;
+
+    if (lossless) {
+        if (q->stats.lossless_depth >= q->max_lossless ||
+            append_entry(q, key, true, data, length) == CONFLATE_NONE) {
+            q->stats.rejected++;
+            return HW_STATUS_ERROR;
+        }
+        q->stats.lossless_depth++;
+        q->stats.pushed++;
+        q->epoch++;
+        return HW_STATUS_OK;
+    }
+
+    uint32_t index = find_key(q, key);
+    if (index != CONFLATE_NONE && q->entries[index].epoch == q->epoch) {
+        replace_entry(q, index, data, length);
+        return HW_STATUS_OK;
+    }
+
+    if (index == CONFLATE_NONE && q->hashed_count >= q->max_keys) {
+        q->stats.rejected++;
+        return HW_STATUS_ERROR;
+    }
+    uint32_t added = append_entry(q, key, false, data, length);
+    if (added == CONFLATE_NONE) {
+        if (index == CONFLATE_NONE) {
+            q->stats.rejected++;
+            return HW_STATUS_ERROR;
+        }
+        // No entry left to queue behind the lossless records: the queued
+        // value is replaced where it stands rather than refusing a known key
+        replace_entry(q, index, data, length);
+        return HW_STATUS_OK;
+    }
+    // A value queued ahead of a lossless record stays where it is
+    if (index != CONFLATE_NONE) unhash(q, index);
+
+    uint32_t bucket = hash_key(q, key);
+    q->entries[added].hash_next = q->buckets[bucket];
+    q->entries[added].hashed = true;
+    q->buckets[bucket] = added;
+    q->hashed_count++;
+    q->stats.pushed++;
+    return HW_STATUS_OK;
+}
+
+hw_status_t conflate_pop(conflate_queue_t* q, uint8_t* out, uint32_t capacity, uint32_t* length) {
+    if (!q || !out || !length) return HW_STATUS_INVALID_PARAM;
+    if (q->head == CONFLATE_NONE) return HW_STATUS_TIMEOUT;
+
+    uint32_t index = q->head;
+    conflate_entry_t* e = &q->entries[index];
+    if (e->length > capacity) return HW_STATUS_INVALID_PARAM;
+
+    memcpy(out, q->records + (size_t)index * q->max_record, e->length);
+    *length = e->length;
+
+    if (e->hashed) unhash(q, index);
+    if (e->lossless) q->stats.lossless_depth--;
+    q->head = e->next;
+    if (q->head == CONFLATE_NONE) q->tail = CONFLATE_NONE;
+    e->next = q->free_list;
+    q->free_list = index;
+    q->stats.depth--;
+    q->stats.popped++;
+    return HW_STATUS_OK;
+}
+
+bool conflate_is_empty(const conflate_queue_t* q) {
+    return !q || q->head == CONFLATE_NONE;
+}
+
+void conflate_clear(conflate_queue_t* q) {
+    if (q) reset(q);
+}
+
+void conflate_get_stats(const conflate_queue_t* q, conflate_stats_t* stats) {
+    if (q && stats) *stats = q->stats;
+}
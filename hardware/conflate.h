@@ -0,0 +1,60 @@
+#ifndef CONFLATE_H
+#define CONFLATE_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware_interface.h"
+
+// Bounded per-subscriber queue for consumers that fall behind.
+//
+// Keyed records conflate: while a key is queued, pushing it again replaces
+// the queued value in place, so a slow consumer gets the latest value per
+// key and memory stays bounded by the number of keys. Lossless records
+// (alarms) are always queued in full. A keyed record queued before a
+// lossless one is never rewritten with a newer value; the newer value is
+// queued behind the lossless record, so delivery order never puts a fresh
+// value ahead of an older alarm. The one exception is a full queue: with no
+// entry left, a queued key takes the new value in place instead.
+//
+// Push and pop are O(1) and allocation-free. Not thread-safe; one thread
+// owns a queue.
+
+typedef struct {
+    uint64_t pushed;
+    uint64_t conflated;          // Pushes that replaced a queued value
+    uint64_t popped;
+    uint64_t rejected;           // Pushes refused because the queue was full
+    uint32_t depth;
+    uint32_t lossless_depth;
+} conflate_stats_t;
+
+typedef struct conflate_queue conflate_queue_t;
+
+// Holds up to max_keys distinct keyed values and max_lossless lossless
+// records, each at most max_record bytes
+conflate_queue_t* conflate_create(uint32_t max_keys, uint32_t max_lossless, uint32_t max_record);
+void conflate_destroy(conflate_queue_t* queue);
+
+// HW_STATUS_ERROR when the key or lossless budget is exhausted; a key that
+// is already queued is always taken. The caller decides whether that
+// subscriber is dropped
+hw_status_t conflate_push(conflate_queue_t* queue, uint64_t key, bool lossless,
+                          const uint8_t* data, uint32_t length);
+
+// Copies out the oldest record. HW_STATUS_TIMEOUT when empty,
+// HW_STATUS_INVALID_PARAM when capacity is too small (the record stays queued).
+hw_status_t conflate_pop(conflate_queue_t* queue, uint8_t* out, uint32_t capacity, uint32_t* length);
+
+bool conflate_is_empty(const conflate_queue_t* queue);
+void conflate_clear(conflate_queue_t* queue);
+void conflate_get_stats(const conflate_queue_t* queue, conflate_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // CONFLATE_H
@@ -0,0 +1,1458 @@
+#define _GNU_SOURCE
+#include "gateway.h"
+#include "backoff.h"
+#include "hw_stats.h"
+#include "thresholds.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <termios.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define GW_READ_BUFFER_SIZE  65536
+#define GW_EPOLL_BATCH       128
+#define GW_TICK_MS           100
+#define GW_HANDSHAKE_MS      2000   // A silent link gives its connect slot back after this
+
+typedef struct gw_worker gw_worker_t;
+
+// Immutable once published; freed after every worker has passed a
+// quiescent point (the top of its loop) since it was replaced
+typedef struct gw_threshold_set {
+    uint32_t version;
+    uint32_t count;
+    uint64_t retired_epoch;
+    struct gw_threshold_set* next_retired;
+    gw_threshold_t items[];
+} gw_threshold_set_t;
+
+// One device link, owned by exactly one worker thread
+typedef struct {
+    gw_device_config_t config;
+    gw_worker_t* worker;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    bool resolved;
+    int fd;
+    gw_session_state_t state;
+    uint64_t next_attempt_ms;
+    backoff_t backoff;
+    // Startup pacing
+    bool handshaking;             // Holds a connect slot
+    uint64_t handshake_deadline_ms;
+    bool urgent_waiting;          // Counted in gateway urgent_waiting
+    bool live;                    // Has sent a frame since start
+    uint64_t ingest_ns;
+    uint32_t sequence;
+    // Device-side sequence tracking for RESUME
+    bool synced;
+    uint32_t device_session;
+    uint32_t device_sequence;     // Expected sequence of the next device frame
+    stm32_decoder_t decoder;
+    pthread_mutex_t lock;   // Guards model against concurrent readers
+    gw_device_state_t model;
+    // Demand-driven rates: watchers are counted from any thread, the
+    // owning worker turns changes into rate commands
+    atomic_uint watchers[GW_RATE_CATEGORIES];
+    atomic_bool rates_dirty;
+    atomic_uint applied_period[GW_RATE_CATEGORIES];   // 0 = not sent on this link
+    atomic_uint thresholds_sent;  // Set version sent on this link; 0 = none
+} gw_session_t;
+
+struct gw_worker {
+    gateway_t* gw;
+    pthread_t thread;
+    int epoll_fd;
+    int wake_fd;
+    gw_session_t** sessions;
+    uint32_t session_count;
+    // Counters are written by the owning thread only
+    atomic_uint_fast64_t frames_in;
+    atomic_uint_fast64_t bytes_in;
+    atomic_uint_fast64_t checksum_errors;
+    atomic_uint_fast64_t sync_errors;
+    atomic_uint_fast64_t connect_attempts;
+    atomic_uint_fast64_t resumes;
+    atomic_uint_fast64_t keyframes;
+    atomic_uint_fast64_t rate_commands;
+    atomic_uint_fast64_t threshold_pushes;
+    atomic_uint_fast64_t quiescent;   // Threshold epoch seen at the top of the loop
+    atomic_uint connected;
+    atomic_bool rates_pending;  // Some session has rates_dirty set
+    atomic_bool slot_wanted;    // A due session found no connect slot
+    atomic_bool thresholds_pending;   // A new threshold set was published
+};
+
+typedef struct {
+    gw_sink_fn_t fn;
+    void* user_data;
+} gw_sink_t;
+
+struct gateway {
+    gw_config_t config;
+    gw_session_t* sessions;     // Sorted by device_id once started
+    uint32_t session_count;
+    uint32_t session_capacity;
+    gw_worker_t* workers;
+    uint32_t worker_count;
+    gw_sink_t sinks[GW_MAX_SINKS];
+    uint32_t sink_count;
+    atomic_bool running;
+    bool started;
+    // Startup pacing; see gw_config_t
+    atomic_uint connects_in_flight;
+    atomic_uint urgent_waiting;   // Alarming devices due but without a slot
+    atomic_uint devices_pending;  // Devices yet to send their first frame
+    atomic_uint restored;
+    uint64_t start_ns;
+    atomic_uint_fast64_t startup_ns;
+    // Threshold sets: readers load the pointer, writers swap it under the lock
+    _Atomic(gw_threshold_set_t*) thresholds;
+    pthread_mutex_t thresholds_lock;
+    gw_threshold_set_t* retired;
+    atomic_uint_fast64_t thresholds_epoch;
+};
+
+uint64_t gw_monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static uint64_t monotonic_ms(void) {
+    return gw_monotonic_ns() / 1000000ull;
+}
+
+void gateway_default_config(gw_config_t* config) {
+    if (!config) return;
+    config->thread_count = 4;
+    config->connect_parallelism = 64;
+    config->reconnect_interval_ms = 2000;
+    config->reconnect_initial_ms = 50;
+    config->fast_period_ms = 100;
+    config->background_period_ms = 10000;
+}
+
+gateway_t* gateway_create(const gw_config_t* config) {
+    gateway_t* gw = calloc(1, sizeof(gateway_t));
+    if (!gw) return NULL;
+
+    if (config) {
+        gw->config = *config;
+    } else {
+        gateway_default_config(&gw->config);
+    }
+    if (gw->config.thread_count == 0) gw->config.thread_count = 1;
+    if (gw->config.thread_count > GW_MAX_THREADS) gw->config.thread_count = GW_MAX_THREADS;
+    if (gw->config.reconnect_initial_ms == 0 ||
+        gw->config.reconnect_initial_ms > gw->config.reconnect_interval_ms) {
+        gw->config.reconnect_initial_ms = gw->config.reconnect_interval_ms;
+    }
+    atomic_init(&gw->running, false);
+    pthread_mutex_init(&gw->thresholds_lock, NULL);
+    return gw;
+}
+
+void gateway_destroy(gateway_t* gw) {
+    if (!gw) return;
+
+    gateway_stop(gw);
+    if (gw->started) {
+        for (uint32_t i = 0; i < gw->session_count; i++) {
+            pthread_mutex_destroy(&gw->sessions[i].lock);
+        }
+    }
+    free(gw->sessions);
+    // Workers are gone; nothing can still hold a set
+    free(atomic_load_explicit(&gw->thresholds, memory_order_relaxed));
+    while (gw->retired) {
+        gw_threshold_set_t* next = gw->retired->next_retired;
+        free(gw->retired);
+        gw->retired = next;
+    }
+    pthread_mutex_destroy(&gw->thresholds_lock);
+    free(gw);
+}
+
+hw_status_t gateway_add_device(gateway_t* gw, const gw_device_config_t* device) {
+    if (!gw || !device || gw->started || gw->session_count >= GW_MAX_DEVICES) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    for (uint32_t i = 0; i < gw->session_count; i++) {
+        if (gw->sessions[i].config.device_id == device->device_id) {
+            return HW_STATUS_INVALID_PARAM;
+        }
+    }
+
+    if (gw->session_count == gw->session_capacity) {
+        uint32_t capacity = gw->session_capacity ? gw->session_capacity * 2 : 16;
+        gw_session_t* grown = realloc(gw->sessions, capacity * sizeof(gw_session_t));
+        if (!grown) return HW_STATUS_ERROR;
+        gw->sessions = grown;
+        gw->session_capacity = capacity;
+    }
+
+    gw_session_t* s = &gw->sessions[gw->session_count++];
+    memset(s, 0, sizeof(*s));
+    s->config = *device;
+    s->config.address[sizeof(s->config.address) - 1] = '\0';
+    s->fd = -1;
+    s->model.device_id = device->device_id;
+    stm32_decoder_init(&s->decoder);
+    return HW_STATUS_OK;
+}
+
+// Device file format, one device per line:
+//   <device_id> tcp <host> <port>
+//   <device_id> serial <path> <baud>
+hw_status_t gateway_load_devices(gateway_t* gw, const char* path) {
+    if (!gw || !path) return HW_STATUS_INVALID_PARAM;
+
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Gateway: cannot open device list %s: %s\n", path, strerror(errno));
+        return HW_STATUS_ERROR;
+    }
+
+    char line[256];
+    unsigned line_no = 0;
+    hw_status_t result = HW_STATUS_OK;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+        unsigned id = 0;
+        unsigned long param = 0;
+        char link[16], address[128];
+        if (sscanf(p, "%u %15s %127s %lu", &id, link, address, &param) != 4 || id > 0xFFFF) {
+            fprintf(stderr, "Gateway: %s:%u: malformed device entry\n", path, line_no);
+            result = HW_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        gw_device_config_t dev;
+        memset(&dev, 0, sizeof(dev));
+        dev.device_id = (uint16_t)id;
+        snprintf(dev.address, sizeof(dev.address), "%s", address);
+        if (strcmp(link, "tcp") == 0 && param > 0 && param <= 0xFFFF) {
+            dev.link_type = GW_LINK_TCP;
+            dev.port = (uint16_t)param;
+        } else if (strcmp(link, "serial") == 0) {
+            dev.link_type = GW_LINK_SERIAL;
+            dev.baud_rate = (uint32_t)param;
+        } else {
+            fprintf(stderr, "Gateway: %s:%u: unknown link '%s'\n", path, line_no, link);
+            result = HW_STATUS_INVALID_PARAM;
+            break;
+        }
+
+        result = gateway_add_device(gw, &dev);
+        if (result != HW_STATUS_OK) {
+            fprintf(stderr, "Gateway: %s:%u: duplicate or excess device %u\n", path, line_no, id);
+            break;
+        }
+    }
+
+    fclose(f);
+    return result;
+}
+
+hw_status_t gateway_add_sink(gateway_t* gw, gw_sink_fn_t sink, void* user_data) {
+    if (!gw || !sink || gw->started || gw->sink_count >= GW_MAX_SINKS) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    gw->sinks[gw->sink_count].fn = sink;
+    gw->sinks[gw->sink_count].user_data = user_data;
+    gw->sink_count++;
+    return HW_STATUS_OK;
+}
+
+// Tagged frame helpers
+size_t gateway_encode_tagged(uint16_t device_id, uint32_t sequence, const stm32_frame_t* frame, uint8_t* out) {
+    if (!frame || !out) return 0;
+
+    out[0] = GW_TAG_MAGIC_HIGH;
+    out[1] = GW_TAG_MAGIC_LOW;
+    out[2] = (uint8_t)(device_id & 0xFF);
+    out[3] = (uint8_t)(device_id >> 8);
+    out[4] = (uint8_t)(sequence & 0xFF);
+    out[5] = (uint8_t)((sequence >> 8) & 0xFF);
+    out[6] = (uint8_t)((sequence >> 16) & 0xFF);
+    out[7] = (uint8_t)(sequence >> 24);
+    size_t n = stm32_encode_frame(frame->type, frame->data, frame->length, out + GW_TAG_HEADER_SIZE);
+    return n ? n + GW_TAG_HEADER_SIZE : 0;
+}
+
+size_t gateway_decode_tagged(const uint8_t* bytes, size_t length, uint16_t* device_id,
+                             uint32_t* sequence, stm32_frame_t* frame) {
+    if (!bytes || length < GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD ||
+        bytes[0] != GW_TAG_MAGIC_HIGH || bytes[1] != GW_TAG_MAGIC_LOW) {
+        return 0;
+    }
+
+    const uint8_t* f = bytes + GW_TAG_HEADER_SIZE;
+    uint8_t data_len = f[3];
+    size_t total = GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD + data_len;
+    if (f[0] != STM32_HEADER_HIGH || f[1] != STM32_HEADER_LOW ||
+        data_len > STM32_MAX_FRAME_DATA || length < total ||
+        stm32_calculate_checksum(f, (uint8_t)(data_len + 4)) != f[4 + data_len]) {
+        return 0;
+    }
+
+    if (device_id) *device_id = (uint16_t)(bytes[2] | (bytes[3] << 8));
+    if (sequence) {
+        *sequence = (uint32_t)bytes[4] | ((uint32_t)bytes[5] << 8) |
+                    ((uint32_t)bytes[6] << 16) | ((uint32_t)bytes[7] << 24);
+    }
+    if (frame) {
+        frame->type = f[2];
+        frame->length = data_len;
+        memcpy(frame->data, f + 4, data_len);
+    }
+    return total;
+}
+
+bool gateway_conflation_key(const uint8_t* bytes, size_t length, uint64_t* key) {
+    if (!bytes || length < GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD) return false;
+
+    const uint8_t* f = bytes + GW_TAG_HEADER_SIZE;
+    uint8_t record_id;
+    switch (f[2]) {
+        case PACKET_TYPE_POWER_MODULE:
+        case PACKET_TYPE_BATTERY:
+        case PACKET_TYPE_AC_INPUT:
+        case PACKET_TYPE_DC_OUTPUT:
+            // Record id leads every per-record payload
+            if (f[3] == 0) return false;
+            record_id = f[4];
+            break;
+        case PACKET_TYPE_SYSTEM_STATUS:
+            record_id = 0;
+            break;
+        default:
+            return false;
+    }
+    if (key) {
+        uint16_t device_id = (uint16_t)(bytes[2] | (bytes[3] << 8));
+        *key = ((uint64_t)device_id << 16) | ((uint64_t)f[2] << 8) | record_id;
+    }
+    return true;
+}
+
+// Device model updates
+static void model_apply_alarm(gw_device_state_t* m, const alarm_t* alarm) {
+    HW_STATS_SCOPE(HW_OP_ALARM_EVALUATION);
+    for (uint8_t i = 0; i < m->alarm_count; i++) {
+        if (m->alarms[i].alarm_id == alarm->alarm_id) {
+            if (alarm->is_active) {
+                m->alarms[i] = *alarm;
+            } else {
+                m->alarms[i] = m->alarms[--m->alarm_count];
+            }
+            return;
+        }
+    }
+
+    if (!alarm->is_active) return;
+    if (m->alarm_count < GW_MAX_ALARMS) {
+        m->alarms[m->alarm_count++] = *alarm;
+    } else {
+        // Keep the most recent alarms; replace the oldest
+        uint8_t oldest = 0;
+        for (uint8_t i = 1; i < m->alarm_count; i++) {
+            if (m->alarms[i].timestamp < m->alarms[oldest].timestamp) oldest = i;
+        }
+        m->alarms[oldest] = *alarm;
+    }
+}
+
+// Records are 1-based on the wire; slot = id - 1
+#define MODEL_PUT(arr, count, max, id, rec)                  \
+    do {                                                     \
+        if ((id) == 0 || (id) > (max)) return false;         \
+        (arr)[(id) - 1] = (rec);                             \
+        if ((count) < (id)) (count) = (uint8_t)(id);         \
+    } while (0)
+
+static bool model_apply(gw_device_state_t* m, const stm32_frame_t* frame) {
+    switch (frame->type) {
+        case PACKET_TYPE_POWER_MODULE: {
+            power_module_t rec;
+            if (!stm32_decode_power_module(frame, &rec)) return false;
+            MODEL_PUT(m->power_modules, m->power_module_count, GW_MAX_POWER_MODULES, rec.module_id, rec);
+            break;
+        }
+        case PACKET_TYPE_BATTERY: {
+            battery_info_t rec;
+            if (!stm32_decode_battery(frame, &rec)) return false;
+            MODEL_PUT(m->batteries, m->battery_count, GW_MAX_BATTERIES, rec.battery_id, rec);
+            break;
+        }
+        case PACKET_TYPE_AC_INPUT: {
+            ac_phase_t rec;
+            if (!stm32_decode_ac_input(frame, &rec)) return false;
+            MODEL_PUT(m->ac_phases, m->ac_phase_count, GW_MAX_AC_PHASES, rec.phase_id, rec);
+            break;
+        }
+        case PACKET_TYPE_DC_OUTPUT: {
+            dc_circuit_t rec;
+            if (!stm32_decode_dc_output(frame, &rec)) return false;
+            MODEL_PUT(m->dc_circuits, m->dc_circuit_count, GW_MAX_DC_CIRCUITS, rec.circuit_id, rec);
+            break;
+        }
+        case PACKET_TYPE_ALARM: {
+            alarm_t rec;
+            if (!stm32_decode_alarm(frame, &rec)) return false;
+            model_apply_alarm(m, &rec);
+            break;
+        }
+        case PACKET_TYPE_SYSTEM_STATUS: {
+            system_status_t rec;
+            if (!stm32_decode_system_status(frame, &rec)) return false;
+            m->system_status = rec;
+            break;
+        }
+        default:
+            // Responses and unknown types are forwarded but not modelled
+            return true;
+    }
+
+    m->frames_received++;
+    m->last_update_ms = monotonic_ms();
+    return true;
+}
+
+// Demand-driven rates
+
+// Categories in command order; index into watchers/applied_period
+static const uint8_t rate_categories[GW_RATE_CATEGORIES] = {
+    PACKET_TYPE_POWER_MODULE, PACKET_TYPE_BATTERY, PACKET_TYPE_AC_INPUT,
+    PACKET_TYPE_DC_OUTPUT, PACKET_TYPE_SYSTEM_STATUS
+};
+
+static int rate_index(uint8_t category) {
+    for (int i = 0; i < GW_RATE_CATEGORIES; i++) {
+        if (rate_categories[i] == category) return i;
+    }
+    return -1;
+}
+
+// Periods travel in STM32_RATE_UNIT_MS steps in a u8
+static uint8_t rate_parameter(uint32_t period_ms) {
+    uint32_t units = period_ms / STM32_RATE_UNIT_MS;
+    if (units == 0) units = 1;
+    return units > 255 ? 255 : (uint8_t)units;
+}
+
+static void session_close(gw_session_t* s);
+
+// Writes a burst of command frames whole. EAGAIN (socket or serial buffer
+// full) sends nothing and returns false with the link up, to retry later.
+// Any other failure, or a burst cut short, would leave part of a frame on
+// the wire: the link is closed and everything is re-sent after reconnecting.
+static bool session_send(gw_session_t* s, const uint8_t* wire, size_t length) {
+    ssize_t n = write(s->fd, wire, length);
+    if (n == (ssize_t)length) return true;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return false;
+    session_close(s);
+    return false;
+}
+
+static void session_mark_rates(gw_session_t* s) {
+    atomic_store_explicit(&s->rates_dirty, true, memory_order_relaxed);
+    atomic_store_explicit(&s->worker->rates_pending, true, memory_order_release);
+}
+
+// Sends a rate command for every category whose wanted period changed,
+// or one for all of them when they all move to the same period
+static void session_apply_rates(gw_session_t* s) {
+    gateway_t* gw = s->worker->gw;
+    if (!atomic_exchange_explicit(&s->rates_dirty, false, memory_order_acq_rel)) return;
+    if (s->state != GW_SESSION_CONNECTED || gw->config.background_period_ms == 0) return;
+
+    pthread_mutex_lock(&s->lock);
+    bool alarming = s->model.alarm_count > 0;
+    pthread_mutex_unlock(&s->lock);
+
+    uint8_t wanted[GW_RATE_CATEGORIES];
+    uint32_t changed = 0;
+    bool uniform = true;
+    for (int i = 0; i < GW_RATE_CATEGORIES; i++) {
+        bool fast = alarming || atomic_load_explicit(&s->watchers[i], memory_order_relaxed) > 0;
+        wanted[i] = rate_parameter(fast ? gw->config.fast_period_ms : gw->config.background_period_ms);
+        if (wanted[i] != wanted[0]) uniform = false;
+        if (atomic_load_explicit(&s->applied_period[i], memory_order_relaxed) !=
+            (uint32_t)wanted[i] * STM32_RATE_UNIT_MS) {
+            changed++;
+        }
+    }
+    if (changed == 0) return;
+
+    uint8_t wire[GW_RATE_CATEGORIES * (STM32_FRAME_OVERHEAD + STM32_WIRE_COMMAND_SIZE)];
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    size_t length = 0;
+    uint32_t commands = 0;
+    stm32_command_t command = {STM32_CMD_SET_RATE, 0, STM32_CMD_ACTION_RATE, 0, 0};
+    for (int i = 0; i < GW_RATE_CATEGORIES; i++) {
+        uint32_t period = (uint32_t)wanted[i] * STM32_RATE_UNIT_MS;
+        bool all = uniform && changed == GW_RATE_CATEGORIES;
+        if (all ? i > 0 : atomic_load_explicit(&s->applied_period[i], memory_order_relaxed) == period) continue;
+        command.target_id = all ? 0 : rate_categories[i];
+        command.parameter = wanted[i];
+        length += stm32_encode_frame(PACKET_TYPE_COMMAND, data, stm32_encode_command(&command, data), wire + length);
+        commands++;
+    }
+    if (!session_send(s, wire, length)) {
+        // Buffer full: the next loop pass tries again
+        if (s->fd >= 0) session_mark_rates(s);
+        return;
+    }
+    atomic_fetch_add_explicit(&s->worker->rate_commands, commands, memory_order_relaxed);
+    for (int i = 0; i < GW_RATE_CATEGORIES; i++) {
+        atomic_store_explicit(&s->applied_period[i], (uint32_t)wanted[i] * STM32_RATE_UNIT_MS,
+                              memory_order_relaxed);
+    }
+}
+
+// Threshold sets
+
+// Sends the current set as SETs then a COMMIT, seven commands to a batch
+// frame, in one write. The device only switches on the commit, and a link
+// cut mid-set leaves an uncommitted draft the next RESUME discards.
+static void session_apply_thresholds(gw_session_t* s) {
+    if (s->state != GW_SESSION_CONNECTED) return;
+    const gw_threshold_set_t* set = atomic_load_explicit(&s->worker->gw->thresholds, memory_order_acquire);
+    if (!set || atomic_load_explicit(&s->thresholds_sent, memory_order_relaxed) == set->version) return;
+
+    uint8_t wire[(GW_MAX_THRESHOLDS / STM32_MAX_BATCH_COMMANDS + 1) * STM32_MAX_PACKET_SIZE];
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    stm32_command_t batch[STM32_MAX_BATCH_COMMANDS];
+    size_t length = 0;
+    uint8_t count = 0;
+    for (uint32_t i = 0; i <= set->count; i++) {
+        stm32_command_t* c = &batch[count++];
+        c->command_id = STM32_CMD_THRESHOLD;
+        if (i < set->count) {
+            c->target_id = set->items[i].key;
+            c->action = STM32_CMD_ACTION_SET;
+            c->parameter = set->items[i].index;
+            c->reserved = set->items[i].value;
+        } else {
+            c->target_id = 0;
+            c->action = STM32_CMD_ACTION_COMMIT;
+            c->parameter = 0;
+            c->reserved = set->version;
+        }
+        if (count == STM32_MAX_BATCH_COMMANDS || i == set->count) {
+            length += stm32_encode_frame(PACKET_TYPE_COMMAND_BATCH, data,
+                                         stm32_encode_command_batch(batch, count, data), wire + length);
+            count = 0;
+        }
+    }
+    if (!session_send(s, wire, length)) {
+        // Buffer full: the next loop pass tries again
+        if (s->fd >= 0) atomic_store_explicit(&s->worker->thresholds_pending, true, memory_order_release);
+        return;
+    }
+    atomic_store_explicit(&s->thresholds_sent, set->version, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->worker->threshold_pushes, 1, memory_order_relaxed);
+}
+
+// Frees retired sets every worker has moved past. Called with
+// thresholds_lock held.
+static void thresholds_reclaim(gateway_t* gw) {
+    uint64_t oldest = UINT64_MAX;
+    if (gw->started && gw->workers) {
+        for (uint32_t i = 0; i < gw->worker_count; i++) {
+            uint64_t seen = atomic_load_explicit(&gw->workers[i].quiescent, memory_order_acquire);
+            if (seen < oldest) oldest = seen;
+        }
+    }
+
+    gw_threshold_set_t** link = &gw->retired;
+    while (*link) {
+        gw_threshold_set_t* set = *link;
+        if (set->retired_epoch <= oldest) {
+            *link = set->next_retired;
+            free(set);
+        } else {
+            link = &set->next_retired;
+        }
+    }
+}
+
+// Connect slots
+
+// Alarming devices count as urgent. The model is only written on the owning
+// worker, which is the only caller, so no lock is needed to read it.
+static bool session_take_slot(gw_session_t* s) {
+    gateway_t* gw = s->worker->gw;
+    uint32_t limit = gw->config.connect_parallelism;
+    bool urgent = s->model.alarm_count > 0;
+
+    // Other devices leave slots free for alarming ones already waiting
+    uint32_t reserved = urgent ? 0 : atomic_load_explicit(&gw->urgent_waiting, memory_order_relaxed);
+    uint32_t n = atomic_load_explicit(&gw->connects_in_flight, memory_order_relaxed);
+    do {
+        if (limit && n + reserved >= limit) {
+            if (urgent && !s->urgent_waiting) {
+                s->urgent_waiting = true;
+                atomic_fetch_add_explicit(&gw->urgent_waiting, 1, memory_order_relaxed);
+            }
+            atomic_store_explicit(&s->worker->slot_wanted, true, memory_order_relaxed);
+            return false;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&gw->connects_in_flight, &n, n + 1,
+                                                    memory_order_relaxed, memory_order_relaxed));
+    if (s->urgent_waiting) {
+        s->urgent_waiting = false;
+        atomic_fetch_sub_explicit(&gw->urgent_waiting, 1, memory_order_relaxed);
+    }
+    s->handshaking = true;
+    s->handshake_deadline_ms = monotonic_ms() + GW_HANDSHAKE_MS;
+    return true;
+}
+
+// Wakes every worker that has a session waiting for a slot
+static void session_release_slot(gw_session_t* s) {
+    if (!s->handshaking) return;
+    s->handshaking = false;
+
+    gateway_t* gw = s->worker->gw;
+    atomic_fetch_sub_explicit(&gw->connects_in_flight, 1, memory_order_relaxed);
+    for (uint32_t i = 0; i < gw->worker_count; i++) {
+        gw_worker_t* w = &gw->workers[i];
+        if (atomic_load_explicit(&w->slot_wanted, memory_order_relaxed) &&
+            atomic_exchange_explicit(&w->slot_wanted, false, memory_order_relaxed)) {
+            uint64_t one = 1;
+            if (write(w->wake_fd, &one, sizeof(one)) < 0) {
+                // eventfd counter saturated; the worker is already awake
+            }
+        }
+    }
+}
+
+// First frame on a link ends its handshake
+static void session_on_data(gw_session_t* s) {
+    session_release_slot(s);
+    if (s->live) return;
+    s->live = true;
+    gateway_t* gw = s->worker->gw;
+    if (atomic_fetch_sub_explicit(&gw->devices_pending, 1, memory_order_relaxed) == 1) {
+        atomic_store_explicit(&gw->startup_ns, gw_monotonic_ns() - gw->start_ns, memory_order_relaxed);
+    }
+}
+
+// SYNC frames are link control: they re-anchor sequence tracking and are
+// not forwarded to sinks
+static void session_on_sync(gw_session_t* s, const stm32_frame_t* frame) {
+    stm32_sync_t sync;
+    if (!stm32_decode_sync(frame, &sync)) return;
+
+    s->synced = true;
+    s->device_session = sync.session_id;
+    s->device_sequence = sync.next_sequence;
+    if (sync.mode == STM32_SYNC_KEYFRAME) {
+        // The keyframe re-sends every active alarm; stale ones must go. A
+        // restored model also drops records the device may no longer have.
+        pthread_mutex_lock(&s->lock);
+        gw_device_state_t* m = &s->model;
+        m->alarm_count = 0;
+        bool was_restored = m->restored;
+        if (was_restored) {
+            m->power_module_count = m->battery_count = m->ac_phase_count = m->dc_circuit_count = 0;
+            m->restored = false;
+        }
+        pthread_mutex_unlock(&s->lock);
+        if (was_restored) atomic_fetch_sub_explicit(&s->worker->gw->restored, 1, memory_order_relaxed);
+        session_mark_rates(s);
+        atomic_fetch_add_explicit(&s->worker->keyframes, 1, memory_order_relaxed);
+    } else if (sync.mode == STM32_SYNC_RESUMED) {
+        atomic_fetch_add_explicit(&s->worker->resumes, 1, memory_order_relaxed);
+    }
+}
+
+// Frame handler; runs on the worker thread owning the session
+static void session_on_frame(const stm32_frame_t* frame, void* user_data) {
+    gw_session_t* s = user_data;
+    gateway_t* gw = s->worker->gw;
+
+    if (s->handshaking || !s->live) session_on_data(s);
+    if (frame->type == PACKET_TYPE_SYNC) {
+        session_on_sync(s, frame);
+        return;
+    }
+    // The link is healthy once data flows; the next drop retries fast again
+    backoff_reset(&s->backoff);
+    if (s->synced) s->device_sequence++;
+
+    pthread_mutex_lock(&s->lock);
+    bool valid = model_apply(&s->model, frame);
+    bool was_restored = valid && s->model.restored;
+    if (was_restored) s->model.restored = false;
+    pthread_mutex_unlock(&s->lock);
+    if (was_restored) atomic_fetch_sub_explicit(&gw->restored, 1, memory_order_relaxed);
+    if (!valid) return;
+    // Alarms raise or lower the device's rates once the read batch is done
+    if (frame->type == PACKET_TYPE_ALARM) session_mark_rates(s);
+
+    uint8_t wire[GW_MAX_TAGGED_SIZE];
+    gw_tagged_frame_t tagged;
+    tagged.device_id = s->config.device_id;
+    tagged.sequence = s->sequence++;
+    tagged.ingest_ns = s->ingest_ns;
+    tagged.frame = frame;
+    tagged.wire = wire;
+    tagged.wire_length = gateway_encode_tagged(tagged.device_id, tagged.sequence, frame, wire);
+
+    atomic_fetch_add_explicit(&s->worker->frames_in, 1, memory_order_relaxed);
+    for (uint32_t i = 0; i < gw->sink_count; i++) {
+        gw->sinks[i].fn(&tagged, gw->sinks[i].user_data);
+    }
+}
+
+// Link management
+static void session_set_state(gw_session_t* s, gw_session_state_t state) {
+    if (s->state == GW_SESSION_CONNECTED && state != GW_SESSION_CONNECTED) {
+        atomic_fetch_sub_explicit(&s->worker->connected, 1, memory_order_relaxed);
+    } else if (s->state != GW_SESSION_CONNECTED && state == GW_SESSION_CONNECTED) {
+        atomic_fetch_add_explicit(&s->worker->connected, 1, memory_order_relaxed);
+    }
+
+    s->state = state;
+    pthread_mutex_lock(&s->lock);
+    s->model.state = state;
+    pthread_mutex_unlock(&s->lock);
+}
+
+static void session_close(gw_session_t* s) {
+    if (s->fd >= 0) {
+        epoll_ctl(s->worker->epoll_fd, EPOLL_CTL_DEL, s->fd, NULL);
+        close(s->fd);
+        s->fd = -1;
+    }
+    session_release_slot(s);
+    stm32_decoder_reset(&s->decoder);
+    session_set_state(s, GW_SESSION_DISCONNECTED);
+    for (int i = 0; i < GW_RATE_CATEGORIES; i++) {
+        atomic_store_explicit(&s->applied_period[i], 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&s->thresholds_sent, 0, memory_order_relaxed);
+    s->next_attempt_ms = monotonic_ms() + backoff_next(&s->backoff);
+}
+
+// Link is up: ask the device to replay what was missed, or for a keyframe
+// if this gateway has never seen its sequence
+static void session_on_connected(gw_session_t* s) {
+    session_set_state(s, GW_SESSION_CONNECTED);
+
+    stm32_resume_t resume;
+    resume.session_id = s->synced ? s->device_session : 0;
+    resume.last_sequence = s->device_sequence - 1;
+    resume.flags = s->synced ? 0 : STM32_RESUME_FLAG_KEYFRAME;
+
+    uint8_t data[STM32_MAX_FRAME_DATA], wire[STM32_MAX_PACKET_SIZE];
+    size_t n = stm32_encode_frame(PACKET_TYPE_RESUME, data, stm32_encode_resume(&resume, data), wire);
+    if (write(s->fd, wire, n) != (ssize_t)n) {
+        // Usually a link that is already gone, but a reopened serial line
+        // can still be full. Without the RESUME the device would keep a
+        // draft cut off on the last link, so try again later.
+        session_close(s);
+        return;
+    }
+    // The device may have restarted with its own defaults
+    session_mark_rates(s);
+    session_apply_thresholds(s);
+}
+
+static speed_t baud_to_speed(uint32_t baud) {
+    switch (baud) {
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default:     return B115200;
+    }
+}
+
+static int open_serial(const gw_device_config_t* cfg) {
+    int fd = open(cfg->address, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, baud_to_speed(cfg->baud_rate));
+        cfsetospeed(&tio, baud_to_speed(cfg->baud_rate));
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+// Runs on the owning worker at the first connect, so lookups for many
+// devices proceed on every thread at once instead of before start
+static bool session_resolve(gw_session_t* s) {
+    if (s->config.link_type != GW_LINK_TCP || s->resolved) return true;
+
+    char port[8];
+    snprintf(port, sizeof(port), "%u", s->config.port);
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(s->config.address, port, &hints, &res) != 0 || !res) {
+        fprintf(stderr, "Gateway: device %u: cannot resolve %s\n", s->config.device_id, s->config.address);
+        return false;
+    }
+    memcpy(&s->addr, res->ai_addr, res->ai_addrlen);
+    s->addr_len = res->ai_addrlen;
+    s->resolved = true;
+    freeaddrinfo(res);
+    return true;
+}
+
+static void session_connect(gw_session_t* s) {
+    gw_worker_t* w = s->worker;
+    atomic_fetch_add_explicit(&w->connect_attempts, 1, memory_order_relaxed);
+
+    if (!session_resolve(s)) {
+        session_close(s);
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.data.ptr = s;
+
+    if (s->config.link_type == GW_LINK_SERIAL) {
+        s->fd = open_serial(&s->config);
+        if (s->fd < 0) {
+            session_close(s);
+            return;
+        }
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, s->fd, &ev);
+        session_on_connected(s);
+        return;
+    }
+
+    s->fd = socket(s->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (s->fd < 0) {
+        session_close(s);
+        return;
+    }
+    int one = 1;
+    setsockopt(s->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(s->fd, (struct sockaddr*)&s->addr, s->addr_len) == 0) {
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, s->fd, &ev);
+        session_on_connected(s);
+    } else if (errno == EINPROGRESS) {
+        ev.events = EPOLLOUT;
+        epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, s->fd, &ev);
+        session_set_state(s, GW_SESSION_CONNECTING);
+    } else {
+        session_close(s);
+    }
+}
+
+static void session_on_writable(gw_session_t* s) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(s->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        session_close(s);
+        return;
+    }
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = s;
+    epoll_ctl(s->worker->epoll_fd, EPOLL_CTL_MOD, s->fd, &ev);
+    session_on_connected(s);
+}
+
+static void session_on_readable(gw_session_t* s, uint8_t* buffer) {
+    gw_worker_t* w = s->worker;
+
+    for (;;) {
+        ssize_t n = read(s->fd, buffer, GW_READ_BUFFER_SIZE);
+        if (n > 0) {
+            uint32_t checksum_errors = s->decoder.checksum_errors;
+            uint32_t sync_errors = s->decoder.sync_errors;
+            s->ingest_ns = gw_monotonic_ns();
+            atomic_fetch_add_explicit(&w->bytes_in, (uint64_t)n, memory_order_relaxed);
+            stm32_decoder_feed(&s->decoder, buffer, (size_t)n, session_on_frame, s);
+            atomic_fetch_add_explicit(&w->checksum_errors, s->decoder.checksum_errors - checksum_errors,
+                                      memory_order_relaxed);
+            atomic_fetch_add_explicit(&w->sync_errors, s->decoder.sync_errors - sync_errors,
+                                      memory_order_relaxed);
+            if (n < GW_READ_BUFFER_SIZE) return;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            session_close(s);
+            return;
+        }
+    }
+}
+
+// Event loop; one per worker thread
+static void* worker_main(void* arg) {
+    gw_worker_t* w = arg;
+    gateway_t* gw = w->gw;
+    struct epoll_event events[GW_EPOLL_BATCH];
+    uint8_t* buffer = malloc(GW_READ_BUFFER_SIZE);
+    if (!buffer) return NULL;
+
+    while (atomic_load_explicit(&gw->running, memory_order_acquire)) {
+        // No threshold set is held across iterations
+        atomic_store_explicit(&w->quiescent, atomic_load(&gw->thresholds_epoch), memory_order_release);
+        uint64_t now = monotonic_ms();
+        uint64_t next_attempt = now + GW_TICK_MS;
+        for (uint32_t i = 0; i < w->session_count; i++) {
+            gw_session_t* s = w->sessions[i];
+            if (s->state == GW_SESSION_DISCONNECTED && now >= s->next_attempt_ms) {
+                // Without a slot the session waits for a release or the next tick
+                if (!session_take_slot(s)) continue;
+                session_connect(s);
+            }
+            if (s->handshaking) {
+                if (now >= s->handshake_deadline_ms) {
+                    session_release_slot(s);
+                } else if (s->handshake_deadline_ms < next_attempt) {
+                    next_attempt = s->handshake_deadline_ms;
+                }
+            }
+            if (s->state == GW_SESSION_DISCONNECTED && s->next_attempt_ms < next_attempt) {
+                next_attempt = s->next_attempt_ms;
+            }
+        }
+
+        // Wake for the earliest retry so backoff delays are honoured to the ms
+        int timeout = next_attempt > now ? (int)(next_attempt - now) : 0;
+        int n = epoll_wait(w->epoll_fd, events, GW_EPOLL_BATCH, timeout);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == NULL) {
+                uint64_t value;
+                if (read(w->wake_fd, &value, sizeof(value)) < 0) {
+                    // Spurious wakeup; the running flag decides
+                }
+                continue;
+            }
+
+            gw_session_t* s = events[i].data.ptr;
+            if (s->fd < 0) continue;
+            if (s->state == GW_SESSION_CONNECTING) {
+                session_on_writable(s);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                session_on_readable(s, buffer);
+            }
+            if (s->fd >= 0 && (events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP))) {
+                session_close(s);
+            }
+        }
+        if (atomic_exchange_explicit(&w->rates_pending, false, memory_order_acq_rel)) {
+            for (uint32_t i = 0; i < w->session_count; i++) {
+                session_apply_rates(w->sessions[i]);
+            }
+        }
+        if (atomic_exchange_explicit(&w->thresholds_pending, false, memory_order_acq_rel)) {
+            for (uint32_t i = 0; i < w->session_count; i++) {
+                session_apply_thresholds(w->sessions[i]);
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < w->session_count; i++) {
+        if (w->sessions[i]->fd >= 0) session_close(w->sessions[i]);
+    }
+    free(buffer);
+    return NULL;
+}
+
+static int compare_sessions(const void* a, const void* b) {
+    const gw_session_t* sa = a;
+    const gw_session_t* sb = b;
+    return (int)sa->config.device_id - (int)sb->config.device_id;
+}
+
+hw_status_t gateway_start(gateway_t* gw) {
+    if (!gw || gw->started) return HW_STATUS_INVALID_PARAM;
+
+    qsort(gw->sessions, gw->session_count, sizeof(gw_session_t), compare_sessions);
+
+    gw->worker_count = gw->config.thread_count;
+    gw->workers = calloc(gw->worker_count, sizeof(gw_worker_t));
+    if (!gw->workers) return HW_STATUS_ERROR;
+    // gateway_stop() unwinds a partial start; it skips fds still at -1
+    for (uint32_t i = 0; i < gw->worker_count; i++) {
+        gw->workers[i].epoll_fd = -1;
+        gw->workers[i].wake_fd = -1;
+    }
+
+    for (uint32_t i = 0; i < gw->worker_count; i++) {
+        gw_worker_t* w = &gw->workers[i];
+        w->gw = gw;
+        w->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        w->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        w->sessions = calloc(gw->session_count / gw->worker_count + 1, sizeof(gw_session_t*));
+        if (w->epoll_fd < 0 || w->wake_fd < 0 || !w->sessions) {
+            gateway_stop(gw);
+            return HW_STATUS_ERROR;
+        }
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.ptr = NULL;
+        epoll_ctl(w->epoll_fd, EPOLL_CTL_ADD, w->wake_fd, &ev);
+    }
+
+    // Shard sessions round-robin so neighbouring device ids spread across
+    // threads; each thread lists devices restored with alarms first
+    for (uint32_t i = 0; i < gw->session_count; i++) {
+        gw_session_t* s = &gw->sessions[i];
+        pthread_mutex_init(&s->lock, NULL);
+        s->worker = &gw->workers[i % gw->worker_count];
+        backoff_init(&s->backoff, gw->config.reconnect_initial_ms, gw->config.reconnect_interval_ms,
+                     (uint32_t)(gw_monotonic_ns() ^ (s->config.device_id * 2654435761u)));
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        for (uint32_t i = 0; i < gw->session_count; i++) {
+            gw_session_t* s = &gw->sessions[i];
+            if ((s->model.alarm_count > 0) == (pass == 0)) {
+                s->worker->sessions[s->worker->session_count++] = s;
+            }
+        }
+    }
+
+    atomic_store_explicit(&gw->devices_pending, gw->session_count, memory_order_relaxed);
+    gw->start_ns = gw_monotonic_ns();
+    gw->started = true;
+    atomic_store_explicit(&gw->running, true, memory_order_release);
+    for (uint32_t i = 0; i < gw->worker_count; i++) {
+        if (pthread_create(&gw->workers[i].thread, NULL, worker_main, &gw->workers[i]) != 0) {
+            gateway_stop(gw);
+            return HW_STATUS_ERROR;
+        }
+    }
+    return HW_STATUS_OK;
+}
+
+void gateway_stop(gateway_t* gw) {
+    if (!gw || !gw->workers) return;
+
+    atomic_store_explicit(&gw->running, false, memory_order_release);
+    for (uint32_t i = 0; i < gw->worker_count; i++) {
+        uint64_t one = 1;
+        if (gw->workers[i].wake_fd >= 0 && write(gw->workers[i].wake_fd, &one, sizeof(one)) < 0) {
+            // The worker still exits on its next tick
+        }
+    }
+    for (uint32_t i = 0; i < gw->worker_count; i++) {
+        gw_worker_t* w = &gw->workers[i];
+        if (w->thread) pthread_join(w->thread, NULL);
+        if (w->epoll_fd >= 0) close(w->epoll_fd);
+        if (w->wake_fd >= 0) close(w->wake_fd);
+        free(w->sessions);
+    }
+    free(gw->workers);
+    gw->workers = NULL;
+    gw->worker_count = 0;
+}
+
+static gw_session_t* find_session(gateway_t* gw, uint16_t device_id) {
+    uint32_t lo = 0, hi = gw->session_count;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        uint16_t id = gw->sessions[mid].config.device_id;
+        if (id == device_id) return &gw->sessions[mid];
+        if (id < device_id) lo = mid + 1; else hi = mid;
+    }
+    return NULL;
+}
+
+// Warm-start snapshots
+//
+// File: header, then per device
+//   [device_id u16][power, battery, AC, DC, alarm counts u8 x5][frames_received u32]
+//   [records of each kind, count of each][system status]
+// Records are the in-memory structs; the header carries their sizes so a
+// file from a different build is refused rather than misread.
+#define SNAPSHOT_MAGIC      "NMGS"
+#define SNAPSHOT_VERSION    1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint16_t record_sizes[6];
+    uint32_t device_count;
+} snapshot_header_t;
+
+static void snapshot_header_init(snapshot_header_t* h, uint32_t device_count) {
+    memset(h, 0, sizeof(*h));
+    memcpy(h->magic, SNAPSHOT_MAGIC, 4);
+    h->version = SNAPSHOT_VERSION;
+    h->record_sizes[0] = sizeof(power_module_t);
+    h->record_sizes[1] = sizeof(battery_info_t);
+    h->record_sizes[2] = sizeof(ac_phase_t);
+    h->record_sizes[3] = sizeof(dc_circuit_t);
+    h->record_sizes[4] = sizeof(alarm_t);
+    h->record_sizes[5] = sizeof(system_status_t);
+    h->device_count = device_count;
+}
+
+static bool snapshot_write_device(FILE* f, const gw_device_state_t* m) {
+    uint8_t counts[5] = {m->power_module_count, m->battery_count, m->ac_phase_count,
+                         m->dc_circuit_count, m->alarm_count};
+    return fwrite(&m->device_id, sizeof(m->device_id), 1, f) == 1 &&
+           fwrite(counts, sizeof(counts), 1, f) == 1 &&
+           fwrite(&m->frames_received, sizeof(m->frames_received), 1, f) == 1 &&
+           fwrite(m->power_modules, sizeof(power_module_t), counts[0], f) == counts[0] &&
+           fwrite(m->batteries, sizeof(battery_info_t), counts[1], f) == counts[1] &&
+           fwrite(m->ac_phases, sizeof(ac_phase_t), counts[2], f) == counts[2] &&
+           fwrite(m->dc_circuits, sizeof(dc_circuit_t), counts[3], f) == counts[3] &&
+           fwrite(m->alarms, sizeof(alarm_t), counts[4], f) == counts[4] &&
+           fwrite(&m->system_status, sizeof(system_status_t), 1, f) == 1;
+}
+
+static bool snapshot_read_device(FILE* f, gw_device_state_t* m) {
+    uint8_t counts[5];
+    if (fread(&m->device_id, sizeof(m->device_id), 1, f) != 1 ||
+        fread(counts, sizeof(counts), 1, f) != 1 ||
+        fread(&m->frames_received, sizeof(m->frames_received), 1, f) != 1) {
+        return false;
+    }
+    if (counts[0] > GW_MAX_POWER_MODULES || counts[1] > GW_MAX_BATTERIES || counts[2] > GW_MAX_AC_PHASES ||
+        counts[3] > GW_MAX_DC_CIRCUITS || counts[4] > GW_MAX_ALARMS) {
+        return false;
+    }
+    m->power_module_count = counts[0];
+    m->battery_count = counts[1];
+    m->ac_phase_count = counts[2];
+    m->dc_circuit_count = counts[3];
+    m->alarm_count = counts[4];
+    return fread(m->power_modules, sizeof(power_module_t), counts[0], f) == counts[0] &&
+           fread(m->batteries, sizeof(battery_info_t), counts[1], f) == counts[1] &&
+           fread(m->ac_phases, sizeof(ac_phase_t), counts[2], f) == counts[2] &&
+           fread(m->dc_circuits, sizeof(dc_circuit_t), counts[3], f) == counts[3] &&
+           fread(m->alarms, sizeof(alarm_t), counts[4], f) == counts[4] &&
+           fread(&m->system_status, sizeof(system_status_t), 1, f) == 1;
+}
+
+hw_status_t gateway_load_snapshot(gateway_t* gw, const char* path) {
+    if (!gw || !path || gw->started) return HW_STATUS_INVALID_PARAM;
+
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        // No snapshot yet is the normal first start
+        return errno == ENOENT ? HW_STATUS_OK : HW_STATUS_ERROR;
+    }
+
+    snapshot_header_t header, expected;
+    snapshot_header_init(&expected, 0);
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(&header, &expected, offsetof(snapshot_header_t, device_count)) != 0) {
+        fprintf(stderr, "Gateway: %s is not a snapshot from this build, ignoring it\n", path);
+        fclose(f);
+        return HW_STATUS_ERROR;
+    }
+
+    // Sorted now so records find their session; gateway_start() keeps the order
+    qsort(gw->sessions, gw->session_count, sizeof(gw_session_t), compare_sessions);
+    gw_device_state_t* m = malloc(sizeof(gw_device_state_t));
+    if (!m) {
+        fclose(f);
+        return HW_STATUS_ERROR;
+    }
+
+    hw_status_t result = HW_STATUS_OK;
+    uint32_t restored = 0;
+    for (uint32_t i = 0; i < header.device_count; i++) {
+        memset(m, 0, sizeof(*m));
+        if (!snapshot_read_device(f, m)) {
+            fprintf(stderr, "Gateway: %s is truncated after %u devices\n", path, i);
+            result = HW_STATUS_ERROR;
+            break;
+        }
+        // Devices dropped from the configuration are skipped
+        gw_session_t* s = find_session(gw, m->device_id);
+        if (!s) continue;
+        if (!s->model.restored) restored++;
+        m->state = GW_SESSION_DISCONNECTED;
+        m->restored = true;
+        s->model = *m;
+    }
+    atomic_fetch_add_explicit(&gw->restored, restored, memory_order_relaxed);
+
+    free(m);
+    fclose(f);
+    return result;
+}
+
+hw_status_t gateway_save_snapshot(gateway_t* gw, const char* path) {
+    if (!gw || !path) return HW_STATUS_INVALID_PARAM;
+
+    char tmp[512];
+    if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)) return HW_STATUS_INVALID_PARAM;
+    FILE* f = fopen(tmp, "wb");
+    if (!f) {
+        fprintf(stderr, "Gateway: cannot write snapshot %s: %s\n", tmp, strerror(errno));
+        return HW_STATUS_ERROR;
+    }
+    gw_device_state_t* m = malloc(sizeof(gw_device_state_t));
+
+    snapshot_header_t header;
+    snapshot_header_init(&header, gw->session_count);
+    bool ok = m && fwrite(&header, sizeof(header), 1, f) == 1;
+    for (uint32_t i = 0; ok && i < gw->session_count; i++) {
+        gw_session_t* s = &gw->sessions[i];
+        // Locks exist once started; before that nothing else touches the model
+        if (gw->started) pthread_mutex_lock(&s->lock);
+        memcpy(m, &s->model, sizeof(*m));
+        if (gw->started) pthread_mutex_unlock(&s->lock);
+        ok = snapshot_write_device(f, m);
+    }
+    free(m);
+
+    // The old snapshot stays in place until the new one is on disk
+    ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+    if (fclose(f) != 0) ok = false;
+    if (!ok || rename(tmp, path) != 0) {
+        fprintf(stderr, "Gateway: cannot write snapshot %s: %s\n", path, strerror(errno));
+        unlink(tmp);
+        return HW_STATUS_ERROR;
+    }
+    return HW_STATUS_OK;
+}
+
+hw_status_t gateway_watch(gateway_t* gw, uint16_t device_id, uint8_t category, bool watch) {
+    // Outputs release their watches while shutting down, after gateway_stop()
+    if (!gw || !gw->started || !gw->workers) return HW_STATUS_INVALID_PARAM;
+    int index = rate_index(category);
+    if (category != 0 && index < 0) return HW_STATUS_INVALID_PARAM;
+
+    gw_session_t* s = find_session(gw, device_id);
+    if (!s) return HW_STATUS_INVALID_PARAM;
+
+    for (int i = 0; i < GW_RATE_CATEGORIES; i++) {
+        if (category != 0 && i != index) continue;
+        if (watch) {
+            atomic_fetch_add_explicit(&s->watchers[i], 1, memory_order_relaxed);
+        } else if (atomic_load_explicit(&s->watchers[i], memory_order_relaxed) > 0) {
+            atomic_fetch_sub_explicit(&s->watchers[i], 1, memory_order_relaxed);
+        }
+    }
+    session_mark_rates(s);
+    uint64_t one = 1;
+    if (write(s->worker->wake_fd, &one, sizeof(one)) < 0) {
+        // eventfd counter saturated; the worker is already awake
+    }
+    return HW_STATUS_OK;
+}
+
+// Builds the configuration a device would commit from items, with the
+// device's own checks (thresholds.c): a set it would refuse is refused here
+static bool thresholds_build(thresholds_t* config, const gw_threshold_t* items, uint32_t count) {
+    thresholds_defaults(config);
+    for (uint32_t i = 0; i < count; i++) {
+        if (!thresholds_set(config, items[i].key, items[i].index, items[i].value)) return false;
+    }
+    return thresholds_valid(config);
+}
+
+uint32_t gateway_set_thresholds(gateway_t* gw, const gw_threshold_t* items, uint32_t count) {
+    if (!gw || (count && !items) || count > GW_MAX_THRESHOLDS) return 0;
+    thresholds_t config;
+    if (!thresholds_build(&config, items, count)) return 0;
+
+    // Built before taking the lock; readers never see it half written
+    gw_threshold_set_t* set = malloc(sizeof(*set) + count * sizeof(gw_threshold_t));
+    if (!set) return 0;
+    set->count = count;
+    set->next_retired = NULL;
+    if (count) memcpy(set->items, items, count * sizeof(gw_threshold_t));
+
+    pthread_mutex_lock(&gw->thresholds_lock);
+    gw_threshold_set_t* old = atomic_load_explicit(&gw->thresholds, memory_order_relaxed);
+    set->version = old ? old->version + 1 : 1;
+    atomic_store(&gw->thresholds, set);
+    if (old) {
+        // Workers that saw this epoch at their loop top loaded the new set
+        old->retired_epoch = atomic_fetch_add(&gw->thresholds_epoch, 1) + 1;
+        old->next_retired = gw->retired;
+        gw->retired = old;
+    }
+    thresholds_reclaim(gw);
+    uint32_t version = set->version;
+    if (gw->started && gw->workers) {
+        for (uint32_t i = 0; i < gw->worker_count; i++) {
+            atomic_store_explicit(&gw->workers[i].thresholds_pending, true, memory_order_release);
+            uint64_t one = 1;
+            if (write(gw->workers[i].wake_fd, &one, sizeof(one)) < 0) {
+                // eventfd counter saturated; the worker is already awake
+            }
+        }
+    }
+    pthread_mutex_unlock(&gw->thresholds_lock);
+    return version;
+}
+
+// File names of the STM32_THRESHOLD_* keys, in key order
+static const char* const threshold_names[STM32_THRESHOLD_KEY_COUNT] = {
+    "module_voltage_min_mv", "module_voltage_max_mv", "module_current_max_ma", "module_temp_max_c",
+    "module_power_max_mw", "alarm_voltage_low_mv", "alarm_voltage_high_mv", "alarm_current_high_ma",
+    "alarm_temp_high_c", "alarm_power_overload_mw", "alarm_battery_low_mv", "safety_voltage_min_mv",
+    "safety_voltage_max_mv", "safety_current_max_ma", "safety_temp_max_c", "safety_power_max_mw"
+};
+
+hw_status_t gateway_load_thresholds(gateway_t* gw, const char* path) {
+    if (!gw || !path) return HW_STATUS_INVALID_PARAM;
+
+    FILE* f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "Gateway: cannot open threshold file %s: %s\n", path, strerror(errno));
+        return HW_STATUS_ERROR;
+    }
+
+    gw_threshold_t items[GW_MAX_THRESHOLDS];
+    uint32_t count = 0;
+    thresholds_t config;
+    thresholds_defaults(&config);
+    char line[256];
+    unsigned line_no = 0;
+    hw_status_t result = HW_STATUS_OK;
+    while (fgets(line, sizeof(line), f)) {
+        line_no++;
+        char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '#' || *p == '\n' || *p == '\0') continue;
+
+        char name[32];
+        unsigned long a = 0, b = 0;
+        int fields = sscanf(p, "%31s %lu %lu", name, &a, &b);
+        uint8_t key = 0;
+        for (uint8_t k = 0; k < STM32_THRESHOLD_KEY_COUNT; k++) {
+            if (fields >= 2 && strcmp(name, threshold_names[k]) == 0) key = (uint8_t)(k + 1);
+        }
+        bool per_module = key >= STM32_THRESHOLD_MODULE_VOLTAGE_MIN && key <= STM32_THRESHOLD_MODULE_TEMP_MAX;
+        unsigned long index = fields == 3 ? a : 0;
+        unsigned long value = fields == 3 ? b : a;
+        if (key == 0 || (fields == 3 && !per_module) || index > 0xFF || value > 0xFFFFFFFFul) {
+            fprintf(stderr, "Gateway: %s:%u: malformed threshold entry\n", path, line_no);
+            result = HW_STATUS_INVALID_PARAM;
+            break;
+        }
+        if (count == GW_MAX_THRESHOLDS) {
+            fprintf(stderr, "Gateway: %s:%u: more than %d thresholds\n", path, line_no, GW_MAX_THRESHOLDS);
+            result = HW_STATUS_INVALID_PARAM;
+            break;
+        }
+        if (!thresholds_set(&config, key, (uint8_t)index, (uint32_t)value)) {
+            fprintf(stderr, "Gateway: %s:%u: %s out of range\n", path, line_no, name);
+            result = HW_STATUS_INVALID_PARAM;
+            break;
+        }
+        items[count].key = key;
+        items[count].index = (uint8_t)index;
+        items[count].value = (uint32_t)value;
+        count++;
+    }
+    fclose(f);
+    if (result == HW_STATUS_OK && !thresholds_valid(&config)) {
+        fprintf(stderr, "Gateway: %s: a minimum is not below its maximum\n", path);
+        result = HW_STATUS_INVALID_PARAM;
+    }
+
+    // A file with an error changes nothing
+    if (result == HW_STATUS_OK && gateway_set_thresholds(gw, items, count) == 0) {
+        result = HW_STATUS_ERROR;
+    }
+    return result;
+}
+
+uint32_t gateway_get_thresholds_version(gateway_t* gw, uint16_t device_id) {
+    if (!gw || !gw->started) return 0;
+    gw_session_t* s = find_session(gw, device_id);
+    return s ? atomic_load_explicit(&s->thresholds_sent, memory_order_relaxed) : 0;
+}
+
+uint32_t gateway_get_rate(gateway_t* gw, uint16_t device_id, uint8_t category) {
+    int index = rate_index(category);
+    if (!gw || !gw->started || index < 0) return 0;
+    gw_session_t* s = find_session(gw, device_id);
+    return s ? atomic_load_explicit(&s->applied_period[index], memory_order_relaxed) : 0;
+}
+
+hw_status_t gateway_get_device_state(gateway_t* gw, uint16_t device_id, gw_device_state_t* state) {
+    if (!gw || !state || !gw->started) return HW_STATUS_INVALID_PARAM;
+
+    gw_session_t* s = find_session(gw, device_id);
+    if (!s) return HW_STATUS_INVALID_PARAM;
+
+    pthread_mutex_lock(&s->lock);
+    memcpy(state, &s->model, sizeof(*state));
+    pthread_mutex_unlock(&s->lock);
+    return HW_STATUS_OK;
+}
+
+uint32_t gateway_get_device_ids(gateway_t* gw, uint16_t* ids, uint32_t max_ids) {
+    if (!gw || !ids) return 0;
+
+    uint32_t n = gw->session_count < max_ids ? gw->session_count : max_ids;
+    for (uint32_t i = 0; i < n; i++) {
+        ids[i] = gw->sessions[i].config.device_id;
+    }
+    return n;
+}
+
+void gateway_get_stats(gateway_t* gw, gw_stats_t* stats) {
+    if (!gw || !stats) return;
+
+    memset(stats, 0, sizeof(*stats));
+    stats->devices_configured = gw->session_count;
+    stats->devices_restored = atomic_load_explicit(&gw->restored, memory_order_relaxed);
+    stats->connects_in_flight = atomic_load_explicit(&gw->connects_in_flight, memory_order_relaxed);
+    stats->startup_ms = atomic_load_explicit(&gw->startup_ns, memory_order_relaxed) / 1000000ull;
+    pthread_mutex_lock(&gw->thresholds_lock);
+    gw_threshold_set_t* set = atomic_load_explicit(&gw->thresholds, memory_order_relaxed);
+    stats->thresholds_version = set ? set->version : 0;
+    pthread_mutex_unlock(&gw->thresholds_lock);
+    for (uint32_t i = 0; i < gw->worker_count; i++) {
+        gw_worker_t* w = &gw->workers[i];
+        stats->devices_connected += atomic_load_explicit(&w->connected, memory_order_relaxed);
+        stats->frames_in += atomic_load_explicit(&w->frames_in, memory_order_relaxed);
+        stats->bytes_in += atomic_load_explicit(&w->bytes_in, memory_order_relaxed);
+        stats->checksum_errors += atomic_load_explicit(&w->checksum_errors, memory_order_relaxed);
+        stats->sync_errors += atomic_load_explicit(&w->sync_errors, memory_order_relaxed);
+        stats->connect_attempts += atomic_load_explicit(&w->connect_attempts, memory_order_relaxed);
+        stats->resumes += atomic_load_explicit(&w->resumes, memory_order_relaxed);
+        stats->keyframes += atomic_load_explicit(&w->keyframes, memory_order_relaxed);
+        stats->rate_commands += atomic_load_explicit(&w->rate_commands, memory_order_relaxed);
+        stats->threshold_pushes += atomic_load_explicit(&w->threshold_pushes, memory_order_relaxed);
+    }
+}
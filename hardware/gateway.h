@@ -0,0 +1,208 @@
+#ifndef GATEWAY_H
+#define GATEWAY_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware_interface.h"
+#include "stm32_decoder.h"
+
+// Gateway limits
+#define GW_MAX_DEVICES          4096
+#define GW_MAX_THREADS          64
+#define GW_MAX_SINKS            8
+#define GW_MAX_POWER_MODULES    64
+#define GW_MAX_BATTERIES        32
+#define GW_MAX_AC_PHASES        8
+#define GW_MAX_DC_CIRCUITS      64
+#define GW_MAX_ALARMS           32
+#define GW_RATE_CATEGORIES      5       // Power, battery, AC, DC, system status
+#define GW_MAX_THRESHOLDS       64      // Entries in one threshold set
+
+// Device-tagged frame on the merged output stream:
+// ['N']['M'][device_id u16 LE][sequence u32 LE][STM32 frame (length + 5 bytes)]
+#define GW_TAG_MAGIC_HIGH       0x4E
+#define GW_TAG_MAGIC_LOW        0x4D
+#define GW_TAG_HEADER_SIZE      8
+#define GW_MAX_TAGGED_SIZE      (GW_TAG_HEADER_SIZE + STM32_MAX_PACKET_SIZE)
+
+// Device link types
+typedef enum {
+    GW_LINK_TCP = 0,
+    GW_LINK_SERIAL = 1
+} gw_link_type_t;
+
+// Session states
+typedef enum {
+    GW_SESSION_DISCONNECTED = 0,
+    GW_SESSION_CONNECTING = 1,
+    GW_SESSION_CONNECTED = 2
+} gw_session_state_t;
+
+// One configured controller
+typedef struct {
+    uint16_t device_id;
+    gw_link_type_t link_type;
+    char address[128];     // Host for TCP, device path for serial
+    uint16_t port;         // TCP port
+    uint32_t baud_rate;    // Serial baud rate
+} gw_device_config_t;
+
+// Gateway configuration
+// Failed links are retried with jittered exponential backoff, starting at
+// reconnect_initial_ms and capped at reconnect_interval_ms.
+//
+// Devices are asked to send each category at fast_period_ms while someone
+// watches it (gateway_watch) or the device has an active alarm, and at
+// background_period_ms otherwise.
+//
+// At most connect_parallelism links are connecting or waiting for their
+// first frame at once, so a cold start or a site-wide outage does not open
+// thousands of handshakes together. Devices last known to have an active
+// alarm (live, or from a warm-start snapshot) go first.
+typedef struct {
+    uint32_t thread_count;           // Event-loop threads; sessions are sharded across them
+    uint32_t connect_parallelism;    // Handshakes in flight across all threads; 0 = unlimited
+    uint32_t reconnect_interval_ms;  // Longest delay before retrying a failed link
+    uint32_t reconnect_initial_ms;   // First retry delay after a link drops
+    uint32_t fast_period_ms;         // Watched or alarming categories
+    uint32_t background_period_ms;   // Everything else; 0 leaves device rates alone
+} gw_config_t;
+
+// Decoded state of one device
+typedef struct {
+    uint16_t device_id;
+    gw_session_state_t state;
+    uint8_t power_module_count;
+    uint8_t battery_count;
+    uint8_t ac_phase_count;
+    uint8_t dc_circuit_count;
+    uint8_t alarm_count;
+    power_module_t power_modules[GW_MAX_POWER_MODULES];
+    battery_info_t batteries[GW_MAX_BATTERIES];
+    ac_phase_t ac_phases[GW_MAX_AC_PHASES];
+    dc_circuit_t dc_circuits[GW_MAX_DC_CIRCUITS];
+    alarm_t alarms[GW_MAX_ALARMS];
+    system_status_t system_status;
+    uint32_t frames_received;
+    uint64_t last_update_ms;
+    bool restored;         // Loaded from a snapshot, no live frame since
+} gw_device_state_t;
+
+// A decoded frame as delivered to sinks. The tagged wire encoding is
+// built once per frame and shared by every sink.
+typedef struct {
+    uint16_t device_id;
+    uint32_t sequence;     // Per-device output sequence
+    uint64_t ingest_ns;    // Monotonic time the bytes were read
+    const stm32_frame_t* frame;
+    const uint8_t* wire;
+    size_t wire_length;
+} gw_tagged_frame_t;
+
+// Sinks run on the event-loop thread that owns the device and must be thread-safe
+typedef void (*gw_sink_fn_t)(const gw_tagged_frame_t* frame, void* user_data);
+
+// Gateway counters
+typedef struct {
+    uint32_t devices_configured;
+    uint32_t devices_connected;
+    uint32_t devices_restored;   // Still serving snapshot state
+    uint32_t connects_in_flight;
+    uint64_t startup_ms;         // Start until every device had sent data; 0 until then
+    uint64_t frames_in;
+    uint64_t bytes_in;
+    uint64_t checksum_errors;
+    uint64_t sync_errors;
+    uint64_t connect_attempts;
+    uint64_t resumes;       // Reconnects served from the device's replay ring
+    uint64_t keyframes;     // Reconnects that needed a full-state keyframe
+    uint64_t rate_commands; // Rate changes sent to devices
+    uint32_t thresholds_version;  // Current threshold set; 0 = none
+    uint64_t threshold_pushes;    // Threshold sets sent to devices
+} gw_stats_t;
+
+// One device threshold (STM32_THRESHOLD_* key). index is the power module
+// for per-module keys, 1-based, 0 for every module.
+typedef struct {
+    uint8_t key;
+    uint8_t index;
+    uint32_t value;
+} gw_threshold_t;
+
+typedef struct gateway gateway_t;
+
+// Lifecycle
+void gateway_default_config(gw_config_t* config);
+gateway_t* gateway_create(const gw_config_t* config);
+void gateway_destroy(gateway_t* gw);
+hw_status_t gateway_start(gateway_t* gw);
+void gateway_stop(gateway_t* gw);
+
+// Setup (before gateway_start)
+hw_status_t gateway_add_device(gateway_t* gw, const gw_device_config_t* device);
+hw_status_t gateway_load_devices(gateway_t* gw, const char* path);
+hw_status_t gateway_add_sink(gateway_t* gw, gw_sink_fn_t sink, void* user_data);
+
+// Warm start. A snapshot holds the decoded model of every device; loading
+// one before gateway_start() lets queries answer with the last known state
+// (flagged restored) until each device is back. Saving works at any time
+// and replaces the file atomically. Snapshots are only read back by the
+// build that wrote them.
+hw_status_t gateway_load_snapshot(gateway_t* gw, const char* path);
+hw_status_t gateway_save_snapshot(gateway_t* gw, const char* path);
+
+// Demand-driven sampling (any thread). Watches are counted: every
+// gateway_watch(..., true) needs a matching false. category is a packet
+// type (power, battery, AC, DC, system status) or 0 for all of them.
+hw_status_t gateway_watch(gateway_t* gw, uint16_t device_id, uint8_t category, bool watch);
+
+// Period a device was last asked to use for a category; 0 while unknown
+uint32_t gateway_get_rate(gateway_t* gw, uint16_t device_id, uint8_t category);
+
+// Fleet thresholds (any thread, at any time). A set is complete: keys it
+// leaves out take the device defaults. Each call builds a new immutable set
+// and swaps it in; workers send it to every connected device, and to each
+// device as it connects, as staged commands ending in a commit, so a device
+// switches to the whole set at once or, if the link drops first, not at
+// all. Ingest does not pause. Returns the set's version, 0 if refused:
+// a set is checked as the device checks it (value widths, module index up
+// to MAX_POWER_MODULES, every minimum below its maximum) first.
+uint32_t gateway_set_thresholds(gateway_t* gw, const gw_threshold_t* items, uint32_t count);
+
+// Threshold file, one entry per line:
+//   <name> <value>             e.g. alarm_temp_high_c 55
+//   <name> <module> <value>    per-module keys, e.g. module_current_max_ma 2 28000
+hw_status_t gateway_load_thresholds(gateway_t* gw, const char* path);
+
+// Version last sent to a device on its current link; 0 while none. Devices
+// do not acknowledge sets; one refused anyway keeps its previous limits.
+uint32_t gateway_get_thresholds_version(gateway_t* gw, uint16_t device_id);
+
+// Queries (any thread)
+hw_status_t gateway_get_device_state(gateway_t* gw, uint16_t device_id, gw_device_state_t* state);
+uint32_t gateway_get_device_ids(gateway_t* gw, uint16_t* ids, uint32_t max_ids);
+void gateway_get_stats(gateway_t* gw, gw_stats_t* stats);
+
+// Tagged frame helpers
+size_t gateway_encode_tagged(uint16_t device_id, uint32_t sequence, const stm32_frame_t* frame, uint8_t* out);
+size_t gateway_decode_tagged(const uint8_t* bytes, size_t length, uint16_t* device_id,
+                             uint32_t* sequence, stm32_frame_t* frame);
+
+// Conflation key (device, packet type, record id) of a tagged frame for
+// slow-consumer queues. False for frames that must not be conflated:
+// alarms, commands and anything not recognised.
+bool gateway_conflation_key(const uint8_t* bytes, size_t length, uint64_t* key);
+
+// Monotonic clock shared by gateway components
+uint64_t gw_monotonic_ns(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GATEWAY_H
@@ -0,0 +1,1235 @@
+#define _GNU_SOURCE
+#include "gateway_http.h"
+#include "conflate.h"
+#include "pool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <zlib.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define HTTP_REQUEST_MAX     8192
+#define HTTP_INPUT_MAX       (HTTP_REQUEST_MAX - 1)   // Buffered input; one byte ends a request
+#define HTTP_EPOLL_BATCH     64
+#define HTTP_PENDING_MAX     (8 * 1024 * 1024)
+#define WS_DEFLATE_MIN       128     // Smaller messages are not worth compressing
+#define HTTP_CONFLATE_HIGH   (GW_HTTP_CLIENT_QUEUE / 2)   // Queued messages before a client conflates
+#define HTTP_BATCH_BYTES     (16 * 1024)   // Frames per message; bounds every update message
+#define HTTP_REFILL_BYTES    HTTP_BATCH_BYTES
+#define WS_GUID              "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define HTTP_MSG_CLASSES     3
+
+#define WS_OP_TEXT           0x1
+#define WS_OP_BINARY         0x2
+#define WS_OP_CLOSE          0x8
+#define WS_OP_PING           0x9
+#define WS_OP_PONG           0xA
+
+// Growable text buffer for JSON and HTTP headers
+typedef struct {
+    char* data;
+    size_t length;
+    size_t capacity;
+} text_t;
+
+static bool text_reserve(text_t* t, size_t extra) {
+    if (t->length + extra + 1 <= t->capacity) return true;
+    size_t capacity = t->capacity ? t->capacity : 4096;
+    while (capacity < t->length + extra + 1) capacity *= 2;
+    char* grown = realloc(t->data, capacity);
+    if (!grown) return false;
+    t->data = grown;
+    t->capacity = capacity;
+    return true;
+}
+
+static void text_append(text_t* t, const char* s, size_t length) {
+    if (!text_reserve(t, length)) return;
+    memcpy(t->data + t->length, s, length);
+    t->length += length;
+    t->data[t->length] = '\0';
+}
+
+#define TEXT_LITERAL(t, s) text_append((t), (s), sizeof(s) - 1)
+
+static void text_printf(text_t* t, const char* fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    char small[256];
+    int n = vsnprintf(small, sizeof(small), fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+    if ((size_t)n < sizeof(small)) {
+        text_append(t, small, (size_t)n);
+        return;
+    }
+    if (!text_reserve(t, (size_t)n)) return;
+    va_start(ap, fmt);
+    vsnprintf(t->data + t->length, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    t->length += (size_t)n;
+}
+
+static void text_json_string(text_t* t, const char* s) {
+    TEXT_LITERAL(t, "\"");
+    for (; *s; s++) {
+        unsigned char ch = (unsigned char)*s;
+        if (ch == '"' || ch == '\\') {
+            char esc[2] = {'\\', (char)ch};
+            text_append(t, esc, 2);
+        } else if (ch < 0x20) {
+            text_printf(t, "\\u%04x", ch);
+        } else {
+            text_append(t, (const char*)&ch, 1);
+        }
+    }
+    TEXT_LITERAL(t, "\"");
+}
+
+// Message blocks by size. Batches reuse blocks once warm; only a message
+// larger than the largest block, or one arriving while every block that
+// fits is queued, comes from the heap.
+// Blocks are carved on first use, so unused ones cost address space only.
+static const struct {
+    uint32_t size;
+    uint32_t count;
+} msg_classes[HTTP_MSG_CLASSES] = {
+    {1024, 1024},               // Handshakes, control frames, small batches
+    {32 * 1024, 512},           // Binary and deflated batches
+    {256 * 1024, 128},          // JSON batches
+};
+
+// Encoded message, shared by reference between client queues
+typedef struct {
+    uint32_t refs;
+    pool_t* pool;               // NULL when heap-allocated
+    size_t length;
+    uint8_t data[];
+} http_msg_t;
+
+typedef enum {
+    CLIENT_HTTP = 0,        // Reading the request
+    CLIENT_WEBSOCKET = 1,   // Upgraded; receives updates
+    CLIENT_CLOSING = 2      // Close once the queue drains
+} client_kind_t;
+
+typedef struct {
+    int fd;
+    client_kind_t kind;
+    bool binary;
+    bool deflate;
+    bool want_write;
+    uint8_t* in;
+    size_t in_length;
+    http_msg_t* queue[GW_HTTP_CLIENT_QUEUE];
+    uint32_t queue_head;
+    uint32_t queue_count;
+    size_t queue_offset;
+    bool conflating;            // Batches go to backlog until it drains
+    conflate_queue_t* backlog;  // Allocated the first time the client lags
+    uint16_t watched[GW_HTTP_MAX_WATCH];    // Devices this viewer keeps at the fast rate
+    uint8_t watch_count;
+} http_client_t;
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} byte_buffer_t;
+
+// Message variants per batch: [binary][deflate]
+#define VARIANT(binary, deflate) ((binary) * 2 + (deflate))
+
+struct gw_http_server {
+    gateway_t* gw;
+    uint16_t port;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    pthread_t thread;
+    atomic_bool running;
+
+    // Producers append tagged frames here; the server thread swaps it out
+    pthread_mutex_t lock;
+    byte_buffer_t pending;
+    byte_buffer_t active;
+
+    z_stream deflater;
+    bool deflater_ready;
+    gw_device_state_t* scratch;
+    uint8_t* refill;            // Frames popped from a lagging client's backlog
+    // Kept between batches so a warm server does not allocate
+    pool_t* msg_pools[HTTP_MSG_CLASSES];
+    text_t batch_json;
+    text_t refill_json;
+    byte_buffer_t deflated;
+
+    http_client_t clients[GW_HTTP_MAX_CLIENTS];
+    atomic_uint http_clients;
+    atomic_uint websocket_clients;
+    atomic_uint_fast64_t requests;
+    atomic_uint_fast64_t messages_serialized;
+    atomic_uint_fast64_t messages_sent;
+    atomic_uint_fast64_t bytes_sent;
+    atomic_uint_fast64_t clients_dropped;
+    atomic_uint_fast64_t frames_conflated;
+    atomic_uint_fast64_t heap_messages;
+};
+
+static http_msg_t* msg_alloc(gw_http_server_t* server, size_t length) {
+    size_t size = sizeof(http_msg_t) + length;
+    http_msg_t* m = NULL;
+    pool_t* pool = NULL;
+    for (int i = 0; i < HTTP_MSG_CLASSES && !m; i++) {
+        if (size > msg_classes[i].size) continue;
+        pool = server->msg_pools[i];
+        m = pool_get(pool);
+    }
+    if (!m) {
+        pool = NULL;
+        m = malloc(size);
+        if (!m) return NULL;
+        atomic_fetch_add_explicit(&server->heap_messages, 1, memory_order_relaxed);
+    }
+    m->refs = 1;
+    m->pool = pool;
+    m->length = length;
+    return m;
+}
+
+static void msg_release(http_msg_t* m) {
+    if (!m || --m->refs != 0) return;
+    if (m->pool) {
+        pool_put(m->pool, m);
+    } else {
+        free(m);
+    }
+}
+
+// SHA-1 (RFC 3174); only used for the WebSocket handshake
+static uint32_t rol32(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+static void sha1_block(uint32_t h[5], const uint8_t* p) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)p[i * 4] << 24) | ((uint32_t)p[i * 4 + 1] << 16) |
+               ((uint32_t)p[i * 4 + 2] << 8) | (uint32_t)p[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+        else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+        else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+        else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+        uint32_t t = rol32(a, 5) + f + e + k + w[i];
+        e = d; d = c; c = rol32(b, 30); b = a; a = t;
+    }
+    h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+}
+
+static void sha1(const uint8_t* data, size_t length, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    uint8_t block[64];
+    size_t i = 0;
+
+    for (; i + 64 <= length; i += 64) sha1_block(h, data + i);
+
+    size_t rest = length - i;
+    memset(block, 0, sizeof(block));
+    memcpy(block, data + i, rest);
+    block[rest] = 0x80;
+    if (rest >= 56) {
+        sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    uint64_t bits = (uint64_t)length * 8;
+    for (int j = 0; j < 8; j++) block[63 - j] = (uint8_t)(bits >> (8 * j));
+    sha1_block(h, block);
+
+    for (int j = 0; j < 5; j++) {
+        digest[j * 4] = (uint8_t)(h[j] >> 24);
+        digest[j * 4 + 1] = (uint8_t)(h[j] >> 16);
+        digest[j * 4 + 2] = (uint8_t)(h[j] >> 8);
+        digest[j * 4 + 3] = (uint8_t)h[j];
+    }
+}
+
+static void base64_encode(const uint8_t* in, size_t length, char* out) {
+    static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < length; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < length) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < length) v |= in[i + 2];
+        out[o++] = table[(v >> 18) & 0x3F];
+        out[o++] = table[(v >> 12) & 0x3F];
+        out[o++] = i + 1 < length ? table[(v >> 6) & 0x3F] : '=';
+        out[o++] = i + 2 < length ? table[v & 0x3F] : '=';
+    }
+    out[o] = '\0';
+}
+
+// JSON serialization of device records
+static void json_power_module(text_t* t, const power_module_t* m) {
+    text_printf(t, "{\"moduleId\":%u,\"voltage\":%.3f,\"current\":%.3f,\"power\":%.3f,"
+                   "\"temperature\":%.1f,\"isActive\":%s,\"hasFault\":%s}",
+                m->module_id, m->voltage, m->current, m->power, m->temperature,
+                m->is_active ? "true" : "false", m->has_fault ? "true" : "false");
+}
+
+static void json_battery(text_t* t, const battery_info_t* b) {
+    text_printf(t, "{\"batteryId\":%u,\"voltage\":%.3f,\"current\":%.3f,\"temperature\":%.1f,"
+                   "\"capacityPercent\":%u,\"isCharging\":%s,\"testInProgress\":%s}",
+                b->battery_id, b->voltage, b->current, b->temperature, b->capacity_percent,
+                b->is_charging ? "true" : "false", b->test_in_progress ? "true" : "false");
+}
+
+static void json_ac_phase(text_t* t, const ac_phase_t* p) {
+    text_printf(t, "{\"phaseId\":%u,\"voltage\":%.1f,\"current\":%.1f,\"frequency\":%.1f,"
+                   "\"power\":%.3f,\"isNormal\":%s}",
+                p->phase_id, p->voltage, p->current, p->frequency, p->power,
+                p->is_normal ? "true" : "false");
+}
+
+static void json_dc_circuit(text_t* t, const dc_circuit_t* c) {
+    text_printf(t, "{\"circuitId\":%u,\"voltage\":%.3f,\"current\":%.3f,\"power\":%.1f,"
+                   "\"isEnabled\":%s,\"loadName\":",
+                c->circuit_id, c->voltage, c->current, c->power, c->is_enabled ? "true" : "false");
+    text_json_string(t, c->load_name);
+    TEXT_LITERAL(t, "}");
+}
+
+static void json_alarm(text_t* t, const alarm_t* a) {
+    text_printf(t, "{\"alarmId\":%u,\"severity\":%u,\"timestamp\":%u,\"isActive\":%s,\"message\":",
+                a->alarm_id, (unsigned)a->severity, a->timestamp, a->is_active ? "true" : "false");
+    text_json_string(t, a->message);
+    TEXT_LITERAL(t, "}");
+}
+
+static void json_system_status(text_t* t, const system_status_t* s) {
+    text_printf(t, "{\"mainsAvailable\":%s,\"batteryBackup\":%s,\"generatorRunning\":%s,"
+                   "\"operationMode\":%u,\"systemLoad\":%.1f,\"uptimeSeconds\":%u}",
+                s->mains_available ? "true" : "false", s->battery_backup ? "true" : "false",
+                s->generator_running ? "true" : "false", s->operation_mode, s->system_load,
+                s->uptime_seconds);
+}
+
+#define JSON_ARRAY(t, name, arr, count, fn)             \
+    do {                                                \
+        TEXT_LITERAL(t, ",\"" name "\":[");             \
+        for (uint32_t i_ = 0; i_ < (count); i_++) {     \
+            if (i_) TEXT_LITERAL(t, ",");               \
+            fn(t, &(arr)[i_]);                          \
+        }                                               \
+        TEXT_LITERAL(t, "]");                           \
+    } while (0)
+
+static void json_device(text_t* t, const gw_device_state_t* m) {
+    static const char* states[] = {"disconnected", "connecting", "connected"};
+    text_printf(t, "{\"deviceId\":%u,\"state\":\"%s\",\"framesReceived\":%u",
+                m->device_id, states[m->state <= GW_SESSION_CONNECTED ? m->state : 0], m->frames_received);
+    if (m->restored) TEXT_LITERAL(t, ",\"restored\":true");
+    JSON_ARRAY(t, "powerModules", m->power_modules, m->power_module_count, json_power_module);
+    JSON_ARRAY(t, "batteries", m->batteries, m->battery_count, json_battery);
+    JSON_ARRAY(t, "acInputs", m->ac_phases, m->ac_phase_count, json_ac_phase);
+    JSON_ARRAY(t, "dcOutputs", m->dc_circuits, m->dc_circuit_count, json_dc_circuit);
+    JSON_ARRAY(t, "alarms", m->alarms, m->alarm_count, json_alarm);
+    TEXT_LITERAL(t, ",\"systemStatus\":");
+    json_system_status(t, &m->system_status);
+    TEXT_LITERAL(t, "}");
+}
+
+// Appends one frame as {"device":..,"seq":..,"type":..,"data":{..}}; false if not modelled
+static bool json_frame(text_t* t, uint16_t device_id, uint32_t sequence, const stm32_frame_t* frame) {
+    size_t mark = t->length;
+    text_printf(t, "{\"device\":%u,\"seq\":%u,\"type\":", device_id, sequence);
+
+    bool ok = true;
+    switch (frame->type) {
+        case PACKET_TYPE_POWER_MODULE: {
+            power_module_t rec;
+            if ((ok = stm32_decode_power_module(frame, &rec))) {
+                TEXT_LITERAL(t, "\"powerModule\",\"data\":");
+                json_power_module(t, &rec);
+            }
+            break;
+        }
+        case PACKET_TYPE_BATTERY: {
+            battery_info_t rec;
+            if ((ok = stm32_decode_battery(frame, &rec))) {
+                TEXT_LITERAL(t, "\"battery\",\"data\":");
+                json_battery(t, &rec);
+            }
+            break;
+        }
+        case PACKET_TYPE_AC_INPUT: {
+            ac_phase_t rec;
+            if ((ok = stm32_decode_ac_input(frame, &rec))) {
+                TEXT_LITERAL(t, "\"acInput\",\"data\":");
+                json_ac_phase(t, &rec);
+            }
+            break;
+        }
+        case PACKET_TYPE_DC_OUTPUT: {
+            dc_circuit_t rec;
+            if ((ok = stm32_decode_dc_output(frame, &rec))) {
+                TEXT_LITERAL(t, "\"dcOutput\",\"data\":");
+                json_dc_circuit(t, &rec);
+            }
+            break;
+        }
+        case PACKET_TYPE_ALARM: {
+            alarm_t rec;
+            if ((ok = stm32_decode_alarm(frame, &rec))) {
+                TEXT_LITERAL(t, "\"alarm\",\"data\":");
+                json_alarm(t, &rec);
+            }
+            break;
+        }
+        case PACKET_TYPE_SYSTEM_STATUS: {
+            system_status_t rec;
+            if ((ok = stm32_decode_system_status(frame, &rec))) {
+                TEXT_LITERAL(t, "\"systemStatus\",\"data\":");
+                json_system_status(t, &rec);
+            }
+            break;
+        }
+        default:
+            ok = false;
+            break;
+    }
+
+    if (!ok) {
+        t->length = mark;
+        if (t->data) t->data[mark] = '\0';
+        return false;
+    }
+    TEXT_LITERAL(t, "}");
+    return true;
+}
+
+// Returns the number of devices written
+static uint32_t json_snapshot(gw_http_server_t* server, text_t* t, int device_filter) {
+    uint16_t* ids = malloc(GW_MAX_DEVICES * sizeof(uint16_t));
+    uint32_t count = ids ? gateway_get_device_ids(server->gw, ids, GW_MAX_DEVICES) : 0;
+
+    TEXT_LITERAL(t, "{\"type\":\"snapshot\",\"devices\":[");
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (device_filter >= 0 && ids[i] != device_filter) continue;
+        if (gateway_get_device_state(server->gw, ids[i], server->scratch) != HW_STATUS_OK) continue;
+        if (written++) TEXT_LITERAL(t, ",");
+        json_device(t, server->scratch);
+    }
+    TEXT_LITERAL(t, "]}");
+    free(ids);
+    return written;
+}
+
+// {"type":"update","frames":[...]} for a run of tagged frames
+static void json_update(text_t* t, const uint8_t* data, size_t length) {
+    TEXT_LITERAL(t, "{\"type\":\"update\",\"frames\":[");
+    size_t pos = 0;
+    bool first = true;
+    while (pos < length) {
+        uint16_t device_id;
+        uint32_t sequence;
+        stm32_frame_t frame;
+        size_t used = gateway_decode_tagged(data + pos, length - pos, &device_id, &sequence, &frame);
+        if (!used) break;
+        if (!first) TEXT_LITERAL(t, ",");
+        if (json_frame(t, device_id, sequence, &frame)) {
+            first = false;
+        } else if (!first) {
+            t->data[--t->length] = '\0';
+        }
+        pos += used;
+    }
+    TEXT_LITERAL(t, "]}");
+}
+
+// WebSocket framing. Server frames are never masked. With deflate the
+// payload is compressed without context takeover, so the same bytes are
+// valid for every client that negotiated permessage-deflate.
+static http_msg_t* ws_message(gw_http_server_t* server, uint8_t opcode,
+                              const uint8_t* payload, size_t length, bool compress) {
+    uint8_t* compressed = NULL;
+    if (compress && length >= WS_DEFLATE_MIN && server->deflater_ready) {
+        size_t capacity = deflateBound(&server->deflater, (uLong)length) + 16;
+        byte_buffer_t* b = &server->deflated;
+        if (capacity > b->capacity) {
+            uint8_t* grown = realloc(b->data, capacity);
+            if (grown) {
+                b->data = grown;
+                b->capacity = capacity;
+            }
+        }
+        if (capacity <= b->capacity) {
+            compressed = b->data;
+            deflateReset(&server->deflater);
+            server->deflater.next_in = (Bytef*)payload;
+            server->deflater.avail_in = (uInt)length;
+            server->deflater.next_out = compressed;
+            server->deflater.avail_out = (uInt)capacity;
+            if (deflate(&server->deflater, Z_SYNC_FLUSH) == Z_OK && server->deflater.avail_in == 0) {
+                size_t produced = capacity - server->deflater.avail_out;
+                // RFC 7692: drop the trailing empty stored block
+                if (produced >= 4 && memcmp(compressed + produced - 4, "\x00\x00\xff\xff", 4) == 0) {
+                    produced -= 4;
+                }
+                payload = compressed;
+                length = produced;
+            } else {
+                compressed = NULL;
+            }
+        }
+    }
+
+    size_t header = length < 126 ? 2 : (length <= 0xFFFF ? 4 : 10);
+    http_msg_t* m = msg_alloc(server, header + length);
+    if (m) {
+        m->data[0] = (uint8_t)(0x80 | (compressed ? 0x40 : 0) | opcode);
+        if (header == 2) {
+            m->data[1] = (uint8_t)length;
+        } else if (header == 4) {
+            m->data[1] = 126;
+            m->data[2] = (uint8_t)(length >> 8);
+            m->data[3] = (uint8_t)length;
+        } else {
+            m->data[1] = 127;
+            for (int i = 0; i < 8; i++) m->data[2 + i] = (uint8_t)((uint64_t)length >> (56 - 8 * i));
+        }
+        memcpy(m->data + header, payload, length);
+    }
+    return m;
+}
+
+gw_http_server_t* gw_http_create(gateway_t* gw, uint16_t port) {
+    if (!gw) return NULL;
+
+    gw_http_server_t* server = calloc(1, sizeof(gw_http_server_t));
+    if (!server) return NULL;
+
+    server->scratch = malloc(sizeof(gw_device_state_t));
+    server->refill = malloc(HTTP_REFILL_BYTES);
+    // Batch buffers at their cap, as in the TCP output stream
+    server->pending.data = malloc(HTTP_PENDING_MAX);
+    server->active.data = malloc(HTTP_PENDING_MAX);
+    server->pending.capacity = server->active.capacity = HTTP_PENDING_MAX;
+    bool ready = server->pending.data && server->active.data;
+    for (int i = 0; i < HTTP_MSG_CLASSES; i++) {
+        server->msg_pools[i] = pool_create(msg_classes[i].size, msg_classes[i].count);
+        ready = ready && server->msg_pools[i];
+    }
+    if (!server->scratch || !server->refill || !ready) {
+        for (int i = 0; i < HTTP_MSG_CLASSES; i++) pool_destroy(server->msg_pools[i]);
+        free(server->scratch);
+        free(server->refill);
+        free(server->pending.data);
+        free(server->active.data);
+        free(server);
+        return NULL;
+    }
+    server->gw = gw;
+    server->port = port;
+    server->listen_fd = -1;
+    server->epoll_fd = -1;
+    server->wake_fd = -1;
+    pthread_mutex_init(&server->lock, NULL);
+    for (int i = 0; i < GW_HTTP_MAX_CLIENTS; i++) {
+        server->clients[i].fd = -1;
+    }
+    // Raw deflate (no zlib header) as permessage-deflate requires
+    server->deflater_ready = deflateInit2(&server->deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                                          -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+
+    // Scratch for the largest pooled message up front, so it never grows
+    // under load; a bigger batch just takes the heap path
+    size_t largest = msg_classes[HTTP_MSG_CLASSES - 1].size;
+    text_reserve(&server->batch_json, largest);
+    text_reserve(&server->refill_json, largest);
+    if (server->deflater_ready) {
+        server->deflated.capacity = deflateBound(&server->deflater, (uLong)largest) + 16;
+        server->deflated.data = malloc(server->deflated.capacity);
+        if (!server->deflated.data) server->deflated.capacity = 0;
+    }
+    return server;
+}
+
+// Client handling; everything below runs on the server thread
+static void client_drop(gw_http_server_t* server, http_client_t* c) {
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    while (c->queue_count > 0) {
+        msg_release(c->queue[c->queue_head]);
+        c->queue_head = (c->queue_head + 1) % GW_HTTP_CLIENT_QUEUE;
+        c->queue_count--;
+    }
+    if (c->kind == CLIENT_WEBSOCKET) {
+        atomic_fetch_sub_explicit(&server->websocket_clients, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_sub_explicit(&server->http_clients, 1, memory_order_relaxed);
+    }
+    for (uint8_t i = 0; i < c->watch_count; i++) {
+        gateway_watch(server->gw, c->watched[i], 0, false);
+    }
+    free(c->in);
+    conflate_destroy(c->backlog);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+}
+
+static bool client_refill(gw_http_server_t* server, http_client_t* c);
+
+static void client_flush(gw_http_server_t* server, http_client_t* c) {
+    for (;;) {
+        while (c->queue_count > 0) {
+            http_msg_t* m = c->queue[c->queue_head];
+            ssize_t n = send(c->fd, m->data + c->queue_offset, m->length - c->queue_offset,
+                             MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) {
+                atomic_fetch_add_explicit(&server->bytes_sent, (uint64_t)n, memory_order_relaxed);
+                c->queue_offset += (size_t)n;
+                if (c->queue_offset == m->length) {
+                    msg_release(m);
+                    c->queue_head = (c->queue_head + 1) % GW_HTTP_CLIENT_QUEUE;
+                    c->queue_count--;
+                    c->queue_offset = 0;
+                }
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                client_drop(server, c);
+                return;
+            }
+        }
+        // Caught up with the queue: send what the backlog conflated meanwhile
+        if (c->queue_count > 0 || !c->conflating || !client_refill(server, c)) break;
+    }
+
+    if (c->queue_count == 0 && c->kind == CLIENT_CLOSING) {
+        client_drop(server, c);
+        return;
+    }
+
+    bool want_write = c->queue_count > 0;
+    if (want_write != c->want_write) {
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP | (want_write ? EPOLLOUT : 0);
+        ev.data.ptr = c;
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_write = want_write;
+    }
+}
+
+// Queues a reference to m; the caller keeps its own reference
+static void client_enqueue(gw_http_server_t* server, http_client_t* c, http_msg_t* m) {
+    if (!m) return;
+    if (c->queue_count == GW_HTTP_CLIENT_QUEUE) {
+        fprintf(stderr, "HTTP: client too slow, disconnecting\n");
+        atomic_fetch_add_explicit(&server->clients_dropped, 1, memory_order_relaxed);
+        client_drop(server, c);
+        return;
+    }
+
+    m->refs++;
+    c->queue[(c->queue_head + c->queue_count) % GW_HTTP_CLIENT_QUEUE] = m;
+    c->queue_count++;
+    atomic_fetch_add_explicit(&server->messages_sent, 1, memory_order_relaxed);
+    if (c->queue_count == 1) client_flush(server, c);
+}
+
+static void client_respond(gw_http_server_t* server, http_client_t* c, const char* status,
+                           const char* content_type, const char* body, size_t length) {
+    text_t t = {0};
+    text_printf(&t, "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\n"
+                    "Cache-Control: no-store\r\nConnection: close\r\n\r\n",
+                status, content_type, length);
+    http_msg_t* m = t.data ? msg_alloc(server, t.length + length) : NULL;
+    if (m) {
+        memcpy(m->data, t.data, t.length);
+        memcpy(m->data + t.length, body, length);
+    }
+    free(t.data);
+
+    c->kind = CLIENT_CLOSING;
+    client_enqueue(server, c, m);
+    msg_release(m);
+}
+
+// Case-insensitive header lookup in a NUL-terminated request
+static bool header_value(const char* request, const char* name, char* out, size_t capacity) {
+    size_t name_len = strlen(name);
+    const char* line = strstr(request, "\r\n");
+    while (line && line[2] != '\r') {
+        line += 2;
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char* v = line + name_len + 1;
+            while (*v == ' ' || *v == '\t') v++;
+            const char* end = strstr(v, "\r\n");
+            size_t len = end ? (size_t)(end - v) : strlen(v);
+            if (len >= capacity) len = capacity - 1;
+            memcpy(out, v, len);
+            out[len] = '\0';
+            return true;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return false;
+}
+
+static void websocket_upgrade(gw_http_server_t* server, http_client_t* c, const char* request, const char* query) {
+    char value[256], key[128];
+    if (!header_value(request, "Upgrade", value, sizeof(value)) || strcasecmp(value, "websocket") != 0 ||
+        !header_value(request, "Sec-WebSocket-Key", key, sizeof(key)) ||
+        !header_value(request, "Sec-WebSocket-Version", value, sizeof(value)) || strcmp(value, "13") != 0) {
+        static const char body[] = "WebSocket upgrade required\n";
+        client_respond(server, c, "400 Bad Request", "text/plain", body, sizeof(body) - 1);
+        return;
+    }
+
+    char material[256];
+    uint8_t digest[20];
+    char accept[32];
+    int n = snprintf(material, sizeof(material), "%s%s", key, WS_GUID);
+    sha1((const uint8_t*)material, (size_t)n, digest);
+    base64_encode(digest, sizeof(digest), accept);
+
+    c->binary = query && strstr(query, "format=binary") != NULL;
+    const char* watch = query ? strstr(query, "watch=") : NULL;
+    if (watch) {
+        // The page shows these devices in detail: sample them fast while it is open
+        const char* p = watch + 6;
+        while (c->watch_count < GW_HTTP_MAX_WATCH && *p >= '0' && *p <= '9') {
+            char* end;
+            unsigned long id = strtoul(p, &end, 10);
+            if (id <= 0xFFFF && gateway_watch(server->gw, (uint16_t)id, 0, true) == HW_STATUS_OK) {
+                c->watched[c->watch_count++] = (uint16_t)id;
+            }
+            p = *end == ',' ? end + 1 : end;
+        }
+    }
+    c->deflate = server->deflater_ready &&
+                 header_value(request, "Sec-WebSocket-Extensions", value, sizeof(value)) &&
+                 strstr(value, "permessage-deflate") != NULL;
+
+    text_t t = {0};
+    text_printf(&t, "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                    "Sec-WebSocket-Accept: %s\r\n", accept);
+    if (c->deflate) {
+        text_printf(&t, "Sec-WebSocket-Extensions: permessage-deflate; "
+                        "server_no_context_takeover; client_no_context_takeover\r\n");
+    }
+    TEXT_LITERAL(&t, "\r\n");
+    http_msg_t* m = t.data ? msg_alloc(server, t.length) : NULL;
+    if (m) memcpy(m->data, t.data, t.length);
+    free(t.data);
+
+    c->kind = CLIENT_WEBSOCKET;
+    atomic_fetch_sub_explicit(&server->http_clients, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&server->websocket_clients, 1, memory_order_relaxed);
+    client_enqueue(server, c, m);
+    msg_release(m);
+    if (c->fd < 0) return;
+
+    // Full state first so the page renders without waiting for a cycle
+    text_t snapshot = {0};
+    json_snapshot(server, &snapshot, -1);
+    m = snapshot.data ? ws_message(server, WS_OP_TEXT, (const uint8_t*)snapshot.data, snapshot.length, c->deflate)
+                      : NULL;
+    free(snapshot.data);
+    client_enqueue(server, c, m);
+    msg_release(m);
+}
+
+static void handle_request(gw_http_server_t* server, http_client_t* c) {
+    char* request = (char*)c->in;
+    char method[8], target[256];
+    atomic_fetch_add_explicit(&server->requests, 1, memory_order_relaxed);
+
+    if (sscanf(request, "%7s %255s HTTP/1.%*c", method, target) != 2) {
+        static const char body[] = "Bad request\n";
+        client_respond(server, c, "400 Bad Request", "text/plain", body, sizeof(body) - 1);
+        return;
+    }
+    if (strcmp(method, "GET") != 0) {
+        static const char body[] = "Only GET is supported\n";
+        client_respond(server, c, "405 Method Not Allowed", "text/plain", body, sizeof(body) - 1);
+        return;
+    }
+
+    char* query = strchr(target, '?');
+    if (query) *query++ = '\0';
+
+    unsigned device_id;
+    int filter = -2;
+    if (strcmp(target, "/ws") == 0) {
+        websocket_upgrade(server, c, request, query);
+        return;
+    } else if (strcmp(target, "/api/snapshot") == 0) {
+        filter = -1;
+    } else if (sscanf(target, "/api/devices/%u", &device_id) == 1 && device_id <= 0xFFFF) {
+        filter = (int)device_id;
+    }
+
+    if (filter == -2) {
+        static const char body[] = "Not found\n";
+        client_respond(server, c, "404 Not Found", "text/plain", body, sizeof(body) - 1);
+        return;
+    }
+    text_t body = {0};
+    if (json_snapshot(server, &body, filter) == 0 && filter >= 0) {
+        static const char missing[] = "Unknown device\n";
+        client_respond(server, c, "404 Not Found", "text/plain", missing, sizeof(missing) - 1);
+    } else {
+        client_respond(server, c, "200 OK", "application/json", body.data ? body.data : "", body.length);
+    }
+    free(body.data);
+}
+
+// Client frames are only inspected for control opcodes; data is ignored
+static void handle_websocket_input(gw_http_server_t* server, http_client_t* c) {
+    size_t pos = 0;
+    while (c->in_length - pos >= 2) {
+        const uint8_t* f = c->in + pos;
+        // Clients mask every frame; an unmasked one fails the connection
+        if (!(f[1] & 0x80)) {
+            client_drop(server, c);
+            return;
+        }
+        uint8_t opcode = f[0] & 0x0F;
+        uint64_t length = f[1] & 0x7F;
+        size_t header = 2;
+        if (length == 126) {
+            if (c->in_length - pos < 4) break;
+            length = ((uint64_t)f[2] << 8) | f[3];
+            header = 4;
+        } else if (length == 127) {
+            if (c->in_length - pos < 10) break;
+            length = 0;
+            for (int i = 0; i < 8; i++) length = (length << 8) | f[2 + i];
+            header = 10;
+        }
+        header += 4;
+        if (length > HTTP_INPUT_MAX - header) {
+            client_drop(server, c);
+            return;
+        }
+        if (c->in_length - pos < header + length) break;
+
+        uint8_t payload[125];
+        size_t n = length <= sizeof(payload) ? (size_t)length : 0;
+        for (size_t i = 0; i < n; i++) {
+            payload[i] = f[header + i] ^ f[header - 4 + (i & 3)];
+        }
+
+        if (opcode == WS_OP_CLOSE || opcode == WS_OP_PING) {
+            http_msg_t* m = ws_message(server, opcode == WS_OP_CLOSE ? WS_OP_CLOSE : WS_OP_PONG,
+                                       payload, n, false);
+            if (opcode == WS_OP_CLOSE) {
+                atomic_fetch_sub_explicit(&server->websocket_clients, 1, memory_order_relaxed);
+                atomic_fetch_add_explicit(&server->http_clients, 1, memory_order_relaxed);
+                c->kind = CLIENT_CLOSING;
+            }
+            client_enqueue(server, c, m);
+            msg_release(m);
+            if (c->fd < 0 || c->kind == CLIENT_CLOSING) return;
+        }
+        pos += header + (size_t)length;
+    }
+    memmove(c->in, c->in + pos, c->in_length - pos);
+    c->in_length -= pos;
+}
+
+static void client_read(gw_http_server_t* server, http_client_t* c) {
+    for (;;) {
+        // Too large; a zero-length recv would read as EOF
+        if (c->in_length == HTTP_INPUT_MAX) {
+            client_drop(server, c);
+            return;
+        }
+        ssize_t n = recv(c->fd, c->in + c->in_length, HTTP_INPUT_MAX - c->in_length, MSG_DONTWAIT);
+        if (n == 0) {
+            client_drop(server, c);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) client_drop(server, c);
+            return;
+        }
+        c->in_length += (size_t)n;
+
+        if (c->kind == CLIENT_HTTP) {
+            c->in[c->in_length] = '\0';
+            char* end = strstr((char*)c->in, "\r\n\r\n");
+            if (end) {
+                size_t used = (size_t)(end + 4 - (char*)c->in);
+                handle_request(server, c);
+                if (c->fd < 0) return;
+                // A client may send its first frame right behind the upgrade
+                memmove(c->in, c->in + used, c->in_length - used);
+                c->in_length -= used;
+                if (c->kind == CLIENT_WEBSOCKET && c->in_length > 0) {
+                    handle_websocket_input(server, c);
+                    if (c->fd < 0) return;
+                }
+            } else if (c->in_length == HTTP_INPUT_MAX) {
+                static const char body[] = "Request too large\n";
+                client_respond(server, c, "431 Request Header Fields Too Large", "text/plain",
+                               body, sizeof(body) - 1);
+                return;
+            }
+        } else if (c->kind == CLIENT_WEBSOCKET) {
+            handle_websocket_input(server, c);
+            if (c->fd < 0) return;
+        } else {
+            c->in_length = 0;
+        }
+    }
+}
+
+static void accept_clients(gw_http_server_t* server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        http_client_t* slot = NULL;
+        for (int i = 0; i < GW_HTTP_MAX_CLIENTS; i++) {
+            if (server->clients[i].fd < 0) {
+                slot = &server->clients[i];
+                break;
+            }
+        }
+        uint8_t* in = slot ? malloc(HTTP_REQUEST_MAX) : NULL;
+        if (!in) {
+            close(fd);
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        memset(slot, 0, sizeof(*slot));
+        slot->fd = fd;
+        slot->kind = CLIENT_HTTP;
+        slot->in = in;
+
+        struct epoll_event ev;
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.ptr = slot;
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        atomic_fetch_add_explicit(&server->http_clients, 1, memory_order_relaxed);
+    }
+}
+
+static void client_start_conflating(http_client_t* c) {
+    if (!c->backlog) {
+        c->backlog = conflate_create(GW_HTTP_CONFLATE_KEYS, GW_HTTP_CONFLATE_LOSSLESS, GW_MAX_TAGGED_SIZE);
+        if (!c->backlog) return;
+    }
+    c->conflating = true;
+}
+
+// Keeps the latest value per record for a lagging client; alarms in full
+static void client_conflate(gw_http_server_t* server, http_client_t* c, const uint8_t* data, size_t length) {
+    conflate_stats_t before, after;
+    conflate_get_stats(c->backlog, &before);
+
+    size_t pos = 0;
+    while (pos < length) {
+        size_t used = gateway_decode_tagged(data + pos, length - pos, NULL, NULL, NULL);
+        if (!used) break;
+        uint64_t key = 0;
+        bool keyed = gateway_conflation_key(data + pos, used, &key);
+        if (conflate_push(c->backlog, key, !keyed, data + pos, (uint32_t)used) != HW_STATUS_OK) {
+            fprintf(stderr, "HTTP: client backlog full, disconnecting\n");
+            atomic_fetch_add_explicit(&server->clients_dropped, 1, memory_order_relaxed);
+            client_drop(server, c);
+            return;
+        }
+        pos += used;
+    }
+
+    conflate_get_stats(c->backlog, &after);
+    atomic_fetch_add_explicit(&server->frames_conflated, after.conflated - before.conflated, memory_order_relaxed);
+}
+
+// Encodes up to HTTP_REFILL_BYTES of backlog for this client alone and
+// queues it. False when there was nothing to send.
+static bool client_refill(gw_http_server_t* server, http_client_t* c) {
+    size_t length = 0;
+    uint32_t used;
+    while (length + GW_MAX_TAGGED_SIZE <= HTTP_REFILL_BYTES &&
+           conflate_pop(c->backlog, server->refill + length, GW_MAX_TAGGED_SIZE, &used) == HW_STATUS_OK) {
+        length += used;
+    }
+    if (conflate_is_empty(c->backlog)) c->conflating = false;
+    if (length == 0) return false;
+
+    http_msg_t* m = NULL;
+    if (c->binary) {
+        m = ws_message(server, WS_OP_BINARY, server->refill, length, c->deflate);
+    } else {
+        text_t* json = &server->refill_json;
+        json->length = 0;
+        json_update(json, server->refill, length);
+        if (json->data) m = ws_message(server, WS_OP_TEXT, (const uint8_t*)json->data, json->length, c->deflate);
+    }
+    if (!m) return false;
+
+    // Queued directly: the caller is the flush loop
+    c->queue[(c->queue_head + c->queue_count) % GW_HTTP_CLIENT_QUEUE] = m;
+    c->queue_count++;
+    atomic_fetch_add_explicit(&server->messages_serialized, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&server->messages_sent, 1, memory_order_relaxed);
+    return true;
+}
+
+// Tagged frames in the pending buffer were validated by the sink
+static size_t tagged_size(const uint8_t* frame) {
+    return GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD + frame[GW_TAG_HEADER_SIZE + 3];
+}
+
+// Serializes one batch at most once per variant and queues it by
+// reference to every WebSocket client
+static void publish_batch(gw_http_server_t* server, const uint8_t* data, size_t length) {
+    http_msg_t* variants[4] = {NULL, NULL, NULL, NULL};
+    // Not refill_json: enqueueing can refill a client that just caught up
+    text_t* json = &server->batch_json;
+    bool json_built = false;
+
+    for (int i = 0; i < GW_HTTP_MAX_CLIENTS; i++) {
+        http_client_t* c = &server->clients[i];
+        if (c->fd < 0 || c->kind != CLIENT_WEBSOCKET) continue;
+        if (c->conflating) {
+            client_conflate(server, c, data, length);
+            continue;
+        }
+
+        int v = VARIANT(c->binary, c->deflate);
+        if (!variants[v]) {
+            if (c->binary) {
+                variants[v] = ws_message(server, WS_OP_BINARY, data, length, c->deflate);
+            } else {
+                if (!json_built) {
+                    json->length = 0;
+                    json_update(json, data, length);
+                    json_built = true;
+                }
+                variants[v] = json->data ? ws_message(server, WS_OP_TEXT, (const uint8_t*)json->data, json->length,
+                                                      c->deflate)
+                                         : NULL;
+            }
+            if (variants[v]) {
+                atomic_fetch_add_explicit(&server->messages_serialized, 1, memory_order_relaxed);
+            }
+        }
+        client_enqueue(server, c, variants[v]);
+        if (c->fd >= 0 && c->queue_count >= HTTP_CONFLATE_HIGH) client_start_conflating(c);
+    }
+
+    for (int v = 0; v < 4; v++) msg_release(variants[v]);
+}
+
+// Publishes what the sink gathered since the last wakeup, in batches of at
+// most HTTP_BATCH_BYTES so every message fits a pooled block
+static void publish_pending(gw_http_server_t* server) {
+    pthread_mutex_lock(&server->lock);
+    byte_buffer_t swap = server->active;
+    server->active = server->pending;
+    server->pending = swap;
+    server->pending.length = 0;
+    pthread_mutex_unlock(&server->lock);
+
+    const uint8_t* data = server->active.data;
+    size_t length = server->active.length;
+    server->active.length = 0;
+    if (length == 0 || atomic_load_explicit(&server->websocket_clients, memory_order_relaxed) == 0) return;
+
+    size_t pos = 0;
+    while (pos < length) {
+        size_t end = pos;
+        while (end < length && end - pos + tagged_size(data + end) <= HTTP_BATCH_BYTES) {
+            end += tagged_size(data + end);
+        }
+        publish_batch(server, data + pos, end - pos);
+        pos = end;
+    }
+}
+
+static void* http_main(void* arg) {
+    gw_http_server_t* server = arg;
+    struct epoll_event events[HTTP_EPOLL_BATCH];
+
+    while (atomic_load_explicit(&server->running, memory_order_acquire)) {
+        int n = epoll_wait(server->epoll_fd, events, HTTP_EPOLL_BATCH, 500);
+        for (int i = 0; i < n; i++) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &server->listen_fd) {
+                accept_clients(server);
+            } else if (ptr == &server->wake_fd) {
+                uint64_t value;
+                if (read(server->wake_fd, &value, sizeof(value)) < 0) {
+                    // Nothing to drain
+                }
+                publish_pending(server);
+            } else {
+                http_client_t* c = ptr;
+                if (c->fd < 0) continue;
+                if (events[i].events & EPOLLIN) client_read(server, c);
+                if (c->fd >= 0 && (events[i].events & EPOLLOUT)) client_flush(server, c);
+                if (c->fd >= 0 && (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                    client_drop(server, c);
+                }
+            }
+        }
+    }
+    return NULL;
+}
+
+hw_status_t gw_http_start(gw_http_server_t* server) {
+    if (!server) return HW_STATUS_INVALID_PARAM;
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0) return HW_STATUS_ERROR;
+
+    int opt = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(server->port);
+    if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(server->listen_fd, 64) < 0) {
+        perror("HTTP: bind/listen failed");
+        return HW_STATUS_ERROR;
+    }
+
+    socklen_t len = sizeof(addr);
+    if (getsockname(server->listen_fd, (struct sockaddr*)&addr, &len) == 0) {
+        server->port = ntohs(addr.sin_port);
+    }
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (server->epoll_fd < 0 || server->wake_fd < 0) return HW_STATUS_ERROR;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &server->listen_fd;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &ev);
+    ev.data.ptr = &server->wake_fd;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &ev);
+
+    atomic_store_explicit(&server->running, true, memory_order_release);
+    if (pthread_create(&server->thread, NULL, http_main, server) != 0) {
+        atomic_store_explicit(&server->running, false, memory_order_release);
+        return HW_STATUS_ERROR;
+    }
+    return HW_STATUS_OK;
+}
+
+uint16_t gw_http_port(gw_http_server_t* server) {
+    return server ? server->port : 0;
+}
+
+void gw_http_destroy(gw_http_server_t* server) {
+    if (!server) return;
+
+    if (atomic_exchange(&server->running, false)) {
+        uint64_t one = 1;
+        if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+            // Thread still exits on its next timeout
+        }
+        pthread_join(server->thread, NULL);
+    }
+    for (int i = 0; i < GW_HTTP_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0) client_drop(server, &server->clients[i]);
+    }
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+    if (server->wake_fd >= 0) close(server->wake_fd);
+    if (server->deflater_ready) deflateEnd(&server->deflater);
+    pthread_mutex_destroy(&server->lock);
+    free(server->pending.data);
+    free(server->active.data);
+    free(server->scratch);
+    free(server->refill);
+    free(server->batch_json.data);
+    free(server->refill_json.data);
+    free(server->deflated.data);
+    // Clients are gone, so every pooled message is back
+    for (int i = 0; i < HTTP_MSG_CLASSES; i++) pool_destroy(server->msg_pools[i]);
+    free(server);
+}
+
+void gw_http_get_stats(gw_http_server_t* server, gw_http_stats_t* stats) {
+    if (!server || !stats) return;
+
+    stats->http_clients = atomic_load_explicit(&server->http_clients, memory_order_relaxed);
+    stats->websocket_clients = atomic_load_explicit(&server->websocket_clients, memory_order_relaxed);
+    stats->requests = atomic_load_explicit(&server->requests, memory_order_relaxed);
+    stats->messages_serialized = atomic_load_explicit(&server->messages_serialized, memory_order_relaxed);
+    stats->messages_sent = atomic_load_explicit(&server->messages_sent, memory_order_relaxed);
+    stats->bytes_sent = atomic_load_explicit(&server->bytes_sent, memory_order_relaxed);
+    stats->clients_dropped = atomic_load_explicit(&server->clients_dropped, memory_order_relaxed);
+    stats->frames_conflated = atomic_load_explicit(&server->frames_conflated, memory_order_relaxed);
+    stats->heap_messages = atomic_load_explicit(&server->heap_messages, memory_order_relaxed);
+}
+
+void gw_http_sink(const gw_tagged_frame_t* frame, void* user_data) {
+    gw_http_server_t* server = user_data;
+    if (!server || !frame || !frame->wire_length) return;
+    if (atomic_load_explicit(&server->websocket_clients, memory_order_relaxed) == 0) return;
+
+    pthread_mutex_lock(&server->lock);
+    bool was_empty = server->pending.length == 0;
+    bool queued = false;
+    byte_buffer_t* b = &server->pending;
+    if (b->length + frame->wire_length <= HTTP_PENDING_MAX) {
+        if (b->length + frame->wire_length > b->capacity) {
+            size_t capacity = b->capacity ? b->capacity : 65536;
+            while (capacity < b->length + frame->wire_length) capacity *= 2;
+            uint8_t* grown = realloc(b->data, capacity);
+            if (grown) {
+                b->data = grown;
+                b->capacity = capacity;
+            }
+        }
+        if (b->length + frame->wire_length <= b->capacity) {
+            memcpy(b->data + b->length, frame->wire, frame->wire_length);
+            b->length += frame->wire_length;
+            queued = true;
+        }
+    }
+    pthread_mutex_unlock(&server->lock);
+
+    // One wakeup per batch, as in the TCP output stream
+    if (queued && was_empty) {
+        uint64_t one = 1;
+        if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+            // eventfd counter saturated; the server thread is already awake
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef GATEWAY_HTTP_H
+#define GATEWAY_HTTP_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "gateway.h"
+
+// Embedded HTTP/1.1 + WebSocket endpoint for browsers.
+//
+//   GET /api/snapshot        Latest state of every device as JSON
+//   GET /api/devices/<id>    Latest state of one device
+//   GET /ws[?format=binary]  WebSocket: a snapshot message, then live updates
+//       [&watch=<id>,<id>]   Devices the page shows in detail; sampled at the
+//                            fast rate while the socket is open
+//
+// Updates are batched; each batch is serialized once per variant (JSON or
+// binary tagged frames, plain or permessage-deflate) and the same encoded
+// message is queued to every client by reference. Binary messages carry the
+// same tagged frames as the TCP output stream.
+#define GW_HTTP_MAX_CLIENTS      256
+#define GW_HTTP_CLIENT_QUEUE     256     // Messages queued per client
+#define GW_HTTP_MAX_WATCH        16      // Devices one page can watch
+
+// A client with half its queue in use stops receiving shared batches and
+// gets a conflating backlog instead (latest value per record, alarms in
+// full), encoded for it alone as it catches up
+#define GW_HTTP_CONFLATE_KEYS    8192
+#define GW_HTTP_CONFLATE_LOSSLESS 4096
+
+typedef struct {
+    uint32_t http_clients;
+    uint32_t websocket_clients;
+    uint64_t requests;
+    uint64_t messages_serialized;        // Encoded once per batch and variant
+    uint64_t messages_sent;              // Sum over clients
+    uint64_t bytes_sent;
+    uint64_t clients_dropped;
+    uint64_t frames_conflated;           // Superseded before a lagging client read them
+    uint64_t heap_messages;              // Too large for the message pools, or every block was queued
+} gw_http_stats_t;
+
+typedef struct gw_http_server gw_http_server_t;
+
+gw_http_server_t* gw_http_create(gateway_t* gw, uint16_t port);
+hw_status_t gw_http_start(gw_http_server_t* server);
+void gw_http_destroy(gw_http_server_t* server);
+uint16_t gw_http_port(gw_http_server_t* server);
+void gw_http_get_stats(gw_http_server_t* server, gw_http_stats_t* stats);
+
+// Gateway sink; pass the server as user_data to gateway_add_sink()
+void gw_http_sink(const gw_tagged_frame_t* frame, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GATEWAY_HTTP_H
@@ -0,0 +1,710 @@
+#define _GNU_SOURCE
+#include "gateway_multicast.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define MCAST_MAGIC_HIGH      0x4E    // 'N'
+#define MCAST_MAGIC_DATA      0x43    // 'C'
+#define MCAST_MAGIC_NACK      0x4B    // 'K'
+#define MCAST_PENDING_MAX     (8 * 1024 * 1024)
+#define MCAST_EPOLL_BATCH     16
+#define MCAST_MAX_FRAMES      255     // Frame count is a u8
+#define MCAST_NACK_MAX        256     // Datagrams requested per NACK
+#define MCAST_RCVBUF          (4 * 1024 * 1024)
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_header(uint8_t* p, uint8_t flags, uint8_t count, uint32_t session, uint32_t sequence) {
+    p[0] = MCAST_MAGIC_HIGH;
+    p[1] = MCAST_MAGIC_DATA;
+    p[2] = flags;
+    p[3] = count;
+    put_u32(p + 4, session);
+    put_u32(p + 8, sequence);
+}
+
+// Sequence distance that survives u32 wraparound; negative when b is ahead
+static int32_t seq_diff(uint32_t a, uint32_t b) {
+    return (int32_t)(a - b);
+}
+
+static uint64_t mcast_now_ms(void) {
+    return gw_monotonic_ns() / 1000000ull;
+}
+
+static bool parse_ipv4(const char* text, struct in_addr* out) {
+    return text && text[0] && inet_pton(AF_INET, text, out) == 1;
+}
+
+void gw_mcast_default_config(gw_mcast_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    snprintf(config->group, sizeof(config->group), "239.255.0.1");
+    config->port = 9200;
+    config->ttl = 1;
+    config->history = 4096;
+    config->heartbeat_ms = 250;
+}
+
+void gw_mcast_receiver_default_config(gw_mcast_receiver_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    snprintf(config->group, sizeof(config->group), "239.255.0.1");
+    config->port = 9200;
+    config->nack_interval_ms = 20;
+    config->nack_attempts = 5;
+}
+
+// Publisher
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} byte_buffer_t;
+
+typedef struct {
+    uint16_t length;
+    uint8_t data[GW_MCAST_MAX_DATAGRAM];
+} mcast_slot_t;
+
+struct gw_mcast_publisher {
+    gw_mcast_config_t config;
+    int fd;
+    int epoll_fd;
+    int wake_fd;
+    pthread_t thread;
+    atomic_bool running;
+    struct sockaddr_in group_addr;
+
+    uint32_t session;
+    uint32_t next_sequence;
+    uint32_t held;                  // Datagrams in history, at most config.history
+    mcast_slot_t* history;
+    uint64_t last_send_ms;
+
+    // Producers append tagged frames here; the publisher thread swaps it out
+    pthread_mutex_t lock;
+    byte_buffer_t pending;
+    uint64_t pending_frames;
+    byte_buffer_t active;
+
+    atomic_uint_fast64_t frames_published;
+    atomic_uint_fast64_t datagrams_sent;
+    atomic_uint_fast64_t bytes_sent;
+    atomic_uint_fast64_t heartbeats;
+    atomic_uint_fast64_t nacks_received;
+    atomic_uint_fast64_t retransmits;
+    atomic_uint_fast64_t gone;
+};
+
+gw_mcast_publisher_t* gw_mcast_publisher_create(const gw_mcast_config_t* config) {
+    if (!config || config->history == 0) return NULL;
+
+    struct in_addr group;
+    if (!parse_ipv4(config->group, &group) || !IN_MULTICAST(ntohl(group.s_addr))) {
+        fprintf(stderr, "Multicast: %s is not an IPv4 multicast group\n", config->group);
+        return NULL;
+    }
+
+    gw_mcast_publisher_t* pub = calloc(1, sizeof(gw_mcast_publisher_t));
+    if (!pub) return NULL;
+
+    pub->history = calloc(config->history, sizeof(mcast_slot_t));
+    if (!pub->history) {
+        free(pub);
+        return NULL;
+    }
+    pub->config = *config;
+    pub->fd = -1;
+    pub->epoll_fd = -1;
+    pub->wake_fd = -1;
+    pub->group_addr.sin_family = AF_INET;
+    pub->group_addr.sin_addr = group;
+    pub->group_addr.sin_port = htons(config->port);
+    pub->session = (uint32_t)(gw_monotonic_ns() ^ ((uint64_t)getpid() << 16));
+    pthread_mutex_init(&pub->lock, NULL);
+    return pub;
+}
+
+static void publisher_send(gw_mcast_publisher_t* pub, const uint8_t* data, size_t length,
+                           const struct sockaddr_in* to) {
+    ssize_t n = sendto(pub->fd, data, length, MSG_DONTWAIT, (const struct sockaddr*)to, sizeof(*to));
+    if (n > 0) {
+        atomic_fetch_add_explicit(&pub->bytes_sent, (uint64_t)n, memory_order_relaxed);
+    }
+    pub->last_send_ms = mcast_now_ms();
+}
+
+// Seals the datagram being built in the next history slot and multicasts it
+static void publisher_emit(gw_mcast_publisher_t* pub, mcast_slot_t* slot, uint8_t frames) {
+    put_header(slot->data, 0, frames, pub->session, pub->next_sequence);
+    pub->next_sequence++;
+    if (pub->held < pub->config.history) pub->held++;
+
+    publisher_send(pub, slot->data, slot->length, &pub->group_addr);
+    atomic_fetch_add_explicit(&pub->datagrams_sent, 1, memory_order_relaxed);
+}
+
+// Packs the swapped-out batch into as few datagrams as fit the MTU
+static void publish_pending(gw_mcast_publisher_t* pub) {
+    pthread_mutex_lock(&pub->lock);
+    byte_buffer_t swap = pub->active;
+    pub->active = pub->pending;
+    pub->pending = swap;
+    pub->pending.length = 0;
+    uint64_t frames = pub->pending_frames;
+    pub->pending_frames = 0;
+    pthread_mutex_unlock(&pub->lock);
+
+    const uint8_t* data = pub->active.data;
+    size_t length = pub->active.length;
+    size_t offset = 0;
+    mcast_slot_t* slot = NULL;
+    uint8_t count = 0;
+
+    while (offset + GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD <= length) {
+        size_t size = GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD + data[offset + GW_TAG_HEADER_SIZE + 3];
+        if (offset + size > length) break;
+
+        if (slot && (slot->length + size > GW_MCAST_MAX_DATAGRAM || count == MCAST_MAX_FRAMES)) {
+            publisher_emit(pub, slot, count);
+            slot = NULL;
+        }
+        if (!slot) {
+            slot = &pub->history[pub->next_sequence % pub->config.history];
+            slot->length = GW_MCAST_HEADER_SIZE;
+            count = 0;
+        }
+        memcpy(slot->data + slot->length, data + offset, size);
+        slot->length += (uint16_t)size;
+        count++;
+        offset += size;
+    }
+    if (slot) publisher_emit(pub, slot, count);
+
+    atomic_fetch_add_explicit(&pub->frames_published, frames, memory_order_relaxed);
+    pub->active.length = 0;
+}
+
+static void publisher_heartbeat(gw_mcast_publisher_t* pub) {
+    uint8_t hb[GW_MCAST_HEADER_SIZE];
+    put_header(hb, GW_MCAST_FLAG_HEARTBEAT, 0, pub->session, pub->next_sequence);
+    publisher_send(pub, hb, sizeof(hb), &pub->group_addr);
+    atomic_fetch_add_explicit(&pub->heartbeats, 1, memory_order_relaxed);
+}
+
+// Resends what history still holds to the requester; older sequences
+// form a prefix of the range and are answered with one GONE datagram
+static void publisher_handle_nack(gw_mcast_publisher_t* pub, const uint8_t* nack, const struct sockaddr_in* from) {
+    if (get_u32(nack + 4) != pub->session) return;
+    atomic_fetch_add_explicit(&pub->nacks_received, 1, memory_order_relaxed);
+
+    uint32_t first = get_u32(nack + 8);
+    uint32_t count = get_u32(nack + 12);
+    if (count > MCAST_NACK_MAX) count = MCAST_NACK_MAX;
+
+    uint32_t gone = 0;
+    uint8_t resend[GW_MCAST_MAX_DATAGRAM];
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t sequence = first + i;
+        int32_t age = seq_diff(pub->next_sequence, sequence);
+        if (age <= 0) break;                     // Not sent yet
+        if ((uint32_t)age > pub->held) {
+            gone++;
+            continue;
+        }
+        const mcast_slot_t* slot = &pub->history[sequence % pub->config.history];
+        memcpy(resend, slot->data, slot->length);
+        resend[2] |= GW_MCAST_FLAG_RETRANSMIT;
+        publisher_send(pub, resend, slot->length, from);
+        atomic_fetch_add_explicit(&pub->retransmits, 1, memory_order_relaxed);
+    }
+
+    if (gone > 0) {
+        uint8_t reply[GW_MCAST_HEADER_SIZE + 4];
+        put_header(reply, GW_MCAST_FLAG_GONE, 0, pub->session, first);
+        put_u32(reply + GW_MCAST_HEADER_SIZE, gone);
+        publisher_send(pub, reply, sizeof(reply), from);
+        atomic_fetch_add_explicit(&pub->gone, gone, memory_order_relaxed);
+    }
+}
+
+static void publisher_read_nacks(gw_mcast_publisher_t* pub) {
+    uint8_t buffer[64];
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(pub->fd, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr*)&from, &from_len);
+        if (n < 0) return;
+        if (n == GW_MCAST_NACK_SIZE && buffer[0] == MCAST_MAGIC_HIGH && buffer[1] == MCAST_MAGIC_NACK) {
+            publisher_handle_nack(pub, buffer, &from);
+        }
+    }
+}
+
+static void* publisher_main(void* arg) {
+    gw_mcast_publisher_t* pub = arg;
+    struct epoll_event events[MCAST_EPOLL_BATCH];
+
+    while (atomic_load_explicit(&pub->running, memory_order_acquire)) {
+        uint64_t now = mcast_now_ms();
+        uint64_t due = pub->last_send_ms + pub->config.heartbeat_ms;
+        int timeout = pub->config.heartbeat_ms == 0 ? 500 : (due > now ? (int)(due - now) : 0);
+
+        int n = epoll_wait(pub->epoll_fd, events, MCAST_EPOLL_BATCH, timeout);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &pub->wake_fd) {
+                uint64_t value;
+                if (read(pub->wake_fd, &value, sizeof(value)) < 0) {
+                    // Nothing to drain
+                }
+                publish_pending(pub);
+            } else {
+                publisher_read_nacks(pub);
+            }
+        }
+        if (pub->config.heartbeat_ms && mcast_now_ms() >= pub->last_send_ms + pub->config.heartbeat_ms) {
+            publisher_heartbeat(pub);
+        }
+    }
+    return NULL;
+}
+
+hw_status_t gw_mcast_publisher_start(gw_mcast_publisher_t* pub) {
+    if (!pub) return HW_STATUS_INVALID_PARAM;
+
+    pub->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (pub->fd < 0) return HW_STATUS_ERROR;
+
+    // Bound to an ephemeral port: receivers send NACKs to the source address
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+    if (bind(pub->fd, (struct sockaddr*)&local, sizeof(local)) < 0) {
+        perror("Multicast: bind failed");
+        return HW_STATUS_ERROR;
+    }
+
+    unsigned char ttl = pub->config.ttl;
+    unsigned char loop = 1;
+    setsockopt(pub->fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+    setsockopt(pub->fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+    struct in_addr iface;
+    if (parse_ipv4(pub->config.interface_addr, &iface) &&
+        setsockopt(pub->fd, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface)) < 0) {
+        perror("Multicast: cannot select interface");
+        return HW_STATUS_ERROR;
+    }
+
+    pub->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    pub->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pub->epoll_fd < 0 || pub->wake_fd < 0) return HW_STATUS_ERROR;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &pub->fd;
+    epoll_ctl(pub->epoll_fd, EPOLL_CTL_ADD, pub->fd, &ev);
+    ev.data.ptr = &pub->wake_fd;
+    epoll_ctl(pub->epoll_fd, EPOLL_CTL_ADD, pub->wake_fd, &ev);
+
+    pub->last_send_ms = mcast_now_ms();
+    atomic_store_explicit(&pub->running, true, memory_order_release);
+    if (pthread_create(&pub->thread, NULL, publisher_main, pub) != 0) {
+        atomic_store_explicit(&pub->running, false, memory_order_release);
+        return HW_STATUS_ERROR;
+    }
+    return HW_STATUS_OK;
+}
+
+void gw_mcast_publisher_destroy(gw_mcast_publisher_t* pub) {
+    if (!pub) return;
+
+    if (atomic_exchange(&pub->running, false)) {
+        uint64_t one = 1;
+        if (write(pub->wake_fd, &one, sizeof(one)) < 0) {
+            // Thread still exits on its next timeout
+        }
+        pthread_join(pub->thread, NULL);
+    }
+    if (pub->fd >= 0) close(pub->fd);
+    if (pub->epoll_fd >= 0) close(pub->epoll_fd);
+    if (pub->wake_fd >= 0) close(pub->wake_fd);
+    pthread_mutex_destroy(&pub->lock);
+    free(pub->pending.data);
+    free(pub->active.data);
+    free(pub->history);
+    free(pub);
+}
+
+void gw_mcast_publisher_get_stats(gw_mcast_publisher_t* pub, gw_mcast_publisher_stats_t* stats) {
+    if (!pub || !stats) return;
+
+    stats->frames_published = atomic_load_explicit(&pub->frames_published, memory_order_relaxed);
+    stats->datagrams_sent = atomic_load_explicit(&pub->datagrams_sent, memory_order_relaxed);
+    stats->bytes_sent = atomic_load_explicit(&pub->bytes_sent, memory_order_relaxed);
+    stats->heartbeats = atomic_load_explicit(&pub->heartbeats, memory_order_relaxed);
+    stats->nacks_received = atomic_load_explicit(&pub->nacks_received, memory_order_relaxed);
+    stats->retransmits = atomic_load_explicit(&pub->retransmits, memory_order_relaxed);
+    stats->gone = atomic_load_explicit(&pub->gone, memory_order_relaxed);
+}
+
+void gw_mcast_sink(const gw_tagged_frame_t* frame, void* user_data) {
+    gw_mcast_publisher_t* pub = user_data;
+    if (!pub || !frame || !frame->wire_length) return;
+
+    pthread_mutex_lock(&pub->lock);
+    bool was_empty = pub->pending.length == 0;
+    bool queued = false;
+    byte_buffer_t* b = &pub->pending;
+    if (b->length + frame->wire_length <= MCAST_PENDING_MAX) {
+        if (b->length + frame->wire_length > b->capacity) {
+            size_t capacity = b->capacity ? b->capacity : 65536;
+            while (capacity < b->length + frame->wire_length) capacity *= 2;
+            uint8_t* grown = realloc(b->data, capacity);
+            if (grown) {
+                b->data = grown;
+                b->capacity = capacity;
+            }
+        }
+        if (b->length + frame->wire_length <= b->capacity) {
+            memcpy(b->data + b->length, frame->wire, frame->wire_length);
+            b->length += frame->wire_length;
+            pub->pending_frames++;
+            queued = true;
+        }
+    }
+    pthread_mutex_unlock(&pub->lock);
+
+    if (queued && was_empty) {
+        uint64_t one = 1;
+        if (write(pub->wake_fd, &one, sizeof(one)) < 0) {
+            // eventfd counter saturated; the publisher thread is already awake
+        }
+    }
+}
+
+// Receiver
+
+typedef struct {
+    bool present;
+    bool retransmit;
+    uint16_t length;
+    uint8_t data[GW_MCAST_MAX_DATAGRAM];
+} rx_slot_t;
+
+struct gw_mcast_receiver {
+    gw_mcast_receiver_config_t config;
+    int group_fd;
+    int nack_fd;                    // Unicast: NACKs out, retransmits in
+    struct sockaddr_in source;
+    bool have_source;
+
+    bool synced;
+    uint32_t session;
+    uint32_t next;                  // Next sequence to deliver
+    uint32_t end;                   // One past the highest sequence known to exist
+    rx_slot_t* window;
+
+    uint32_t gap_start;
+    bool in_gap;
+    uint32_t nack_attempts;
+    uint64_t last_nack_ms;
+    uint64_t multicast_received;
+
+    gw_mcast_receiver_stats_t stats;
+};
+
+gw_mcast_receiver_t* gw_mcast_receiver_open(const gw_mcast_receiver_config_t* config) {
+    if (!config) return NULL;
+
+    struct in_addr group;
+    if (!parse_ipv4(config->group, &group) || !IN_MULTICAST(ntohl(group.s_addr))) {
+        fprintf(stderr, "Multicast: %s is not an IPv4 multicast group\n", config->group);
+        return NULL;
+    }
+
+    gw_mcast_receiver_t* rx = calloc(1, sizeof(gw_mcast_receiver_t));
+    if (!rx) return NULL;
+    rx->window = calloc(GW_MCAST_REORDER_WINDOW, sizeof(rx_slot_t));
+    rx->config = *config;
+    rx->group_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    rx->nack_fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (!rx->window || rx->group_fd < 0 || rx->nack_fd < 0) {
+        gw_mcast_receiver_close(rx);
+        return NULL;
+    }
+
+    int one = 1;
+    int rcvbuf = MCAST_RCVBUF;
+    setsockopt(rx->group_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    setsockopt(rx->group_fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    // Binding to the group address keeps other traffic on the port out
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr = group;
+    addr.sin_port = htons(config->port);
+
+    struct ip_mreq mreq;
+    mreq.imr_multiaddr = group;
+    if (!parse_ipv4(config->interface_addr, &mreq.imr_interface)) {
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    }
+
+    struct sockaddr_in local;
+    memset(&local, 0, sizeof(local));
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = INADDR_ANY;
+
+    if (bind(rx->group_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        setsockopt(rx->group_fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+        bind(rx->nack_fd, (struct sockaddr*)&local, sizeof(local)) < 0) {
+        perror("Multicast: cannot join group");
+        gw_mcast_receiver_close(rx);
+        return NULL;
+    }
+    return rx;
+}
+
+void gw_mcast_receiver_close(gw_mcast_receiver_t* rx) {
+    if (!rx) return;
+    if (rx->group_fd >= 0) close(rx->group_fd);
+    if (rx->nack_fd >= 0) close(rx->nack_fd);
+    free(rx->window);
+    free(rx);
+}
+
+void gw_mcast_receiver_get_stats(gw_mcast_receiver_t* rx, gw_mcast_receiver_stats_t* stats) {
+    if (rx && stats) *stats = rx->stats;
+}
+
+static int deliver_datagram(gw_mcast_receiver_t* rx, const rx_slot_t* slot, gw_sink_fn_t fn, void* user_data) {
+    uint64_t now_ns = gw_monotonic_ns();
+    size_t offset = GW_MCAST_HEADER_SIZE;
+    int delivered = 0;
+
+    while (offset < slot->length) {
+        gw_tagged_frame_t tagged;
+        stm32_frame_t frame;
+        size_t used = gateway_decode_tagged(slot->data + offset, slot->length - offset,
+                                            &tagged.device_id, &tagged.sequence, &frame);
+        if (!used) break;
+        tagged.ingest_ns = now_ns;
+        tagged.frame = &frame;
+        tagged.wire = slot->data + offset;
+        tagged.wire_length = used;
+        if (fn) fn(&tagged, user_data);
+        offset += used;
+        delivered++;
+    }
+    rx->stats.frames_delivered += (uint64_t)delivered;
+    return delivered;
+}
+
+// Hands over every datagram that is now in order
+static int drain_window(gw_mcast_receiver_t* rx, gw_sink_fn_t fn, void* user_data) {
+    int delivered = 0;
+    for (;;) {
+        rx_slot_t* slot = &rx->window[rx->next % GW_MCAST_REORDER_WINDOW];
+        if (!slot->present || get_u32(slot->data + 8) != rx->next) break;
+        delivered += deliver_datagram(rx, slot, fn, user_data);
+        slot->present = false;
+        rx->next++;
+    }
+    if (seq_diff(rx->end, rx->next) < 0) rx->end = rx->next;
+    return delivered;
+}
+
+// Skips sequences that will never arrive, counting them as lost
+static void skip_to(gw_mcast_receiver_t* rx, uint32_t sequence) {
+    while (seq_diff(sequence, rx->next) > 0) {
+        rx_slot_t* slot = &rx->window[rx->next % GW_MCAST_REORDER_WINDOW];
+        if (slot->present && get_u32(slot->data + 8) == rx->next) break;
+        rx->stats.lost++;
+        rx->next++;
+    }
+}
+
+static void reset_session(gw_mcast_receiver_t* rx, uint32_t session, uint32_t sequence) {
+    if (rx->synced) rx->stats.session_changes++;
+    for (uint32_t i = 0; i < GW_MCAST_REORDER_WINDOW; i++) rx->window[i].present = false;
+    rx->synced = true;
+    rx->session = session;
+    rx->next = sequence;
+    rx->end = sequence;
+    rx->in_gap = false;
+}
+
+static int receive_datagram(gw_mcast_receiver_t* rx, const uint8_t* data, size_t length,
+                            gw_sink_fn_t fn, void* user_data) {
+    if (length < GW_MCAST_HEADER_SIZE || data[0] != MCAST_MAGIC_HIGH || data[1] != MCAST_MAGIC_DATA) return 0;
+
+    uint8_t flags = data[2];
+    uint32_t session = get_u32(data + 4);
+    uint32_t sequence = get_u32(data + 8);
+    rx->stats.datagrams++;
+
+    if (!rx->synced || session != rx->session) {
+        // Join at whatever the publisher sends now; history is not replayed
+        if (flags & GW_MCAST_FLAG_GONE) return 0;
+        reset_session(rx, session, sequence);
+    }
+
+    if (flags & GW_MCAST_FLAG_HEARTBEAT) {
+        if (seq_diff(sequence, rx->end) > 0) rx->end = sequence;
+        return 0;
+    }
+    if (flags & GW_MCAST_FLAG_GONE) {
+        if (length < GW_MCAST_HEADER_SIZE + 4) return 0;
+        uint32_t count = get_u32(data + GW_MCAST_HEADER_SIZE);
+        if (seq_diff(rx->next, sequence) >= 0 && seq_diff(rx->next, sequence + count) < 0) {
+            skip_to(rx, sequence + count);
+            rx->in_gap = false;
+        }
+        return drain_window(rx, fn, user_data);
+    }
+
+    int32_t ahead = seq_diff(sequence, rx->next);
+    if (ahead < 0) {
+        rx->stats.duplicates++;
+        return 0;
+    }
+    if (ahead >= GW_MCAST_REORDER_WINDOW) {
+        // Too far past the gap to buffer: give up on the oldest sequences
+        skip_to(rx, sequence - GW_MCAST_REORDER_WINDOW + 1);
+        int delivered = drain_window(rx, fn, user_data);
+        skip_to(rx, sequence - GW_MCAST_REORDER_WINDOW + 1);
+        return delivered + receive_datagram(rx, data, length, fn, user_data);
+    }
+
+    rx_slot_t* slot = &rx->window[sequence % GW_MCAST_REORDER_WINDOW];
+    if (slot->present && get_u32(slot->data + 8) == sequence) {
+        rx->stats.duplicates++;
+        return 0;
+    }
+    slot->present = true;
+    slot->retransmit = (flags & GW_MCAST_FLAG_RETRANSMIT) != 0;
+    slot->length = (uint16_t)length;
+    memcpy(slot->data, data, length);
+    if (slot->retransmit) rx->stats.recovered++;
+    if (seq_diff(sequence + 1, rx->end) > 0) rx->end = sequence + 1;
+
+    return drain_window(rx, fn, user_data);
+}
+
+static void send_nack(gw_mcast_receiver_t* rx, uint32_t first, uint32_t count) {
+    uint8_t nack[GW_MCAST_NACK_SIZE];
+    nack[0] = MCAST_MAGIC_HIGH;
+    nack[1] = MCAST_MAGIC_NACK;
+    nack[2] = 0;
+    nack[3] = 0;
+    put_u32(nack + 4, rx->session);
+    put_u32(nack + 8, first);
+    put_u32(nack + 12, count);
+    if (sendto(rx->nack_fd, nack, sizeof(nack), MSG_DONTWAIT, (struct sockaddr*)&rx->source,
+               sizeof(rx->source)) == (ssize_t)sizeof(nack)) {
+        rx->stats.nacks_sent++;
+    }
+}
+
+// NACKs the missing run at the head of the window, and gives up on it
+// after the configured number of attempts
+static int check_gap(gw_mcast_receiver_t* rx, uint64_t now, gw_sink_fn_t fn, void* user_data) {
+    if (!rx->synced || rx->next == rx->end) {
+        rx->in_gap = false;
+        return 0;
+    }
+    if (!rx->in_gap || rx->gap_start != rx->next) {
+        rx->in_gap = true;
+        rx->gap_start = rx->next;
+        rx->nack_attempts = 0;
+        rx->last_nack_ms = 0;
+        rx->stats.gaps++;
+    }
+    if (now < rx->last_nack_ms + rx->config.nack_interval_ms) return 0;
+
+    uint32_t missing = 0;
+    while (missing < MCAST_NACK_MAX && seq_diff(rx->end, rx->next + missing) > 0) {
+        const rx_slot_t* slot = &rx->window[(rx->next + missing) % GW_MCAST_REORDER_WINDOW];
+        if (slot->present && get_u32(slot->data + 8) == rx->next + missing) break;
+        missing++;
+    }
+
+    if (rx->nack_attempts >= rx->config.nack_attempts || !rx->have_source) {
+        skip_to(rx, rx->next + missing);
+        rx->in_gap = false;
+        return drain_window(rx, fn, user_data);
+    }
+    send_nack(rx, rx->next, missing);
+    rx->nack_attempts++;
+    rx->last_nack_ms = now;
+    return 0;
+}
+
+static int read_socket(gw_mcast_receiver_t* rx, int fd, bool multicast, gw_sink_fn_t fn, void* user_data) {
+    uint8_t buffer[GW_MCAST_MAX_DATAGRAM];
+    int delivered = 0;
+    for (;;) {
+        struct sockaddr_in from;
+        socklen_t from_len = sizeof(from);
+        ssize_t n = recvfrom(fd, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr*)&from, &from_len);
+        if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? delivered : -1;
+
+        if (multicast) {
+            rx->source = from;
+            rx->have_source = true;
+            rx->multicast_received++;
+            if (rx->config.loss_every && rx->multicast_received % rx->config.loss_every == 0) continue;
+        }
+        delivered += receive_datagram(rx, buffer, (size_t)n, fn, user_data);
+    }
+}
+
+int gw_mcast_receiver_poll(gw_mcast_receiver_t* rx, int timeout_ms, gw_sink_fn_t fn, void* user_data) {
+    if (!rx) return -1;
+
+    // Wake in time for the next NACK while a gap is open
+    uint64_t now = mcast_now_ms();
+    if (rx->in_gap) {
+        uint64_t due = rx->last_nack_ms + rx->config.nack_interval_ms;
+        int until = due > now ? (int)(due - now) : 0;
+        if (timeout_ms < 0 || until < timeout_ms) timeout_ms = until;
+    }
+
+    struct pollfd fds[2] = {{rx->group_fd, POLLIN, 0}, {rx->nack_fd, POLLIN, 0}};
+    if (poll(fds, 2, timeout_ms) < 0 && errno != EINTR) return -1;
+
+    int delivered = 0;
+    int n = read_socket(rx, rx->nack_fd, false, fn, user_data);
+    if (n < 0) return -1;
+    delivered += n;
+    n = read_socket(rx, rx->group_fd, true, fn, user_data);
+    if (n < 0) return -1;
+    delivered += n;
+
+    delivered += check_gap(rx, mcast_now_ms(), fn, user_data);
+    return delivered;
+}
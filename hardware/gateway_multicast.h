@@ -0,0 +1,97 @@
+#ifndef GATEWAY_MULTICAST_H
+#define GATEWAY_MULTICAST_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "gateway.h"
+
+// UDP multicast distribution of device-tagged frames. Frames are packed into
+// datagrams once and sent once to the group, however many listeners joined.
+//
+// Datagram: ['N']['C'][flags u8][frame count u8][session u32][sequence u32][tagged frames]
+// NACK:     ['N']['K'][reserved u16][session u32][first u32][count u32]
+//
+// Datagram sequences are gapless per session. A receiver that sees a gap
+// (or a heartbeat ahead of it) sends a NACK to the datagram's source
+// address; the publisher resends the datagrams it still holds by unicast,
+// and answers GONE for the rest so the receiver can skip them.
+#define GW_MCAST_HEADER_SIZE        12
+#define GW_MCAST_NACK_SIZE          16
+#define GW_MCAST_MAX_DATAGRAM       1472    // Fits a 1500-byte Ethernet MTU
+#define GW_MCAST_REORDER_WINDOW     1024    // Datagrams a receiver buffers past a gap
+
+#define GW_MCAST_FLAG_RETRANSMIT    0x01
+#define GW_MCAST_FLAG_HEARTBEAT     0x02    // No frames; sequence is the next to be sent
+#define GW_MCAST_FLAG_GONE          0x04    // No frames; sequences no longer held, u32 count follows
+
+typedef struct {
+    char group[64];                 // IPv4 multicast group, e.g. "239.255.0.1"
+    uint16_t port;
+    char interface_addr[64];        // Local interface address; empty for the default route
+    uint8_t ttl;
+    uint32_t history;               // Datagrams kept for retransmission
+    uint32_t heartbeat_ms;          // Idle heartbeat so receivers notice a lost tail
+} gw_mcast_config_t;
+
+typedef struct {
+    uint64_t frames_published;
+    uint64_t datagrams_sent;
+    uint64_t bytes_sent;
+    uint64_t heartbeats;
+    uint64_t nacks_received;
+    uint64_t retransmits;
+    uint64_t gone;                  // Requested datagrams already out of history
+} gw_mcast_publisher_stats_t;
+
+typedef struct gw_mcast_publisher gw_mcast_publisher_t;
+
+void gw_mcast_default_config(gw_mcast_config_t* config);
+gw_mcast_publisher_t* gw_mcast_publisher_create(const gw_mcast_config_t* config);
+hw_status_t gw_mcast_publisher_start(gw_mcast_publisher_t* publisher);
+void gw_mcast_publisher_destroy(gw_mcast_publisher_t* publisher);
+void gw_mcast_publisher_get_stats(gw_mcast_publisher_t* publisher, gw_mcast_publisher_stats_t* stats);
+
+// Gateway sink; pass the publisher as user_data to gateway_add_sink()
+void gw_mcast_sink(const gw_tagged_frame_t* frame, void* user_data);
+
+// Receiver: joins the group and delivers frames in publisher order,
+// recovering gaps through NACKs. Single-threaded; the caller drives it.
+typedef struct {
+    char group[64];
+    uint16_t port;
+    char interface_addr[64];
+    uint32_t nack_interval_ms;      // Wait before (re)requesting a gap
+    uint32_t nack_attempts;         // Requests before the gap is declared lost
+    uint32_t loss_every;            // Drop every Nth datagram on receipt (0 = off), for tests
+} gw_mcast_receiver_config_t;
+
+typedef struct {
+    uint64_t datagrams;
+    uint64_t frames_delivered;
+    uint64_t duplicates;
+    uint64_t gaps;
+    uint64_t nacks_sent;
+    uint64_t recovered;             // Datagrams filled in by retransmission
+    uint64_t lost;                  // Datagrams given up on
+    uint64_t session_changes;
+} gw_mcast_receiver_stats_t;
+
+typedef struct gw_mcast_receiver gw_mcast_receiver_t;
+
+void gw_mcast_receiver_default_config(gw_mcast_receiver_config_t* config);
+gw_mcast_receiver_t* gw_mcast_receiver_open(const gw_mcast_receiver_config_t* config);
+void gw_mcast_receiver_close(gw_mcast_receiver_t* receiver);
+
+// Waits up to timeout_ms for traffic, then delivers every frame that is in
+// order. Returns the number of frames delivered, or -1 on socket error.
+int gw_mcast_receiver_poll(gw_mcast_receiver_t* receiver, int timeout_ms, gw_sink_fn_t fn, void* user_data);
+void gw_mcast_receiver_get_stats(gw_mcast_receiver_t* receiver, gw_mcast_receiver_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GATEWAY_MULTICAST_H
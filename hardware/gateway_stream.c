@@ -0,0 +1,534 @@
+#define _GNU_SOURCE
+#include "gateway_stream.h"
+#include "conflate.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define STREAM_PENDING_MAX   (8 * 1024 * 1024)
+#define STREAM_EPOLL_BATCH   64
+#define STREAM_COMMIT_MS     200
+
+// A consumer whose buffer passes the high mark switches to a conflating
+// queue; the buffer is refilled from it below the low mark
+#define STREAM_CONFLATE_HIGH     (GW_STREAM_CLIENT_BUFFER / 4)
+#define STREAM_CONFLATE_LOW      (GW_STREAM_CLIENT_BUFFER / 8)
+
+typedef struct {
+    int fd;
+    uint8_t* buffer;
+    size_t head;
+    size_t length;
+    bool want_write;
+    bool conflating;            // New frames go to backlog until it drains
+    conflate_queue_t* backlog;  // Allocated the first time the consumer lags
+} stream_client_t;
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} byte_buffer_t;
+
+struct gw_stream_server {
+    uint16_t port;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    pthread_t thread;
+    atomic_bool running;
+
+    // Producers append here; the publisher thread swaps it out
+    pthread_mutex_t lock;
+    byte_buffer_t pending;
+    uint64_t pending_frames;
+    byte_buffer_t active;
+
+    spool_t* spool;
+    uint8_t* replay_buffer;
+    uint64_t last_commit_ms;
+    bool replay_dirty;
+
+    stream_client_t clients[GW_STREAM_MAX_CLIENTS];
+    atomic_uint client_count;
+    atomic_uint_fast64_t frames_published;
+    atomic_uint_fast64_t bytes_sent;
+    atomic_uint_fast64_t clients_dropped;
+    atomic_uint_fast64_t frames_spooled;
+    atomic_uint_fast64_t frames_replayed;
+    atomic_uint_fast64_t frames_conflated;
+};
+
+static bool buffer_append(byte_buffer_t* b, const uint8_t* data, size_t length, size_t limit) {
+    if (b->length + length > b->capacity) {
+        size_t capacity = b->capacity ? b->capacity : 65536;
+        while (capacity < b->length + length) capacity *= 2;
+        if (capacity > limit) return false;
+        uint8_t* grown = realloc(b->data, capacity);
+        if (!grown) return false;
+        b->data = grown;
+        b->capacity = capacity;
+    }
+    memcpy(b->data + b->length, data, length);
+    b->length += length;
+    return true;
+}
+
+gw_stream_server_t* gw_stream_create(uint16_t port) {
+    gw_stream_server_t* server = calloc(1, sizeof(gw_stream_server_t));
+    if (!server) return NULL;
+
+    // Both batch buffers at their cap up front, so the sink never reallocs
+    // under load; pages are only faulted in as far as a burst reaches
+    server->pending.data = malloc(STREAM_PENDING_MAX);
+    server->active.data = malloc(STREAM_PENDING_MAX);
+    if (!server->pending.data || !server->active.data) {
+        free(server->pending.data);
+        free(server->active.data);
+        free(server);
+        return NULL;
+    }
+    server->pending.capacity = server->active.capacity = STREAM_PENDING_MAX;
+    server->port = port;
+    server->listen_fd = -1;
+    server->epoll_fd = -1;
+    server->wake_fd = -1;
+    pthread_mutex_init(&server->lock, NULL);
+    for (int i = 0; i < GW_STREAM_MAX_CLIENTS; i++) {
+        server->clients[i].fd = -1;
+    }
+    return server;
+}
+
+static void client_drop(gw_stream_server_t* server, stream_client_t* c) {
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->buffer);
+    conflate_destroy(c->backlog);
+    memset(c, 0, sizeof(*c));
+    c->fd = -1;
+    atomic_fetch_sub_explicit(&server->client_count, 1, memory_order_relaxed);
+}
+
+// Size of the tagged frame at the front of the buffer, 0 if incomplete
+static size_t tagged_frame_size(const uint8_t* bytes, size_t length) {
+    if (length < GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD) return 0;
+    size_t size = GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD + bytes[GW_TAG_HEADER_SIZE + 3];
+    return size <= length ? size : 0;
+}
+
+static bool client_start_conflating(stream_client_t* c) {
+    if (!c->backlog) {
+        c->backlog = conflate_create(GW_STREAM_CONFLATE_KEYS, GW_STREAM_CONFLATE_LOSSLESS, GW_MAX_TAGGED_SIZE);
+        if (!c->backlog) return false;
+    }
+    c->conflating = true;
+    return true;
+}
+
+// Queues frames for a lagging consumer, keeping the latest value per record.
+// Returns false if the consumer had to be dropped.
+static bool client_conflate(gw_stream_server_t* server, stream_client_t* c, const uint8_t* data, size_t length) {
+    conflate_stats_t before, after;
+    conflate_get_stats(c->backlog, &before);
+
+    size_t offset = 0;
+    while (offset < length) {
+        size_t size = tagged_frame_size(data + offset, length - offset);
+        if (size == 0) break;
+        uint64_t key = 0;
+        bool keyed = gateway_conflation_key(data + offset, size, &key);
+        if (conflate_push(c->backlog, key, !keyed, data + offset, (uint32_t)size) != HW_STATUS_OK) {
+            fprintf(stderr, "Stream: consumer backlog full, disconnecting\n");
+            atomic_fetch_add_explicit(&server->clients_dropped, 1, memory_order_relaxed);
+            client_drop(server, c);
+            return false;
+        }
+        offset += size;
+    }
+
+    conflate_get_stats(c->backlog, &after);
+    atomic_fetch_add_explicit(&server->frames_conflated, after.conflated - before.conflated, memory_order_relaxed);
+    return true;
+}
+
+// Moves backlog records into the send buffer up to the high mark
+static void client_refill(stream_client_t* c) {
+    if (c->head > 0) {
+        memmove(c->buffer, c->buffer + c->head, c->length);
+        c->head = 0;
+    }
+    uint32_t length;
+    while (c->length + GW_MAX_TAGGED_SIZE <= STREAM_CONFLATE_HIGH &&
+           conflate_pop(c->backlog, c->buffer + c->length, GW_MAX_TAGGED_SIZE, &length) == HW_STATUS_OK) {
+        c->length += length;
+    }
+    if (conflate_is_empty(c->backlog)) c->conflating = false;
+}
+
+static void client_flush(gw_stream_server_t* server, stream_client_t* c) {
+    for (;;) {
+        bool blocked = false;
+        while (c->length > 0) {
+            ssize_t n = send(c->fd, c->buffer + c->head, c->length, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (n > 0) {
+                c->head += (size_t)n;
+                c->length -= (size_t)n;
+                atomic_fetch_add_explicit(&server->bytes_sent, (uint64_t)n, memory_order_relaxed);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                blocked = true;
+                break;
+            } else {
+                client_drop(server, c);
+                return;
+            }
+        }
+        if (c->length == 0) c->head = 0;
+
+        // Catching up: top the buffer up from the conflated backlog
+        if (!c->conflating || c->length > STREAM_CONFLATE_LOW) break;
+        size_t before = c->length;
+        client_refill(c);
+        if (c->length == before || (blocked && c->length > STREAM_CONFLATE_LOW)) break;
+    }
+
+    bool want_write = c->length > 0;
+    if (want_write != c->want_write) {
+        struct epoll_event ev;
+        ev.events = EPOLLRDHUP | (want_write ? EPOLLOUT : 0);
+        ev.data.ptr = c;
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+        c->want_write = want_write;
+    }
+}
+
+static void client_enqueue(gw_stream_server_t* server, stream_client_t* c, const uint8_t* data, size_t length) {
+    if (c->conflating) {
+        client_conflate(server, c, data, length);
+        return;
+    }
+
+    size_t sent = 0;
+    if (c->length == 0) {
+        // Fast path: write straight from the shared buffer
+        ssize_t n = send(c->fd, data, length, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            client_drop(server, c);
+            return;
+        }
+        if (n > 0) {
+            atomic_fetch_add_explicit(&server->bytes_sent, (uint64_t)n, memory_order_relaxed);
+            sent = (size_t)n;
+        }
+        if (sent == length) return;
+    }
+
+    if (c->head + c->length + length - sent > GW_STREAM_CLIENT_BUFFER) {
+        memmove(c->buffer, c->buffer + c->head, c->length);
+        c->head = 0;
+    }
+    if (c->length + length - sent > GW_STREAM_CLIENT_BUFFER) {
+        // Finish the frame the fast path started, conflate the rest
+        size_t boundary = 0;
+        while (boundary < sent) {
+            size_t size = tagged_frame_size(data + boundary, length - boundary);
+            if (size == 0) break;
+            boundary += size;
+        }
+        if (boundary < sent || !client_start_conflating(c)) {
+            fprintf(stderr, "Stream: consumer too slow, disconnecting\n");
+            atomic_fetch_add_explicit(&server->clients_dropped, 1, memory_order_relaxed);
+            client_drop(server, c);
+            return;
+        }
+        memcpy(c->buffer + c->head + c->length, data + sent, boundary - sent);
+        c->length += boundary - sent;
+        if (!client_conflate(server, c, data + boundary, length - boundary)) return;
+        client_flush(server, c);
+        return;
+    }
+    memcpy(c->buffer + c->head + c->length, data + sent, length - sent);
+    c->length += length - sent;
+    if (c->length > STREAM_CONFLATE_HIGH) client_start_conflating(c);
+    client_flush(server, c);
+}
+
+static void accept_clients(gw_stream_server_t* server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        stream_client_t* slot = NULL;
+        for (int i = 0; i < GW_STREAM_MAX_CLIENTS; i++) {
+            if (server->clients[i].fd < 0) {
+                slot = &server->clients[i];
+                break;
+            }
+        }
+        uint8_t* buffer = slot ? malloc(GW_STREAM_CLIENT_BUFFER) : NULL;
+        if (!buffer) {
+            close(fd);
+            continue;
+        }
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        slot->fd = fd;
+        slot->buffer = buffer;
+        slot->head = 0;
+        slot->length = 0;
+        slot->want_write = false;
+
+        struct epoll_event ev;
+        ev.events = EPOLLRDHUP;
+        ev.data.ptr = slot;
+        epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+        atomic_fetch_add_explicit(&server->client_count, 1, memory_order_relaxed);
+    }
+}
+
+static void fan_out(gw_stream_server_t* server, const uint8_t* data, size_t length) {
+    for (int i = 0; i < GW_STREAM_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0) {
+            client_enqueue(server, &server->clients[i], data, length);
+        }
+    }
+}
+
+static void spool_frames(gw_stream_server_t* server, const uint8_t* data, size_t length) {
+    size_t offset = 0;
+    while (offset < length) {
+        size_t size = tagged_frame_size(data + offset, length - offset);
+        if (size == 0) break;
+        if (spool_append(server->spool, data + offset, (uint32_t)size) == HW_STATUS_OK) {
+            atomic_fetch_add_explicit(&server->frames_spooled, 1, memory_order_relaxed);
+        }
+        offset += size;
+    }
+}
+
+static uint64_t stream_now_ms(void) {
+    return gw_monotonic_ns() / 1000000ull;
+}
+
+// Replays spooled frames to connected consumers. Stops when the rate budget
+// is spent or any consumer's buffer is half full, so catch-up never gets a
+// slow consumer disconnected.
+static void replay_spool(gw_stream_server_t* server) {
+    uint64_t now = stream_now_ms();
+    uint32_t budget = spool_replay_budget(server->spool, now);
+    uint32_t sent = 0;
+
+    while (sent < budget && atomic_load_explicit(&server->client_count, memory_order_relaxed) > 0) {
+        bool room = true;
+        for (int i = 0; i < GW_STREAM_MAX_CLIENTS && room; i++) {
+            const stream_client_t* c = &server->clients[i];
+            if (c->fd >= 0 && (c->conflating || c->length > GW_STREAM_CLIENT_BUFFER / 2)) {
+                room = false;
+            }
+        }
+        if (!room) break;
+
+        uint32_t length;
+        hw_status_t status = spool_peek(server->spool, server->replay_buffer, GW_MAX_TAGGED_SIZE, &length);
+        if (status == HW_STATUS_INVALID_PARAM) {
+            // Not a tagged frame; skip it
+            spool_skip(server->spool);
+            continue;
+        }
+        if (status != HW_STATUS_OK) break;
+
+        fan_out(server, server->replay_buffer, length);
+        spool_advance(server->spool);
+        server->replay_dirty = true;
+        sent++;
+    }
+    spool_consume_budget(server->spool, sent);
+    atomic_fetch_add_explicit(&server->frames_replayed, sent, memory_order_relaxed);
+
+    if (server->replay_dirty && (spool_is_empty(server->spool) || now - server->last_commit_ms >= STREAM_COMMIT_MS)) {
+        spool_commit(server->spool);
+        server->last_commit_ms = now;
+        server->replay_dirty = false;
+    }
+}
+
+static void publish_pending(gw_stream_server_t* server) {
+    pthread_mutex_lock(&server->lock);
+    byte_buffer_t swap = server->active;
+    server->active = server->pending;
+    server->pending = swap;
+    server->pending.length = 0;
+    uint64_t frames = server->pending_frames;
+    server->pending_frames = 0;
+    pthread_mutex_unlock(&server->lock);
+
+    if (server->active.length == 0) return;
+    if (server->spool && (atomic_load_explicit(&server->client_count, memory_order_relaxed) == 0 ||
+                          !spool_is_empty(server->spool))) {
+        // Keep ordering: live frames queue behind anything still spooled
+        spool_frames(server, server->active.data, server->active.length);
+        spool_flush(server->spool);
+    } else {
+        fan_out(server, server->active.data, server->active.length);
+        atomic_fetch_add_explicit(&server->frames_published, frames, memory_order_relaxed);
+    }
+    server->active.length = 0;
+}
+
+static void* stream_main(void* arg) {
+    gw_stream_server_t* server = arg;
+    struct epoll_event events[STREAM_EPOLL_BATCH];
+
+    while (atomic_load_explicit(&server->running, memory_order_acquire)) {
+        bool replaying = server->spool && !spool_is_empty(server->spool) &&
+                         atomic_load_explicit(&server->client_count, memory_order_relaxed) > 0;
+        int n = epoll_wait(server->epoll_fd, events, STREAM_EPOLL_BATCH, replaying ? 10 : 500);
+        for (int i = 0; i < n; i++) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &server->listen_fd) {
+                accept_clients(server);
+            } else if (ptr == &server->wake_fd) {
+                uint64_t value;
+                if (read(server->wake_fd, &value, sizeof(value)) < 0) {
+                    // Nothing to drain
+                }
+                publish_pending(server);
+            } else {
+                stream_client_t* c = ptr;
+                if (c->fd < 0) continue;
+                if (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                    client_drop(server, c);
+                } else if (events[i].events & EPOLLOUT) {
+                    client_flush(server, c);
+                }
+            }
+        }
+        if (replaying) replay_spool(server);
+    }
+    if (server->spool && server->replay_dirty) spool_commit(server->spool);
+    return NULL;
+}
+
+hw_status_t gw_stream_start(gw_stream_server_t* server) {
+    if (!server) return HW_STATUS_INVALID_PARAM;
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0) return HW_STATUS_ERROR;
+
+    int opt = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(server->port);
+    if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(server->listen_fd, 16) < 0) {
+        perror("Stream: bind/listen failed");
+        return HW_STATUS_ERROR;
+    }
+
+    socklen_t len = sizeof(addr);
+    if (getsockname(server->listen_fd, (struct sockaddr*)&addr, &len) == 0) {
+        server->port = ntohs(addr.sin_port);
+    }
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    server->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (server->epoll_fd < 0 || server->wake_fd < 0) return HW_STATUS_ERROR;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &server->listen_fd;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->listen_fd, &ev);
+    ev.data.ptr = &server->wake_fd;
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, server->wake_fd, &ev);
+
+    atomic_store_explicit(&server->running, true, memory_order_release);
+    if (pthread_create(&server->thread, NULL, stream_main, server) != 0) {
+        atomic_store_explicit(&server->running, false, memory_order_release);
+        return HW_STATUS_ERROR;
+    }
+    return HW_STATUS_OK;
+}
+
+void gw_stream_set_spool(gw_stream_server_t* server, spool_t* spool) {
+    if (!server || atomic_load_explicit(&server->running, memory_order_acquire)) return;
+
+    if (spool && !server->replay_buffer) {
+        server->replay_buffer = malloc(GW_MAX_TAGGED_SIZE);
+        if (!server->replay_buffer) return;
+    }
+    server->spool = spool;
+}
+
+uint16_t gw_stream_port(gw_stream_server_t* server) {
+    return server ? server->port : 0;
+}
+
+void gw_stream_destroy(gw_stream_server_t* server) {
+    if (!server) return;
+
+    if (atomic_exchange(&server->running, false)) {
+        uint64_t one = 1;
+        if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+            // Thread still exits on its next timeout
+        }
+        pthread_join(server->thread, NULL);
+    }
+    for (int i = 0; i < GW_STREAM_MAX_CLIENTS; i++) {
+        if (server->clients[i].fd >= 0) client_drop(server, &server->clients[i]);
+    }
+    if (server->listen_fd >= 0) close(server->listen_fd);
+    if (server->epoll_fd >= 0) close(server->epoll_fd);
+    if (server->wake_fd >= 0) close(server->wake_fd);
+    pthread_mutex_destroy(&server->lock);
+    free(server->pending.data);
+    free(server->active.data);
+    free(server->replay_buffer);
+    free(server);
+}
+
+void gw_stream_get_stats(gw_stream_server_t* server, gw_stream_stats_t* stats) {
+    if (!server || !stats) return;
+
+    stats->clients = atomic_load_explicit(&server->client_count, memory_order_relaxed);
+    stats->frames_published = atomic_load_explicit(&server->frames_published, memory_order_relaxed);
+    stats->bytes_sent = atomic_load_explicit(&server->bytes_sent, memory_order_relaxed);
+    stats->clients_dropped = atomic_load_explicit(&server->clients_dropped, memory_order_relaxed);
+    stats->frames_spooled = atomic_load_explicit(&server->frames_spooled, memory_order_relaxed);
+    stats->frames_replayed = atomic_load_explicit(&server->frames_replayed, memory_order_relaxed);
+    stats->frames_conflated = atomic_load_explicit(&server->frames_conflated, memory_order_relaxed);
+}
+
+void gw_stream_sink(const gw_tagged_frame_t* frame, void* user_data) {
+    gw_stream_server_t* server = user_data;
+    if (!server || !frame || !frame->wire_length) return;
+
+    pthread_mutex_lock(&server->lock);
+    bool was_empty = server->pending.length == 0;
+    bool queued = buffer_append(&server->pending, frame->wire, frame->wire_length, STREAM_PENDING_MAX);
+    if (queued) server->pending_frames++;
+    pthread_mutex_unlock(&server->lock);
+
+    // One wakeup per batch; the publisher drains everything queued since
+    if (queued && was_empty) {
+        uint64_t one = 1;
+        if (write(server->wake_fd, &one, sizeof(one)) < 0) {
+            // eventfd counter saturated; publisher is already awake
+        }
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef GATEWAY_STREAM_H
+#define GATEWAY_STREAM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "gateway.h"
+#include "spool.h"
+
+// Merged output stream server: accepts TCP consumers and writes every
+// device-tagged frame to each of them, in ingest order.
+#define GW_STREAM_MAX_CLIENTS        64
+#define GW_STREAM_CLIENT_BUFFER      (1024 * 1024)
+
+// A consumer that falls behind gets a conflating backlog: the latest value
+// per (device, type, record id), alarms kept in full. It is dropped only if
+// the backlog itself overflows.
+#define GW_STREAM_CONFLATE_KEYS      8192
+#define GW_STREAM_CONFLATE_LOSSLESS  4096
+
+typedef struct {
+    uint32_t clients;
+    uint64_t frames_published;
+    uint64_t bytes_sent;
+    uint64_t clients_dropped;
+    uint64_t frames_spooled;
+    uint64_t frames_replayed;
+    uint64_t frames_conflated;       // Superseded before a lagging consumer read them
+} gw_stream_stats_t;
+
+typedef struct gw_stream_server gw_stream_server_t;
+
+gw_stream_server_t* gw_stream_create(uint16_t port);
+hw_status_t gw_stream_start(gw_stream_server_t* server);
+void gw_stream_destroy(gw_stream_server_t* server);
+uint16_t gw_stream_port(gw_stream_server_t* server);
+void gw_stream_get_stats(gw_stream_server_t* server, gw_stream_stats_t* stats);
+
+// Store-and-forward: while no consumer is connected, frames go to the spool
+// and are replayed (paced by the spool's replay rate) once one reconnects.
+// Call before gw_stream_start(); the publisher thread owns the spool after.
+void gw_stream_set_spool(gw_stream_server_t* server, spool_t* spool);
+
+// Gateway sink; pass the server as user_data to gateway_add_sink()
+void gw_stream_sink(const gw_tagged_frame_t* frame, void* user_data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GATEWAY_STREAM_H
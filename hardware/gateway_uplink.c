@@ -0,0 +1,867 @@
+#define _GNU_SOURCE
+#include "gateway_uplink.h"
+#include "backoff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#define UPLINK_MAGIC_HIGH     0x4E    // 'N'
+#define UPLINK_MAGIC_LOW      0x58    // 'X'
+#define UPLINK_CHANNELS       65536   // Channel ids are u16
+#define UPLINK_PENDING_MAX    (8 * 1024 * 1024)
+#define UPLINK_EPOLL_BATCH    16
+#define UPLINK_READ_SIZE      4096
+#define UPLINK_MIN_QUEUE      4096    // First allocation of a channel queue
+
+#define UPLINK_MAX_PEERS      64
+#define UPLINK_PEER_IN        (2 * (GW_UPLINK_HEADER_SIZE + GW_UPLINK_MAX_PAYLOAD))
+#define UPLINK_PEER_OUT_MAX   (1024 * 1024)
+#define UPLINK_READ_BUDGET    (1024 * 1024)   // Bytes read from one peer per poll
+
+static void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_header(uint8_t* p, uint8_t type, uint16_t channel, uint16_t length) {
+    p[0] = UPLINK_MAGIC_HIGH;
+    p[1] = UPLINK_MAGIC_LOW;
+    p[2] = type;
+    p[3] = 0;
+    put_u16(p + 4, channel);
+    put_u16(p + 6, length);
+}
+
+static size_t tagged_frame_size(const uint8_t* frame) {
+    return GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD + frame[GW_TAG_HEADER_SIZE + 3];
+}
+
+static uint64_t uplink_now_ms(void) {
+    return gw_monotonic_ns() / 1000000ull;
+}
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+} byte_buffer_t;
+
+static bool buffer_reserve(byte_buffer_t* b, size_t extra) {
+    if (b->length + extra <= b->capacity) return true;
+    size_t capacity = b->capacity ? b->capacity : 4096;
+    while (capacity < b->length + extra) capacity *= 2;
+    uint8_t* grown = realloc(b->data, capacity);
+    if (!grown) return false;
+    b->data = grown;
+    b->capacity = capacity;
+    return true;
+}
+
+void gw_uplink_default_config(gw_uplink_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    snprintf(config->host, sizeof(config->host), "127.0.0.1");
+    config->port = 9300;
+    config->window = 64 * 1024;
+    config->channel_queue = 256 * 1024;
+    config->quantum = 4096;
+    config->max_write = 64 * 1024;
+    config->reconnect_initial_ms = 50;
+    config->reconnect_max_ms = 2000;
+}
+
+// Gateway side
+
+typedef struct {
+    uint16_t id;
+    bool ready;                     // In the round-robin queue
+    uint32_t credit;
+    uint8_t* data;                  // Queued tagged frames in [head, tail)
+    size_t head;
+    size_t tail;
+    size_t capacity;
+} uplink_channel_t;
+
+struct gw_uplink {
+    gw_uplink_config_t config;
+    int fd;
+    int epoll_fd;
+    int wake_fd;
+    pthread_t thread;
+    atomic_bool running;
+
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    bool resolved;
+    bool connecting;
+    bool connected;
+    bool want_write;
+    backoff_t backoff;
+    uint64_t next_attempt_ms;
+
+    // Uplink thread only
+    uplink_channel_t** channels;    // Indexed by channel id
+    uint16_t* channel_ids;          // Created channels, in creation order
+    uint32_t channel_count;
+    uint16_t* ready;                // Round-robin ring of channel ids
+    uint32_t ready_head;
+    uint32_t ready_count;
+    byte_buffer_t out;
+    size_t out_sent;
+    uint8_t in[UPLINK_READ_SIZE];
+    size_t in_length;
+
+    // Producers append tagged frames here; the uplink thread swaps it out
+    pthread_mutex_t lock;
+    byte_buffer_t pending;
+    byte_buffer_t active;
+
+    atomic_bool stat_connected;
+    atomic_uint_fast32_t channels_open;
+    atomic_uint_fast32_t channels_blocked;
+    atomic_uint_fast64_t frames_queued;
+    atomic_uint_fast64_t frames_sent;
+    atomic_uint_fast64_t frames_dropped;
+    atomic_uint_fast64_t bytes_sent;
+    atomic_uint_fast64_t writes;
+    atomic_uint_fast64_t credits_received;
+    atomic_uint_fast64_t connects;
+};
+
+gw_uplink_t* gw_uplink_create(const gw_uplink_config_t* config) {
+    if (!config || config->window == 0 || config->max_write == 0) return NULL;
+
+    gw_uplink_t* up = calloc(1, sizeof(gw_uplink_t));
+    if (!up) return NULL;
+    up->config = *config;
+    // Half a window must hold a frame, or a channel could wait forever on
+    // credit the central side only grants in half-window steps
+    if (up->config.window < 2 * GW_MAX_TAGGED_SIZE) up->config.window = 2 * GW_MAX_TAGGED_SIZE;
+    if (up->config.quantum == 0) up->config.quantum = 1;
+    if (up->config.quantum > GW_UPLINK_MAX_PAYLOAD - GW_MAX_TAGGED_SIZE) {
+        up->config.quantum = GW_UPLINK_MAX_PAYLOAD - GW_MAX_TAGGED_SIZE;
+    }
+    up->fd = -1;
+    up->epoll_fd = -1;
+    up->wake_fd = -1;
+
+    // A record never exceeds quantum plus one frame, so a pass that starts
+    // below max_write always fits
+    up->out.capacity = up->config.max_write + GW_UPLINK_HEADER_SIZE + up->config.quantum + GW_MAX_TAGGED_SIZE;
+    up->out.data = malloc(up->out.capacity);
+    up->channels = calloc(UPLINK_CHANNELS, sizeof(uplink_channel_t*));
+    up->channel_ids = malloc(UPLINK_CHANNELS * sizeof(uint16_t));
+    up->ready = malloc(UPLINK_CHANNELS * sizeof(uint16_t));
+    if (!up->out.data || !up->channels || !up->channel_ids || !up->ready) {
+        free(up->out.data);
+        free(up->channels);
+        free(up->channel_ids);
+        free(up->ready);
+        free(up);
+        return NULL;
+    }
+    backoff_init(&up->backoff, config->reconnect_initial_ms, config->reconnect_max_ms,
+                 (uint32_t)gw_monotonic_ns() ^ (uint32_t)getpid());
+    pthread_mutex_init(&up->lock, NULL);
+    return up;
+}
+
+static bool channel_eligible(const uplink_channel_t* ch) {
+    return ch->tail > ch->head && ch->credit >= tagged_frame_size(ch->data + ch->head);
+}
+
+static void channel_mark_ready(gw_uplink_t* up, uplink_channel_t* ch) {
+    if (ch->ready || !channel_eligible(ch)) return;
+    up->ready[(up->ready_head + up->ready_count) % UPLINK_CHANNELS] = ch->id;
+    up->ready_count++;
+    ch->ready = true;
+}
+
+static uplink_channel_t* channel_get(gw_uplink_t* up, uint16_t id) {
+    uplink_channel_t* ch = up->channels[id];
+    if (ch) return ch;
+    ch = calloc(1, sizeof(uplink_channel_t));
+    if (!ch) return NULL;
+    ch->id = id;
+    ch->credit = up->config.window;
+    up->channels[id] = ch;
+    up->channel_ids[up->channel_count++] = id;
+    atomic_store_explicit(&up->channels_open, up->channel_count, memory_order_relaxed);
+    return ch;
+}
+
+// Appends a frame, dropping the oldest ones while the queue is over budget
+static void channel_push(gw_uplink_t* up, uplink_channel_t* ch, const uint8_t* frame, size_t size) {
+    while (ch->tail > ch->head && ch->tail - ch->head + size > up->config.channel_queue) {
+        ch->head += tagged_frame_size(ch->data + ch->head);
+        atomic_fetch_add_explicit(&up->frames_dropped, 1, memory_order_relaxed);
+    }
+    if (ch->head == ch->tail) ch->head = ch->tail = 0;
+
+    if (ch->tail + size > ch->capacity) {
+        if (ch->head > 0) {
+            memmove(ch->data, ch->data + ch->head, ch->tail - ch->head);
+            ch->tail -= ch->head;
+            ch->head = 0;
+        }
+        if (ch->tail + size > ch->capacity) {
+            size_t capacity = ch->capacity ? ch->capacity : UPLINK_MIN_QUEUE;
+            while (capacity < ch->tail + size) capacity *= 2;
+            uint8_t* grown = realloc(ch->data, capacity);
+            if (!grown) {
+                atomic_fetch_add_explicit(&up->frames_dropped, 1, memory_order_relaxed);
+                return;
+            }
+            ch->data = grown;
+            ch->capacity = capacity;
+        }
+    }
+    memcpy(ch->data + ch->tail, frame, size);
+    ch->tail += size;
+    channel_mark_ready(up, ch);
+}
+
+// Routes the swapped-out batch into per-channel queues
+static void take_pending(gw_uplink_t* up) {
+    pthread_mutex_lock(&up->lock);
+    byte_buffer_t swap = up->active;
+    up->active = up->pending;
+    up->pending = swap;
+    up->pending.length = 0;
+    pthread_mutex_unlock(&up->lock);
+
+    const uint8_t* data = up->active.data;
+    size_t length = up->active.length;
+    size_t offset = 0;
+    while (offset + GW_TAG_HEADER_SIZE + STM32_FRAME_OVERHEAD <= length) {
+        size_t size = tagged_frame_size(data + offset);
+        if (offset + size > length) break;
+        uplink_channel_t* ch = channel_get(up, get_u16(data + offset + 2));
+        if (ch) {
+            channel_push(up, ch, data + offset, size);
+        } else {
+            atomic_fetch_add_explicit(&up->frames_dropped, 1, memory_order_relaxed);
+        }
+        offset += size;
+    }
+    up->active.length = 0;
+}
+
+// Fills the write buffer up to max_write, one DATA record per turn: each
+// ready channel adds up to a quantum within its credit, then goes to the
+// back of the line
+static void schedule(gw_uplink_t* up) {
+    uint64_t frames = 0;
+    while (up->out.length < up->config.max_write && up->ready_count > 0) {
+        uplink_channel_t* ch = up->channels[up->ready[up->ready_head]];
+        up->ready_head = (up->ready_head + 1) % UPLINK_CHANNELS;
+        up->ready_count--;
+        ch->ready = false;
+
+        uint8_t* record = up->out.data + up->out.length;
+        size_t payload = 0;
+        while (ch->tail > ch->head) {
+            size_t size = tagged_frame_size(ch->data + ch->head);
+            if (size > ch->credit || (payload > 0 && payload + size > up->config.quantum)) break;
+            memcpy(record + GW_UPLINK_HEADER_SIZE + payload, ch->data + ch->head, size);
+            ch->head += size;
+            ch->credit -= (uint32_t)size;
+            payload += size;
+            frames++;
+        }
+        put_header(record, GW_UPLINK_DATA, ch->id, (uint16_t)payload);
+        up->out.length += GW_UPLINK_HEADER_SIZE + payload;
+        channel_mark_ready(up, ch);
+    }
+    atomic_fetch_add_explicit(&up->frames_sent, frames, memory_order_relaxed);
+}
+
+static void uplink_watch(gw_uplink_t* up, uint32_t events) {
+    struct epoll_event ev;
+    ev.events = events;
+    ev.data.ptr = &up->fd;
+    epoll_ctl(up->epoll_fd, EPOLL_CTL_MOD, up->fd, &ev);
+}
+
+static void uplink_disconnect(gw_uplink_t* up) {
+    if (up->fd >= 0) {
+        epoll_ctl(up->epoll_fd, EPOLL_CTL_DEL, up->fd, NULL);
+        close(up->fd);
+    }
+    up->fd = -1;
+    if (up->connected) fprintf(stderr, "Uplink: connection to %s:%u lost\n", up->config.host, up->config.port);
+    up->connecting = false;
+    up->connected = false;
+    up->want_write = false;
+    up->out.length = 0;
+    up->out_sent = 0;
+    up->in_length = 0;
+    up->next_attempt_ms = uplink_now_ms() + backoff_next(&up->backoff);
+    atomic_store_explicit(&up->stat_connected, false, memory_order_relaxed);
+}
+
+// Writes what the buffer holds; false once the socket is full or gone
+static bool uplink_flush(gw_uplink_t* up) {
+    while (up->out_sent < up->out.length) {
+        ssize_t n = send(up->fd, up->out.data + up->out_sent, up->out.length - up->out_sent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            up->out_sent += (size_t)n;
+            atomic_fetch_add_explicit(&up->bytes_sent, (uint64_t)n, memory_order_relaxed);
+            atomic_fetch_add_explicit(&up->writes, 1, memory_order_relaxed);
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!up->want_write) uplink_watch(up, EPOLLIN | EPOLLRDHUP | EPOLLOUT);
+            up->want_write = true;
+            return false;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            uplink_disconnect(up);
+            return false;
+        }
+    }
+    up->out.length = 0;
+    up->out_sent = 0;
+    if (up->want_write) uplink_watch(up, EPOLLIN | EPOLLRDHUP);
+    up->want_write = false;
+    return true;
+}
+
+static void uplink_pump(gw_uplink_t* up) {
+    while (up->connected) {
+        if (up->out.length == 0) schedule(up);
+        if (up->out.length == 0 || !uplink_flush(up)) return;
+    }
+}
+
+static void uplink_on_connected(gw_uplink_t* up) {
+    up->connecting = false;
+    up->connected = true;
+    backoff_reset(&up->backoff);
+    uplink_watch(up, EPOLLIN | EPOLLRDHUP);
+    atomic_store_explicit(&up->stat_connected, true, memory_order_relaxed);
+    atomic_fetch_add_explicit(&up->connects, 1, memory_order_relaxed);
+
+    // Every channel starts the connection with a full window
+    up->ready_head = 0;
+    up->ready_count = 0;
+    for (uint32_t i = 0; i < up->channel_count; i++) {
+        uplink_channel_t* ch = up->channels[up->channel_ids[i]];
+        ch->credit = up->config.window;
+        ch->ready = false;
+        channel_mark_ready(up, ch);
+    }
+
+    put_header(up->out.data, GW_UPLINK_HELLO, 0, 4);
+    put_u32(up->out.data + GW_UPLINK_HEADER_SIZE, up->config.window);
+    up->out.length = GW_UPLINK_HEADER_SIZE + 4;
+    up->out_sent = 0;
+}
+
+static bool uplink_resolve(gw_uplink_t* up) {
+    char port[8];
+    snprintf(port, sizeof(port), "%u", up->config.port);
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(up->config.host, port, &hints, &res) != 0 || !res) {
+        fprintf(stderr, "Uplink: cannot resolve %s\n", up->config.host);
+        return false;
+    }
+    memcpy(&up->addr, res->ai_addr, res->ai_addrlen);
+    up->addr_len = res->ai_addrlen;
+    freeaddrinfo(res);
+    return true;
+}
+
+static void uplink_connect(gw_uplink_t* up) {
+    if (!up->resolved) up->resolved = uplink_resolve(up);
+    if (!up->resolved) {
+        up->next_attempt_ms = uplink_now_ms() + backoff_next(&up->backoff);
+        return;
+    }
+
+    up->fd = socket(up->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (up->fd < 0) {
+        uplink_disconnect(up);
+        return;
+    }
+    // Writes are already coalesced; do not let Nagle hold back the tail
+    int one = 1;
+    setsockopt(up->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    struct epoll_event ev;
+    ev.data.ptr = &up->fd;
+    if (connect(up->fd, (struct sockaddr*)&up->addr, up->addr_len) == 0) {
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        epoll_ctl(up->epoll_fd, EPOLL_CTL_ADD, up->fd, &ev);
+        uplink_on_connected(up);
+    } else if (errno == EINPROGRESS) {
+        ev.events = EPOLLOUT;
+        epoll_ctl(up->epoll_fd, EPOLL_CTL_ADD, up->fd, &ev);
+        up->connecting = true;
+    } else {
+        uplink_disconnect(up);
+    }
+}
+
+static void uplink_on_writable(gw_uplink_t* up) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(up->fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+        uplink_disconnect(up);
+        return;
+    }
+    uplink_on_connected(up);
+}
+
+static void uplink_handle_record(gw_uplink_t* up, const uint8_t* record) {
+    uint16_t length = get_u16(record + 6);
+    if (record[2] != GW_UPLINK_CREDIT || length != 4) return;
+
+    uplink_channel_t* ch = up->channels[get_u16(record + 4)];
+    if (!ch) return;
+    uint64_t credit = (uint64_t)ch->credit + get_u32(record + GW_UPLINK_HEADER_SIZE);
+    ch->credit = credit > UINT32_MAX ? UINT32_MAX : (uint32_t)credit;
+    atomic_fetch_add_explicit(&up->credits_received, 1, memory_order_relaxed);
+    channel_mark_ready(up, ch);
+}
+
+static void uplink_read(gw_uplink_t* up) {
+    for (;;) {
+        ssize_t n = recv(up->fd, up->in + up->in_length, sizeof(up->in) - up->in_length, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            uplink_disconnect(up);
+            return;
+        }
+        if (n < 0) return;
+        up->in_length += (size_t)n;
+
+        size_t offset = 0;
+        while (up->in_length - offset >= GW_UPLINK_HEADER_SIZE) {
+            const uint8_t* record = up->in + offset;
+            size_t size = GW_UPLINK_HEADER_SIZE + get_u16(record + 6);
+            if (record[0] != UPLINK_MAGIC_HIGH || record[1] != UPLINK_MAGIC_LOW || size > sizeof(up->in)) {
+                fprintf(stderr, "Uplink: protocol error from %s:%u\n", up->config.host, up->config.port);
+                uplink_disconnect(up);
+                return;
+            }
+            if (up->in_length - offset < size) break;
+            uplink_handle_record(up, record);
+            offset += size;
+        }
+        memmove(up->in, up->in + offset, up->in_length - offset);
+        up->in_length -= offset;
+    }
+}
+
+static void update_blocked(gw_uplink_t* up) {
+    uint32_t blocked = 0;
+    for (uint32_t i = 0; i < up->channel_count; i++) {
+        const uplink_channel_t* ch = up->channels[up->channel_ids[i]];
+        if (ch->tail > ch->head && !channel_eligible(ch)) blocked++;
+    }
+    atomic_store_explicit(&up->channels_blocked, blocked, memory_order_relaxed);
+}
+
+static void* uplink_main(void* arg) {
+    gw_uplink_t* up = arg;
+    struct epoll_event events[UPLINK_EPOLL_BATCH];
+
+    while (atomic_load_explicit(&up->running, memory_order_acquire)) {
+        int timeout = 500;
+        if (up->fd < 0 && uplink_now_ms() >= up->next_attempt_ms) uplink_connect(up);
+        if (up->fd < 0) {
+            uint64_t now = uplink_now_ms();
+            uint64_t wait = up->next_attempt_ms > now ? up->next_attempt_ms - now : 0;
+            if (wait < (uint64_t)timeout) timeout = (int)wait;
+        }
+
+        int n = epoll_wait(up->epoll_fd, events, UPLINK_EPOLL_BATCH, timeout);
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.ptr == &up->wake_fd) {
+                uint64_t value;
+                if (read(up->wake_fd, &value, sizeof(value)) < 0) {
+                    // Nothing to drain
+                }
+                take_pending(up);
+            } else if (up->fd >= 0 && up->connecting) {
+                uplink_on_writable(up);
+            } else if (up->fd >= 0 && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+                uplink_read(up);
+            }
+        }
+        uplink_pump(up);
+        update_blocked(up);
+    }
+    return NULL;
+}
+
+hw_status_t gw_uplink_start(gw_uplink_t* up) {
+    if (!up) return HW_STATUS_INVALID_PARAM;
+
+    up->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    up->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (up->epoll_fd < 0 || up->wake_fd < 0) return HW_STATUS_ERROR;
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &up->wake_fd;
+    epoll_ctl(up->epoll_fd, EPOLL_CTL_ADD, up->wake_fd, &ev);
+
+    atomic_store_explicit(&up->running, true, memory_order_release);
+    if (pthread_create(&up->thread, NULL, uplink_main, up) != 0) {
+        atomic_store_explicit(&up->running, false, memory_order_release);
+        return HW_STATUS_ERROR;
+    }
+    return HW_STATUS_OK;
+}
+
+void gw_uplink_destroy(gw_uplink_t* up) {
+    if (!up) return;
+
+    if (atomic_exchange(&up->running, false)) {
+        uint64_t one = 1;
+        if (write(up->wake_fd, &one, sizeof(one)) < 0) {
+            // Thread still exits on its next timeout
+        }
+        pthread_join(up->thread, NULL);
+    }
+    if (up->fd >= 0) close(up->fd);
+    if (up->epoll_fd >= 0) close(up->epoll_fd);
+    if (up->wake_fd >= 0) close(up->wake_fd);
+    for (uint32_t i = 0; i < up->channel_count; i++) {
+        uplink_channel_t* ch = up->channels[up->channel_ids[i]];
+        free(ch->data);
+        free(ch);
+    }
+    pthread_mutex_destroy(&up->lock);
+    free(up->pending.data);
+    free(up->active.data);
+    free(up->out.data);
+    free(up->channels);
+    free(up->channel_ids);
+    free(up->ready);
+    free(up);
+}
+
+void gw_uplink_get_stats(gw_uplink_t* up, gw_uplink_stats_t* stats) {
+    if (!up || !stats) return;
+
+    stats->connected = atomic_load_explicit(&up->stat_connected, memory_order_relaxed);
+    stats->channels_blocked = (uint32_t)atomic_load_explicit(&up->channels_blocked, memory_order_relaxed);
+    stats->frames_queued = atomic_load_explicit(&up->frames_queued, memory_order_relaxed);
+    stats->frames_sent = atomic_load_explicit(&up->frames_sent, memory_order_relaxed);
+    stats->frames_dropped = atomic_load_explicit(&up->frames_dropped, memory_order_relaxed);
+    stats->bytes_sent = atomic_load_explicit(&up->bytes_sent, memory_order_relaxed);
+    stats->writes = atomic_load_explicit(&up->writes, memory_order_relaxed);
+    stats->credits_received = atomic_load_explicit(&up->credits_received, memory_order_relaxed);
+    stats->connects = atomic_load_explicit(&up->connects, memory_order_relaxed);
+
+    stats->channels = (uint32_t)atomic_load_explicit(&up->channels_open, memory_order_relaxed);
+}
+
+void gw_uplink_sink(const gw_tagged_frame_t* frame, void* user_data) {
+    gw_uplink_t* up = user_data;
+    if (!up || !frame || !frame->wire_length) return;
+
+    pthread_mutex_lock(&up->lock);
+    bool was_empty = up->pending.length == 0;
+    bool queued = up->pending.length + frame->wire_length <= UPLINK_PENDING_MAX &&
+                  buffer_reserve(&up->pending, frame->wire_length);
+    if (queued) {
+        memcpy(up->pending.data + up->pending.length, frame->wire, frame->wire_length);
+        up->pending.length += frame->wire_length;
+    }
+    pthread_mutex_unlock(&up->lock);
+
+    if (!queued) {
+        atomic_fetch_add_explicit(&up->frames_dropped, 1, memory_order_relaxed);
+        return;
+    }
+    atomic_fetch_add_explicit(&up->frames_queued, 1, memory_order_relaxed);
+    if (was_empty) {
+        uint64_t one = 1;
+        if (write(up->wake_fd, &one, sizeof(one)) < 0) {
+            // eventfd counter saturated; the uplink thread is already awake
+        }
+    }
+}
+
+// Central side
+
+typedef struct {
+    int fd;
+    uint32_t window;                // From HELLO; 0 until then
+    uint8_t* in;
+    size_t in_length;
+    byte_buffer_t out;
+    size_t out_sent;
+    uint32_t* owed;                 // Consumed bytes not yet granted back, per channel
+} uplink_peer_t;
+
+struct gw_uplink_server {
+    int listen_fd;
+    uint16_t port;
+    uplink_peer_t peers[UPLINK_MAX_PEERS];
+    uint32_t peer_count;
+    uint8_t paused[UPLINK_CHANNELS / 8];
+    gw_uplink_server_stats_t stats;
+};
+
+static bool channel_paused(const gw_uplink_server_t* server, uint16_t channel) {
+    return server->paused[channel / 8] & (1u << (channel % 8));
+}
+
+static void peer_close(gw_uplink_server_t* server, uint32_t index) {
+    uplink_peer_t* peer = &server->peers[index];
+    close(peer->fd);
+    free(peer->in);
+    free(peer->out.data);
+    free(peer->owed);
+    server->peers[index] = server->peers[--server->peer_count];
+    server->stats.connections = server->peer_count;
+}
+
+static bool peer_flush(uplink_peer_t* peer) {
+    while (peer->out_sent < peer->out.length) {
+        ssize_t n = send(peer->fd, peer->out.data + peer->out_sent, peer->out.length - peer->out_sent,
+                         MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            peer->out_sent += (size_t)n;
+        } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else if (n < 0 && errno == EINTR) {
+            continue;
+        } else {
+            return false;
+        }
+    }
+    if (peer->out_sent == peer->out.length) {
+        peer->out.length = 0;
+        peer->out_sent = 0;
+    }
+    return peer->out.length - peer->out_sent <= UPLINK_PEER_OUT_MAX;
+}
+
+static void peer_grant(gw_uplink_server_t* server, uplink_peer_t* peer, uint16_t channel) {
+    if (!buffer_reserve(&peer->out, GW_UPLINK_HEADER_SIZE + 4)) return;
+    uint8_t* record = peer->out.data + peer->out.length;
+    put_header(record, GW_UPLINK_CREDIT, channel, 4);
+    put_u32(record + GW_UPLINK_HEADER_SIZE, peer->owed[channel]);
+    peer->out.length += GW_UPLINK_HEADER_SIZE + 4;
+    peer->owed[channel] = 0;
+    server->stats.credits_sent++;
+}
+
+// Delivers one record; false on a protocol error
+static bool peer_handle_record(gw_uplink_server_t* server, uplink_peer_t* peer, const uint8_t* record,
+                               gw_sink_fn_t fn, void* user_data, int* delivered) {
+    uint16_t channel = get_u16(record + 4);
+    uint16_t length = get_u16(record + 6);
+    const uint8_t* payload = record + GW_UPLINK_HEADER_SIZE;
+    server->stats.records++;
+
+    if (record[2] == GW_UPLINK_HELLO) {
+        if (length != 4 || get_u32(payload) == 0) return false;
+        peer->window = get_u32(payload);
+        return true;
+    }
+    if (record[2] != GW_UPLINK_DATA || peer->window == 0) return false;
+
+    uint64_t ingest_ns = gw_monotonic_ns();
+    size_t offset = 0;
+    while (offset < length) {
+        stm32_frame_t frame;
+        uint16_t device_id;
+        uint32_t sequence;
+        size_t used = gateway_decode_tagged(payload + offset, length - offset, &device_id, &sequence, &frame);
+        if (used == 0) return false;
+        gw_tagged_frame_t tagged = {device_id, sequence, ingest_ns, &frame, payload + offset, used};
+        if (fn) fn(&tagged, user_data);
+        server->stats.frames_delivered++;
+        (*delivered)++;
+        offset += used;
+    }
+
+    // Grant in half-window steps so credit records stay rare
+    peer->owed[channel] += length;
+    if (!channel_paused(server, channel) && peer->owed[channel] >= peer->window / 2) {
+        peer_grant(server, peer, channel);
+    }
+    return true;
+}
+
+static bool peer_read(gw_uplink_server_t* server, uplink_peer_t* peer, gw_sink_fn_t fn, void* user_data,
+                      int* delivered) {
+    size_t budget = UPLINK_READ_BUDGET;
+    while (budget > 0) {
+        ssize_t n = recv(peer->fd, peer->in + peer->in_length, UPLINK_PEER_IN - peer->in_length, MSG_DONTWAIT);
+        if (n == 0) return false;
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        peer->in_length += (size_t)n;
+        budget = (size_t)n >= budget ? 0 : budget - (size_t)n;
+
+        size_t offset = 0;
+        while (peer->in_length - offset >= GW_UPLINK_HEADER_SIZE) {
+            const uint8_t* record = peer->in + offset;
+            size_t size = GW_UPLINK_HEADER_SIZE + get_u16(record + 6);
+            if (record[0] != UPLINK_MAGIC_HIGH || record[1] != UPLINK_MAGIC_LOW) {
+                server->stats.protocol_errors++;
+                return false;
+            }
+            if (peer->in_length - offset < size) break;
+            if (!peer_handle_record(server, peer, record, fn, user_data, delivered)) {
+                server->stats.protocol_errors++;
+                return false;
+            }
+            offset += size;
+        }
+        memmove(peer->in, peer->in + offset, peer->in_length - offset);
+        peer->in_length -= offset;
+    }
+    return true;
+}
+
+gw_uplink_server_t* gw_uplink_server_open(uint16_t port) {
+    gw_uplink_server_t* server = calloc(1, sizeof(gw_uplink_server_t));
+    if (!server) return NULL;
+
+    server->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listen_fd < 0) {
+        free(server);
+        return NULL;
+    }
+    int opt = 1;
+    setsockopt(server->listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+    if (bind(server->listen_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(server->listen_fd, 16) < 0) {
+        perror("Uplink: bind/listen failed");
+        close(server->listen_fd);
+        free(server);
+        return NULL;
+    }
+    socklen_t len = sizeof(addr);
+    server->port = port;
+    if (getsockname(server->listen_fd, (struct sockaddr*)&addr, &len) == 0) {
+        server->port = ntohs(addr.sin_port);
+    }
+    return server;
+}
+
+uint16_t gw_uplink_server_port(gw_uplink_server_t* server) {
+    return server ? server->port : 0;
+}
+
+void gw_uplink_server_close(gw_uplink_server_t* server) {
+    if (!server) return;
+    while (server->peer_count > 0) peer_close(server, server->peer_count - 1);
+    close(server->listen_fd);
+    free(server);
+}
+
+static void accept_peers(gw_uplink_server_t* server) {
+    for (;;) {
+        int fd = accept4(server->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+        if (server->peer_count == UPLINK_MAX_PEERS) {
+            close(fd);
+            continue;
+        }
+        uplink_peer_t* peer = &server->peers[server->peer_count];
+        memset(peer, 0, sizeof(*peer));
+        peer->fd = fd;
+        peer->in = malloc(UPLINK_PEER_IN);
+        peer->owed = calloc(UPLINK_CHANNELS, sizeof(uint32_t));
+        if (!peer->in || !peer->owed) {
+            free(peer->in);
+            free(peer->owed);
+            close(fd);
+            continue;
+        }
+        server->peer_count++;
+        server->stats.connections = server->peer_count;
+    }
+}
+
+int gw_uplink_server_poll(gw_uplink_server_t* server, int timeout_ms, gw_sink_fn_t fn, void* user_data) {
+    if (!server) return -1;
+
+    struct pollfd fds[UPLINK_MAX_PEERS + 1];
+    fds[0].fd = server->listen_fd;
+    fds[0].events = POLLIN;
+    for (uint32_t i = 0; i < server->peer_count; i++) {
+        uplink_peer_t* peer = &server->peers[i];
+        fds[i + 1].fd = peer->fd;
+        fds[i + 1].events = POLLIN | (peer->out.length > peer->out_sent ? POLLOUT : 0);
+    }
+    uint32_t polled = server->peer_count;
+    if (poll(fds, polled + 1, timeout_ms) < 0) return errno == EINTR ? 0 : -1;
+
+    int delivered = 0;
+    // Walk backwards: closing a peer moves the last one into its slot
+    for (uint32_t i = polled; i-- > 0;) {
+        if (!fds[i + 1].revents) continue;
+        uplink_peer_t* peer = &server->peers[i];
+        bool ok = true;
+        if (fds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ok = peer_read(server, peer, fn, user_data, &delivered);
+        }
+        if (!ok || !peer_flush(peer)) peer_close(server, i);
+    }
+    if (fds[0].revents & POLLIN) accept_peers(server);
+    return delivered;
+}
+
+void gw_uplink_server_pause(gw_uplink_server_t* server, uint16_t channel, bool paused) {
+    if (!server) return;
+    if (paused) {
+        server->paused[channel / 8] |= (uint8_t)(1u << (channel % 8));
+        return;
+    }
+    server->paused[channel / 8] &= (uint8_t)~(1u << (channel % 8));
+    for (uint32_t i = server->peer_count; i-- > 0;) {
+        uplink_peer_t* peer = &server->peers[i];
+        if (peer->owed[channel] == 0) continue;
+        peer_grant(server, peer, channel);
+        if (!peer_flush(peer)) peer_close(server, i);
+    }
+}
+
+void gw_uplink_server_get_stats(gw_uplink_server_t* server, gw_uplink_server_stats_t* stats) {
+    if (server && stats) *stats = server->stats;
+}
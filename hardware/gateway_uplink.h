@@ -0,0 +1,100 @@
+#ifndef GATEWAY_UPLINK_H
+#define GATEWAY_UPLINK_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gateway.h"
+
+// Multiplexed uplink: a regional gateway forwards every device stream to the
+// central backend over one TCP connection, one channel per device.
+//
+// Record: ['N']['X'][type u8][reserved u8][channel u16 LE][length u16 LE][payload]
+//
+//   HELLO   gateway -> central   payload: per-channel window u32
+//   DATA    gateway -> central   payload: whole tagged frames of that channel
+//   CREDIT  central -> gateway   payload: bytes u32 the channel may send
+//
+// Each channel starts every connection with the HELLO window and spends it
+// on DATA payload bytes; the central side grants credit back as it consumes.
+// A channel out of credit queues locally, up to channel_queue bytes (oldest
+// frames dropped first), while the other channels keep flowing. Channels
+// take turns filling each write, so a noisy site cannot starve a quiet one,
+// and small frames from many channels leave in a few large writes.
+#define GW_UPLINK_HEADER_SIZE       8
+#define GW_UPLINK_MAX_PAYLOAD       0xFFFF
+
+#define GW_UPLINK_HELLO             1
+#define GW_UPLINK_DATA              2
+#define GW_UPLINK_CREDIT            3
+
+typedef struct {
+    char host[128];                 // Central backend address
+    uint16_t port;
+    uint32_t window;                // Credit each channel starts a connection with, bytes
+    uint32_t channel_queue;         // Bytes a channel buffers while out of credit
+    uint32_t quantum;               // Bytes a channel adds to a write before the next one's turn
+    uint32_t max_write;             // Coalescing target per send()
+    uint32_t reconnect_initial_ms;
+    uint32_t reconnect_max_ms;
+} gw_uplink_config_t;
+
+typedef struct {
+    bool connected;
+    uint32_t channels;
+    uint32_t channels_blocked;      // Channels with frames queued and no credit
+    uint64_t frames_queued;
+    uint64_t frames_sent;
+    uint64_t frames_dropped;        // Oldest frames dropped from a full channel queue
+    uint64_t bytes_sent;
+    uint64_t writes;                // send() calls; frames_sent / writes is the coalescing ratio
+    uint64_t credits_received;
+    uint64_t connects;
+} gw_uplink_stats_t;
+
+typedef struct gw_uplink gw_uplink_t;
+
+void gw_uplink_default_config(gw_uplink_config_t* config);
+gw_uplink_t* gw_uplink_create(const gw_uplink_config_t* config);
+hw_status_t gw_uplink_start(gw_uplink_t* uplink);
+void gw_uplink_destroy(gw_uplink_t* uplink);
+void gw_uplink_get_stats(gw_uplink_t* uplink, gw_uplink_stats_t* stats);
+
+// Gateway sink; pass the uplink as user_data to gateway_add_sink()
+void gw_uplink_sink(const gw_tagged_frame_t* frame, void* user_data);
+
+// Central side: accepts uplinks and demultiplexes them back into tagged
+// frames, granting credit as frames are delivered. Single-threaded; the
+// caller drives it.
+typedef struct {
+    uint32_t connections;
+    uint64_t records;
+    uint64_t frames_delivered;
+    uint64_t credits_sent;
+    uint64_t protocol_errors;
+} gw_uplink_server_stats_t;
+
+typedef struct gw_uplink_server gw_uplink_server_t;
+
+// Port 0 picks an ephemeral port
+gw_uplink_server_t* gw_uplink_server_open(uint16_t port);
+uint16_t gw_uplink_server_port(gw_uplink_server_t* server);
+void gw_uplink_server_close(gw_uplink_server_t* server);
+
+// Waits up to timeout_ms for traffic and delivers every complete frame.
+// Returns the number of frames delivered, or -1 on listener error.
+int gw_uplink_server_poll(gw_uplink_server_t* server, int timeout_ms, gw_sink_fn_t fn, void* user_data);
+
+// Withholds credit for a channel (its consumer is stuck); the uplink then
+// stops sending it once the window is spent. Resuming grants what is owed.
+void gw_uplink_server_pause(gw_uplink_server_t* server, uint16_t channel, bool paused);
+void gw_uplink_server_get_stats(gw_uplink_server_t* server, gw_uplink_server_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GATEWAY_UPLINK_H
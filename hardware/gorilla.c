@@ -0,0 +1,188 @@
+#include "gorilla.h"
+#include <stdbool.h>
+#include <string.h>
+
+static inline uint64_t load_be64(const uint8_t* p) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    return word;
+#else
+    return __builtin_bswap64(word);
+#endif
+}
+
+static inline void store_be64(uint8_t* p, uint64_t word) {
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_BIG_ENDIAN__
+    word = __builtin_bswap64(word);
+#endif
+    memcpy(p, &word, sizeof(word));
+}
+
+// ORs the low n bits of value (n <= 57) in at *pos; the bits there are zero
+static inline void put_bits(uint8_t* stream, uint64_t* pos, uint64_t value, unsigned n) {
+    uint8_t* p = stream + (*pos >> 3);
+    store_be64(p, load_be64(p) | value << (64 - n - (*pos & 7)));
+    *pos += n;
+}
+
+// At least 57 valid bits from pos, MSB first
+static inline uint64_t peek_bits(const uint8_t* stream, uint64_t pos) {
+    return load_be64(stream + (pos >> 3)) << (pos & 7);
+}
+
+void gorilla_init(gorilla_encoder_t* encoder) {
+    if (encoder) memset(encoder, 0, sizeof(*encoder));
+}
+
+void gorilla_append(gorilla_encoder_t* encoder, uint8_t* stream, uint32_t timestamp, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    if (encoder->count == 0) {
+        put_bits(stream, &encoder->bits, timestamp, 32);
+        put_bits(stream, &encoder->bits, bits, 32);
+    } else {
+        uint32_t delta = timestamp - encoder->timestamp;
+        int64_t dod = (int64_t)delta - encoder->delta;
+        if (dod == 0) {
+            put_bits(stream, &encoder->bits, 0, 1);
+        } else if (dod >= -63 && dod <= 64) {
+            put_bits(stream, &encoder->bits, (0x2ull << 7) | (uint64_t)(dod + 63), 9);
+        } else if (dod >= -255 && dod <= 256) {
+            put_bits(stream, &encoder->bits, (0x6ull << 9) | (uint64_t)(dod + 255), 12);
+        } else if (dod >= -2047 && dod <= 2048) {
+            put_bits(stream, &encoder->bits, (0xEull << 12) | (uint64_t)(dod + 2047), 16);
+        } else {
+            put_bits(stream, &encoder->bits, (0xFull << 33) | (uint64_t)(dod + 0xFFFFFFFFll), 37);
+        }
+        encoder->delta = delta;
+
+        uint32_t x = bits ^ encoder->value;
+        if (x == 0) {
+            put_bits(stream, &encoder->bits, 0, 1);
+        } else {
+            unsigned leading = (unsigned)__builtin_clz(x);
+            unsigned trailing = (unsigned)__builtin_ctz(x);
+            unsigned window_trailing = 32u - encoder->leading - encoder->meaningful;
+            if (encoder->meaningful && leading >= encoder->leading && trailing >= window_trailing) {
+                put_bits(stream, &encoder->bits, (0x2ull << encoder->meaningful) | (x >> window_trailing),
+                         2 + encoder->meaningful);
+            } else {
+                unsigned meaningful = 32 - leading - trailing;
+                put_bits(stream, &encoder->bits, (0x3ull << 10) | (leading << 5) | (meaningful - 1), 12);
+                put_bits(stream, &encoder->bits, x >> trailing, meaningful);
+                encoder->leading = (uint8_t)leading;
+                encoder->meaningful = (uint8_t)meaningful;
+            }
+        }
+    }
+    encoder->timestamp = timestamp;
+    encoder->value = bits;
+    encoder->count++;
+}
+
+typedef struct {
+    uint64_t pos;
+    uint64_t limit;          // Stream bits; a point ending past it is not whole
+    uint32_t timestamp;
+    uint32_t delta;
+    uint32_t value;
+    unsigned leading;
+    unsigned meaningful;
+} reader_t;
+
+static inline bool read_first(reader_t* r, const uint8_t* stream, size_t bytes) {
+    if (bytes < 8) return false;
+    uint64_t word = peek_bits(stream, 0);
+    r->pos = 64;
+    r->limit = (uint64_t)bytes * 8;
+    r->timestamp = (uint32_t)(word >> 32);
+    r->value = (uint32_t)word;
+    r->delta = 0;
+    r->leading = 0;
+    r->meaningful = 0;
+    return true;
+}
+
+// One point after the first; false if it does not end within the stream.
+// A peek holds at least 57 bits: a regular interval (1 bit) leaves enough
+// for the largest value (44 bits), so most points take a single load.
+static inline bool read_next(reader_t* r, const uint8_t* stream) {
+    uint64_t w = peek_bits(stream, r->pos);
+    if (!(w >> 63)) {
+        r->pos += 1;
+        w <<= 1;
+    } else {
+        int64_t dod;
+        if (!(w >> 62 & 1)) {
+            dod = (int64_t)(w >> 55 & 0x7F) - 63;
+            r->pos += 9;
+        } else if (!(w >> 61 & 1)) {
+            dod = (int64_t)(w >> 52 & 0x1FF) - 255;
+            r->pos += 12;
+        } else if (!(w >> 60 & 1)) {
+            dod = (int64_t)(w >> 48 & 0xFFF) - 2047;
+            r->pos += 16;
+        } else {
+            dod = (int64_t)(w >> 27 & 0x1FFFFFFFFull) - 0xFFFFFFFFll;
+            r->pos += 37;
+        }
+        r->delta = (uint32_t)((int64_t)r->delta + dod);
+        if (r->pos > r->limit) return false;
+        w = peek_bits(stream, r->pos);
+    }
+    r->timestamp += r->delta;
+
+    // Noisy readings make the three value cases unpredictable, so they
+    // are selected without branches
+    unsigned control = (unsigned)(w >> 62);
+    bool fresh = control == 3;
+    r->leading = fresh ? (unsigned)(w >> 57 & 31) : r->leading;
+    r->meaningful = fresh ? (unsigned)(w >> 52 & 31) + 1 : r->meaningful;
+    unsigned skip = fresh ? 12 : 2;
+    uint32_t x = (uint32_t)((w << skip >> 1) >> (63 - r->meaningful));
+    x <<= (32 - r->leading - r->meaningful) & 31;
+    r->value ^= control >= 2 ? x : 0;
+    r->pos += control >= 2 ? skip + r->meaningful : 1;
+    return r->pos <= r->limit;
+}
+
+uint32_t gorilla_decode(const uint8_t* stream, size_t bytes, uint32_t count, uint32_t start, uint32_t end,
+                        uint32_t* timestamps, float* values, uint32_t room) {
+    reader_t r;
+    if (count == 0 || room == 0 || !read_first(&r, stream, bytes)) return 0;
+
+    // Skip to start, then store until end
+    uint32_t i = 1, n = 0;
+    while (r.timestamp < start) {
+        if (i++ == count || !read_next(&r, stream)) return 0;
+    }
+    while (r.timestamp <= end) {
+        if (timestamps) timestamps[n] = r.timestamp;
+        memcpy(&values[n], &r.value, sizeof(float));
+        if (++n == room || i++ == count || !read_next(&r, stream)) break;
+    }
+    return n;
+}
+
+uint32_t gorilla_resume(gorilla_encoder_t* encoder, const uint8_t* stream, size_t bytes, uint32_t count) {
+    reader_t r;
+    gorilla_init(encoder);
+    if (count == 0 || !read_first(&r, stream, bytes)) return 0;
+
+    uint32_t found = 1;
+    reader_t next = r;
+    while (found < count && read_next(&next, stream)) {
+        r = next;
+        found++;
+    }
+    encoder->bits = r.pos;
+    encoder->count = found;
+    encoder->timestamp = r.timestamp;
+    encoder->delta = r.delta;
+    encoder->value = r.value;
+    encoder->leading = (uint8_t)r.leading;
+    encoder->meaningful = (uint8_t)r.meaningful;
+    return found;
+}
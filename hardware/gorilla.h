@@ -0,0 +1,62 @@
+#ifndef GORILLA_H
+#define GORILLA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Gorilla-style bit stream of (timestamp, float) points.
+//
+// The first point is stored raw (32 + 32 bits). After it, a timestamp is
+// the delta-of-delta to the previous one: a single 0 bit while the interval
+// stays the same, else a 2-4 bit prefix and 7, 9, 12 or 33 bits. A value is
+// XORed with the previous one: a single 0 bit when unchanged, else the
+// meaningful bits of the XOR, reusing the previous leading/trailing zero
+// window when they fit in it. Regular 1 s samples of a slowly varying
+// reading take a few bits per point instead of 64.
+//
+// Bits are packed MSB first and accessed as 64-bit big-endian words, so
+// the buffer must stay readable GORILLA_PADDING bytes past the stream, and
+// an append needs GORILLA_POINT_ROOM zeroed bytes from the current end.
+// Timestamps must not go backwards. Not thread-safe.
+
+#define GORILLA_PADDING     16
+#define GORILLA_POINT_ROOM  32     // Largest point (81 bits), word access and padding
+
+typedef struct {
+    uint64_t bits;           // Stream length
+    uint32_t count;
+    uint32_t timestamp;      // Last point
+    uint32_t delta;          // Last interval
+    uint32_t value;          // Last value's bit pattern
+    uint8_t leading;         // Window of the last stored XOR
+    uint8_t meaningful;      // 0: no window yet
+} gorilla_encoder_t;
+
+void gorilla_init(gorilla_encoder_t* encoder);
+void gorilla_append(gorilla_encoder_t* encoder, uint8_t* stream, uint32_t timestamp, float value);
+
+// Bytes the stream occupies
+static inline size_t gorilla_bytes(const gorilla_encoder_t* encoder) {
+    return (size_t)((encoder->bits + 7) / 8);
+}
+
+// Decodes the first count points of a stream of at most bytes bytes and
+// stores those with start <= timestamp <= end, up to room of them;
+// timestamps may be NULL. Returns the number stored.
+uint32_t gorilla_decode(const uint8_t* stream, size_t bytes, uint32_t count, uint32_t start, uint32_t end,
+                        uint32_t* timestamps, float* values, uint32_t room);
+
+// Rebuilds the encoder state after the first count points of a stream, to
+// append to it again. Returns the points found, fewer than count if the
+// stream ends within bytes first.
+uint32_t gorilla_resume(gorilla_encoder_t* encoder, const uint8_t* stream, size_t bytes, uint32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // GORILLA_H
@@ -0,0 +1,1729 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "hardware_interface.h"
+#include "hw_backend.h"
+#include "hw_stats.h"
+#include "tsdb.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+typedef CRITICAL_SECTION hw_lock_t;
+typedef CONDITION_VARIABLE hw_cond_t;
+typedef HANDLE hw_thread_t;
+#define hw_lock_init(l)     InitializeCriticalSection(l)
+#define hw_lock_destroy(l)  DeleteCriticalSection(l)
+#define hw_lock(l)          EnterCriticalSection(l)
+#define hw_unlock(l)        LeaveCriticalSection(l)
+#define hw_trylock(l)       TryEnterCriticalSection(l)
+#define hw_cond_init(c)     InitializeConditionVariable(c)
+#define hw_cond_destroy(c)  ((void)(c))
+#define hw_cond_signal(c)   WakeConditionVariable(c)
+#define hw_cond_wait_ms(c, l, ms) SleepConditionVariableCS(c, l, ms)
+#define HW_THREAD_FN(name)  static DWORD WINAPI name(LPVOID arg)
+#define HW_THREAD_RETURN    return 0
+#define hw_thread_start(t, fn, arg) ((*(t) = CreateThread(NULL, 0, fn, arg, 0, NULL)) != NULL)
+#define hw_thread_join(t)   (WaitForSingleObject(t, INFINITE), CloseHandle(t))
+#else
+#include <pthread.h>
+typedef pthread_mutex_t hw_lock_t;
+typedef pthread_cond_t hw_cond_t;
+typedef pthread_t hw_thread_t;
+#define hw_lock_init(l)     pthread_mutex_init(l, NULL)
+#define hw_lock_destroy(l)  pthread_mutex_destroy(l)
+#define hw_lock(l)          pthread_mutex_lock(l)
+#define hw_unlock(l)        pthread_mutex_unlock(l)
+#define hw_trylock(l)       (pthread_mutex_trylock(l) == 0)
+#define hw_cond_destroy(c)  pthread_cond_destroy(c)
+#define hw_cond_signal(c)   pthread_cond_signal(c)
+#define HW_THREAD_FN(name)  static void* name(void* arg)
+#define HW_THREAD_RETURN    return NULL
+#define hw_thread_start(t, fn, arg) (pthread_create(t, NULL, fn, arg) == 0)
+#define hw_thread_join(t)   pthread_join(t, NULL)
+
+static void hw_cond_init(hw_cond_t* cond) {
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static void hw_cond_wait_ms(hw_cond_t* cond, hw_lock_t* lock, uint32_t ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_cond_timedwait(cond, lock, &ts);
+}
+#endif
+
+struct hw_subscription {
+    hw_device_t* device;
+    hw_subscription_t* next;
+    uint32_t mask;
+    uint32_t min_interval_ms;
+    hw_change_fn_t fn;
+    void* user_data;
+    uint32_t pending;        // Changes not yet delivered
+    uint64_t next_ms;        // Earliest next call under min_interval_ms
+    bool removed;            // Unsubscribed from its own callback
+};
+
+#define CMD_NONE        UINT32_MAX
+#define CMD_BATCH       64
+
+enum {
+    CMD_FREE,
+    CMD_QUEUED,              // Waiting for the simulated link
+    CMD_CANCELLED,           // Off the queue, completion not yet delivered
+    CMD_SENT,                // Taken by the dispatcher
+    CMD_DONE                 // Fn-less, waiting for hw_dev_poll_completions()
+};
+
+typedef struct {
+    uint32_t generation;     // High half of the token; stale tokens miss
+    uint32_t next;           // Queue order, or the free/cancelled list
+    uint32_t prev;
+    uint8_t state;
+    uint8_t type;            // hw_command_type_t
+    uint8_t target;
+    uint8_t arg;             // enable, or the battery test type
+    float voltage;
+    hw_status_t result;      // Also why a command sits on the cancelled list
+    uint64_t due_ms;         // Answer arrives after the link round trip
+    uint64_t deadline_ms;    // 0: no timeout
+    hw_command_fn_t fn;
+    void* user_data;
+} command_t;
+
+// What the dispatcher carries out of the lock for one command
+typedef struct {
+    hw_token_t token;
+    uint32_t index;
+    bool execute;
+    hw_status_t result;
+    command_t command;
+} command_run_t;
+
+// Measurements each bank has
+static const uint8_t bank_fields[BANK_COUNT] = {
+    [HW_BANK_POWER_MODULES] = 1 << HW_FIELD_VOLTAGE | 1 << HW_FIELD_CURRENT |
+                              1 << HW_FIELD_POWER | 1 << HW_FIELD_TEMPERATURE,
+    [HW_BANK_BATTERIES]     = 1 << HW_FIELD_VOLTAGE | 1 << HW_FIELD_CURRENT | 1 << HW_FIELD_TEMPERATURE,
+    [HW_BANK_AC_PHASES]     = 1 << HW_FIELD_VOLTAGE | 1 << HW_FIELD_CURRENT |
+                              1 << HW_FIELD_POWER | 1 << HW_FIELD_FREQUENCY,
+    [HW_BANK_DC_CIRCUITS]   = 1 << HW_FIELD_VOLTAGE | 1 << HW_FIELD_CURRENT | 1 << HW_FIELD_POWER,
+};
+
+// Device state, one per handle.
+//
+// The state lives in two buffers. version names the published one
+// (buffers[version & 1]); a writer copies it into the other buffer, changes
+// that private copy and publishes it by bumping version. Before touching a
+// buffer the writer sets begin to the version it is about to publish, so a
+// reader that copied buffers[v & 1] knows its copy is whole when begin is
+// still at most v + 1. Readers only load; they never block and never write
+// shared memory, so they scale with reader threads.
+struct hw_device {
+    hw_lock_t lock;          // Writers only
+    _Atomic uint64_t version;
+    _Atomic uint64_t begin;
+    state_t buffers[2];
+    size_t state_size;
+    char (*load_names)[32];  // Per DC circuit; fixed after hw_open()
+
+    hw_cond_t changed_cond;
+    uint32_t changed;        // Categories changed since the dispatcher last looked
+    bool wake;               // Subscription list changed
+
+    // Dispatch thread; subscriptions are only touched under dispatch_lock
+    hw_lock_t dispatch_lock;
+    hw_thread_t dispatcher;
+    bool dispatching;
+    bool stopping;
+    hw_subscription_t* subscriptions;
+    hw_snapshot_t dispatch_snapshot;
+
+    // Async commands, under lock
+    command_t* commands;
+    uint32_t max_commands;
+    uint32_t command_latency_ms;
+    uint32_t free_command;
+    uint32_t queue_head;
+    uint32_t queue_tail;
+    uint32_t cancelled;
+    uint32_t* completions;   // Ring of CMD_DONE indices
+    uint32_t completion_head;
+    uint32_t completion_count;
+    int command_fd;
+
+    // Change feed ring, appended by write_publish(). Positions count every
+    // entry ever logged; slot = position % log_size. A writer raises
+    // log_begin before reusing a slot, so a reader that copied positions
+    // from p on knows they were whole while log_begin <= p + log_size.
+    hw_change_t* log;
+    uint32_t log_size;
+    _Atomic uint64_t log_begin;
+    _Atomic uint64_t log_end;     // Positions written
+    _Atomic uint64_t log_version; // Latest version logged
+    _Atomic uint64_t log_floor;   // Newest version with entries dropped
+
+    tsdb_t* history;         // Logged data points
+
+    const hw_backend_t* backend;
+    void* backend_data;
+    _Atomic uint32_t noise;  // Sensor noise for lock-free readers
+    uint32_t update_ms;      // Backend step
+    _Atomic uint64_t last_update_ms;
+};
+
+static hw_device_t* default_device = NULL;
+
+// Set on a dispatch thread, so calls from its callbacks skip dispatch_lock
+static _Thread_local hw_device_t* dispatch_device = NULL;
+
+// Weyl sequence through a mixer; one atomic add, no lock
+static int noise_rand(hw_device_t* dev) {
+    uint32_t x = atomic_fetch_add_explicit(&dev->noise, 0x9E3779B9u, memory_order_relaxed);
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return (int)(x & 0x7FFFFFFF);
+}
+
+uint64_t hw_monotonic_ms(void) {
+#ifdef _WIN32
+    return GetTickCount64();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+#endif
+}
+
+// Arrays start on 16 bytes for vector loads
+static void carve(uint8_t* block, size_t* offset, size_t bytes, void** out) {
+    *out = block ? block + *offset : NULL;
+    *offset += (bytes + 15) & ~(size_t)15;
+}
+
+// Lays a buffer out over block; with block NULL it only measures one
+static size_t layout_state(state_t* s, uint8_t* block, const uint8_t counts[BANK_COUNT]) {
+    size_t offset = 0;
+    void* p;
+    carve(block, &offset, sizeof(state_header_t), &p);
+    s->header = p;
+    s->block = block;
+    for (int b = 0; b < BANK_COUNT; b++) {
+        bank_t* bank = &s->banks[b];
+        bank->count = counts[b];
+        for (int f = 0; f < FIELD_COUNT; f++) {
+            bank->fields[f] = NULL;
+            if (bank_fields[b] & (1 << f)) {
+                carve(block, &offset, counts[b] * sizeof(float), &p);
+                bank->fields[f] = p;
+            }
+        }
+        carve(block, &offset, counts[b], &p);
+        bank->flags = p;
+        bank->capacity = NULL;
+        if (b == HW_BANK_BATTERIES) {
+            carve(block, &offset, counts[b], &p);
+            bank->capacity = p;
+        }
+    }
+    return offset;
+}
+
+// Published state; stable while dev->lock is held
+static state_t* current(hw_device_t* dev) {
+    return &dev->buffers[atomic_load_explicit(&dev->version, memory_order_relaxed) & 1];
+}
+
+// Writers, with dev->lock held: change the buffer write_begin() returns,
+// then write_publish() it
+static state_t* write_begin(hw_device_t* dev) {
+    uint64_t v = atomic_load_explicit(&dev->version, memory_order_relaxed);
+    state_t* next = &dev->buffers[(v + 1) & 1];
+    atomic_store_explicit(&dev->begin, v + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(next->block, dev->buffers[v & 1].block, dev->state_size);
+    return next;
+}
+
+// Change feed, written with dev->lock held
+static void log_change(hw_device_t* dev, uint64_t version, uint8_t record, uint8_t unit_id, uint8_t field,
+                       float value) {
+    uint64_t pos = atomic_load_explicit(&dev->log_end, memory_order_relaxed);
+    hw_change_t* slot = &dev->log[pos % dev->log_size];
+    if (pos >= dev->log_size) {
+        atomic_store_explicit(&dev->log_floor, slot->version, memory_order_relaxed);
+    }
+    atomic_store_explicit(&dev->log_begin, pos + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    *slot = (hw_change_t){version, record, unit_id, field, value};
+    atomic_store_explicit(&dev->log_end, pos + 1, memory_order_release);
+}
+
+static void log_if_changed(hw_device_t* dev, uint64_t version, uint8_t record, uint8_t unit_id, uint8_t field,
+                           float before, float after) {
+    // Bitwise, so a NaN reading is logged once rather than on every version
+    if (memcmp(&before, &after, sizeof(float)) != 0) log_change(dev, version, record, unit_id, field, after);
+}
+
+// Logs every field of the changed categories that differs between the
+// published state and next
+static void log_changes(hw_device_t* dev, const state_t* prev, const state_t* next, uint32_t categories) {
+    static const struct {
+        uint8_t flag;
+        uint8_t field;
+    } flag_fields[] = {
+        {UNIT_ON, HW_FIELD_ACTIVE},
+        {UNIT_FAULT, HW_FIELD_FAULT},
+        {UNIT_CHARGING, HW_FIELD_CHARGING},
+        {UNIT_TEST, HW_FIELD_TEST},
+    };
+    uint64_t version = next->header->version;
+
+    // HW_CHANGE_POWER .. HW_CHANGE_DC are the banks in order
+    for (int b = 0; b < BANK_COUNT; b++) {
+        if (!(categories & (1u << b))) continue;
+        const bank_t* was = &prev->banks[b];
+        const bank_t* now = &next->banks[b];
+        for (int f = 0; f < FIELD_COUNT; f++) {
+            if (!(bank_fields[b] & (1 << f))) continue;
+            for (int i = 0; i < now->count; i++) {
+                log_if_changed(dev, version, b, i + 1, f, was->fields[f][i], now->fields[f][i]);
+            }
+        }
+        for (int i = 0; i < now->count; i++) {
+            uint8_t flipped = was->flags[i] ^ now->flags[i];
+            for (size_t k = 0; flipped && k < sizeof(flag_fields) / sizeof(flag_fields[0]); k++) {
+                if (flipped & flag_fields[k].flag) {
+                    log_change(dev, version, b, i + 1, flag_fields[k].field, (now->flags[i] & flag_fields[k].flag) != 0);
+                }
+            }
+            if (now->capacity && was->capacity[i] != now->capacity[i]) {
+                log_change(dev, version, b, i + 1, HW_FIELD_CAPACITY, now->capacity[i]);
+            }
+        }
+    }
+
+    const state_header_t* was = prev->header;
+    const state_header_t* now = next->header;
+    if (categories & HW_CHANGE_STATUS) {
+        const system_status_t* a = &was->status;
+        const system_status_t* b = &now->status;
+        log_if_changed(dev, version, HW_RECORD_SYSTEM, 0, HW_FIELD_MAINS, a->mains_available, b->mains_available);
+        log_if_changed(dev, version, HW_RECORD_SYSTEM, 0, HW_FIELD_BATTERY_BACKUP, a->battery_backup, b->battery_backup);
+        log_if_changed(dev, version, HW_RECORD_SYSTEM, 0, HW_FIELD_GENERATOR, a->generator_running, b->generator_running);
+        log_if_changed(dev, version, HW_RECORD_SYSTEM, 0, HW_FIELD_OPERATION_MODE, a->operation_mode, b->operation_mode);
+        log_if_changed(dev, version, HW_RECORD_SYSTEM, 0, HW_FIELD_SYSTEM_LOAD, a->system_load, b->system_load);
+        log_if_changed(dev, version, HW_RECORD_SYSTEM, 0, HW_FIELD_UPTIME, (float)a->uptime_seconds,
+                       (float)b->uptime_seconds);
+    }
+    if ((categories & HW_CHANGE_ALARMS) &&
+        (was->alarm_count != now->alarm_count || memcmp(was->alarms, now->alarms, now->alarm_count * sizeof(alarm_t)))) {
+        log_change(dev, version, HW_RECORD_SYSTEM, 0, HW_FIELD_ALARMS, now->alarm_count);
+    }
+    atomic_store_explicit(&dev->log_version, version, memory_order_release);
+}
+
+// Every state change goes through here so snapshot readers, the change
+// feed and the dispatcher can tell
+static void write_publish(hw_device_t* dev, state_t* next, uint32_t categories) {
+    next->header->version = atomic_load_explicit(&dev->version, memory_order_relaxed) + 1;
+    if (dev->log) log_changes(dev, current(dev), next, categories);
+    next->header->timestamp = (uint32_t)time(NULL);
+    atomic_store_explicit(&dev->version, next->header->version, memory_order_release);
+    dev->changed |= categories;
+    if (dev->dispatching) hw_cond_signal(&dev->changed_cond);
+}
+
+state_t* hw_state_begin(hw_device_t* dev) {
+    hw_lock(&dev->lock);
+    return write_begin(dev);
+}
+
+// An unpublished copy needs no undoing: begin already allows for the
+// version it would have been
+void hw_state_publish(hw_device_t* dev, state_t* s, uint32_t categories) {
+    if (categories) write_publish(dev, s, categories);
+    hw_unlock(&dev->lock);
+}
+
+// Readers copy out of the buffer read_begin() returns, then call
+// read_retry(): true when a writer started reusing the buffer mid-copy and
+// the copy must be redone
+static const state_t* read_begin(hw_device_t* dev, uint64_t* v) {
+    *v = atomic_load_explicit(&dev->version, memory_order_acquire);
+    return &dev->buffers[*v & 1];
+}
+
+static bool read_retry(hw_device_t* dev, uint64_t v) {
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&dev->begin, memory_order_relaxed) > v + 1;
+}
+
+// Records out of the banks, for the category getters and snapshots
+static void copy_power_modules(const state_t* s, power_module_t* out, int n) {
+    const bank_t* bank = BANK(s, POWER_MODULES);
+    memset(out, 0, n * sizeof(*out));
+    for (int i = 0; i < n; i++) {
+        out[i].module_id = i + 1;
+        out[i].voltage = bank->fields[HW_FIELD_VOLTAGE][i];
+        out[i].current = bank->fields[HW_FIELD_CURRENT][i];
+        out[i].power = bank->fields[HW_FIELD_POWER][i];
+        out[i].temperature = bank->fields[HW_FIELD_TEMPERATURE][i];
+        out[i].is_active = (bank->flags[i] & UNIT_ON) != 0;
+        out[i].has_fault = (bank->flags[i] & UNIT_FAULT) != 0;
+    }
+}
+
+static void copy_batteries(const state_t* s, battery_info_t* out, int n) {
+    const bank_t* bank = BANK(s, BATTERIES);
+    memset(out, 0, n * sizeof(*out));
+    for (int i = 0; i < n; i++) {
+        out[i].battery_id = i + 1;
+        out[i].voltage = bank->fields[HW_FIELD_VOLTAGE][i];
+        out[i].current = bank->fields[HW_FIELD_CURRENT][i];
+        out[i].temperature = bank->fields[HW_FIELD_TEMPERATURE][i];
+        out[i].capacity_percent = bank->capacity[i];
+        out[i].is_charging = (bank->flags[i] & UNIT_CHARGING) != 0;
+        out[i].test_in_progress = (bank->flags[i] & UNIT_TEST) != 0;
+    }
+}
+
+static void copy_ac_phases(const state_t* s, ac_phase_t* out, int n) {
+    const bank_t* bank = BANK(s, AC_PHASES);
+    memset(out, 0, n * sizeof(*out));
+    for (int i = 0; i < n; i++) {
+        out[i].phase_id = i + 1;
+        out[i].voltage = bank->fields[HW_FIELD_VOLTAGE][i];
+        out[i].current = bank->fields[HW_FIELD_CURRENT][i];
+        out[i].frequency = bank->fields[HW_FIELD_FREQUENCY][i];
+        out[i].power = bank->fields[HW_FIELD_POWER][i];
+        out[i].is_normal = (bank->flags[i] & UNIT_ON) != 0;
+    }
+}
+
+static void copy_dc_circuits(const hw_device_t* dev, const state_t* s, dc_circuit_t* out, int n) {
+    const bank_t* bank = BANK(s, DC_CIRCUITS);
+    memset(out, 0, n * sizeof(*out));
+    for (int i = 0; i < n; i++) {
+        out[i].circuit_id = i + 1;
+        out[i].voltage = bank->fields[HW_FIELD_VOLTAGE][i];
+        out[i].current = bank->fields[HW_FIELD_CURRENT][i];
+        out[i].power = bank->fields[HW_FIELD_POWER][i];
+        out[i].is_enabled = (bank->flags[i] & UNIT_ON) != 0;
+        memcpy(out[i].load_name, dev->load_names[i], sizeof(out[i].load_name));
+    }
+}
+
+static void copy_snapshot(const hw_device_t* dev, const state_t* s, hw_snapshot_t* out) {
+    const state_header_t* h = s->header;
+    out->version = h->version;
+    out->timestamp = h->timestamp;
+    out->power_module_count = s->banks[HW_BANK_POWER_MODULES].count;
+    out->battery_count = s->banks[HW_BANK_BATTERIES].count;
+    out->ac_phase_count = s->banks[HW_BANK_AC_PHASES].count;
+    out->dc_circuit_count = s->banks[HW_BANK_DC_CIRCUITS].count;
+    out->alarm_count = h->alarm_count < HW_MAX_ALARMS ? h->alarm_count : HW_MAX_ALARMS;
+    copy_power_modules(s, out->power_modules, out->power_module_count);
+    copy_batteries(s, out->batteries, out->battery_count);
+    copy_ac_phases(s, out->ac_phases, out->ac_phase_count);
+    copy_dc_circuits(dev, s, out->dc_circuits, out->dc_circuit_count);
+    memcpy(out->alarms, h->alarms, sizeof(out->alarms));
+    out->status = h->status;
+}
+
+// Ids of the values within [min, max]. Four lanes per compare where SSE2
+// is there; the mask says which lanes matched, so only hits cost a branch.
+static int scan_range(const float* values, int n, float min, float max, uint8_t* ids, int capacity) {
+    int found = 0;
+    int i = 0;
+#ifdef __SSE2__
+    __m128 lo = _mm_set1_ps(min);
+    __m128 hi = _mm_set1_ps(max);
+    for (; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(values + i);
+        int mask = _mm_movemask_ps(_mm_and_ps(_mm_cmpge_ps(x, lo), _mm_cmple_ps(x, hi)));
+        for (int lane = 0; mask; lane++, mask >>= 1) {
+            if (!(mask & 1)) continue;
+            if (found < capacity) ids[found] = (uint8_t)(i + lane + 1);
+            found++;
+        }
+    }
+#endif
+    for (; i < n; i++) {
+        if (values[i] >= min && values[i] <= max) {
+            if (found < capacity) ids[found] = (uint8_t)(i + 1);
+            found++;
+        }
+    }
+    return found;
+}
+
+// One backend step, with dev->lock held
+static void advance(hw_device_t* dev, uint64_t now) {
+    if (!dev->backend->step) return;
+    if (now - atomic_load_explicit(&dev->last_update_ms, memory_order_relaxed) < dev->update_ms) return;
+    atomic_store_explicit(&dev->last_update_ms, now, memory_order_relaxed);
+
+    state_t* s = write_begin(dev);
+    uint32_t changed = dev->backend->step(dev, dev->backend_data, s, now);
+    if (changed) write_publish(dev, s, changed);
+}
+
+// Readers move the simulation along when a step is due, unless a writer
+// holds the lock; they never wait for it
+static void maybe_advance(hw_device_t* dev) {
+    if (!dev->backend->step) return;
+    uint64_t now = hw_monotonic_ms();
+    if (now - atomic_load_explicit(&dev->last_update_ms, memory_order_relaxed) < dev->update_ms) return;
+    if (!hw_trylock(&dev->lock)) return;
+    advance(dev, now);
+    hw_unlock(&dev->lock);
+}
+
+void hw_default_config(hw_config_t* config) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    config->update_ms = 1000;
+    config->max_commands = 1024;
+    config->change_log = 4096;
+    config->power_modules = 4;
+    config->batteries = 4;
+    config->ac_phases = 3;
+    config->dc_circuits = 6;
+}
+
+static uint8_t clamp_count(uint8_t count, uint8_t max) {
+    if (count < 1) return 1;
+    return count > max ? max : count;
+}
+
+static void free_device(hw_device_t* dev) {
+    free(dev->buffers[0].block);
+    free(dev->buffers[1].block);
+    free(dev->load_names);
+    free(dev->commands);
+    free(dev->completions);
+    free(dev->log);
+    tsdb_close(dev->history);
+    free(dev);
+}
+
+hw_device_t* hw_open(const hw_config_t* config) {
+    HW_STATS_SCOPE(HW_OP_OPEN);
+    hw_config_t defaults;
+    if (!config) {
+        hw_default_config(&defaults);
+        config = &defaults;
+    }
+
+    hw_device_t* dev = calloc(1, sizeof(hw_device_t));
+    if (!dev) {
+        return NULL;
+    }
+    dev->backend = config->link && config->link[0] ? &hw_stm32_backend : &hw_sim_backend;
+    atomic_init(&dev->noise, config->seed ? config->seed : (uint32_t)time(NULL) ^ (uint32_t)(uintptr_t)dev);
+    dev->update_ms = config->update_ms;
+
+    const uint8_t counts[BANK_COUNT] = {
+        [HW_BANK_POWER_MODULES] = clamp_count(config->power_modules, HW_MAX_POWER_MODULES),
+        [HW_BANK_BATTERIES] = clamp_count(config->batteries, HW_MAX_BATTERIES),
+        [HW_BANK_AC_PHASES] = clamp_count(config->ac_phases, HW_MAX_AC_PHASES),
+        [HW_BANK_DC_CIRCUITS] = clamp_count(config->dc_circuits, HW_MAX_DC_CIRCUITS),
+    };
+    dev->state_size = layout_state(&dev->buffers[0], NULL, counts);
+    uint8_t* blocks[2] = {calloc(1, dev->state_size), calloc(1, dev->state_size)};
+    layout_state(&dev->buffers[0], blocks[0], counts);
+    layout_state(&dev->buffers[1], blocks[1], counts);
+    dev->load_names = calloc(counts[HW_BANK_DC_CIRCUITS], sizeof(*dev->load_names));
+
+    dev->max_commands = config->max_commands ? config->max_commands : 1;
+    dev->command_latency_ms = config->command_latency_ms;
+    dev->commands = calloc(dev->max_commands, sizeof(command_t));
+    dev->completions = malloc(dev->max_commands * sizeof(uint32_t));
+    dev->log_size = config->change_log;
+    dev->log = dev->log_size ? calloc(dev->log_size, sizeof(hw_change_t)) : NULL;
+    tsdb_config_t history;
+    tsdb_default_config(&history, config->history_dir);
+    dev->history = tsdb_open(&history);
+    if (!blocks[0] || !blocks[1] || !dev->load_names || !dev->commands || !dev->completions ||
+        (dev->log_size && !dev->log) || !dev->history) {
+        free_device(dev);
+        return NULL;
+    }
+    for (uint32_t i = 0; i < dev->max_commands; i++) {
+        dev->commands[i].next = i + 1 < dev->max_commands ? i + 1 : CMD_NONE;
+    }
+    dev->free_command = 0;
+    dev->queue_head = CMD_NONE;
+    dev->queue_tail = CMD_NONE;
+    dev->cancelled = CMD_NONE;
+
+    // Version 1 lives in buffers[1]; the backend may start publishing as
+    // soon as open() returns, so everything else is ready first
+    state_t* s = &dev->buffers[1];
+    s->header->version = 1;
+    s->header->timestamp = (uint32_t)time(NULL);
+    atomic_init(&dev->version, 1);
+    atomic_init(&dev->begin, 1);
+    atomic_init(&dev->last_update_ms, hw_monotonic_ms());
+    atomic_init(&dev->log_begin, 0);
+    atomic_init(&dev->log_end, 0);
+    atomic_init(&dev->log_version, 1);
+    atomic_init(&dev->log_floor, 0);
+    hw_lock_init(&dev->lock);
+    hw_lock_init(&dev->dispatch_lock);
+    hw_cond_init(&dev->changed_cond);
+#ifdef __linux__
+    dev->command_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    dev->command_fd = -1;
+#endif
+
+    dev->backend_data = dev->backend->open(dev, config, s, dev->load_names);
+    if (!dev->backend_data) {
+#ifdef __linux__
+        if (dev->command_fd >= 0) close(dev->command_fd);
+#endif
+        hw_cond_destroy(&dev->changed_cond);
+        hw_lock_destroy(&dev->dispatch_lock);
+        hw_lock_destroy(&dev->lock);
+        free_device(dev);
+        return NULL;
+    }
+    return dev;
+}
+
+void hw_close(hw_device_t* dev) {
+    HW_STATS_SCOPE(HW_OP_CLOSE);
+    if (!dev) return;
+
+    hw_lock(&dev->lock);
+    bool dispatching = dev->dispatching;
+    dev->stopping = true;
+    hw_cond_signal(&dev->changed_cond);
+    hw_unlock(&dev->lock);
+    if (dispatching) hw_thread_join(dev->dispatcher);
+
+    dev->backend->close(dev, dev->backend_data);
+
+    while (dev->subscriptions) {
+        hw_subscription_t* sub = dev->subscriptions;
+        dev->subscriptions = sub->next;
+        free(sub);
+    }
+#ifdef __linux__
+    if (dev->command_fd >= 0) close(dev->command_fd);
+#endif
+    hw_cond_destroy(&dev->changed_cond);
+    hw_lock_destroy(&dev->dispatch_lock);
+    hw_lock_destroy(&dev->lock);
+    free_device(dev);
+}
+
+// Snapshot
+hw_status_t hw_dev_get_snapshot(hw_device_t* dev, hw_snapshot_t* snapshot) {
+    HW_STATS_SCOPE(HW_OP_GET_SNAPSHOT);
+    if (!dev || !snapshot) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    maybe_advance(dev);
+    if (snapshot->version == atomic_load_explicit(&dev->version, memory_order_acquire)) {
+        return HW_STATUS_NOT_MODIFIED;
+    }
+    uint64_t v;
+    do {
+        copy_snapshot(dev, read_begin(dev, &v), snapshot);
+    } while (read_retry(dev, v));
+    return HW_STATUS_OK;
+}
+
+// Change feed. Entries are copied out without a lock; a copy a writer
+// overtook is redone.
+hw_status_t hw_dev_get_changes_since(hw_device_t* dev, uint64_t since, hw_change_t* changes,
+                                     uint32_t* count, uint64_t* version) {
+    HW_STATS_SCOPE(HW_OP_GET_CHANGES);
+    if (!dev || !changes || !count || !version) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    maybe_advance(dev);
+    if (!dev->log) {
+        return HW_STATUS_TOO_OLD;
+    }
+    for (;;) {
+        uint64_t latest = atomic_load_explicit(&dev->log_version, memory_order_acquire);
+        uint64_t end = atomic_load_explicit(&dev->log_end, memory_order_acquire);
+        if (since == latest) {
+            *count = 0;
+            *version = latest;
+            return HW_STATUS_NOT_MODIFIED;
+        }
+        if (since == 0 || since > latest) {
+            return HW_STATUS_TOO_OLD;
+        }
+
+        // Back from the end to the first change after since; a newer
+        // version may already be partly logged past latest
+        uint64_t oldest = end > dev->log_size ? end - dev->log_size : 0;
+        uint64_t first = end;
+        while (first > oldest && dev->log[(first - 1) % dev->log_size].version > since) first--;
+        uint64_t last = first;
+        while (last < end && dev->log[last % dev->log_size].version <= latest) last++;
+
+        // Whole versions only
+        uint64_t reached = latest;
+        if (last - first > *count) {
+            last = first + *count;
+            reached = *count ? dev->log[(last - 1) % dev->log_size].version : 0;
+            if (last < end && dev->log[last % dev->log_size].version == reached) {
+                while (last > first && dev->log[(last - 1) % dev->log_size].version == reached) last--;
+                reached--;
+            }
+        }
+        for (uint64_t p = first; p < last; p++) {
+            changes[p - first] = dev->log[p % dev->log_size];
+        }
+
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&dev->log_begin, memory_order_relaxed) > first + dev->log_size) {
+            continue;
+        }
+        if (since < atomic_load_explicit(&dev->log_floor, memory_order_relaxed) || reached <= since) {
+            return HW_STATUS_TOO_OLD;
+        }
+        *count = (uint32_t)(last - first);
+        *version = reached;
+        return HW_STATUS_OK;
+    }
+}
+
+// Bulk access
+uint8_t hw_dev_unit_count(hw_device_t* dev, hw_bank_t bank) {
+    if (!dev || (unsigned)bank >= BANK_COUNT) {
+        return 0;
+    }
+    return dev->buffers[0].banks[bank].count;
+}
+
+static bool has_field(hw_bank_t bank, hw_field_t field) {
+    return (unsigned)bank < BANK_COUNT && (unsigned)field < FIELD_COUNT && (bank_fields[bank] & (1 << field));
+}
+
+hw_status_t hw_dev_read_field(hw_device_t* dev, hw_bank_t bank, hw_field_t field,
+                              uint8_t first_id, uint8_t count, float* values) {
+    HW_STATS_SCOPE(HW_OP_READ_FIELD);
+    if (!dev || !values || !has_field(bank, field) || first_id < 1 ||
+        first_id - 1 + count > dev->buffers[0].banks[bank].count) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    maybe_advance(dev);
+    uint64_t v;
+    do {
+        memcpy(values, read_begin(dev, &v)->banks[bank].fields[field] + first_id - 1, count * sizeof(float));
+    } while (read_retry(dev, v));
+    return HW_STATUS_OK;
+}
+
+int hw_dev_find_units(hw_device_t* dev, hw_bank_t bank, hw_field_t field, float min, float max,
+                      uint8_t* ids, int capacity) {
+    HW_STATS_SCOPE(HW_OP_FIND_UNITS);
+    if (!dev || !has_field(bank, field) || (capacity > 0 && !ids)) {
+        return -1;
+    }
+
+    maybe_advance(dev);
+    int found;
+    uint64_t v;
+    do {
+        const bank_t* b = &read_begin(dev, &v)->banks[bank];
+        found = scan_range(b->fields[field], b->count, min, max, ids, capacity);
+    } while (read_retry(dev, v));
+    return found;
+}
+
+// Range checks shared by the setters and the async queue
+static hw_status_t check_command(hw_device_t* dev, const hw_command_args_t* c) {
+    const state_t* s = &dev->buffers[0];
+    switch (c->type) {
+    case HW_CMD_SET_POWER_MODULE:
+        return c->target >= 1 && c->target <= BANK(s, POWER_MODULES)->count ? HW_STATUS_OK : HW_STATUS_INVALID_PARAM;
+    case HW_CMD_SET_TARGET_VOLTAGE:
+        return c->voltage >= 48.0f && c->voltage <= 58.0f ? HW_STATUS_OK : HW_STATUS_INVALID_PARAM;
+    case HW_CMD_START_BATTERY_TEST:
+    case HW_CMD_STOP_BATTERY_TEST:
+        return c->target >= 1 && c->target <= BANK(s, BATTERIES)->count ? HW_STATUS_OK : HW_STATUS_INVALID_PARAM;
+    case HW_CMD_SET_DC_CIRCUIT:
+        return c->target >= 1 && c->target <= BANK(s, DC_CIRCUITS)->count ? HW_STATUS_OK : HW_STATUS_INVALID_PARAM;
+    case HW_CMD_SET_OPERATION_MODE:
+        return c->arg <= 2 ? HW_STATUS_OK : HW_STATUS_INVALID_PARAM;
+    case HW_CMD_ACKNOWLEDGE_ALARM:
+        return HW_STATUS_OK;
+    }
+    return HW_STATUS_INVALID_PARAM;
+}
+
+static hw_status_t execute_one(hw_device_t* dev, const hw_command_args_t* command) {
+    hw_status_t result = check_command(dev, command);
+    if (result == HW_STATUS_OK) {
+        dev->backend->execute(dev, dev->backend_data, command, &result, 1);
+    }
+    return result;
+}
+
+// Coalescing rules. A setpoint replaces a queued one for the same setting;
+// it may not move past a command whose order relative to it matters.
+static bool is_setpoint(uint8_t type) {
+    return type == HW_CMD_SET_POWER_MODULE || type == HW_CMD_SET_TARGET_VOLTAGE || type == HW_CMD_SET_DC_CIRCUIT;
+}
+
+static bool supersedes(const command_t* newer, const command_t* older) {
+    return is_setpoint(newer->type) && newer->type == older->type && newer->target == older->target;
+}
+
+static bool ordered(const command_t* a, const command_t* b) {
+    if (!is_setpoint(a->type) || !is_setpoint(b->type)) return true;
+    // The target voltage is applied to whichever modules are on
+    return (a->type == HW_CMD_SET_TARGET_VOLTAGE && b->type == HW_CMD_SET_POWER_MODULE) ||
+           (a->type == HW_CMD_SET_POWER_MODULE && b->type == HW_CMD_SET_TARGET_VOLTAGE);
+}
+
+// Async command queue, all under dev->lock
+static hw_token_t command_token(const hw_device_t* dev, uint32_t index) {
+    return ((uint64_t)dev->commands[index].generation << 32) | index;
+}
+
+static void command_unlink(hw_device_t* dev, uint32_t index) {
+    command_t* c = &dev->commands[index];
+    if (c->prev != CMD_NONE) dev->commands[c->prev].next = c->next; else dev->queue_head = c->next;
+    if (c->next != CMD_NONE) dev->commands[c->next].prev = c->prev; else dev->queue_tail = c->prev;
+}
+
+static void command_free(hw_device_t* dev, uint32_t index) {
+    dev->commands[index].state = CMD_FREE;
+    dev->commands[index].next = dev->free_command;
+    dev->free_command = index;
+}
+
+static void command_take(hw_device_t* dev, uint32_t index, bool execute, hw_status_t result,
+                         command_run_t* batch, int* count) {
+    command_t* c = &dev->commands[index];
+    command_run_t* run = &batch[(*count)++];
+    run->token = command_token(dev, index);
+    run->index = index;
+    run->execute = execute;
+    run->result = result;
+    run->command = *c;
+    // Callbacks need nothing more from the slot; fn-less ones park it until polled
+    if (c->fn) {
+        command_free(dev, index);
+    } else {
+        c->state = CMD_SENT;
+    }
+}
+
+// Moves answered, timed-out and cancelled commands into batch and lowers
+// next to the earliest moment another one is due
+static int collect_commands(hw_device_t* dev, uint64_t now, command_run_t* batch, uint64_t* next) {
+    int count = 0;
+    while (dev->cancelled != CMD_NONE && count < CMD_BATCH) {
+        uint32_t index = dev->cancelled;
+        dev->cancelled = dev->commands[index].next;
+        command_take(dev, index, false, dev->commands[index].result, batch, &count);
+    }
+
+    uint32_t index = dev->queue_head;
+    while (index != CMD_NONE && count < CMD_BATCH) {
+        command_t* c = &dev->commands[index];
+        uint32_t following = c->next;
+        bool expired = c->deadline_ms && c->deadline_ms <= now && c->deadline_ms < c->due_ms;
+        if (expired || c->due_ms <= now) {
+            command_unlink(dev, index);
+            command_take(dev, index, !expired, expired ? HW_STATUS_TIMEOUT : HW_STATUS_OK, batch, &count);
+        } else {
+            if (c->due_ms < *next) *next = c->due_ms;
+            if (c->deadline_ms && c->deadline_ms < *next) *next = c->deadline_ms;
+        }
+        index = following;
+    }
+    if (count == CMD_BATCH) *next = now;
+    return count;
+}
+
+// Hands every valid command of the batch to the backend in one call, in
+// queue order
+static void execute_commands(hw_device_t* dev, command_run_t* batch, int count) {
+    hw_command_args_t args[CMD_BATCH];
+    hw_status_t results[CMD_BATCH];
+    command_run_t* runs[CMD_BATCH];
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        command_run_t* run = &batch[i];
+        if (!run->execute) continue;
+        const command_t* c = &run->command;
+        args[n] = (hw_command_args_t){.type = c->type, .target = c->target, .arg = c->arg, .voltage = c->voltage};
+        run->result = check_command(dev, &args[n]);
+        if (run->result == HW_STATUS_OK) runs[n++] = run;
+    }
+    if (n == 0) return;
+    dev->backend->execute(dev, dev->backend_data, args, results, n);
+    for (int i = 0; i < n; i++) {
+        runs[i]->result = results[i];
+    }
+}
+
+static void run_commands(hw_device_t* dev, command_run_t* batch, int count) {
+    execute_commands(dev, batch, count);
+    for (int i = 0; i < count; i++) {
+        command_run_t* run = &batch[i];
+        if (run->command.fn) {
+            run->command.fn(dev, run->token, run->result, run->command.user_data);
+            continue;
+        }
+
+        hw_lock(&dev->lock);
+        command_t* c = &dev->commands[run->index];
+        c->result = run->result;
+        c->state = CMD_DONE;
+        dev->completions[(dev->completion_head + dev->completion_count) % dev->max_commands] = run->index;
+        dev->completion_count++;
+#ifdef __linux__
+        uint64_t one = 1;
+        if (dev->command_fd >= 0 && write(dev->command_fd, &one, sizeof(one)) < 0) {
+            // Counter saturated; the fd is readable regardless
+        }
+#endif
+        hw_unlock(&dev->lock);
+    }
+}
+
+// Dispatch thread
+HW_THREAD_FN(dispatch_thread) {
+    hw_device_t* dev = arg;
+    dispatch_device = dev;
+    command_run_t batch[CMD_BATCH];
+
+    for (;;) {
+        hw_lock(&dev->lock);
+        uint64_t now = hw_monotonic_ms();
+        advance(dev, now);
+        if (dev->stopping) {
+            hw_unlock(&dev->lock);
+            break;
+        }
+        uint32_t changed = dev->changed;
+        dev->changed = 0;
+        dev->wake = false;
+        if (dev->dispatch_snapshot.version != current(dev)->header->version) {
+            copy_snapshot(dev, current(dev), &dev->dispatch_snapshot);
+        }
+        uint64_t next = atomic_load_explicit(&dev->last_update_ms, memory_order_relaxed) +
+                        (dev->update_ms ? dev->update_ms : 1);
+        int commands = collect_commands(dev, now, batch, &next);
+        hw_unlock(&dev->lock);
+
+        run_commands(dev, batch, commands);
+
+        // Deliver, or work out how long the rate limits hold calls back
+        hw_lock(&dev->dispatch_lock);
+        for (hw_subscription_t* sub = dev->subscriptions; sub; sub = sub->next) {
+            sub->pending |= changed & sub->mask;
+            if (!sub->pending || sub->removed) continue;
+            if (now < sub->next_ms) {
+                if (sub->next_ms < next) next = sub->next_ms;
+                continue;
+            }
+            uint32_t pending = sub->pending;
+            sub->pending = 0;
+            sub->next_ms = now + sub->min_interval_ms;
+            sub->fn(dev, pending, &dev->dispatch_snapshot, sub->user_data);
+        }
+        hw_subscription_t** link = &dev->subscriptions;
+        while (*link) {
+            hw_subscription_t* sub = *link;
+            if (sub->removed) {
+                *link = sub->next;
+                free(sub);
+            } else {
+                link = &sub->next;
+            }
+        }
+        hw_unlock(&dev->dispatch_lock);
+
+        hw_lock(&dev->lock);
+        now = hw_monotonic_ms();
+        if (!dev->changed && !dev->wake && !dev->stopping && next > now) {
+            hw_cond_wait_ms(&dev->changed_cond, &dev->lock, (uint32_t)(next - now));
+        }
+        hw_unlock(&dev->lock);
+    }
+    HW_THREAD_RETURN;
+}
+
+// With dev->lock held
+static bool start_dispatcher(hw_device_t* dev) {
+    if (!dev->dispatching) {
+        dev->dispatching = hw_thread_start(&dev->dispatcher, dispatch_thread, dev);
+    }
+    return dev->dispatching;
+}
+
+hw_subscription_t* hw_dev_subscribe(hw_device_t* dev, uint32_t mask, uint32_t min_interval_ms,
+                                    hw_change_fn_t fn, void* user_data) {
+    HW_STATS_SCOPE(HW_OP_SUBSCRIBE);
+    if (!dev || !fn || !(mask & HW_CHANGE_ALL)) {
+        return NULL;
+    }
+
+    hw_subscription_t* sub = calloc(1, sizeof(hw_subscription_t));
+    if (!sub) {
+        return NULL;
+    }
+    sub->device = dev;
+    sub->mask = mask & HW_CHANGE_ALL;
+    sub->min_interval_ms = min_interval_ms;
+    sub->fn = fn;
+    sub->user_data = user_data;
+    sub->pending = sub->mask;
+
+    bool on_dispatcher = dispatch_device == dev;
+    if (!on_dispatcher) hw_lock(&dev->dispatch_lock);
+    sub->next = dev->subscriptions;
+    dev->subscriptions = sub;
+
+    hw_lock(&dev->lock);
+    bool ok = start_dispatcher(dev);
+    if (ok) {
+        dev->wake = true;
+        hw_cond_signal(&dev->changed_cond);
+    } else {
+        dev->subscriptions = sub->next;
+    }
+    hw_unlock(&dev->lock);
+    if (!on_dispatcher) hw_unlock(&dev->dispatch_lock);
+
+    if (!ok) {
+        free(sub);
+        return NULL;
+    }
+    return sub;
+}
+
+void hw_unsubscribe(hw_subscription_t* sub) {
+    HW_STATS_SCOPE(HW_OP_UNSUBSCRIBE);
+    if (!sub) return;
+    hw_device_t* dev = sub->device;
+
+    // From a callback the dispatcher is mid-walk; it frees the entry after
+    if (dispatch_device == dev) {
+        sub->removed = true;
+        return;
+    }
+
+    hw_lock(&dev->dispatch_lock);
+    hw_subscription_t** link = &dev->subscriptions;
+    while (*link && *link != sub) link = &(*link)->next;
+    if (*link) *link = sub->next;
+    hw_unlock(&dev->dispatch_lock);
+    free(sub);
+}
+
+// Asynchronous commands
+static hw_token_t submit_command(hw_device_t* dev, uint8_t type, uint8_t target, uint8_t arg, float voltage,
+                                 uint32_t timeout_ms, hw_command_fn_t fn, void* user_data) {
+    HW_STATS_SCOPE(HW_OP_SUBMIT_COMMAND);
+    if (!dev) {
+        return 0;
+    }
+
+    hw_lock(&dev->lock);
+    uint32_t index = dev->free_command;
+    if (index == CMD_NONE || !start_dispatcher(dev)) {
+        hw_unlock(&dev->lock);
+        return 0;
+    }
+    command_t* c = &dev->commands[index];
+    dev->free_command = c->next;
+
+    uint64_t now = hw_monotonic_ms();
+    c->generation = c->generation + 1 ? c->generation + 1 : 1;
+    c->state = CMD_QUEUED;
+    c->type = type;
+    c->target = target;
+    c->arg = arg;
+    c->voltage = voltage;
+    c->result = HW_STATUS_OK;
+    c->due_ms = now + dev->command_latency_ms;
+    c->deadline_ms = timeout_ms ? now + timeout_ms : 0;
+    c->fn = fn;
+    c->user_data = user_data;
+
+    // Newest first, so the search ends at the first command it may not pass
+    uint32_t older = CMD_NONE;
+    hw_command_args_t args = {.type = type, .target = target, .arg = arg, .voltage = voltage};
+    if (check_command(dev, &args) == HW_STATUS_OK) {
+        for (uint32_t i = dev->queue_tail; i != CMD_NONE; i = dev->commands[i].prev) {
+            if (supersedes(c, &dev->commands[i])) {
+                older = i;
+                break;
+            }
+            if (ordered(c, &dev->commands[i])) break;
+        }
+    }
+
+    if (older != CMD_NONE) {
+        // Take its place and its send time; it completes as superseded
+        command_t* o = &dev->commands[older];
+        c->prev = o->prev;
+        c->next = o->next;
+        c->due_ms = o->due_ms;
+        if (c->prev != CMD_NONE) dev->commands[c->prev].next = index; else dev->queue_head = index;
+        if (c->next != CMD_NONE) dev->commands[c->next].prev = index; else dev->queue_tail = index;
+        o->state = CMD_CANCELLED;
+        o->result = HW_STATUS_SUPERSEDED;
+        o->next = dev->cancelled;
+        dev->cancelled = older;
+    } else {
+        c->next = CMD_NONE;
+        c->prev = dev->queue_tail;
+        if (dev->queue_tail != CMD_NONE) dev->commands[dev->queue_tail].next = index; else dev->queue_head = index;
+        dev->queue_tail = index;
+    }
+
+    dev->wake = true;
+    hw_cond_signal(&dev->changed_cond);
+    hw_token_t token = command_token(dev, index);
+    hw_unlock(&dev->lock);
+    return token;
+}
+
+hw_token_t hw_dev_set_power_module_state_async(hw_device_t* dev, uint8_t module_id, bool enable,
+                                               uint32_t timeout_ms, hw_command_fn_t fn, void* user_data) {
+    return submit_command(dev, HW_CMD_SET_POWER_MODULE, module_id, enable, 0.0f, timeout_ms, fn, user_data);
+}
+
+hw_token_t hw_dev_set_target_voltage_async(hw_device_t* dev, float voltage,
+                                           uint32_t timeout_ms, hw_command_fn_t fn, void* user_data) {
+    return submit_command(dev, HW_CMD_SET_TARGET_VOLTAGE, 0, 0, voltage, timeout_ms, fn, user_data);
+}
+
+hw_token_t hw_dev_start_battery_test_async(hw_device_t* dev, uint8_t battery_id, uint8_t test_type,
+                                           uint32_t timeout_ms, hw_command_fn_t fn, void* user_data) {
+    return submit_command(dev, HW_CMD_START_BATTERY_TEST, battery_id, test_type, 0.0f, timeout_ms, fn, user_data);
+}
+
+hw_token_t hw_dev_set_dc_circuit_state_async(hw_device_t* dev, uint8_t circuit_id, bool enable,
+                                             uint32_t timeout_ms, hw_command_fn_t fn, void* user_data) {
+    return submit_command(dev, HW_CMD_SET_DC_CIRCUIT, circuit_id, enable, 0.0f, timeout_ms, fn, user_data);
+}
+
+hw_status_t hw_dev_cancel(hw_device_t* dev, hw_token_t token) {
+    HW_STATS_SCOPE(HW_OP_CANCEL);
+    uint32_t index = (uint32_t)token;
+    if (!dev || index >= dev->max_commands) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    hw_status_t result = HW_STATUS_INVALID_PARAM;
+    hw_lock(&dev->lock);
+    command_t* c = &dev->commands[index];
+    if (c->state == CMD_QUEUED && c->generation == (uint32_t)(token >> 32)) {
+        command_unlink(dev, index);
+        c->state = CMD_CANCELLED;
+        c->result = HW_STATUS_CANCELLED;
+        c->next = dev->cancelled;
+        dev->cancelled = index;
+        dev->wake = true;
+        hw_cond_signal(&dev->changed_cond);
+        result = HW_STATUS_OK;
+    }
+    hw_unlock(&dev->lock);
+    return result;
+}
+
+int hw_dev_poll_completions(hw_device_t* dev, hw_completion_t* completions, int max) {
+    HW_STATS_SCOPE(HW_OP_POLL_COMPLETIONS);
+    if (!dev || !completions || max <= 0) {
+        return 0;
+    }
+
+    int count = 0;
+    hw_lock(&dev->lock);
+    while (count < max && dev->completion_count > 0) {
+        uint32_t index = dev->completions[dev->completion_head];
+        dev->completion_head = (dev->completion_head + 1) % dev->max_commands;
+        dev->completion_count--;
+
+        command_t* c = &dev->commands[index];
+        completions[count].token = command_token(dev, index);
+        completions[count].result = c->result;
+        completions[count].user_data = c->user_data;
+        command_free(dev, index);
+        count++;
+    }
+#ifdef __linux__
+    uint64_t pending;
+    if (dev->completion_count == 0 && dev->command_fd >= 0 &&
+        read(dev->command_fd, &pending, sizeof(pending)) < 0) {
+        // Already drained
+    }
+#endif
+    hw_unlock(&dev->lock);
+    return count;
+}
+
+int hw_dev_command_fd(hw_device_t* dev) {
+    return dev ? dev->command_fd : -1;
+}
+
+// Power module functions
+hw_status_t hw_dev_get_power_modules(hw_device_t* dev, power_module_t* modules, uint8_t* count) {
+    HW_STATS_SCOPE(HW_OP_GET_POWER_MODULES);
+    if (!dev || !modules || !count) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    maybe_advance(dev);
+    uint8_t n = dev->buffers[0].banks[HW_BANK_POWER_MODULES].count;
+    if (n > *count) n = *count;
+    uint64_t v;
+    do {
+        copy_power_modules(read_begin(dev, &v), modules, n);
+    } while (read_retry(dev, v));
+    *count = n;
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_set_power_module_state(hw_device_t* dev, uint8_t module_id, bool enable) {
+    HW_STATS_SCOPE(HW_OP_SET_POWER_MODULE_STATE);
+    if (!dev) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    hw_command_args_t command = {.type = HW_CMD_SET_POWER_MODULE, .target = module_id, .arg = enable};
+    return execute_one(dev, &command);
+}
+
+hw_status_t hw_dev_set_target_voltage(hw_device_t* dev, float voltage) {
+    HW_STATS_SCOPE(HW_OP_SET_TARGET_VOLTAGE);
+    if (!dev) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    hw_command_args_t command = {.type = HW_CMD_SET_TARGET_VOLTAGE, .voltage = voltage};
+    return execute_one(dev, &command);
+}
+
+// Battery functions
+hw_status_t hw_dev_get_battery_info(hw_device_t* dev, battery_info_t* batteries_out, uint8_t* count) {
+    HW_STATS_SCOPE(HW_OP_GET_BATTERY_INFO);
+    if (!dev || !batteries_out || !count) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    maybe_advance(dev);
+    uint8_t n = dev->buffers[0].banks[HW_BANK_BATTERIES].count;
+    if (n > *count) n = *count;
+    uint64_t v;
+    do {
+        copy_batteries(read_begin(dev, &v), batteries_out, n);
+    } while (read_retry(dev, v));
+    *count = n;
+    return HW_STATUS_OK;
+}
+
+static hw_status_t battery_test(hw_device_t* dev, uint8_t type, uint8_t battery_id, uint8_t test_type) {
+    if (!dev) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    hw_command_args_t command = {.type = type, .target = battery_id, .arg = test_type};
+    return execute_one(dev, &command);
+}
+
+hw_status_t hw_dev_start_battery_test(hw_device_t* dev, uint8_t battery_id, uint8_t test_type) {
+    HW_STATS_SCOPE(HW_OP_START_BATTERY_TEST);
+    return battery_test(dev, HW_CMD_START_BATTERY_TEST, battery_id, test_type);
+}
+
+hw_status_t hw_dev_stop_battery_test(hw_device_t* dev, uint8_t battery_id) {
+    HW_STATS_SCOPE(HW_OP_STOP_BATTERY_TEST);
+    return battery_test(dev, HW_CMD_STOP_BATTERY_TEST, battery_id, 0);
+}
+
+// AC input functions
+hw_status_t hw_dev_get_ac_inputs(hw_device_t* dev, ac_phase_t* phases, uint8_t* count) {
+    HW_STATS_SCOPE(HW_OP_GET_AC_INPUTS);
+    if (!dev || !phases || !count) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    maybe_advance(dev);
+    uint8_t n = dev->buffers[0].banks[HW_BANK_AC_PHASES].count;
+    if (n > *count) n = *count;
+    uint64_t v;
+    do {
+        copy_ac_phases(read_begin(dev, &v), phases, n);
+    } while (read_retry(dev, v));
+    *count = n;
+    return HW_STATUS_OK;
+}
+
+// DC output functions
+hw_status_t hw_dev_get_dc_outputs(hw_device_t* dev, dc_circuit_t* circuits, uint8_t* count) {
+    HW_STATS_SCOPE(HW_OP_GET_DC_OUTPUTS);
+    if (!dev || !circuits || !count) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    maybe_advance(dev);
+    uint8_t n = dev->buffers[0].banks[HW_BANK_DC_CIRCUITS].count;
+    if (n > *count) n = *count;
+    uint64_t v;
+    do {
+        copy_dc_circuits(dev, read_begin(dev, &v), circuits, n);
+    } while (read_retry(dev, v));
+    *count = n;
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_set_dc_circuit_state(hw_device_t* dev, uint8_t circuit_id, bool enable) {
+    HW_STATS_SCOPE(HW_OP_SET_DC_CIRCUIT_STATE);
+    if (!dev) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    hw_command_args_t command = {.type = HW_CMD_SET_DC_CIRCUIT, .target = circuit_id, .arg = enable};
+    return execute_one(dev, &command);
+}
+
+// Alarm functions
+hw_status_t hw_dev_get_active_alarms(hw_device_t* dev, alarm_t* alarms, uint8_t* count) {
+    HW_STATS_SCOPE(HW_OP_GET_ACTIVE_ALARMS);
+    if (!dev || !alarms || !count) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    // Count and list must come from the same version
+    uint8_t n;
+    uint64_t v;
+    do {
+        const state_header_t* h = read_begin(dev, &v)->header;
+        n = h->alarm_count < HW_MAX_ALARMS ? h->alarm_count : HW_MAX_ALARMS;
+        if (n > *count) n = *count;
+        memcpy(alarms, h->alarms, n * sizeof(alarm_t));
+    } while (read_retry(dev, v));
+    *count = n;
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_acknowledge_alarm(hw_device_t* dev, uint32_t alarm_id) {
+    HW_STATS_SCOPE(HW_OP_ACKNOWLEDGE_ALARM);
+    if (!dev) {
+        return HW_STATUS_ERROR;
+    }
+
+    alarm_t alarms[HW_MAX_ALARMS];
+    uint8_t count = HW_MAX_ALARMS;
+    hw_dev_get_active_alarms(dev, alarms, &count);
+    for (int i = 0; i < count; i++) {
+        if (alarms[i].alarm_id == alarm_id) {
+            hw_command_args_t command = {.type = HW_CMD_ACKNOWLEDGE_ALARM, .alarm_id = alarm_id};
+            return execute_one(dev, &command);
+        }
+    }
+
+    return HW_STATUS_INVALID_PARAM;
+}
+
+hw_status_t hw_dev_clear_alarm(hw_device_t* dev, uint32_t alarm_id) {
+    HW_STATS_SCOPE(HW_OP_CLEAR_ALARM);
+    if (!dev) {
+        return HW_STATUS_ERROR;
+    }
+
+    hw_status_t result = HW_STATUS_INVALID_PARAM;
+    hw_lock(&dev->lock);
+    const state_header_t* cur = current(dev)->header;
+    for (int i = 0; i < cur->alarm_count; i++) {
+        if (cur->alarms[i].alarm_id == alarm_id) {
+            // Remove alarm from active list
+            state_t* s = write_begin(dev);
+            state_header_t* h = s->header;
+            for (int j = i; j < h->alarm_count - 1; j++) {
+                h->alarms[j] = h->alarms[j + 1];
+            }
+            h->alarm_count--;
+            write_publish(dev, s, HW_CHANGE_ALARMS);
+            result = HW_STATUS_OK;
+            break;
+        }
+    }
+    hw_unlock(&dev->lock);
+
+    return result;
+}
+
+// System control functions
+hw_status_t hw_dev_get_system_status(hw_device_t* dev, system_status_t* status) {
+    HW_STATS_SCOPE(HW_OP_GET_SYSTEM_STATUS);
+    if (!dev || !status) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    maybe_advance(dev);
+    uint64_t v;
+    do {
+        *status = read_begin(dev, &v)->header->status;
+    } while (read_retry(dev, v));
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_set_operation_mode(hw_device_t* dev, uint8_t mode) {
+    HW_STATS_SCOPE(HW_OP_SET_OPERATION_MODE);
+    if (!dev) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    hw_command_args_t command = {.type = HW_CMD_SET_OPERATION_MODE, .arg = mode};
+    return execute_one(dev, &command);
+}
+
+hw_status_t hw_dev_system_restart(hw_device_t* dev) {
+    HW_STATS_SCOPE(HW_OP_SYSTEM_RESTART);
+    if (!dev) {
+        return HW_STATUS_ERROR;
+    }
+
+    // Simulate system restart
+    printf("System restart initiated...\n");
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_system_shutdown(hw_device_t* dev) {
+    HW_STATS_SCOPE(HW_OP_SYSTEM_SHUTDOWN);
+    if (!dev) {
+        return HW_STATUS_ERROR;
+    }
+
+    // Simulate system shutdown
+    printf("System shutdown initiated...\n");
+    return HW_STATUS_OK;
+}
+
+// Network and communication
+hw_status_t hw_dev_send_snmp_trap(hw_device_t* dev, const char* message) {
+    HW_STATS_SCOPE(HW_OP_SEND_SNMP_TRAP);
+    if (!dev || !message) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    printf("SNMP Trap sent: %s\n", message);
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_test_network_connection(hw_device_t* dev) {
+    HW_STATS_SCOPE(HW_OP_TEST_NETWORK);
+    if (!dev) {
+        return HW_STATUS_ERROR;
+    }
+
+    // Simulate network test
+    return (noise_rand(dev) % 10 > 1) ? HW_STATUS_OK : HW_STATUS_TIMEOUT;
+}
+
+// GPS and location
+hw_status_t hw_dev_get_gps_coordinates(hw_device_t* dev, float* latitude, float* longitude, float* altitude) {
+    HW_STATS_SCOPE(HW_OP_GET_GPS);
+    if (!dev || !latitude || !longitude || !altitude) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    *latitude = 39.9334f + (noise_rand(dev) % 100) * 0.0001f;
+    *longitude = 32.8597f + (noise_rand(dev) % 100) * 0.0001f;
+    *altitude = 850.0f + (noise_rand(dev) % 100) * 0.1f;
+
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_get_system_time(hw_device_t* dev, uint32_t* timestamp) {
+    HW_STATS_SCOPE(HW_OP_GET_SYSTEM_TIME);
+    if (!dev || !timestamp) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    *timestamp = (uint32_t)time(NULL);
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_set_system_time(hw_device_t* dev, uint32_t timestamp) {
+    HW_STATS_SCOPE(HW_OP_SET_SYSTEM_TIME);
+    if (!dev) {
+        return HW_STATUS_ERROR;
+    }
+
+    // In real implementation, this would set system time
+    printf("System time set to: %u\n", timestamp);
+    return HW_STATUS_OK;
+}
+
+// Temperature and environmental sensors
+hw_status_t hw_dev_get_ambient_temperature(hw_device_t* dev, float* temperature) {
+    HW_STATS_SCOPE(HW_OP_GET_AMBIENT_TEMPERATURE);
+    if (!dev || !temperature) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    *temperature = 18.0f + (noise_rand(dev) % 100) * 0.1f;
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_get_humidity(hw_device_t* dev, float* humidity) {
+    HW_STATS_SCOPE(HW_OP_GET_HUMIDITY);
+    if (!dev || !humidity) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    *humidity = 60.0f + (noise_rand(dev) % 200) * 0.1f;
+    return HW_STATUS_OK;
+}
+
+hw_status_t hw_dev_get_door_status(hw_device_t* dev, bool* is_open) {
+    HW_STATS_SCOPE(HW_OP_GET_DOOR_STATUS);
+    if (!dev || !is_open) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    *is_open = false; // Door is closed
+    return HW_STATUS_OK;
+}
+
+// Logging and data storage
+hw_status_t hw_dev_log_data_point(hw_device_t* dev, const char* parameter, float value, uint32_t timestamp) {
+    HW_STATS_SCOPE(HW_OP_LOG_DATA_POINT);
+    if (!dev || !parameter) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    return tsdb_append(dev->history, parameter, timestamp, value);
+}
+
+hw_status_t hw_dev_get_historical_data(hw_device_t* dev, const char* parameter, uint32_t start_time,
+                                       uint32_t end_time, float* values, uint32_t* count) {
+    HW_STATS_SCOPE(HW_OP_GET_HISTORICAL_DATA);
+    if (!dev || !parameter || !values || !count) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    return tsdb_query(dev->history, parameter, start_time, end_time, NULL, values, count);
+}
+
+hw_status_t hw_dev_get_history_summary(hw_device_t* dev, const char* parameter, uint32_t start_time,
+                                       uint32_t end_time, hw_history_bucket_t* buckets, uint32_t* count,
+                                       uint32_t* resolution) {
+    HW_STATS_SCOPE(HW_OP_GET_HISTORY_SUMMARY);
+    if (!dev || !parameter || !buckets || !count) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    return tsdb_query_summary(dev->history, parameter, start_time, end_time, buckets, count, resolution);
+}
+
+// Default device shim
+hw_status_t hw_init(void) {
+    if (default_device) {
+        return HW_STATUS_OK;
+    }
+
+    // NETMON_HW_LINK moves programs on the default device onto a real one;
+    // NETMON_HW_HISTORY keeps its logged data points on disk
+    hw_config_t config;
+    hw_default_config(&config);
+    config.link = getenv("NETMON_HW_LINK");
+    config.history_dir = getenv("NETMON_HW_HISTORY");
+    default_device = hw_open(&config);
+    return default_device ? HW_STATUS_OK : HW_STATUS_ERROR;
+}
+
+hw_status_t hw_cleanup(void) {
+    hw_close(default_device);
+    default_device = NULL;
+    return HW_STATUS_OK;
+}
+
+hw_device_t* hw_default_device(void) {
+    return default_device;
+}
+
+hw_status_t hw_get_snapshot(hw_snapshot_t* snapshot) {
+    return hw_dev_get_snapshot(default_device, snapshot);
+}
+
+hw_status_t hw_get_changes_since(uint64_t since, hw_change_t* changes, uint32_t* count, uint64_t* version) {
+    return hw_dev_get_changes_since(default_device, since, changes, count, version);
+}
+
+hw_subscription_t* hw_subscribe(uint32_t mask, hw_change_fn_t fn, void* user_data) {
+    return hw_dev_subscribe(default_device, mask, 0, fn, user_data);
+}
+
+hw_token_t hw_set_power_module_state_async(uint8_t module_id, bool enable,
+                                           uint32_t timeout_ms, hw_command_fn_t fn, void* user_data) {
+    return hw_dev_set_power_module_state_async(default_device, module_id, enable, timeout_ms, fn, user_data);
+}
+
+hw_token_t hw_set_target_voltage_async(float voltage, uint32_t timeout_ms, hw_command_fn_t fn, void* user_data) {
+    return hw_dev_set_target_voltage_async(default_device, voltage, timeout_ms, fn, user_data);
+}
+
+hw_token_t hw_start_battery_test_async(uint8_t battery_id, uint8_t test_type,
+                                       uint32_t timeout_ms, hw_command_fn_t fn, void* user_data) {
+    return hw_dev_start_battery_test_async(default_device, battery_id, test_type, timeout_ms, fn, user_data);
+}
+
+hw_token_t hw_set_dc_circuit_state_async(uint8_t circuit_id, bool enable,
+                                         uint32_t timeout_ms, hw_command_fn_t fn, void* user_data) {
+    return hw_dev_set_dc_circuit_state_async(default_device, circuit_id, enable, timeout_ms, fn, user_data);
+}
+
+hw_status_t hw_cancel(hw_token_t token) {
+    return hw_dev_cancel(default_device, token);
+}
+
+hw_status_t hw_get_power_modules(power_module_t* modules, uint8_t* count) {
+    return hw_dev_get_power_modules(default_device, modules, count);
+}
+
+hw_status_t hw_set_power_module_state(uint8_t module_id, bool enable) {
+    return hw_dev_set_power_module_state(default_device, module_id, enable);
+}
+
+hw_status_t hw_set_target_voltage(float voltage) {
+    return hw_dev_set_target_voltage(default_device, voltage);
+}
+
+hw_status_t hw_get_battery_info(battery_info_t* batteries, uint8_t* count) {
+    return hw_dev_get_battery_info(default_device, batteries, count);
+}
+
+hw_status_t hw_start_battery_test(uint8_t battery_id, uint8_t test_type) {
+    return hw_dev_start_battery_test(default_device, battery_id, test_type);
+}
+
+hw_status_t hw_stop_battery_test(uint8_t battery_id) {
+    return hw_dev_stop_battery_test(default_device, battery_id);
+}
+
+hw_status_t hw_get_ac_inputs(ac_phase_t* phases, uint8_t* count) {
+    return hw_dev_get_ac_inputs(default_device, phases, count);
+}
+
+hw_status_t hw_get_dc_outputs(dc_circuit_t* circuits, uint8_t* count) {
+    return hw_dev_get_dc_outputs(default_device, circuits, count);
+}
+
+hw_status_t hw_set_dc_circuit_state(uint8_t circuit_id, bool enable) {
+    return hw_dev_set_dc_circuit_state(default_device, circuit_id, enable);
+}
+
+hw_status_t hw_get_active_alarms(alarm_t* alarms, uint8_t* count) {
+    return hw_dev_get_active_alarms(default_device, alarms, count);
+}
+
+hw_status_t hw_acknowledge_alarm(uint32_t alarm_id) {
+    return hw_dev_acknowledge_alarm(default_device, alarm_id);
+}
+
+hw_status_t hw_clear_alarm(uint32_t alarm_id) {
+    return hw_dev_clear_alarm(default_device, alarm_id);
+}
+
+hw_status_t hw_get_system_status(system_status_t* status) {
+    return hw_dev_get_system_status(default_device, status);
+}
+
+hw_status_t hw_set_operation_mode(uint8_t mode) {
+    return hw_dev_set_operation_mode(default_device, mode);
+}
+
+hw_status_t hw_system_restart(void) {
+    return hw_dev_system_restart(default_device);
+}
+
+hw_status_t hw_system_shutdown(void) {
+    return hw_dev_system_shutdown(default_device);
+}
+
+hw_status_t hw_send_snmp_trap(const char* message) {
+    return hw_dev_send_snmp_trap(default_device, message);
+}
+
+hw_status_t hw_test_network_connection(void) {
+    return hw_dev_test_network_connection(default_device);
+}
+
+hw_status_t hw_get_gps_coordinates(float* latitude, float* longitude, float* altitude) {
+    return hw_dev_get_gps_coordinates(default_device, latitude, longitude, altitude);
+}
+
+hw_status_t hw_get_system_time(uint32_t* timestamp) {
+    return hw_dev_get_system_time(default_device, timestamp);
+}
+
+hw_status_t hw_set_system_time(uint32_t timestamp) {
+    return hw_dev_set_system_time(default_device, timestamp);
+}
+
+hw_status_t hw_get_ambient_temperature(float* temperature) {
+    return hw_dev_get_ambient_temperature(default_device, temperature);
+}
+
+hw_status_t hw_get_humidity(float* humidity) {
+    return hw_dev_get_humidity(default_device, humidity);
+}
+
+hw_status_t hw_get_door_status(bool* is_open) {
+    return hw_dev_get_door_status(default_device, is_open);
+}
+
+hw_status_t hw_log_data_point(const char* parameter, float value, uint32_t timestamp) {
+    return hw_dev_log_data_point(default_device, parameter, value, timestamp);
+}
+
+hw_status_t hw_get_historical_data(const char* parameter, uint32_t start_time,
+                                  uint32_t end_time, float* values, uint32_t* count) {
+    return hw_dev_get_historical_data(default_device, parameter, start_time, end_time, values, count);
+}
+
+hw_status_t hw_get_history_summary(const char* parameter, uint32_t start_time, uint32_t end_time,
+                                   hw_history_bucket_t* buckets, uint32_t* count, uint32_t* resolution) {
+    return hw_dev_get_history_summary(default_device, parameter, start_time, end_time, buckets, count, resolution);
+}
@@ -1,4 +1,4 @@
-#define HARDWARE_INTERFACE_H
+#ifndef HARDWARE_INTERFACE_H
 #define HARDWARE_INTERFACE_H
 
 #ifdef __cplusplus
@@ -14,7 +14,11 @@ typedef enum {
     HW_STATUS_ERROR = -1,
     HW_STATUS_TIMEOUT = -2,
     HW_STATUS_NOT_CONNECTED = -3,
-    HW_STATUS_INVALID_PARAM = -4
+    HW_STATUS_INVALID_PARAM = -4,
+    HW_STATUS_CANCELLED = -5,
+    HW_STATUS_SUPERSEDED = -6,      // A newer command for the same setting replaced it
+    HW_STATUS_TOO_OLD = -7,         // Changes since that version are gone; take a snapshot
+    HW_STATUS_NOT_MODIFIED = 1      // Not an error: caller's copy is current
 } hw_status_t;
 
 // Power module structure
@@ -78,11 +82,331 @@ typedef struct {
     uint32_t uptime_seconds;
 } system_status_t;
 
+// Largest site a handle can model; hw_config_t picks the actual counts
+#define HW_MAX_POWER_MODULES    64
+#define HW_MAX_BATTERIES        32
+#define HW_MAX_AC_PHASES        3
+#define HW_MAX_DC_CIRCUITS      255
+#define HW_MAX_ALARMS           10
+
+// Every category in one consistent copy. version grows by one each time any
+// of the device state changes; timestamp is when that happened (Unix seconds).
+typedef struct {
+    uint64_t version;
+    uint32_t timestamp;
+    uint8_t power_module_count;
+    uint8_t battery_count;
+    uint8_t ac_phase_count;
+    uint8_t dc_circuit_count;
+    uint8_t alarm_count;
+    power_module_t power_modules[HW_MAX_POWER_MODULES];
+    battery_info_t batteries[HW_MAX_BATTERIES];
+    ac_phase_t ac_phases[HW_MAX_AC_PHASES];
+    dc_circuit_t dc_circuits[HW_MAX_DC_CIRCUITS];
+    alarm_t alarms[HW_MAX_ALARMS];
+    system_status_t status;
+} hw_snapshot_t;
+
 // Function declarations for hardware interface
 
+// Device handles
+//
+// Every device lives behind its own hw_device_t; a process may open as many
+// as it serves sites. All hw_dev_* calls are thread-safe: any number of
+// threads may call them on the same handle or on different handles at once.
+// Reads (getters and snapshots) take no lock and never block or see a
+// half-written update, however many threads read. Changes (setters and
+// simulation steps) are serialized per handle; different handles never
+// contend. The simulation advances every update_ms, on whichever call
+// notices it is due, not on every read.
+//
+// With config.link set the handle serves a real device instead: a
+// background thread reads the STM32 frame stream from "host:port" or a
+// serial device path ("/dev/ttyUSB0") and keeps the same state current, so
+// every getter still answers from memory without I/O. Setters become
+// command frames and return once written, or HW_STATUS_NOT_CONNECTED while
+// the link is down; the device's own frames then show the effect. The last
+// values stay readable while the link reconnects. hw_close() must not race other
+// calls on the handle being closed, nor be called from a subscription
+// callback.
+typedef struct hw_device hw_device_t;
+
+typedef struct {
+    uint32_t seed;           // Simulation seed; 0 picks one per handle
+    uint32_t update_ms;      // Simulation step
+    uint32_t command_latency_ms; // Simulated link round trip for async commands
+    uint32_t max_commands;   // Async commands outstanding or awaiting pickup
+    uint32_t change_log;     // Changes kept for hw_dev_get_changes_since(); 0: none
+    uint8_t power_modules;   // Site size, clamped to 1..HW_MAX_*
+    uint8_t batteries;
+    uint8_t ac_phases;
+    uint8_t dc_circuits;
+    const char* link;        // STM32 link; NULL or "" simulates
+    uint32_t link_baud;      // Serial links; 0 is 115200
+    const char* history_dir; // Logged data points; NULL or "" keeps them in memory
+} hw_config_t;
+
+void hw_default_config(hw_config_t* config);
+
+// NULL config uses the defaults. Returns NULL when out of memory. A link
+// need not be up yet; hw_open() returns at once and connects in the
+// background.
+hw_device_t* hw_open(const hw_config_t* config);
+void hw_close(hw_device_t* device);
+
+// Snapshot of the whole device. Pass back the previous snapshot: when its
+// version is still current nothing is copied and HW_STATUS_NOT_MODIFIED is
+// returned. A zeroed snapshot (version 0) is always filled in.
+hw_status_t hw_dev_get_snapshot(hw_device_t* device, hw_snapshot_t* snapshot);
+
+// Change categories, for subscriptions
+#define HW_CHANGE_POWER         0x01
+#define HW_CHANGE_BATTERY       0x02
+#define HW_CHANGE_AC            0x04
+#define HW_CHANGE_DC            0x08
+#define HW_CHANGE_ALARMS        0x10
+#define HW_CHANGE_STATUS        0x20
+#define HW_CHANGE_ALL           0x3F
+
+// Called from the device's dispatch thread. changed holds every subscribed
+// category that changed since this subscription's previous call; snapshot
+// is the state after those changes and is only valid during the call.
+typedef void (*hw_change_fn_t)(hw_device_t* device, uint32_t changed,
+                               const hw_snapshot_t* snapshot, void* user_data);
+
+typedef struct hw_subscription hw_subscription_t;
+
+// Push notifications. The first subscription on a device starts its dispatch
+// thread, which from then on also advances the simulation on time.
+// Changes that land while a callback runs, or within min_interval_ms of the
+// previous call (0: no limit), are coalesced into one call. Each new
+// subscription first gets one call with its whole mask. Callbacks may call
+// any hw_dev_* function, including hw_unsubscribe() on their own
+// subscription; elsewhere hw_unsubscribe() returns once no call is in flight.
+// hw_close() releases whatever subscriptions are left on the device.
+hw_subscription_t* hw_dev_subscribe(hw_device_t* device, uint32_t mask, uint32_t min_interval_ms,
+                                    hw_change_fn_t fn, void* user_data);
+void hw_unsubscribe(hw_subscription_t* subscription);
+
+// Asynchronous commands
+//
+// Each *_async call queues the command and returns a token at once, or 0
+// when max_commands are outstanding. The device's answer arrives on the
+// dispatch thread: through fn when one is given, otherwise as an
+// hw_completion_t collected with hw_dev_poll_completions(), with
+// hw_dev_command_fd() becoming readable. Commands are pipelined, so one
+// thread can keep hundreds in flight. A command not answered within
+// timeout_ms (0: no limit) completes with HW_STATUS_TIMEOUT; one cancelled
+// before it is sent completes with HW_STATUS_CANCELLED. hw_close() drops
+// whatever is still outstanding.
+//
+// Setpoints coalesce while queued: a new command for the same power
+// module, DC circuit or the target voltage takes the place, and the send
+// time, of the one still waiting, which completes with
+// HW_STATUS_SUPERSEDED. Commands whose order matters are never merged
+// across: module states and the target voltage (which only reaches active
+// modules) keep their relative order, and a battery test is a barrier for
+// everything. Commands that fall due together reach the backend as one
+// batch, one state version or one batch frame.
+typedef uint64_t hw_token_t;
+
+typedef void (*hw_command_fn_t)(hw_device_t* device, hw_token_t token, hw_status_t result, void* user_data);
+
+typedef struct {
+    hw_token_t token;
+    hw_status_t result;
+    void* user_data;
+} hw_completion_t;
+
+hw_token_t hw_dev_set_power_module_state_async(hw_device_t* device, uint8_t module_id, bool enable,
+                                               uint32_t timeout_ms, hw_command_fn_t fn, void* user_data);
+hw_token_t hw_dev_set_target_voltage_async(hw_device_t* device, float voltage,
+                                           uint32_t timeout_ms, hw_command_fn_t fn, void* user_data);
+hw_token_t hw_dev_start_battery_test_async(hw_device_t* device, uint8_t battery_id, uint8_t test_type,
+                                           uint32_t timeout_ms, hw_command_fn_t fn, void* user_data);
+hw_token_t hw_dev_set_dc_circuit_state_async(hw_device_t* device, uint8_t circuit_id, bool enable,
+                                             uint32_t timeout_ms, hw_command_fn_t fn, void* user_data);
+
+// HW_STATUS_INVALID_PARAM when the command was already sent or completed
+hw_status_t hw_dev_cancel(hw_device_t* device, hw_token_t token);
+
+// Copies out up to max completions of fn-less commands; returns how many
+int hw_dev_poll_completions(hw_device_t* device, hw_completion_t* completions, int max);
+
+// Readable while completions wait to be polled; -1 where eventfd is missing
+int hw_dev_command_fd(hw_device_t* device);
+
+// Bulk access by measurement
+//
+// Each bank keeps one contiguous array per measurement, so reading one
+// field across a whole site, or finding the units whose field lies in a
+// range, scans only that field instead of every unit's full record. Units
+// are named by their 1-based id, as in the setters.
+typedef enum {
+    HW_BANK_POWER_MODULES,
+    HW_BANK_BATTERIES,
+    HW_BANK_AC_PHASES,
+    HW_BANK_DC_CIRCUITS
+} hw_bank_t;
+
+typedef enum {
+    HW_FIELD_VOLTAGE,
+    HW_FIELD_CURRENT,
+    HW_FIELD_POWER,          // Power modules, AC phases, DC circuits
+    HW_FIELD_TEMPERATURE,    // Power modules, batteries
+    HW_FIELD_FREQUENCY,      // AC phases
+    // Change feed only, as 0/1 or the plain number
+    HW_FIELD_ACTIVE,         // is_active, is_normal, is_enabled
+    HW_FIELD_FAULT,
+    HW_FIELD_CHARGING,
+    HW_FIELD_TEST,
+    HW_FIELD_CAPACITY,
+    HW_FIELD_MAINS,          // HW_RECORD_SYSTEM: system_status_t
+    HW_FIELD_BATTERY_BACKUP,
+    HW_FIELD_GENERATOR,
+    HW_FIELD_OPERATION_MODE,
+    HW_FIELD_SYSTEM_LOAD,
+    HW_FIELD_UPTIME,
+    HW_FIELD_ALARMS          // HW_RECORD_SYSTEM: the alarm list changed; value is the count
+} hw_field_t;
+
+// Units in the bank, fixed for the life of the handle; 0 for a bad bank
+uint8_t hw_dev_unit_count(hw_device_t* device, hw_bank_t bank);
+
+// Copies field of units first_id .. first_id + count - 1, all from one version
+hw_status_t hw_dev_read_field(hw_device_t* device, hw_bank_t bank, hw_field_t field,
+                              uint8_t first_id, uint8_t count, float* values);
+
+// Ids of the units whose field lies within [min, max], ascending and from
+// one version. Writes up to capacity ids and returns how many matched, or
+// -1 when the bank has no such field. Modules over 55 °C:
+//   hw_dev_find_units(dev, HW_BANK_POWER_MODULES, HW_FIELD_TEMPERATURE, 55.0f, INFINITY, ids, 64)
+int hw_dev_find_units(hw_device_t* device, hw_bank_t bank, hw_field_t field, float min, float max,
+                      uint8_t* ids, int capacity);
+
+// Change feed
+//
+// Each handle keeps its last config.change_log changes (default 4096): one
+// entry per field whose value a version changed. A client that holds
+// version v, from a snapshot or an earlier call, asks for what happened
+// since and applies a handful of entries instead of fetching everything.
+// Reading takes no lock.
+#define HW_RECORD_SYSTEM    4        // After the banks: status and alarms, unit 0
+
+typedef struct {
+    uint64_t version;        // Version the change was published in
+    uint8_t record;          // hw_bank_t or HW_RECORD_SYSTEM
+    uint8_t unit_id;         // 1-based; 0 for HW_RECORD_SYSTEM
+    uint8_t field;           // hw_field_t
+    float value;             // New value
+} hw_change_t;
+
+// On input *count is how many entries changes holds. Fills in the changes
+// after since, oldest first and whole versions only, and sets *version to
+// the version the caller is then current at; call again with it while
+// *version is behind. HW_STATUS_NOT_MODIFIED when since is current.
+// HW_STATUS_TOO_OLD when changes after since were dropped, since is 0 or
+// unknown, or one version alone does not fit: take a snapshot instead.
+hw_status_t hw_dev_get_changes_since(hw_device_t* device, uint64_t since, hw_change_t* changes,
+                                     uint32_t* count, uint64_t* version);
+
+// Category getters: on input *count is how many entries the array holds,
+// on output how many were filled in
+//
+// Power module functions
+hw_status_t hw_dev_get_power_modules(hw_device_t* device, power_module_t* modules, uint8_t* count);
+hw_status_t hw_dev_set_power_module_state(hw_device_t* device, uint8_t module_id, bool enable);
+hw_status_t hw_dev_set_target_voltage(hw_device_t* device, float voltage);
+
+// Battery functions
+hw_status_t hw_dev_get_battery_info(hw_device_t* device, battery_info_t* batteries, uint8_t* count);
+hw_status_t hw_dev_start_battery_test(hw_device_t* device, uint8_t battery_id, uint8_t test_type);
+hw_status_t hw_dev_stop_battery_test(hw_device_t* device, uint8_t battery_id);
+
+// AC input functions
+hw_status_t hw_dev_get_ac_inputs(hw_device_t* device, ac_phase_t* phases, uint8_t* count);
+
+// DC output functions
+hw_status_t hw_dev_get_dc_outputs(hw_device_t* device, dc_circuit_t* circuits, uint8_t* count);
+hw_status_t hw_dev_set_dc_circuit_state(hw_device_t* device, uint8_t circuit_id, bool enable);
+
+// Alarm functions
+hw_status_t hw_dev_get_active_alarms(hw_device_t* device, alarm_t* alarms, uint8_t* count);
+hw_status_t hw_dev_acknowledge_alarm(hw_device_t* device, uint32_t alarm_id);
+hw_status_t hw_dev_clear_alarm(hw_device_t* device, uint32_t alarm_id);
+
+// System control functions
+hw_status_t hw_dev_get_system_status(hw_device_t* device, system_status_t* status);
+hw_status_t hw_dev_set_operation_mode(hw_device_t* device, uint8_t mode);
+hw_status_t hw_dev_system_restart(hw_device_t* device);
+hw_status_t hw_dev_system_shutdown(hw_device_t* device);
+
+// Network and communication
+hw_status_t hw_dev_send_snmp_trap(hw_device_t* device, const char* message);
+hw_status_t hw_dev_test_network_connection(hw_device_t* device);
+
+// GPS and location
+hw_status_t hw_dev_get_gps_coordinates(hw_device_t* device, float* latitude, float* longitude, float* altitude);
+hw_status_t hw_dev_get_system_time(hw_device_t* device, uint32_t* timestamp);
+hw_status_t hw_dev_set_system_time(hw_device_t* device, uint32_t timestamp);
+
+// Temperature and environmental sensors
+hw_status_t hw_dev_get_ambient_temperature(hw_device_t* device, float* temperature);
+hw_status_t hw_dev_get_humidity(hw_device_t* device, float* humidity);
+hw_status_t hw_dev_get_door_status(hw_device_t* device, bool* is_open);
+
+// One bucket of a history summary
+typedef struct {
+    uint32_t start;          // Unix seconds
+    uint32_t count;          // Points summarized
+    float min;
+    float max;
+    float first;
+    float last;
+    double sum;
+} hw_history_bucket_t;
+
+// Logging and data storage. Points go to a time-series store per handle
+// (tsdb.h), one series per parameter, with timestamps that must not go
+// backwards. A history read returns the points in [start_time, end_time],
+// oldest first, up to *count of them. A summary covers the whole range in
+// at most *count buckets of *resolution seconds, read from pre-computed
+// rollups where the range is long, for charts.
+hw_status_t hw_dev_log_data_point(hw_device_t* device, const char* parameter, float value, uint32_t timestamp);
+hw_status_t hw_dev_get_historical_data(hw_device_t* device, const char* parameter, uint32_t start_time,
+                                       uint32_t end_time, float* values, uint32_t* count);
+hw_status_t hw_dev_get_history_summary(hw_device_t* device, const char* parameter, uint32_t start_time,
+                                       uint32_t end_time, hw_history_bucket_t* buckets, uint32_t* count,
+                                       uint32_t* resolution);
+
+// Default device
+//
+// The functions below act on one process-wide device opened by hw_init()
+// and closed by hw_cleanup(); each forwards to its hw_dev_* counterpart.
+// Between those two calls they are as thread-safe as the hw_dev_* calls;
+// hw_init() and hw_cleanup() themselves must not race any other call.
+// hw_init() simulates unless NETMON_HW_LINK names a link, so programs
+// written against these calls move onto a real device unchanged.
+
 // Initialization and cleanup
 hw_status_t hw_init(void);
 hw_status_t hw_cleanup(void);
+hw_device_t* hw_default_device(void);
+
+// Snapshot, change feed and subscriptions
+hw_status_t hw_get_snapshot(hw_snapshot_t* snapshot);
+hw_status_t hw_get_changes_since(uint64_t since, hw_change_t* changes, uint32_t* count, uint64_t* version);
+hw_subscription_t* hw_subscribe(uint32_t mask, hw_change_fn_t fn, void* user_data);
+
+// Asynchronous commands
+hw_token_t hw_set_power_module_state_async(uint8_t module_id, bool enable,
+                                           uint32_t timeout_ms, hw_command_fn_t fn, void* user_data);
+hw_token_t hw_set_target_voltage_async(float voltage, uint32_t timeout_ms, hw_command_fn_t fn, void* user_data);
+hw_token_t hw_start_battery_test_async(uint8_t battery_id, uint8_t test_type,
+                                       uint32_t timeout_ms, hw_command_fn_t fn, void* user_data);
+hw_token_t hw_set_dc_circuit_state_async(uint8_t circuit_id, bool enable,
+                                         uint32_t timeout_ms, hw_command_fn_t fn, void* user_data);
+hw_status_t hw_cancel(hw_token_t token);
 
 // Power module functions
 hw_status_t hw_get_power_modules(power_module_t* modules, uint8_t* count);
@@ -130,6 +454,8 @@ hw_status_t hw_get_door_status(bool* is_open);
 hw_status_t hw_log_data_point(const char* parameter, float value, uint32_t timestamp);
 hw_status_t hw_get_historical_data(const char* parameter, uint32_t start_time, 
                                   uint32_t end_time, float* values, uint32_t* count);
+hw_status_t hw_get_history_summary(const char* parameter, uint32_t start_time, uint32_t end_time,
+                                   hw_history_bucket_t* buckets, uint32_t* count, uint32_t* resolution);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,511 @@
+#if !defined(_WIN32) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+#include "hardware_interface.h"
+#include "hw_backend.h"
+#include "stm32_decoder.h"
+#include "backoff.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// STM32 backend: one reader thread per handle consumes the device's frame
+// stream and folds every record into the device state, so getters answer
+// from memory exactly as they do for the simulation. Commands are written
+// as command frames by whichever thread issues them.
+
+#ifdef _WIN32
+// The link code is POSIX only; a Windows build can simulate but not link
+static void* stm32_open(hw_device_t* dev, const hw_config_t* config, state_t* s, char (*names)[32]) {
+    (void)dev;
+    (void)config;
+    (void)s;
+    (void)names;
+    fprintf(stderr, "hw: STM32 links are not supported on this platform\n");
+    return NULL;
+}
+
+static void stm32_close(hw_device_t* dev, void* data) {
+    (void)dev;
+    (void)data;
+}
+
+static void stm32_execute(hw_device_t* dev, void* data, const hw_command_args_t* commands,
+                          hw_status_t* results, int count) {
+    (void)dev;
+    (void)data;
+    (void)commands;
+    for (int i = 0; i < count; i++) {
+        results[i] = HW_STATUS_NOT_CONNECTED;
+    }
+}
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <poll.h>
+#include <termios.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define CONNECT_TIMEOUT_MS   2000
+#define RECONNECT_INITIAL_MS 100
+#define RECONNECT_MAX_MS     10000
+
+typedef struct {
+    hw_device_t* dev;
+    char address[128];       // Host, or the serial device path
+    char port[8];            // Empty for serial
+    uint32_t baud;
+
+    pthread_t reader;
+    int wake[2];             // Pipe; hw_close() interrupts waits with it
+    atomic_bool stopping;
+
+    pthread_mutex_t send_lock;
+    int fd;                  // -1 while down; written under send_lock
+
+    // Reader thread only
+    stm32_decoder_t decoder;
+    backoff_t backoff;
+    bool synced;
+    uint32_t session_id;
+    uint32_t next_sequence;  // Expected sequence of the next device frame
+    state_t* pending;        // Copy being filled from one read, or NULL
+    uint32_t changed;
+} link_t;
+
+static speed_t baud_to_speed(uint32_t baud) {
+    switch (baud) {
+        case 9600:   return B9600;
+        case 19200:  return B19200;
+        case 38400:  return B38400;
+        case 57600:  return B57600;
+        case 230400: return B230400;
+        case 460800: return B460800;
+        case 921600: return B921600;
+        default:     return B115200;
+    }
+}
+
+static int open_serial(const link_t* link) {
+    // Non-blocking so a port waiting for carrier does not hang the open
+    int fd = open(link->address, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) return -1;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, baud_to_speed(link->baud));
+        cfsetospeed(&tio, baud_to_speed(link->baud));
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+// True when woken for hw_close() rather than by fd or the timeout
+static bool wait_for(link_t* link, int fd, short events, int timeout_ms) {
+    struct pollfd fds[2] = {{link->wake[0], POLLIN, 0}, {fd, events, 0}};
+    while (poll(fds, fd >= 0 ? 2 : 1, timeout_ms) < 0 && errno == EINTR) {
+    }
+    return atomic_load(&link->stopping);
+}
+
+static int connect_tcp(link_t* link) {
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(link->address, link->port, &hints, &res) != 0 || !res) {
+        return -1;
+    }
+
+    int fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) < 0) {
+        int err = errno;
+        socklen_t len = sizeof(err);
+        if (err != EINPROGRESS || wait_for(link, fd, POLLOUT, CONNECT_TIMEOUT_MS) ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+    if (fd < 0) return -1;
+
+    // Blocking from here on; reads wait in poll() and commands are small
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_NONBLOCK);
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static bool send_all(int fd, const uint8_t* bytes, size_t length) {
+    while (length > 0) {
+        ssize_t n = send(fd, bytes, length, MSG_NOSIGNAL);
+        if (n < 0 && errno == ENOTSOCK) n = write(fd, bytes, length);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        bytes += n;
+        length -= (size_t)n;
+    }
+    return true;
+}
+
+static bool send_wire(link_t* link, const uint8_t* wire, size_t size) {
+    pthread_mutex_lock(&link->send_lock);
+    bool ok = link->fd >= 0 && size > 0 && send_all(link->fd, wire, size);
+    pthread_mutex_unlock(&link->send_lock);
+    return ok;
+}
+
+static bool send_frame(link_t* link, uint8_t type, const uint8_t* data, uint8_t length) {
+    uint8_t wire[STM32_MAX_PACKET_SIZE];
+    return send_wire(link, wire, stm32_encode_frame(type, data, length, wire));
+}
+
+// Records into the state. Ids beyond the configured site are dropped.
+static state_t* pending_state(link_t* link) {
+    if (!link->pending) link->pending = hw_state_begin(link->dev);
+    return link->pending;
+}
+
+static void set_flag(uint8_t* flags, uint8_t flag, bool on) {
+    *flags = on ? (*flags | flag) : (*flags & ~flag);
+}
+
+static void apply_power_module(link_t* link, const power_module_t* m) {
+    state_t* s = pending_state(link);
+    int i = m->module_id - 1;
+    if (i < 0 || i >= BANK(s, POWER_MODULES)->count) return;
+    FIELD(s, POWER_MODULES, VOLTAGE)[i] = m->voltage;
+    FIELD(s, POWER_MODULES, CURRENT)[i] = m->current;
+    FIELD(s, POWER_MODULES, POWER)[i] = m->power;
+    FIELD(s, POWER_MODULES, TEMPERATURE)[i] = m->temperature;
+    set_flag(&BANK(s, POWER_MODULES)->flags[i], UNIT_ON, m->is_active);
+    set_flag(&BANK(s, POWER_MODULES)->flags[i], UNIT_FAULT, m->has_fault);
+    link->changed |= HW_CHANGE_POWER;
+}
+
+static void apply_battery(link_t* link, const battery_info_t* b) {
+    state_t* s = pending_state(link);
+    int i = b->battery_id - 1;
+    if (i < 0 || i >= BANK(s, BATTERIES)->count) return;
+    FIELD(s, BATTERIES, VOLTAGE)[i] = b->voltage;
+    FIELD(s, BATTERIES, CURRENT)[i] = b->current;
+    FIELD(s, BATTERIES, TEMPERATURE)[i] = b->temperature;
+    BANK(s, BATTERIES)->capacity[i] = b->capacity_percent;
+    set_flag(&BANK(s, BATTERIES)->flags[i], UNIT_CHARGING, b->is_charging);
+    set_flag(&BANK(s, BATTERIES)->flags[i], UNIT_TEST, b->test_in_progress);
+    link->changed |= HW_CHANGE_BATTERY;
+}
+
+static void apply_ac_phase(link_t* link, const ac_phase_t* p) {
+    state_t* s = pending_state(link);
+    int i = p->phase_id - 1;
+    if (i < 0 || i >= BANK(s, AC_PHASES)->count) return;
+    FIELD(s, AC_PHASES, VOLTAGE)[i] = p->voltage;
+    FIELD(s, AC_PHASES, CURRENT)[i] = p->current;
+    FIELD(s, AC_PHASES, FREQUENCY)[i] = p->frequency;
+    FIELD(s, AC_PHASES, POWER)[i] = p->power;
+    set_flag(&BANK(s, AC_PHASES)->flags[i], UNIT_ON, p->is_normal);
+    link->changed |= HW_CHANGE_AC;
+}
+
+static void apply_dc_circuit(link_t* link, const dc_circuit_t* c) {
+    state_t* s = pending_state(link);
+    int i = c->circuit_id - 1;
+    if (i < 0 || i >= BANK(s, DC_CIRCUITS)->count) return;
+    FIELD(s, DC_CIRCUITS, VOLTAGE)[i] = c->voltage;
+    FIELD(s, DC_CIRCUITS, CURRENT)[i] = c->current;
+    FIELD(s, DC_CIRCUITS, POWER)[i] = c->power;
+    set_flag(&BANK(s, DC_CIRCUITS)->flags[i], UNIT_ON, c->is_enabled);
+    link->changed |= HW_CHANGE_DC;
+}
+
+// An active alarm is added or refreshed, an inactive one removed
+static void apply_alarm(link_t* link, const alarm_t* alarm) {
+    state_header_t* h = pending_state(link)->header;
+    int i = 0;
+    while (i < h->alarm_count && h->alarms[i].alarm_id != alarm->alarm_id) i++;
+    if (alarm->is_active) {
+        if (i == HW_MAX_ALARMS) return;
+        if (i == h->alarm_count) h->alarm_count++;
+        h->alarms[i] = *alarm;
+    } else {
+        if (i == h->alarm_count) return;
+        memmove(&h->alarms[i], &h->alarms[i + 1], (h->alarm_count - i - 1) * sizeof(alarm_t));
+        h->alarm_count--;
+    }
+    link->changed |= HW_CHANGE_ALARMS;
+}
+
+static void apply_status(link_t* link, const system_status_t* status) {
+    pending_state(link)->header->status = *status;
+    link->changed |= HW_CHANGE_STATUS;
+}
+
+// SYNC frames re-anchor sequence tracking; every other frame advances it
+static void on_frame(const stm32_frame_t* frame, void* user_data) {
+    link_t* link = user_data;
+    union {
+        power_module_t module;
+        battery_info_t battery;
+        ac_phase_t phase;
+        dc_circuit_t circuit;
+        alarm_t alarm;
+        system_status_t status;
+        stm32_sync_t sync;
+    } record;
+
+    if (frame->type == PACKET_TYPE_SYNC) {
+        if (stm32_decode_sync(frame, &record.sync)) {
+            link->synced = true;
+            link->session_id = record.sync.session_id;
+            link->next_sequence = record.sync.next_sequence;
+        }
+        return;
+    }
+    if (link->synced) link->next_sequence++;
+
+    switch (frame->type) {
+    case PACKET_TYPE_POWER_MODULE:
+        if (stm32_decode_power_module(frame, &record.module)) apply_power_module(link, &record.module);
+        break;
+    case PACKET_TYPE_BATTERY:
+        if (stm32_decode_battery(frame, &record.battery)) apply_battery(link, &record.battery);
+        break;
+    case PACKET_TYPE_AC_INPUT:
+        if (stm32_decode_ac_input(frame, &record.phase)) apply_ac_phase(link, &record.phase);
+        break;
+    case PACKET_TYPE_DC_OUTPUT:
+        if (stm32_decode_dc_output(frame, &record.circuit)) apply_dc_circuit(link, &record.circuit);
+        break;
+    case PACKET_TYPE_ALARM:
+        if (stm32_decode_alarm(frame, &record.alarm)) apply_alarm(link, &record.alarm);
+        break;
+    case PACKET_TYPE_SYSTEM_STATUS:
+        if (stm32_decode_system_status(frame, &record.status)) apply_status(link, &record.status);
+        break;
+    }
+}
+
+// Picks up where the last connection left off, or asks for a keyframe
+static bool send_resume(link_t* link) {
+    stm32_resume_t resume;
+    resume.session_id = link->synced ? link->session_id : 0;
+    resume.last_sequence = link->next_sequence - 1;
+    resume.flags = link->synced ? 0 : STM32_RESUME_FLAG_KEYFRAME;
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    return send_frame(link, PACKET_TYPE_RESUME, data, stm32_encode_resume(&resume, data));
+}
+
+// Reads until the link drops or hw_close() asks to stop. One state version
+// per read, however many frames it held.
+static void serve(link_t* link, int fd) {
+    uint8_t buffer[1024];
+    while (!wait_for(link, fd, POLLIN, -1)) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) return;
+
+        link->changed = 0;
+        stm32_decoder_feed(&link->decoder, buffer, (size_t)n, on_frame, link);
+        if (link->pending) {
+            hw_state_publish(link->dev, link->pending, link->changed);
+            link->pending = NULL;
+        }
+    }
+}
+
+static void* reader_thread(void* arg) {
+    link_t* link = arg;
+    while (!atomic_load(&link->stopping)) {
+        int fd = link->port[0] ? connect_tcp(link) : open_serial(link);
+        if (fd >= 0) {
+            stm32_decoder_reset(&link->decoder);
+            pthread_mutex_lock(&link->send_lock);
+            link->fd = fd;
+            pthread_mutex_unlock(&link->send_lock);
+            if (send_resume(link)) {
+                backoff_reset(&link->backoff);
+                serve(link, fd);
+            }
+
+            pthread_mutex_lock(&link->send_lock);
+            link->fd = -1;
+            pthread_mutex_unlock(&link->send_lock);
+            close(fd);
+        }
+        wait_for(link, -1, 0, (int)backoff_next(&link->backoff));
+    }
+    return NULL;
+}
+
+// "host:port" is TCP; anything else is a serial device path
+static bool parse_link(link_t* link, const char* spec) {
+    const char* colon = strrchr(spec, ':');
+    if (spec[0] != '/' && colon && colon != spec && colon[1]) {
+        size_t host = (size_t)(colon - spec);
+        if (host >= sizeof(link->address) || strlen(colon + 1) >= sizeof(link->port)) return false;
+        memcpy(link->address, spec, host);
+        link->address[host] = '\0';
+        strcpy(link->port, colon + 1);
+        return true;
+    }
+    if (strlen(spec) >= sizeof(link->address)) return false;
+    strcpy(link->address, spec);
+    return true;
+}
+
+static void* stm32_open(hw_device_t* dev, const hw_config_t* config, state_t* s, char (*names)[32]) {
+    link_t* link = calloc(1, sizeof(link_t));
+    if (!link) {
+        return NULL;
+    }
+    if (!parse_link(link, config->link) || pipe(link->wake) < 0) {
+        free(link);
+        return NULL;
+    }
+    link->dev = dev;
+    link->baud = config->link_baud;
+    link->fd = -1;
+    atomic_init(&link->stopping, false);
+    pthread_mutex_init(&link->send_lock, NULL);
+    stm32_decoder_init(&link->decoder);
+    backoff_init(&link->backoff, RECONNECT_INITIAL_MS, RECONNECT_MAX_MS, (uint32_t)(uintptr_t)link);
+
+    // Nothing is known until the device reports; units start off
+    for (int i = 0; i < BANK(s, DC_CIRCUITS)->count; i++) {
+        snprintf(names[i], sizeof(names[i]), "Circuit %d", i + 1);
+    }
+
+    if (pthread_create(&link->reader, NULL, reader_thread, link) != 0) {
+        close(link->wake[0]);
+        close(link->wake[1]);
+        pthread_mutex_destroy(&link->send_lock);
+        free(link);
+        return NULL;
+    }
+    return link;
+}
+
+static void stm32_close(hw_device_t* dev, void* data) {
+    (void)dev;
+    link_t* link = data;
+    atomic_store(&link->stopping, true);
+    if (write(link->wake[1], "x", 1) < 0) {
+        // The pipe is empty and ours; the write cannot fail
+    }
+    pthread_join(link->reader, NULL);
+    close(link->wake[0]);
+    close(link->wake[1]);
+    pthread_mutex_destroy(&link->send_lock);
+    free(link);
+}
+
+static bool to_stm32(const hw_command_args_t* command, stm32_command_t* out) {
+    stm32_command_t cmd = {0};
+    bool enable = command->arg != 0;
+
+    switch (command->type) {
+    case HW_CMD_SET_POWER_MODULE:
+        cmd.command_id = STM32_CMD_POWER_MODULE;
+        cmd.target_id = command->target;
+        cmd.action = enable ? STM32_CMD_ACTION_START : STM32_CMD_ACTION_STOP;
+        break;
+    case HW_CMD_SET_TARGET_VOLTAGE:
+        cmd.command_id = STM32_CMD_POWER_MODULE;
+        cmd.action = STM32_CMD_ACTION_SET;
+        cmd.reserved = (uint32_t)(command->voltage * 1000.0f + 0.5f);
+        break;
+    case HW_CMD_START_BATTERY_TEST:
+    case HW_CMD_STOP_BATTERY_TEST:
+        cmd.command_id = STM32_CMD_BATTERY;
+        cmd.target_id = command->target;
+        cmd.action = command->type == HW_CMD_START_BATTERY_TEST ? STM32_CMD_ACTION_START : STM32_CMD_ACTION_STOP;
+        cmd.parameter = command->arg;
+        break;
+    case HW_CMD_SET_DC_CIRCUIT:
+        cmd.command_id = STM32_CMD_DC_CIRCUIT;
+        cmd.target_id = command->target;
+        cmd.action = enable ? STM32_CMD_ACTION_START : STM32_CMD_ACTION_STOP;
+        break;
+    case HW_CMD_SET_OPERATION_MODE:
+        cmd.command_id = STM32_CMD_SYSTEM;
+        cmd.action = STM32_CMD_ACTION_SET;
+        cmd.parameter = command->arg;
+        break;
+    case HW_CMD_ACKNOWLEDGE_ALARM:
+        cmd.command_id = STM32_CMD_ALARM;
+        cmd.target_id = (uint8_t)command->alarm_id;
+        cmd.action = STM32_CMD_ACTION_SET;
+        cmd.reserved = command->alarm_id;
+        break;
+    default:
+        return false;
+    }
+    *out = cmd;
+    return true;
+}
+
+// A lone command goes as a COMMAND frame; more are packed into batch frames
+// and written with one send
+static void stm32_execute(hw_device_t* dev, void* data, const hw_command_args_t* commands,
+                          hw_status_t* results, int count) {
+    (void)dev;
+    link_t* link = data;
+    stm32_command_t cmds[STM32_MAX_BATCH_COMMANDS];
+    uint8_t payload[STM32_MAX_FRAME_DATA];
+    uint8_t wire[8 * STM32_MAX_PACKET_SIZE];
+    int first = 0;
+
+    while (first < count) {
+        size_t size = 0;
+        int end = first;
+        int sent = 0;
+        while (end < count && size + STM32_MAX_PACKET_SIZE <= sizeof(wire)) {
+            uint8_t n = 0;
+            while (end < count && n < STM32_MAX_BATCH_COMMANDS) {
+                if (to_stm32(&commands[end], &cmds[n])) {
+                    results[end] = HW_STATUS_OK;
+                    n++;
+                    sent++;
+                } else {
+                    results[end] = HW_STATUS_INVALID_PARAM;
+                }
+                end++;
+            }
+            if (n == 1) {
+                size += stm32_encode_frame(PACKET_TYPE_COMMAND, payload, stm32_encode_command(&cmds[0], payload),
+                                           wire + size);
+            } else if (n > 1) {
+                size += stm32_encode_frame(PACKET_TYPE_COMMAND_BATCH, payload,
+                                           stm32_encode_command_batch(cmds, n, payload), wire + size);
+            }
+        }
+        if (sent > 0 && !send_wire(link, wire, size)) {
+            for (int i = first; i < end; i++) {
+                if (results[i] == HW_STATUS_OK) results[i] = HW_STATUS_NOT_CONNECTED;
+            }
+        }
+        first = end;
+    }
+}
+#endif
+
+const hw_backend_t hw_stm32_backend = {
+    .name = "stm32",
+    .open = stm32_open,
+    .close = stm32_close,
+    .step = NULL,
+    .execute = stm32_execute,
+};
@@ -0,0 +1,110 @@
+#ifndef HW_BACKEND_H
+#define HW_BACKEND_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware_interface.h"
+
+// Internal to libnetmon_hw: what a backend sees of a device.
+//
+// hardware_core.c owns the handle, the published state, readers,
+// subscriptions and the command queue. A backend decides where the state
+// comes from and what a command does: hardware_sim.c makes values up,
+// hardware_stm32.c decodes them off an STM32 link.
+
+#define BANK_COUNT      4
+#define FIELD_COUNT     5
+
+// Unit flags
+#define UNIT_ON         0x01     // Module active, phase normal, circuit enabled
+#define UNIT_FAULT      0x02
+#define UNIT_CHARGING   0x04
+#define UNIT_TEST       0x08     // Battery test in progress
+
+// Everything in a version that is not per unit
+typedef struct {
+    uint64_t version;
+    uint32_t timestamp;
+    uint8_t alarm_count;
+    alarm_t alarms[HW_MAX_ALARMS];
+    system_status_t status;
+} state_header_t;
+
+// One kind of unit as a structure of arrays: a contiguous array per
+// measurement, indexed by id - 1
+typedef struct {
+    uint8_t count;
+    float* fields[FIELD_COUNT];  // Only the bank's own measurements
+    uint8_t* capacity;           // Batteries
+    uint8_t* flags;              // UNIT_*
+} bank_t;
+
+// One state buffer. The header and every array are carved out of a single
+// block, so a buffer is copied with one memcpy; the pointers and counts
+// never change after hw_open().
+typedef struct {
+    state_header_t* header;
+    bank_t banks[BANK_COUNT];
+    uint8_t* block;
+} state_t;
+
+#define BANK(s, b)          (&(s)->banks[HW_BANK_##b])
+#define FIELD(s, b, f)      ((s)->banks[HW_BANK_##b].fields[HW_FIELD_##f])
+
+// A state change a caller asked for, already range-checked by the core
+typedef enum {
+    HW_CMD_SET_POWER_MODULE,
+    HW_CMD_SET_TARGET_VOLTAGE,
+    HW_CMD_START_BATTERY_TEST,
+    HW_CMD_STOP_BATTERY_TEST,
+    HW_CMD_SET_DC_CIRCUIT,
+    HW_CMD_SET_OPERATION_MODE,
+    HW_CMD_ACKNOWLEDGE_ALARM
+} hw_command_type_t;
+
+typedef struct {
+    uint8_t type;            // hw_command_type_t
+    uint8_t target;          // Unit id
+    uint8_t arg;             // enable, test type or mode
+    float voltage;
+    uint32_t alarm_id;
+} hw_command_args_t;
+
+typedef struct {
+    const char* name;
+    // Fills the first version and the load names, and starts whatever the
+    // backend runs on. Returns the backend's own data, NULL on failure.
+    void* (*open)(hw_device_t* dev, const hw_config_t* config, state_t* first, char (*load_names)[32]);
+    // After the dispatcher has stopped; nothing calls in afterwards
+    void (*close)(hw_device_t* dev, void* data);
+    // Periodic update every update_ms, on a private copy with the write
+    // lock held; returns the HW_CHANGE_* categories it changed. NULL when
+    // the backend publishes on its own.
+    uint32_t (*step)(hw_device_t* dev, void* data, state_t* s, uint64_t now_ms);
+    // Carries out count commands in order and fills results; any thread,
+    // no lock held. The dispatcher hands over every command due at once, so
+    // a backend can apply them as one version or send them as one frame.
+    void (*execute)(hw_device_t* dev, void* data, const hw_command_args_t* commands,
+                    hw_status_t* results, int count);
+} hw_backend_t;
+
+extern const hw_backend_t hw_sim_backend;
+extern const hw_backend_t hw_stm32_backend;
+
+// Backend writes: hw_state_begin() takes the write lock and returns a
+// private copy of the published state; hw_state_publish() publishes it
+// (categories 0 drops the copy) and releases the lock.
+state_t* hw_state_begin(hw_device_t* dev);
+void hw_state_publish(hw_device_t* dev, state_t* s, uint32_t categories);
+
+uint64_t hw_monotonic_ms(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HW_BACKEND_H
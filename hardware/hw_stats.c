@@ -0,0 +1,295 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include "hw_stats.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+static SRWLOCK registry_lock = SRWLOCK_INIT;
+#define registry_acquire()  AcquireSRWLockExclusive(&registry_lock)
+#define registry_release()  ReleaseSRWLockExclusive(&registry_lock)
+#else
+#include <pthread.h>
+static pthread_mutex_t registry_lock = PTHREAD_MUTEX_INITIALIZER;
+#define registry_acquire()  pthread_mutex_lock(&registry_lock)
+#define registry_release()  pthread_mutex_unlock(&registry_lock)
+#endif
+
+// Values below 16 ticks get a bucket each; above, every power of two is
+// split into 16. Anything past 2^40 ticks lands in the last bucket.
+#define SUB_BITS        4
+#define SUB_COUNT       (1 << SUB_BITS)
+#define MAX_EXPONENT    39
+#define BUCKET_COUNT    ((MAX_EXPONENT - SUB_BITS + 2) * SUB_COUNT)
+#define CACHE_LINE      64
+// Shortest window that gives the TSC rate to well under a percent
+#define CALIBRATION_NS  5000000ull
+
+// One thread's view of one operation. Only the owning thread writes, so
+// the counters are bumped with a relaxed load and store, not a locked add;
+// hw_get_stats() reads them from other threads.
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic uint64_t calls;
+    _Atomic uint64_t max;
+    _Atomic uint32_t buckets[BUCKET_COUNT];
+} op_histogram_t;
+
+// Histograms of one thread. Blocks are never freed: when a thread exits its
+// block goes back to the pool with its counts, and the next new thread
+// carries on recording into it.
+typedef struct stats_block {
+    op_histogram_t ops[HW_OP_COUNT];
+    struct stats_block* next;
+    atomic_bool owned;
+    void* allocation;
+} stats_block_t;
+
+static _Atomic(stats_block_t*) blocks = NULL;
+static _Thread_local stats_block_t* local_block = NULL;
+static bool block_release_ready = false;
+#ifdef _WIN32
+static DWORD block_release_key;
+#else
+static pthread_key_t block_release_key;
+#endif
+
+// Ticks against wall time at the first recording, for the conversion
+static uint64_t epoch_ticks;
+static uint64_t epoch_ns;
+
+static const char* op_names[HW_OP_COUNT] = {
+    [HW_OP_OPEN] = "open",
+    [HW_OP_CLOSE] = "close",
+    [HW_OP_GET_SNAPSHOT] = "get_snapshot",
+    [HW_OP_GET_CHANGES] = "get_changes_since",
+    [HW_OP_SUBSCRIBE] = "subscribe",
+    [HW_OP_UNSUBSCRIBE] = "unsubscribe",
+    [HW_OP_SUBMIT_COMMAND] = "submit_command",
+    [HW_OP_CANCEL] = "cancel",
+    [HW_OP_POLL_COMPLETIONS] = "poll_completions",
+    [HW_OP_READ_FIELD] = "read_field",
+    [HW_OP_FIND_UNITS] = "find_units",
+    [HW_OP_GET_POWER_MODULES] = "get_power_modules",
+    [HW_OP_SET_POWER_MODULE_STATE] = "set_power_module_state",
+    [HW_OP_SET_TARGET_VOLTAGE] = "set_target_voltage",
+    [HW_OP_GET_BATTERY_INFO] = "get_battery_info",
+    [HW_OP_START_BATTERY_TEST] = "start_battery_test",
+    [HW_OP_STOP_BATTERY_TEST] = "stop_battery_test",
+    [HW_OP_GET_AC_INPUTS] = "get_ac_inputs",
+    [HW_OP_GET_DC_OUTPUTS] = "get_dc_outputs",
+    [HW_OP_SET_DC_CIRCUIT_STATE] = "set_dc_circuit_state",
+    [HW_OP_GET_ACTIVE_ALARMS] = "get_active_alarms",
+    [HW_OP_ACKNOWLEDGE_ALARM] = "acknowledge_alarm",
+    [HW_OP_CLEAR_ALARM] = "clear_alarm",
+    [HW_OP_GET_SYSTEM_STATUS] = "get_system_status",
+    [HW_OP_SET_OPERATION_MODE] = "set_operation_mode",
+    [HW_OP_SYSTEM_RESTART] = "system_restart",
+    [HW_OP_SYSTEM_SHUTDOWN] = "system_shutdown",
+    [HW_OP_SEND_SNMP_TRAP] = "send_snmp_trap",
+    [HW_OP_TEST_NETWORK] = "test_network_connection",
+    [HW_OP_GET_GPS] = "get_gps_coordinates",
+    [HW_OP_GET_SYSTEM_TIME] = "get_system_time",
+    [HW_OP_SET_SYSTEM_TIME] = "set_system_time",
+    [HW_OP_GET_AMBIENT_TEMPERATURE] = "get_ambient_temperature",
+    [HW_OP_GET_HUMIDITY] = "get_humidity",
+    [HW_OP_GET_DOOR_STATUS] = "get_door_status",
+    [HW_OP_LOG_DATA_POINT] = "log_data_point",
+    [HW_OP_GET_HISTORICAL_DATA] = "get_historical_data",
+    [HW_OP_GET_HISTORY_SUMMARY] = "get_history_summary",
+    [HW_OP_DECODE_STREAM] = "decode_stream",
+    [HW_OP_DECODE_RECORD] = "decode_record",
+    [HW_OP_ALARM_EVALUATION] = "alarm_evaluation",
+};
+
+static uint64_t monotonic_ns(void) {
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)((double)count.QuadPart * 1e9 / (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+uint64_t hw_stats_now(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return monotonic_ns();
+#endif
+}
+
+static int highest_bit(uint64_t v) {
+#ifdef __GNUC__
+    return 63 - __builtin_clzll(v);
+#else
+    int bit = 0;
+    while (v >>= 1) bit++;
+    return bit;
+#endif
+}
+
+static uint32_t bucket_of(uint64_t ticks) {
+    if (ticks < SUB_COUNT) return (uint32_t)ticks;
+    int exponent = highest_bit(ticks);
+    if (exponent > MAX_EXPONENT) return BUCKET_COUNT - 1;
+    uint32_t sub = (uint32_t)(ticks >> (exponent - SUB_BITS)) & (SUB_COUNT - 1);
+    return (uint32_t)(exponent - SUB_BITS + 1) * SUB_COUNT + sub;
+}
+
+// Middle of the bucket's range
+static uint64_t bucket_value(uint32_t bucket) {
+    if (bucket < SUB_COUNT) return bucket;
+    int exponent = (int)(bucket / SUB_COUNT) + SUB_BITS - 1;
+    uint64_t width = 1ull << (exponent - SUB_BITS);
+    return ((uint64_t)(SUB_COUNT + bucket % SUB_COUNT) << (exponent - SUB_BITS)) + width / 2;
+}
+
+static void release_block(void* block) {
+    if (block) atomic_store_explicit(&((stats_block_t*)block)->owned, false, memory_order_release);
+}
+
+#ifdef _WIN32
+static void WINAPI release_block_fls(void* block) {
+    release_block(block);
+}
+#endif
+
+// First recording on a thread: adopt an exited thread's block, or add one
+static stats_block_t* claim_block(void) {
+    registry_acquire();
+    if (!block_release_ready) {
+        epoch_ticks = hw_stats_now();
+        epoch_ns = monotonic_ns();
+#ifdef _WIN32
+        block_release_key = FlsAlloc(release_block_fls);
+        block_release_ready = block_release_key != FLS_OUT_OF_INDEXES;
+#else
+        block_release_ready = pthread_key_create(&block_release_key, release_block) == 0;
+#endif
+    }
+
+    stats_block_t* block = atomic_load_explicit(&blocks, memory_order_relaxed);
+    while (block && atomic_load_explicit(&block->owned, memory_order_acquire)) block = block->next;
+    if (block) {
+        atomic_store_explicit(&block->owned, true, memory_order_relaxed);
+    } else {
+        void* allocation = calloc(1, sizeof(stats_block_t) + CACHE_LINE);
+        if (allocation) {
+            block = (stats_block_t*)(((uintptr_t)allocation + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+            block->allocation = allocation;
+            atomic_init(&block->owned, true);
+            block->next = atomic_load_explicit(&blocks, memory_order_relaxed);
+            atomic_store_explicit(&blocks, block, memory_order_release);
+        }
+    }
+    if (block && block_release_ready) {
+#ifdef _WIN32
+        FlsSetValue(block_release_key, block);
+#else
+        pthread_setspecific(block_release_key, block);
+#endif
+    }
+    registry_release();
+    return block;
+}
+
+static void bump32(_Atomic uint32_t* counter) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void hw_stats_record(hw_op_t op, uint64_t start) {
+    uint64_t ticks = hw_stats_now() - start;
+    stats_block_t* block = local_block;
+    if (!block) {
+        block = local_block = claim_block();
+        if (!block) return;
+    }
+
+    op_histogram_t* h = &block->ops[op];
+    bump32(&h->buckets[bucket_of(ticks)]);
+    atomic_store_explicit(&h->calls, atomic_load_explicit(&h->calls, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    if (ticks > atomic_load_explicit(&h->max, memory_order_relaxed)) {
+        atomic_store_explicit(&h->max, ticks, memory_order_relaxed);
+    }
+}
+
+static uint64_t percentile(const uint64_t* buckets, uint64_t total, double q, double ns_per_tick) {
+    uint64_t rank = (uint64_t)(q * (double)total);
+    if (rank >= total) rank = total - 1;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets[i];
+        if (seen > rank) return (uint64_t)((double)bucket_value(i) * ns_per_tick);
+    }
+    return 0;
+}
+
+void hw_get_stats(hw_stats_t* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+
+    stats_block_t* head = atomic_load_explicit(&blocks, memory_order_acquire);
+    if (!head) return;
+
+#if defined(__x86_64__) || defined(__i386__)
+    // The tick rate from everything since the first recording. Nothing
+    // waits for a longer window: a rate from under a few milliseconds is
+    // used as it is and flagged
+    uint64_t ticks = hw_stats_now() - epoch_ticks;
+    uint64_t ns = monotonic_ns() - epoch_ns;
+    double ns_per_tick = ticks && ns ? (double)ns / (double)ticks : 1.0;
+    stats->approximate = ns < CALIBRATION_NS;
+#else
+    double ns_per_tick = 1.0;
+#endif
+
+    static uint64_t merged[BUCKET_COUNT];
+    registry_acquire();
+    for (int op = 0; op < HW_OP_COUNT; op++) {
+        memset(merged, 0, sizeof(merged));
+        uint64_t calls = 0, max = 0;
+        for (stats_block_t* block = head; block; block = block->next) {
+            const op_histogram_t* h = &block->ops[op];
+            calls += atomic_load_explicit(&h->calls, memory_order_relaxed);
+            uint64_t block_max = atomic_load_explicit(&h->max, memory_order_relaxed);
+            if (block_max > max) max = block_max;
+            for (uint32_t i = 0; i < BUCKET_COUNT; i++) {
+                merged[i] += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+            }
+        }
+
+        // Counters are read while owners record, so the buckets may be a
+        // few calls behind or ahead of calls
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < BUCKET_COUNT; i++) total += merged[i];
+        hw_op_stats_t* out = &stats->ops[op];
+        out->calls = calls;
+        if (!total) continue;
+        // A bucket's midpoint can lie past the largest value in it
+        out->max_ns = (uint64_t)((double)max * ns_per_tick);
+        out->p50_ns = percentile(merged, total, 0.50, ns_per_tick);
+        out->p99_ns = percentile(merged, total, 0.99, ns_per_tick);
+        out->p999_ns = percentile(merged, total, 0.999, ns_per_tick);
+        if (out->p50_ns > out->max_ns) out->p50_ns = out->max_ns;
+        if (out->p99_ns > out->max_ns) out->p99_ns = out->max_ns;
+        if (out->p999_ns > out->max_ns) out->p999_ns = out->max_ns;
+    }
+    registry_release();
+}
+
+const char* hw_op_name(hw_op_t op) {
+    return (unsigned)op < HW_OP_COUNT ? op_names[op] : "unknown";
+}
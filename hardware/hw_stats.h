@@ -0,0 +1,110 @@
+#ifndef HW_STATS_H
+#define HW_STATS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Call latency histograms for the hardware interface and the decoder.
+//
+// Every hw_dev_* entry point (and so every hw_* shim) and the decoder
+// record how long each call took. Each thread records into its own
+// histograms, one cache line apart from every other thread's, with plain
+// stores and no lock; hw_get_stats() merges them. Buckets are log-linear,
+// 16 per power of two, so a percentile is within about 6% of the true
+// value. Build with -DHW_NO_STATS to compile the recording out.
+
+typedef enum {
+    HW_OP_OPEN,
+    HW_OP_CLOSE,
+    HW_OP_GET_SNAPSHOT,
+    HW_OP_GET_CHANGES,
+    HW_OP_SUBSCRIBE,
+    HW_OP_UNSUBSCRIBE,
+    HW_OP_SUBMIT_COMMAND,        // Every *_async call
+    HW_OP_CANCEL,
+    HW_OP_POLL_COMPLETIONS,
+    HW_OP_READ_FIELD,
+    HW_OP_FIND_UNITS,
+    HW_OP_GET_POWER_MODULES,
+    HW_OP_SET_POWER_MODULE_STATE,
+    HW_OP_SET_TARGET_VOLTAGE,
+    HW_OP_GET_BATTERY_INFO,
+    HW_OP_START_BATTERY_TEST,
+    HW_OP_STOP_BATTERY_TEST,
+    HW_OP_GET_AC_INPUTS,
+    HW_OP_GET_DC_OUTPUTS,
+    HW_OP_SET_DC_CIRCUIT_STATE,
+    HW_OP_GET_ACTIVE_ALARMS,
+    HW_OP_ACKNOWLEDGE_ALARM,
+    HW_OP_CLEAR_ALARM,
+    HW_OP_GET_SYSTEM_STATUS,
+    HW_OP_SET_OPERATION_MODE,
+    HW_OP_SYSTEM_RESTART,
+    HW_OP_SYSTEM_SHUTDOWN,
+    HW_OP_SEND_SNMP_TRAP,
+    HW_OP_TEST_NETWORK,
+    HW_OP_GET_GPS,
+    HW_OP_GET_SYSTEM_TIME,
+    HW_OP_SET_SYSTEM_TIME,
+    HW_OP_GET_AMBIENT_TEMPERATURE,
+    HW_OP_GET_HUMIDITY,
+    HW_OP_GET_DOOR_STATUS,
+    HW_OP_LOG_DATA_POINT,
+    HW_OP_GET_HISTORICAL_DATA,
+    HW_OP_GET_HISTORY_SUMMARY,
+    HW_OP_DECODE_STREAM,         // stm32_decoder_feed()
+    HW_OP_DECODE_RECORD,         // stm32_decode_*()
+    HW_OP_ALARM_EVALUATION,      // Gateway alarm model updates
+    HW_OP_COUNT
+} hw_op_t;
+
+typedef struct {
+    uint64_t calls;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    uint64_t max_ns;
+} hw_op_stats_t;
+
+typedef struct {
+    hw_op_stats_t ops[HW_OP_COUNT];
+    bool approximate;            // Ticks converted at a rate measured over
+                                 // under 5 ms since the first recording
+} hw_stats_t;
+
+// Every call recorded since the process started, by every thread, living
+// or exited
+void hw_get_stats(hw_stats_t* stats);
+const char* hw_op_name(hw_op_t op);
+
+// Recording. hw_stats_now() is a raw tick count (the TSC on x86);
+// hw_get_stats() converts to nanoseconds.
+uint64_t hw_stats_now(void);
+void hw_stats_record(hw_op_t op, uint64_t start);
+
+// Times the rest of the enclosing block, whichever way it is left
+#if defined(__GNUC__) && !defined(HW_NO_STATS)
+typedef struct {
+    hw_op_t op;
+    uint64_t start;
+} hw_stats_scope_t;
+
+static inline void hw_stats_scope_end(hw_stats_scope_t* scope) {
+    hw_stats_record(scope->op, scope->start);
+}
+
+#define HW_STATS_SCOPE(op) \
+    hw_stats_scope_t hw_stats_scope_ __attribute__((cleanup(hw_stats_scope_end))) = {(op), hw_stats_now()}
+#else
+#define HW_STATS_SCOPE(op) ((void)0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // HW_STATS_H
@@ -0,0 +1,316 @@
+// hardware/netmon_gateway.c
+// Multi-device gateway daemon: holds links to N STM32 controllers (TCP and
+// serial), shards them across event-loop threads and publishes one merged,
+// device-tagged frame stream to downstream consumers.
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include "gateway.h"
+#include "gateway_stream.h"
+#include "gateway_http.h"
+#include "gateway_multicast.h"
+#include "gateway_uplink.h"
+
+static volatile sig_atomic_t keep_running = 1;
+static volatile sig_atomic_t reload_thresholds = 0;
+
+static void signal_handler(int sig) {
+    (void)sig;
+    keep_running = 0;
+}
+
+static void reload_handler(int sig) {
+    (void)sig;
+    reload_thresholds = 1;
+}
+
+static void print_usage(const char* program) {
+    printf("Usage: %s -c <devices.conf> [options]\n", program);
+    printf("  -c <file>   Device list (one '<id> tcp <host> <port>' or '<id> serial <path> <baud>' per line)\n");
+    printf("  -t <n>      Event-loop threads (default 4)\n");
+    printf("  -P <n>      Devices connecting at once, 0 = unlimited (default 64)\n");
+    printf("  -S <file>   Warm-start snapshot, loaded at start and saved every minute and on exit\n");
+    printf("  -T <file>   Device thresholds pushed to every device, reloaded on SIGHUP\n");
+    printf("  -p <port>   Merged output stream port (default 9100)\n");
+    printf("  -r <ms>     Longest reconnect delay (default 2000)\n");
+    printf("  -b <ms>     First reconnect delay; doubles with jitter up to -r (default 50)\n");
+    printf("  -F <ms>     Sampling period for watched or alarming devices (default 100)\n");
+    printf("  -B <ms>     Background sampling period, 0 leaves device rates alone (default 10000)\n");
+    printf("  -s <sec>    Statistics interval, 0 to disable (default 10)\n");
+    printf("  -d <dir>    Spool frames to disk while no consumer is connected\n");
+    printf("  -R <fps>    Spool catch-up rate in frames/sec, 0 = unlimited (default 5000)\n");
+    printf("  -M <MB>     Spool disk budget, oldest segments dropped first (default 256)\n");
+    printf("  -w <port>   Serve HTTP snapshots and WebSocket updates to browsers (default off)\n");
+    printf("  -m <addr>   Also publish to a UDP multicast group, e.g. 239.255.0.1:9200 (default off)\n");
+    printf("  -I <addr>   Local interface address for multicast (default route)\n");
+    printf("  -u <addr>   Forward every device over one multiplexed uplink, e.g. central:9300 (default off)\n");
+}
+
+int main(int argc, char* argv[]) {
+    const char* device_file = NULL;
+    unsigned output_port = 9100;
+    unsigned stats_interval = 10;
+    const char* spool_dir = NULL;
+    unsigned spool_rate = 5000;
+    unsigned spool_mb = 256;
+    int http_port = -1;
+    const char* multicast = NULL;
+    const char* multicast_iface = NULL;
+    const char* uplink_addr = NULL;
+    const char* snapshot = NULL;
+    const char* threshold_file = NULL;
+    gw_config_t config;
+    gateway_default_config(&config);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:t:P:S:T:p:r:b:F:B:s:d:R:M:w:m:I:u:h")) != -1) {
+        switch (opt) {
+            case 'c': device_file = optarg; break;
+            case 't': config.thread_count = (uint32_t)atoi(optarg); break;
+            case 'P': config.connect_parallelism = (uint32_t)atoi(optarg); break;
+            case 'S': snapshot = optarg; break;
+            case 'T': threshold_file = optarg; break;
+            case 'p': output_port = (unsigned)atoi(optarg); break;
+            case 'r': config.reconnect_interval_ms = (uint32_t)atoi(optarg); break;
+            case 'b': config.reconnect_initial_ms = (uint32_t)atoi(optarg); break;
+            case 'F': config.fast_period_ms = (uint32_t)atoi(optarg); break;
+            case 'B': config.background_period_ms = (uint32_t)atoi(optarg); break;
+            case 's': stats_interval = (unsigned)atoi(optarg); break;
+            case 'd': spool_dir = optarg; break;
+            case 'R': spool_rate = (unsigned)atoi(optarg); break;
+            case 'M': spool_mb = (unsigned)atoi(optarg); break;
+            case 'w': http_port = atoi(optarg); break;
+            case 'm': multicast = optarg; break;
+            case 'I': multicast_iface = optarg; break;
+            case 'u': uplink_addr = optarg; break;
+            default:
+                print_usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (!device_file || output_port > 0xFFFF || http_port > 0xFFFF) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGHUP, reload_handler);
+
+    gateway_t* gw = gateway_create(&config);
+    if (!gw || gateway_load_devices(gw, device_file) != HW_STATUS_OK) {
+        fprintf(stderr, "Gateway: failed to load devices\n");
+        gateway_destroy(gw);
+        return 1;
+    }
+    // A bad snapshot only costs the warm start
+    if (snapshot) gateway_load_snapshot(gw, snapshot);
+    if (threshold_file && gateway_load_thresholds(gw, threshold_file) != HW_STATUS_OK) {
+        fprintf(stderr, "Gateway: failed to load thresholds\n");
+        gateway_destroy(gw);
+        return 1;
+    }
+
+    spool_t* spool = NULL;
+    if (spool_dir) {
+        spool_config_t spool_config;
+        spool_default_config(&spool_config, spool_dir);
+        spool_config.replay_rate = spool_rate;
+        spool_config.max_bytes = (uint64_t)spool_mb * 1024 * 1024;
+        spool = spool_open(&spool_config);
+        if (!spool) {
+            fprintf(stderr, "Gateway: cannot open spool in %s\n", spool_dir);
+            gateway_destroy(gw);
+            return 1;
+        }
+    }
+
+    gw_stream_server_t* stream = gw_stream_create((uint16_t)output_port);
+    gw_stream_set_spool(stream, spool);
+    if (!stream || gw_stream_start(stream) != HW_STATUS_OK) {
+        fprintf(stderr, "Gateway: cannot start output stream on port %u\n", output_port);
+        gw_stream_destroy(stream);
+        spool_close(spool);
+        gateway_destroy(gw);
+        return 1;
+    }
+    gateway_add_sink(gw, gw_stream_sink, stream);
+
+    gw_http_server_t* http = NULL;
+    if (http_port >= 0) {
+        http = gw_http_create(gw, (uint16_t)http_port);
+        if (!http || gw_http_start(http) != HW_STATUS_OK) {
+            fprintf(stderr, "Gateway: cannot start HTTP endpoint on port %d\n", http_port);
+            gw_http_destroy(http);
+            gw_stream_destroy(stream);
+            spool_close(spool);
+            gateway_destroy(gw);
+            return 1;
+        }
+        gateway_add_sink(gw, gw_http_sink, http);
+    }
+
+    gw_mcast_publisher_t* mcast = NULL;
+    if (multicast) {
+        gw_mcast_config_t mcast_config;
+        gw_mcast_default_config(&mcast_config);
+        unsigned mcast_port = 0;
+        if (sscanf(multicast, "%63[^:]:%u", mcast_config.group, &mcast_port) == 2 && mcast_port <= 0xFFFF) {
+            mcast_config.port = (uint16_t)mcast_port;
+        }
+        if (multicast_iface) {
+            snprintf(mcast_config.interface_addr, sizeof(mcast_config.interface_addr), "%s", multicast_iface);
+        }
+        mcast = gw_mcast_publisher_create(&mcast_config);
+        if (!mcast || gw_mcast_publisher_start(mcast) != HW_STATUS_OK) {
+            fprintf(stderr, "Gateway: cannot start multicast publisher on %s\n", multicast);
+            gw_mcast_publisher_destroy(mcast);
+            gw_http_destroy(http);
+            gw_stream_destroy(stream);
+            spool_close(spool);
+            gateway_destroy(gw);
+            return 1;
+        }
+        gateway_add_sink(gw, gw_mcast_sink, mcast);
+    }
+
+    gw_uplink_t* uplink = NULL;
+    if (uplink_addr) {
+        gw_uplink_config_t uplink_config;
+        gw_uplink_default_config(&uplink_config);
+        unsigned uplink_port = 0;
+        if (sscanf(uplink_addr, "%127[^:]:%u", uplink_config.host, &uplink_port) == 2 && uplink_port <= 0xFFFF) {
+            uplink_config.port = (uint16_t)uplink_port;
+        }
+        uplink_config.reconnect_initial_ms = config.reconnect_initial_ms;
+        uplink_config.reconnect_max_ms = config.reconnect_interval_ms;
+        uplink = gw_uplink_create(&uplink_config);
+        if (!uplink || gw_uplink_start(uplink) != HW_STATUS_OK) {
+            fprintf(stderr, "Gateway: cannot start uplink to %s\n", uplink_addr);
+            gw_uplink_destroy(uplink);
+            gw_mcast_publisher_destroy(mcast);
+            gw_http_destroy(http);
+            gw_stream_destroy(stream);
+            spool_close(spool);
+            gateway_destroy(gw);
+            return 1;
+        }
+        gateway_add_sink(gw, gw_uplink_sink, uplink);
+    }
+
+    if (gateway_start(gw) != HW_STATUS_OK) {
+        fprintf(stderr, "Gateway: failed to start event loops\n");
+        gw_uplink_destroy(uplink);
+        gw_mcast_publisher_destroy(mcast);
+        gw_http_destroy(http);
+        gw_stream_destroy(stream);
+        spool_close(spool);
+        gateway_destroy(gw);
+        return 1;
+    }
+
+    gw_stats_t stats;
+    gateway_get_stats(gw, &stats);
+    printf("NetMon Gateway: %u devices on %u threads, output port %u\n",
+           stats.devices_configured, config.thread_count, gw_stream_port(stream));
+    if (http) {
+        printf("NetMon Gateway: HTTP/WebSocket on port %u\n", gw_http_port(http));
+    }
+    if (mcast) {
+        printf("NetMon Gateway: multicast to %s\n", multicast);
+    }
+    if (uplink) {
+        printf("NetMon Gateway: uplink to %s\n", uplink_addr);
+    }
+
+    unsigned elapsed = 0;
+    bool started_up = false;
+    while (keep_running) {
+        sleep(1);
+        if (reload_thresholds) {
+            // A bad file keeps the current set in force
+            reload_thresholds = 0;
+            if (threshold_file && gateway_load_thresholds(gw, threshold_file) == HW_STATUS_OK) {
+                gateway_get_stats(gw, &stats);
+                printf("Gateway: thresholds version %u loaded from %s\n", stats.thresholds_version, threshold_file);
+            }
+            continue;
+        }
+        elapsed++;
+        if (!started_up) {
+            gateway_get_stats(gw, &stats);
+            if (stats.startup_ms) {
+                printf("Gateway: all %u devices live %llu ms after start\n",
+                       stats.devices_configured, (unsigned long long)stats.startup_ms);
+                started_up = true;
+            }
+        }
+        if (snapshot && elapsed % 60 == 0) gateway_save_snapshot(gw, snapshot);
+        if (stats_interval && elapsed % stats_interval == 0) {
+            gw_stream_stats_t out;
+            gateway_get_stats(gw, &stats);
+            gw_stream_get_stats(stream, &out);
+            printf("Gateway: %u/%u connected, %llu frames in, %llu published, %u consumers, "
+                   "%llu checksum errors, %llu resumes, %llu keyframes, %llu rate changes\n",
+                   stats.devices_connected, stats.devices_configured,
+                   (unsigned long long)stats.frames_in,
+                   (unsigned long long)out.frames_published, out.clients,
+                   (unsigned long long)stats.checksum_errors,
+                   (unsigned long long)stats.resumes, (unsigned long long)stats.keyframes,
+                   (unsigned long long)stats.rate_commands);
+            if (stats.devices_restored || stats.connects_in_flight) {
+                printf("Gateway: %u devices still on snapshot state, %u connecting\n",
+                       stats.devices_restored, stats.connects_in_flight);
+            }
+            if (out.frames_conflated || out.clients_dropped) {
+                printf("Gateway: %llu frames conflated for slow consumers, %llu consumers dropped\n",
+                       (unsigned long long)out.frames_conflated, (unsigned long long)out.clients_dropped);
+            }
+            if (spool) {
+                printf("Gateway: spool %llu frames written, %llu replayed\n",
+                       (unsigned long long)out.frames_spooled, (unsigned long long)out.frames_replayed);
+            }
+            if (http) {
+                gw_http_stats_t web;
+                gw_http_get_stats(http, &web);
+                printf("Gateway: %u WebSocket clients, %llu requests, %llu messages encoded, %llu sent, "
+                       "%llu conflated\n",
+                       web.websocket_clients, (unsigned long long)web.requests,
+                       (unsigned long long)web.messages_serialized, (unsigned long long)web.messages_sent,
+                       (unsigned long long)web.frames_conflated);
+            }
+            if (mcast) {
+                gw_mcast_publisher_stats_t mc;
+                gw_mcast_publisher_get_stats(mcast, &mc);
+                printf("Gateway: multicast %llu datagrams, %llu NACKs, %llu retransmits, %llu gone\n",
+                       (unsigned long long)mc.datagrams_sent, (unsigned long long)mc.nacks_received,
+                       (unsigned long long)mc.retransmits, (unsigned long long)mc.gone);
+            }
+            if (uplink) {
+                gw_uplink_stats_t up;
+                gw_uplink_get_stats(uplink, &up);
+                printf("Gateway: uplink %s, %u channels (%u blocked), %llu frames in %llu writes, %llu dropped\n",
+                       up.connected ? "connected" : "down", up.channels, up.channels_blocked,
+                       (unsigned long long)up.frames_sent, (unsigned long long)up.writes,
+                       (unsigned long long)up.frames_dropped);
+            }
+        }
+    }
+
+    printf("\nGateway stopping...\n");
+    // Stop the event loops first so no sink runs into a destroyed output
+    gateway_stop(gw);
+    if (snapshot) gateway_save_snapshot(gw, snapshot);
+    gw_uplink_destroy(uplink);
+    gw_mcast_publisher_destroy(mcast);
+    gw_http_destroy(http);
+    gw_stream_destroy(stream);
+    spool_close(spool);
+    gateway_destroy(gw);
+    return 0;
+}
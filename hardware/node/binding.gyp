@@ -0,0 +1,32 @@
+{
+  "targets": [
+    {
+      "target_name": "netmon_hw",
+      "sources": [
+        "netmon_hw_addon.c",
+        "../hardware_core.c",
+        "../hardware_sim.c",
+        "../hardware_stm32.c",
+        "../stm32_interface.c",
+        "../stm32_decoder.c",
+        "../backoff.c",
+        "../conflate.c",
+        "../hw_stats.c",
+        "../tsdb.c",
+        "../gorilla.c"
+      ],
+      "include_dirs": [".."],
+      "cflags_c": ["-std=c11", "-O2"],
+      "defines": ["_DEFAULT_SOURCE"],
+      "conditions": [
+        ["OS=='win'", {
+          "msvs_settings": {
+            "VCCLCompilerTool": {
+              "AdditionalOptions": ["/std:c11", "/experimental:c11atomics"]
+            }
+          }
+        }]
+      ]
+    }
+  ]
+}
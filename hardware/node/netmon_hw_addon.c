@@ -0,0 +1,808 @@
+#define NAPI_VERSION 8
+#include <node_api.h>
+#include <uv.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hardware_interface.h"
+#include "hw_stats.h"
+
+// Node-API binding for libnetmon_hw.
+//
+// Device and subscription handles are externals. Snapshots come back as
+// plain objects with one typed array per measurement; no JSON on either
+// side. Subscription callbacks and command completions arrive on the
+// device's dispatch thread and are handed to JavaScript through
+// threadsafe functions.
+
+#define NAPI_CALL(env, call)                                        \
+    do {                                                            \
+        if ((call) != napi_ok) {                                    \
+            napi_throw_error((env), NULL, "N-API call failed: " #call); \
+            return NULL;                                            \
+        }                                                           \
+    } while (0)
+
+typedef struct addon_device addon_device_t;
+
+// One command in flight; also the library callback's user_data, so it is
+// the only allocation and is freed once, when settled
+typedef struct command_ctx {
+    struct command_ctx* next;
+    struct command_ctx* prev;
+    addon_device_t* device;
+    napi_deferred deferred;
+    hw_status_t result;
+} command_ctx_t;
+
+// One subscription. Changes that land while a call is queued for the JS
+// thread fold into it, so a busy event loop sees the latest snapshot once
+// instead of a backlog. Freed when both the external and the threadsafe
+// function are done with it.
+typedef struct addon_subscription {
+    struct addon_subscription* next;
+    addon_device_t* device;
+    hw_subscription_t* handle;   // NULL once unsubscribed
+    napi_threadsafe_function tsfn;
+    napi_ref device_ref;         // Keeps the device alive while subscribed
+    uv_mutex_t lock;
+    hw_snapshot_t latest;
+    uint32_t changed;
+    bool queued;
+    int refs;
+} addon_subscription_t;
+
+struct addon_device {
+    hw_device_t* device;         // NULL once closed
+    napi_threadsafe_function commands;
+    uv_mutex_t lock;             // pending
+    command_ctx_t* pending;      // Commands not yet answered
+    addon_subscription_t* subscriptions;
+    hw_snapshot_t snapshot;      // Last one handed out, for version checks
+};
+
+// Value helpers
+static void set_value(napi_env env, napi_value obj, const char* name, napi_value value) {
+    napi_set_named_property(env, obj, name, value);
+}
+
+static void set_number(napi_env env, napi_value obj, const char* name, double number) {
+    napi_value value;
+    napi_create_double(env, number, &value);
+    set_value(env, obj, name, value);
+}
+
+static void set_bool(napi_env env, napi_value obj, const char* name, bool flag) {
+    napi_value value;
+    napi_get_boolean(env, flag, &value);
+    set_value(env, obj, name, value);
+}
+
+static void set_string(napi_env env, napi_value obj, const char* name, const char* text) {
+    napi_value value;
+    napi_create_string_utf8(env, text, strnlen(text, 128), &value);
+    set_value(env, obj, name, value);
+}
+
+static napi_value typed_array(napi_env env, napi_typedarray_type type, size_t count, size_t element, void** data) {
+    napi_value buffer, array;
+    napi_create_arraybuffer(env, count * element, data, &buffer);
+    napi_create_typedarray(env, type, count, buffer, 0, &array);
+    return array;
+}
+
+static float* float_field(napi_env env, napi_value obj, const char* name, size_t count) {
+    void* data;
+    set_value(env, obj, name, typed_array(env, napi_float32_array, count, sizeof(float), &data));
+    return data;
+}
+
+static uint8_t* byte_field(napi_env env, napi_value obj, const char* name, size_t count) {
+    void* data;
+    set_value(env, obj, name, typed_array(env, napi_uint8_array, count, 1, &data));
+    return data;
+}
+
+static uint32_t arg_u32(napi_env env, napi_value value, uint32_t fallback) {
+    uint32_t out;
+    return napi_get_value_uint32(env, value, &out) == napi_ok ? out : fallback;
+}
+
+static double arg_double(napi_env env, napi_value value, double fallback) {
+    double out;
+    return napi_get_value_double(env, value, &out) == napi_ok ? out : fallback;
+}
+
+static bool arg_bool(napi_env env, napi_value value) {
+    bool out = false;
+    napi_get_value_bool(env, value, &out);
+    return out;
+}
+
+static addon_device_t* arg_device(napi_env env, napi_value value) {
+    addon_device_t* dev = NULL;
+    if (napi_get_value_external(env, value, (void**)&dev) != napi_ok || !dev || !dev->device) {
+        napi_throw_type_error(env, NULL, "expected an open device");
+        return NULL;
+    }
+    return dev;
+}
+
+// Snapshot -> object; ids are the array index + 1
+static napi_value snapshot_object(napi_env env, const hw_snapshot_t* s) {
+    napi_value obj, bank;
+    napi_create_object(env, &obj);
+    set_number(env, obj, "version", (double)s->version);
+    set_number(env, obj, "timestamp", s->timestamp);
+
+    napi_create_object(env, &bank);
+    float* voltage = float_field(env, bank, "voltage", s->power_module_count);
+    float* current = float_field(env, bank, "current", s->power_module_count);
+    float* power = float_field(env, bank, "power", s->power_module_count);
+    float* temperature = float_field(env, bank, "temperature", s->power_module_count);
+    uint8_t* active = byte_field(env, bank, "active", s->power_module_count);
+    uint8_t* fault = byte_field(env, bank, "fault", s->power_module_count);
+    for (int i = 0; i < s->power_module_count; i++) {
+        const power_module_t* m = &s->power_modules[i];
+        voltage[i] = m->voltage;
+        current[i] = m->current;
+        power[i] = m->power;
+        temperature[i] = m->temperature;
+        active[i] = m->is_active;
+        fault[i] = m->has_fault;
+    }
+    set_value(env, obj, "powerModules", bank);
+
+    napi_create_object(env, &bank);
+    voltage = float_field(env, bank, "voltage", s->battery_count);
+    current = float_field(env, bank, "current", s->battery_count);
+    temperature = float_field(env, bank, "temperature", s->battery_count);
+    uint8_t* capacity = byte_field(env, bank, "capacityPercent", s->battery_count);
+    uint8_t* charging = byte_field(env, bank, "charging", s->battery_count);
+    uint8_t* testing = byte_field(env, bank, "testInProgress", s->battery_count);
+    for (int i = 0; i < s->battery_count; i++) {
+        const battery_info_t* b = &s->batteries[i];
+        voltage[i] = b->voltage;
+        current[i] = b->current;
+        temperature[i] = b->temperature;
+        capacity[i] = b->capacity_percent;
+        charging[i] = b->is_charging;
+        testing[i] = b->test_in_progress;
+    }
+    set_value(env, obj, "batteries", bank);
+
+    napi_create_object(env, &bank);
+    voltage = float_field(env, bank, "voltage", s->ac_phase_count);
+    current = float_field(env, bank, "current", s->ac_phase_count);
+    float* frequency = float_field(env, bank, "frequency", s->ac_phase_count);
+    power = float_field(env, bank, "power", s->ac_phase_count);
+    uint8_t* normal = byte_field(env, bank, "normal", s->ac_phase_count);
+    for (int i = 0; i < s->ac_phase_count; i++) {
+        const ac_phase_t* p = &s->ac_phases[i];
+        voltage[i] = p->voltage;
+        current[i] = p->current;
+        frequency[i] = p->frequency;
+        power[i] = p->power;
+        normal[i] = p->is_normal;
+    }
+    set_value(env, obj, "acPhases", bank);
+
+    napi_value names;
+    napi_create_object(env, &bank);
+    napi_create_array_with_length(env, s->dc_circuit_count, &names);
+    voltage = float_field(env, bank, "voltage", s->dc_circuit_count);
+    current = float_field(env, bank, "current", s->dc_circuit_count);
+    power = float_field(env, bank, "power", s->dc_circuit_count);
+    uint8_t* enabled = byte_field(env, bank, "enabled", s->dc_circuit_count);
+    for (int i = 0; i < s->dc_circuit_count; i++) {
+        const dc_circuit_t* c = &s->dc_circuits[i];
+        voltage[i] = c->voltage;
+        current[i] = c->current;
+        power[i] = c->power;
+        enabled[i] = c->is_enabled;
+        napi_value name;
+        napi_create_string_utf8(env, c->load_name, strnlen(c->load_name, sizeof(c->load_name)), &name);
+        napi_set_element(env, names, i, name);
+    }
+    set_value(env, bank, "loadNames", names);
+    set_value(env, obj, "dcCircuits", bank);
+
+    napi_value alarms;
+    napi_create_array_with_length(env, s->alarm_count, &alarms);
+    for (int i = 0; i < s->alarm_count; i++) {
+        const alarm_t* a = &s->alarms[i];
+        napi_value alarm;
+        napi_create_object(env, &alarm);
+        set_number(env, alarm, "alarmId", a->alarm_id);
+        set_number(env, alarm, "severity", a->severity);
+        set_number(env, alarm, "timestamp", a->timestamp);
+        set_bool(env, alarm, "isActive", a->is_active);
+        set_string(env, alarm, "message", a->message);
+        napi_set_element(env, alarms, i, alarm);
+    }
+    set_value(env, obj, "alarms", alarms);
+
+    napi_value status;
+    napi_create_object(env, &status);
+    set_bool(env, status, "mainsAvailable", s->status.mains_available);
+    set_bool(env, status, "batteryBackup", s->status.battery_backup);
+    set_bool(env, status, "generatorRunning", s->status.generator_running);
+    set_number(env, status, "operationMode", s->status.operation_mode);
+    set_number(env, status, "systemLoad", s->status.system_load);
+    set_number(env, status, "uptimeSeconds", s->status.uptime_seconds);
+    set_value(env, obj, "status", status);
+    return obj;
+}
+
+// Commands: the C callback parks the answer, the JS thread settles the promise
+static void settle_command(napi_env env, napi_value js_fn, void* context, void* data) {
+    (void)js_fn;
+    (void)context;
+    command_ctx_t* ctx = data;
+    if (env) {
+        napi_value result;
+        napi_create_int32(env, ctx->result, &result);
+        napi_resolve_deferred(env, ctx->deferred, result);
+    }
+    free(ctx);
+}
+
+static void device_unlink(addon_device_t* dev, command_ctx_t* ctx) {
+    if (ctx->prev) ctx->prev->next = ctx->next; else dev->pending = ctx->next;
+    if (ctx->next) ctx->next->prev = ctx->prev;
+}
+
+static void on_command_done(hw_device_t* device, hw_token_t token, hw_status_t result, void* user_data) {
+    (void)device;
+    (void)token;
+    command_ctx_t* ctx = user_data;
+    addon_device_t* dev = ctx->device;
+
+    ctx->result = result;
+    uv_mutex_lock(&dev->lock);
+    device_unlink(dev, ctx);
+    uv_mutex_unlock(&dev->lock);
+    napi_call_threadsafe_function(dev->commands, ctx, napi_tsfn_nonblocking);
+}
+
+typedef hw_token_t (*submit_fn_t)(addon_device_t* dev, napi_env env, napi_value* argv, uint32_t timeout_ms,
+                                  command_ctx_t* ctx);
+
+static napi_value submit(napi_env env, napi_callback_info info, size_t arity, submit_fn_t fn) {
+    size_t argc = 5;
+    napi_value argv[5];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    if (argc < arity) {
+        napi_throw_type_error(env, NULL, "missing arguments");
+        return NULL;
+    }
+    addon_device_t* dev = arg_device(env, argv[0]);
+    if (!dev) return NULL;
+    uint32_t timeout_ms = argc > arity ? arg_u32(env, argv[arity], 0) : 0;
+
+    napi_value promise;
+    command_ctx_t* ctx = calloc(1, sizeof(command_ctx_t));
+    if (!ctx) {
+        napi_throw_error(env, NULL, "out of memory");
+        return NULL;
+    }
+    NAPI_CALL(env, napi_create_promise(env, &ctx->deferred, &promise));
+    ctx->device = dev;
+
+    // Listed before submitting: the answer can beat the token back
+    uv_mutex_lock(&dev->lock);
+    ctx->next = dev->pending;
+    if (dev->pending) dev->pending->prev = ctx;
+    dev->pending = ctx;
+    uv_mutex_unlock(&dev->lock);
+
+    if (fn(dev, env, argv, timeout_ms, ctx) == 0) {
+        // Queue full or bad arguments; nothing was queued
+        uv_mutex_lock(&dev->lock);
+        device_unlink(dev, ctx);
+        uv_mutex_unlock(&dev->lock);
+        napi_value result;
+        napi_create_int32(env, HW_STATUS_ERROR, &result);
+        napi_resolve_deferred(env, ctx->deferred, result);
+        free(ctx);
+    }
+    return promise;
+}
+
+static hw_token_t submit_power_module(addon_device_t* dev, napi_env env, napi_value* argv, uint32_t timeout_ms,
+                                      command_ctx_t* ctx) {
+    return hw_dev_set_power_module_state_async(dev->device, (uint8_t)arg_u32(env, argv[1], 0),
+                                               arg_bool(env, argv[2]), timeout_ms, on_command_done, ctx);
+}
+
+static hw_token_t submit_target_voltage(addon_device_t* dev, napi_env env, napi_value* argv, uint32_t timeout_ms,
+                                        command_ctx_t* ctx) {
+    return hw_dev_set_target_voltage_async(dev->device, (float)arg_double(env, argv[1], 0.0),
+                                           timeout_ms, on_command_done, ctx);
+}
+
+static hw_token_t submit_battery_test(addon_device_t* dev, napi_env env, napi_value* argv, uint32_t timeout_ms,
+                                      command_ctx_t* ctx) {
+    return hw_dev_start_battery_test_async(dev->device, (uint8_t)arg_u32(env, argv[1], 0),
+                                           (uint8_t)arg_u32(env, argv[2], 0), timeout_ms, on_command_done, ctx);
+}
+
+static hw_token_t submit_dc_circuit(addon_device_t* dev, napi_env env, napi_value* argv, uint32_t timeout_ms,
+                                    command_ctx_t* ctx) {
+    return hw_dev_set_dc_circuit_state_async(dev->device, (uint8_t)arg_u32(env, argv[1], 0),
+                                             arg_bool(env, argv[2]), timeout_ms, on_command_done, ctx);
+}
+
+// setPowerModuleState(device, id, enable, timeoutMs?) -> Promise<status>
+static napi_value js_set_power_module_state(napi_env env, napi_callback_info info) {
+    return submit(env, info, 3, submit_power_module);
+}
+
+// setTargetVoltage(device, volts, timeoutMs?) -> Promise<status>
+static napi_value js_set_target_voltage(napi_env env, napi_callback_info info) {
+    return submit(env, info, 2, submit_target_voltage);
+}
+
+// startBatteryTest(device, id, testType, timeoutMs?) -> Promise<status>
+static napi_value js_start_battery_test(napi_env env, napi_callback_info info) {
+    return submit(env, info, 3, submit_battery_test);
+}
+
+// setDcCircuitState(device, id, enable, timeoutMs?) -> Promise<status>
+static napi_value js_set_dc_circuit_state(napi_env env, napi_callback_info info) {
+    return submit(env, info, 3, submit_dc_circuit);
+}
+
+// Subscriptions
+static void subscription_drop(addon_subscription_t* sub) {
+    if (--sub->refs == 0) {
+        uv_mutex_destroy(&sub->lock);
+        free(sub);
+    }
+}
+
+static void deliver_change(napi_env env, napi_value js_fn, void* context, void* data) {
+    (void)context;
+    addon_subscription_t* sub = data;
+    if (!env) return;
+
+    hw_snapshot_t* snapshot = malloc(sizeof(hw_snapshot_t));
+    if (!snapshot) return;
+    uv_mutex_lock(&sub->lock);
+    *snapshot = sub->latest;
+    uint32_t changed = sub->changed;
+    sub->changed = 0;
+    sub->queued = false;
+    uv_mutex_unlock(&sub->lock);
+
+    napi_value argv[2], global;
+    napi_create_uint32(env, changed, &argv[0]);
+    argv[1] = snapshot_object(env, snapshot);
+    free(snapshot);
+    napi_get_global(env, &global);
+    napi_call_function(env, global, js_fn, 2, argv, NULL);
+}
+
+static void on_change(hw_device_t* device, uint32_t changed, const hw_snapshot_t* snapshot, void* user_data) {
+    (void)device;
+    addon_subscription_t* sub = user_data;
+    uv_mutex_lock(&sub->lock);
+    sub->latest = *snapshot;
+    sub->changed |= changed;
+    bool post = !sub->queued;
+    sub->queued = true;
+    uv_mutex_unlock(&sub->lock);
+    if (post) napi_call_threadsafe_function(sub->tsfn, sub, napi_tsfn_nonblocking);
+}
+
+static void subscription_tsfn_done(napi_env env, void* data, void* hint) {
+    (void)env;
+    (void)hint;
+    subscription_drop(data);
+}
+
+// With the JS thread; returns once no callback is in flight
+static void subscription_end(napi_env env, addon_subscription_t* sub) {
+    if (!sub->handle) return;
+    hw_unsubscribe(sub->handle);
+    sub->handle = NULL;
+
+    addon_subscription_t** link = &sub->device->subscriptions;
+    while (*link && *link != sub) link = &(*link)->next;
+    if (*link) *link = sub->next;
+
+    napi_release_threadsafe_function(sub->tsfn, napi_tsfn_release);
+    napi_delete_reference(env, sub->device_ref);
+}
+
+static void subscription_finalize(napi_env env, void* data, void* hint) {
+    (void)hint;
+    addon_subscription_t* sub = data;
+    subscription_end(env, sub);
+    subscription_drop(sub);
+}
+
+// subscribe(device, mask, minIntervalMs, fn(changed, snapshot)) -> subscription
+static napi_value js_subscribe(napi_env env, napi_callback_info info) {
+    size_t argc = 4;
+    napi_value argv[4];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    addon_device_t* dev = argc == 4 ? arg_device(env, argv[0]) : NULL;
+    if (!dev) return NULL;
+
+    addon_subscription_t* sub = calloc(1, sizeof(addon_subscription_t));
+    if (!sub) {
+        napi_throw_error(env, NULL, "out of memory");
+        return NULL;
+    }
+    uv_mutex_init(&sub->lock);
+    sub->device = dev;
+    sub->refs = 2;
+
+    napi_value name, external;
+    napi_create_string_utf8(env, "netmon_hw subscription", NAPI_AUTO_LENGTH, &name);
+    if (napi_create_threadsafe_function(env, argv[3], NULL, name, 0, 1, sub, subscription_tsfn_done,
+                                        NULL, deliver_change, &sub->tsfn) != napi_ok) {
+        uv_mutex_destroy(&sub->lock);
+        free(sub);
+        napi_throw_type_error(env, NULL, "expected a callback");
+        return NULL;
+    }
+    napi_create_reference(env, argv[0], 1, &sub->device_ref);
+
+    sub->handle = hw_dev_subscribe(dev->device, arg_u32(env, argv[1], HW_CHANGE_ALL),
+                                   arg_u32(env, argv[2], 0), on_change, sub);
+    if (!sub->handle) {
+        napi_delete_reference(env, sub->device_ref);
+        napi_release_threadsafe_function(sub->tsfn, napi_tsfn_release);
+        subscription_drop(sub);
+        napi_throw_error(env, NULL, "subscribe failed");
+        return NULL;
+    }
+    sub->next = dev->subscriptions;
+    dev->subscriptions = sub;
+    NAPI_CALL(env, napi_create_external(env, sub, subscription_finalize, NULL, &external));
+    return external;
+}
+
+// unsubscribe(subscription)
+static napi_value js_unsubscribe(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value argv[1];
+    addon_subscription_t* sub = NULL;
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    if (argc < 1 || napi_get_value_external(env, argv[0], (void**)&sub) != napi_ok || !sub) {
+        napi_throw_type_error(env, NULL, "expected a subscription");
+        return NULL;
+    }
+    subscription_end(env, sub);
+    return NULL;
+}
+
+// Devices
+static void device_close(napi_env env, addon_device_t* dev) {
+    if (!dev->device) return;
+    while (dev->subscriptions) subscription_end(env, dev->subscriptions);
+    hw_close(dev->device);
+    dev->device = NULL;
+
+    // Commands the device never answered; the dispatch thread is gone
+    while (dev->pending) {
+        command_ctx_t* ctx = dev->pending;
+        dev->pending = ctx->next;
+        napi_value result;
+        napi_create_int32(env, HW_STATUS_CANCELLED, &result);
+        napi_resolve_deferred(env, ctx->deferred, result);
+        free(ctx);
+    }
+    napi_release_threadsafe_function(dev->commands, napi_tsfn_release);
+}
+
+static void device_finalize(napi_env env, void* data, void* hint) {
+    (void)hint;
+    addon_device_t* dev = data;
+    device_close(env, dev);
+    uv_mutex_destroy(&dev->lock);
+    free(dev);
+}
+
+// open({ seed, updateMs, commandLatencyMs, maxCommands, changeLog, powerModules, ...,
+//        link, linkBaud }?) -> device
+static napi_value js_open(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value argv[1];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+
+    hw_config_t config;
+    hw_default_config(&config);
+    char link[160];
+    napi_valuetype type = napi_undefined;
+    if (argc > 0) napi_typeof(env, argv[0], &type);
+    if (type == napi_object) {
+        struct {
+            const char* name;
+            uint32_t* field;
+        } numbers[] = {
+            {"seed", &config.seed},
+            {"updateMs", &config.update_ms},
+            {"commandLatencyMs", &config.command_latency_ms},
+            {"maxCommands", &config.max_commands},
+            {"changeLog", &config.change_log},
+            {"linkBaud", &config.link_baud},
+        };
+        for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+            napi_value value;
+            if (napi_get_named_property(env, argv[0], numbers[i].name, &value) == napi_ok) {
+                *numbers[i].field = arg_u32(env, value, *numbers[i].field);
+            }
+        }
+        struct {
+            const char* name;
+            uint8_t* field;
+        } counts[] = {
+            {"powerModules", &config.power_modules},
+            {"batteries", &config.batteries},
+            {"acPhases", &config.ac_phases},
+            {"dcCircuits", &config.dc_circuits},
+        };
+        for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+            napi_value value;
+            if (napi_get_named_property(env, argv[0], counts[i].name, &value) == napi_ok) {
+                *counts[i].field = (uint8_t)arg_u32(env, value, *counts[i].field);
+            }
+        }
+        // hw_open() keeps its own copy of the link
+        napi_value value;
+        napi_valuetype link_type = napi_undefined;
+        if (napi_get_named_property(env, argv[0], "link", &value) == napi_ok &&
+            napi_typeof(env, value, &link_type) == napi_ok && link_type == napi_string &&
+            napi_get_value_string_utf8(env, value, link, sizeof(link), NULL) == napi_ok) {
+            config.link = link;
+        }
+    }
+
+    addon_device_t* dev = calloc(1, sizeof(addon_device_t));
+    if (!dev || !(dev->device = hw_open(&config))) {
+        free(dev);
+        napi_throw_error(env, NULL, "hw_open failed");
+        return NULL;
+    }
+    uv_mutex_init(&dev->lock);
+
+    // Unreferenced: an idle device does not keep the process alive
+    napi_value name, external;
+    napi_create_string_utf8(env, "netmon_hw commands", NAPI_AUTO_LENGTH, &name);
+    if (napi_create_threadsafe_function(env, NULL, NULL, name, 0, 1, NULL, NULL, NULL,
+                                        settle_command, &dev->commands) != napi_ok) {
+        hw_close(dev->device);
+        uv_mutex_destroy(&dev->lock);
+        free(dev);
+        napi_throw_error(env, NULL, "threadsafe function failed");
+        return NULL;
+    }
+    napi_unref_threadsafe_function(env, dev->commands);
+    NAPI_CALL(env, napi_create_external(env, dev, device_finalize, NULL, &external));
+    return external;
+}
+
+// close(device): outstanding commands settle with STATUS_CANCELLED
+static napi_value js_close(napi_env env, napi_callback_info info) {
+    size_t argc = 1;
+    napi_value argv[1];
+    addon_device_t* dev = NULL;
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    if (argc > 0 && napi_get_value_external(env, argv[0], (void**)&dev) == napi_ok && dev) {
+        device_close(env, dev);
+    }
+    return NULL;
+}
+
+// getSnapshot(device, sinceVersion?) -> snapshot, or null when sinceVersion is current
+static napi_value js_get_snapshot(napi_env env, napi_callback_info info) {
+    size_t argc = 2;
+    napi_value argv[2];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    addon_device_t* dev = argc > 0 ? arg_device(env, argv[0]) : NULL;
+    if (!dev) return NULL;
+
+    // The cached copy is only sent when the caller already has it
+    uint64_t since = argc > 1 ? (uint64_t)arg_double(env, argv[1], 0) : 0;
+    if (since != dev->snapshot.version) dev->snapshot.version = 0;
+    hw_status_t status = hw_dev_get_snapshot(dev->device, &dev->snapshot);
+    if (status == HW_STATUS_NOT_MODIFIED) {
+        napi_value null;
+        napi_get_null(env, &null);
+        return null;
+    }
+    if (status != HW_STATUS_OK) {
+        napi_throw_error(env, NULL, "hw_dev_get_snapshot failed");
+        return NULL;
+    }
+    return snapshot_object(env, &dev->snapshot);
+}
+
+// getChangesSince(device, since, max?) -> { version, changes } with the
+// changes as parallel typed arrays; null when since is current, false when
+// it is too old and a snapshot is needed
+static napi_value js_get_changes_since(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value argv[3];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    addon_device_t* dev = argc >= 2 ? arg_device(env, argv[0]) : NULL;
+    if (!dev) return NULL;
+
+    uint64_t since = (uint64_t)arg_double(env, argv[1], 0);
+    uint32_t count = argc > 2 ? arg_u32(env, argv[2], 4096) : 4096;
+    hw_change_t* changes = malloc((count ? count : 1) * sizeof(hw_change_t));
+    if (!changes) {
+        napi_throw_error(env, NULL, "out of memory");
+        return NULL;
+    }
+    uint64_t version;
+    hw_status_t status = hw_dev_get_changes_since(dev->device, since, changes, &count, &version);
+    napi_value result;
+    if (status == HW_STATUS_NOT_MODIFIED) {
+        napi_get_null(env, &result);
+    } else if (status != HW_STATUS_OK) {
+        napi_get_boolean(env, false, &result);
+    } else {
+        napi_create_object(env, &result);
+        set_number(env, result, "version", (double)version);
+        napi_value list;
+        napi_create_object(env, &list);
+        void* versions;
+        set_value(env, list, "version", typed_array(env, napi_float64_array, count, sizeof(double), &versions));
+        uint8_t* record = byte_field(env, list, "record", count);
+        uint8_t* unit = byte_field(env, list, "unitId", count);
+        uint8_t* field = byte_field(env, list, "field", count);
+        float* value = float_field(env, list, "value", count);
+        for (uint32_t i = 0; i < count; i++) {
+            ((double*)versions)[i] = (double)changes[i].version;
+            record[i] = changes[i].record;
+            unit[i] = changes[i].unit_id;
+            field[i] = changes[i].field;
+            value[i] = changes[i].value;
+        }
+        set_value(env, result, "changes", list);
+    }
+    free(changes);
+    return result;
+}
+
+// readField(device, bank, field) -> Float32Array over every unit
+static napi_value js_read_field(napi_env env, napi_callback_info info) {
+    size_t argc = 3;
+    napi_value argv[3];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    addon_device_t* dev = argc == 3 ? arg_device(env, argv[0]) : NULL;
+    if (!dev) return NULL;
+
+    hw_bank_t bank = (hw_bank_t)arg_u32(env, argv[1], UINT32_MAX);
+    hw_field_t field = (hw_field_t)arg_u32(env, argv[2], UINT32_MAX);
+    uint8_t count = hw_dev_unit_count(dev->device, bank);
+    void* data;
+    napi_value array = typed_array(env, napi_float32_array, count, sizeof(float), &data);
+    if (!count || hw_dev_read_field(dev->device, bank, field, 1, count, data) != HW_STATUS_OK) {
+        napi_throw_range_error(env, NULL, "no such bank or field");
+        return NULL;
+    }
+    return array;
+}
+
+// findUnits(device, bank, field, min, max) -> Uint8Array of ids
+static napi_value js_find_units(napi_env env, napi_callback_info info) {
+    size_t argc = 5;
+    napi_value argv[5];
+    NAPI_CALL(env, napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+    addon_device_t* dev = argc == 5 ? arg_device(env, argv[0]) : NULL;
+    if (!dev) return NULL;
+
+    hw_bank_t bank = (hw_bank_t)arg_u32(env, argv[1], UINT32_MAX);
+    hw_field_t field = (hw_field_t)arg_u32(env, argv[2], UINT32_MAX);
+    uint8_t ids[HW_MAX_DC_CIRCUITS];
+    int found = hw_dev_find_units(dev->device, bank, field, (float)arg_double(env, argv[3], 0),
+                                  (float)arg_double(env, argv[4], 0), ids, (int)sizeof(ids));
+    if (found < 0) {
+        napi_throw_range_error(env, NULL, "no such bank or field");
+        return NULL;
+    }
+    void* data;
+    napi_value array = typed_array(env, napi_uint8_array, (size_t)found, 1, &data);
+    memcpy(data, ids, (size_t)found);
+    return array;
+}
+
+// getStats() -> { op: { calls, p50, p99, p999, max } } in nanoseconds, called ops only
+static napi_value js_get_stats(napi_env env, napi_callback_info info) {
+    (void)info;
+    hw_stats_t* stats = malloc(sizeof(hw_stats_t));
+    if (!stats) return NULL;
+    hw_get_stats(stats);
+
+    napi_value obj;
+    napi_create_object(env, &obj);
+    for (int op = 0; op < HW_OP_COUNT; op++) {
+        const hw_op_stats_t* s = &stats->ops[op];
+        if (!s->calls) continue;
+        napi_value entry;
+        napi_create_object(env, &entry);
+        set_number(env, entry, "calls", (double)s->calls);
+        set_number(env, entry, "p50", (double)s->p50_ns);
+        set_number(env, entry, "p99", (double)s->p99_ns);
+        set_number(env, entry, "p999", (double)s->p999_ns);
+        set_number(env, entry, "max", (double)s->max_ns);
+        set_value(env, obj, hw_op_name((hw_op_t)op), entry);
+    }
+    free(stats);
+    return obj;
+}
+
+static void export_constants(napi_env env, napi_value exports) {
+    static const struct {
+        const char* name;
+        int value;
+    } constants[] = {
+        {"STATUS_OK", HW_STATUS_OK},
+        {"STATUS_ERROR", HW_STATUS_ERROR},
+        {"STATUS_TIMEOUT", HW_STATUS_TIMEOUT},
+        {"STATUS_NOT_CONNECTED", HW_STATUS_NOT_CONNECTED},
+        {"STATUS_INVALID_PARAM", HW_STATUS_INVALID_PARAM},
+        {"STATUS_CANCELLED", HW_STATUS_CANCELLED},
+        {"STATUS_SUPERSEDED", HW_STATUS_SUPERSEDED},
+        {"STATUS_TOO_OLD", HW_STATUS_TOO_OLD},
+        {"CHANGE_POWER", HW_CHANGE_POWER},
+        {"CHANGE_BATTERY", HW_CHANGE_BATTERY},
+        {"CHANGE_AC", HW_CHANGE_AC},
+        {"CHANGE_DC", HW_CHANGE_DC},
+        {"CHANGE_ALARMS", HW_CHANGE_ALARMS},
+        {"CHANGE_STATUS", HW_CHANGE_STATUS},
+        {"CHANGE_ALL", HW_CHANGE_ALL},
+        {"BANK_POWER_MODULES", HW_BANK_POWER_MODULES},
+        {"BANK_BATTERIES", HW_BANK_BATTERIES},
+        {"BANK_AC_PHASES", HW_BANK_AC_PHASES},
+        {"BANK_DC_CIRCUITS", HW_BANK_DC_CIRCUITS},
+        {"FIELD_VOLTAGE", HW_FIELD_VOLTAGE},
+        {"FIELD_CURRENT", HW_FIELD_CURRENT},
+        {"FIELD_POWER", HW_FIELD_POWER},
+        {"FIELD_TEMPERATURE", HW_FIELD_TEMPERATURE},
+        {"FIELD_FREQUENCY", HW_FIELD_FREQUENCY},
+        {"FIELD_ACTIVE", HW_FIELD_ACTIVE},
+        {"FIELD_FAULT", HW_FIELD_FAULT},
+        {"FIELD_CHARGING", HW_FIELD_CHARGING},
+        {"FIELD_TEST", HW_FIELD_TEST},
+        {"FIELD_CAPACITY", HW_FIELD_CAPACITY},
+        {"FIELD_MAINS", HW_FIELD_MAINS},
+        {"FIELD_BATTERY_BACKUP", HW_FIELD_BATTERY_BACKUP},
+        {"FIELD_GENERATOR", HW_FIELD_GENERATOR},
+        {"FIELD_OPERATION_MODE", HW_FIELD_OPERATION_MODE},
+        {"FIELD_SYSTEM_LOAD", HW_FIELD_SYSTEM_LOAD},
+        {"FIELD_UPTIME", HW_FIELD_UPTIME},
+        {"FIELD_ALARMS", HW_FIELD_ALARMS},
+        {"RECORD_SYSTEM", HW_RECORD_SYSTEM},
+    };
+    for (size_t i = 0; i < sizeof(constants) / sizeof(constants[0]); i++) {
+        set_number(env, exports, constants[i].name, constants[i].value);
+    }
+}
+
+static napi_value init(napi_env env, napi_value exports) {
+    napi_property_descriptor methods[] = {
+        {"open", NULL, js_open, NULL, NULL, NULL, napi_default, NULL},
+        {"close", NULL, js_close, NULL, NULL, NULL, napi_default, NULL},
+        {"getSnapshot", NULL, js_get_snapshot, NULL, NULL, NULL, napi_default, NULL},
+        {"getChangesSince", NULL, js_get_changes_since, NULL, NULL, NULL, napi_default, NULL},
+        {"subscribe", NULL, js_subscribe, NULL, NULL, NULL, napi_default, NULL},
+        {"unsubscribe", NULL, js_unsubscribe, NULL, NULL, NULL, napi_default, NULL},
+        {"setPowerModuleState", NULL, js_set_power_module_state, NULL, NULL, NULL, napi_default, NULL},
+        {"setTargetVoltage", NULL, js_set_target_voltage, NULL, NULL, NULL, napi_default, NULL},
+        {"startBatteryTest", NULL, js_start_battery_test, NULL, NULL, NULL, napi_default, NULL},
+        {"setDcCircuitState", NULL, js_set_dc_circuit_state, NULL, NULL, NULL, napi_default, NULL},
+        {"readField", NULL, js_read_field, NULL, NULL, NULL, napi_default, NULL},
+        {"findUnits", NULL, js_find_units, NULL, NULL, NULL, napi_default, NULL},
+        {"getStats", NULL, js_get_stats, NULL, NULL, NULL, napi_default, NULL},
+    };
+    napi_define_properties(env, exports, sizeof(methods) / sizeof(methods[0]), methods);
+    export_constants(env, exports);
+    return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
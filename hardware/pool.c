@@ -0,0 +1,215 @@
+#define _POSIX_C_SOURCE 200809L
+#include "pool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#define CACHE_LINE      64
+#define BLOCK_ALIGN     16
+
+typedef struct free_block {
+    struct free_block* next;
+} free_block_t;
+
+// Free blocks of one thread slot. Only the owning thread touches blocks and
+// count; the counters are bumped with a relaxed load and store and read by
+// pool_get_stats() from any thread.
+typedef struct {
+    _Alignas(CACHE_LINE) uint32_t count;
+    void* blocks[POOL_CACHE_BLOCKS];
+    _Atomic uint64_t gets;
+    _Atomic uint64_t puts;
+    _Atomic uint64_t exhausted;
+} pool_cache_t;
+
+struct pool {
+    pool_cache_t caches[POOL_MAX_THREADS];
+    uint8_t* base;
+    size_t block_size;
+    uint32_t block_count;
+    void* allocation;
+
+    pthread_mutex_t lock;
+    free_block_t* free_list;
+    uint32_t carved;             // Blocks past this were never handed out
+    // Threads without a slot
+    uint64_t gets;
+    uint64_t puts;
+    uint64_t exhausted;
+};
+
+// Thread slots, shared by every pool. A slot is released when its thread
+// exits and adopted, caches and all, by the next thread that asks.
+static atomic_bool slot_owned[POOL_MAX_THREADS];
+static _Thread_local int local_slot = -1;   // -1 not claimed yet, -2 none left
+static pthread_once_t slot_once = PTHREAD_ONCE_INIT;
+static pthread_key_t slot_key;
+static bool slot_key_ready = false;
+
+static void release_slot(void* slot) {
+    atomic_store_explicit(&slot_owned[(intptr_t)slot - 1], false, memory_order_release);
+}
+
+static void create_slot_key(void) {
+    slot_key_ready = pthread_key_create(&slot_key, release_slot) == 0;
+}
+
+static int claim_slot(void) {
+    pthread_once(&slot_once, create_slot_key);
+    // Without the key a slot would never come back
+    if (!slot_key_ready) return -2;
+
+    for (int i = 0; i < POOL_MAX_THREADS; i++) {
+        bool expected = false;
+        if (!atomic_load_explicit(&slot_owned[i], memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&slot_owned[i], &expected, true,
+                                                    memory_order_acq_rel, memory_order_relaxed)) {
+            pthread_setspecific(slot_key, (void*)(intptr_t)(i + 1));
+            return i;
+        }
+    }
+    return -2;
+}
+
+static pool_cache_t* local_cache(pool_t* pool) {
+    if (local_slot == -1) local_slot = claim_slot();
+    return local_slot >= 0 ? &pool->caches[local_slot] : NULL;
+}
+
+static void bump(_Atomic uint64_t* counter) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+// Under the lock: a free block, or fresh space, or NULL
+static void* take_block(pool_t* pool) {
+    free_block_t* b = pool->free_list;
+    if (b) {
+        pool->free_list = b->next;
+        return b;
+    }
+    if (pool->carved < pool->block_count) {
+        return pool->base + (size_t)pool->carved++ * pool->block_size;
+    }
+    return NULL;
+}
+
+pool_t* pool_create(size_t block_size, uint32_t block_count) {
+    if (block_size == 0 || block_count == 0) return NULL;
+    block_size = (block_size + BLOCK_ALIGN - 1) & ~(size_t)(BLOCK_ALIGN - 1);
+    if (block_size > UINT32_MAX || block_size > SIZE_MAX / block_count) return NULL;
+
+    void* allocation = calloc(1, sizeof(pool_t) + CACHE_LINE);
+    if (!allocation) return NULL;
+    pool_t* pool = (pool_t*)(((uintptr_t)allocation + CACHE_LINE - 1) & ~(uintptr_t)(CACHE_LINE - 1));
+    pool->allocation = allocation;
+    // Blocks are carved on demand, so the pages stay untouched until needed
+    pool->base = malloc(block_size * block_count);
+    if (!pool->base) {
+        free(allocation);
+        return NULL;
+    }
+    pool->block_size = block_size;
+    pool->block_count = block_count;
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+void pool_destroy(pool_t* pool) {
+    if (!pool) return;
+    pthread_mutex_destroy(&pool->lock);
+    free(pool->base);
+    free(pool->allocation);
+}
+
+void* pool_get(pool_t* pool) {
+    if (!pool) return NULL;
+
+    pool_cache_t* c = local_cache(pool);
+    if (!c) {
+        pthread_mutex_lock(&pool->lock);
+        void* block = take_block(pool);
+        if (block) pool->gets++; else pool->exhausted++;
+        pthread_mutex_unlock(&pool->lock);
+        return block;
+    }
+
+    if (c->count == 0) {
+        pthread_mutex_lock(&pool->lock);
+        void* block;
+        while (c->count < POOL_CACHE_BATCH && (block = take_block(pool)) != NULL) {
+            c->blocks[c->count++] = block;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        if (c->count == 0) {
+            bump(&c->exhausted);
+            return NULL;
+        }
+    }
+    bump(&c->gets);
+    return c->blocks[--c->count];
+}
+
+void pool_put(pool_t* pool, void* block) {
+    if (!pool || !block) return;
+
+    pool_cache_t* c = local_cache(pool);
+    if (!c) {
+        free_block_t* b = block;
+        pthread_mutex_lock(&pool->lock);
+        b->next = pool->free_list;
+        pool->free_list = b;
+        pool->puts++;
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+
+    // A full cache hands its oldest half back for other threads
+    if (c->count == POOL_CACHE_BLOCKS) {
+        pthread_mutex_lock(&pool->lock);
+        for (uint32_t i = 0; i < POOL_CACHE_BATCH; i++) {
+            free_block_t* b = c->blocks[i];
+            b->next = pool->free_list;
+            pool->free_list = b;
+        }
+        pthread_mutex_unlock(&pool->lock);
+        memmove(c->blocks, c->blocks + POOL_CACHE_BATCH, (POOL_CACHE_BLOCKS - POOL_CACHE_BATCH) * sizeof(void*));
+        c->count -= POOL_CACHE_BATCH;
+    }
+    c->blocks[c->count++] = block;
+    bump(&c->puts);
+}
+
+bool pool_owns(const pool_t* pool, const void* block) {
+    if (!pool || !block) return false;
+    uintptr_t p = (uintptr_t)block, base = (uintptr_t)pool->base;
+    return p >= base && p < base + (uintptr_t)pool->block_size * pool->block_count;
+}
+
+size_t pool_block_size(const pool_t* pool) {
+    return pool ? pool->block_size : 0;
+}
+
+void pool_get_stats(pool_t* pool, pool_stats_t* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    if (!pool) return;
+
+    pthread_mutex_lock(&pool->lock);
+    uint64_t gets = pool->gets, puts = pool->puts;
+    stats->exhausted = pool->exhausted;
+    stats->carved = pool->carved;
+    pthread_mutex_unlock(&pool->lock);
+
+    for (int i = 0; i < POOL_MAX_THREADS; i++) {
+        const pool_cache_t* c = &pool->caches[i];
+        gets += atomic_load_explicit(&c->gets, memory_order_relaxed);
+        puts += atomic_load_explicit(&c->puts, memory_order_relaxed);
+        stats->exhausted += atomic_load_explicit(&c->exhausted, memory_order_relaxed);
+    }
+    // Counters are read while owners count; a put can show before its get
+    stats->block_size = (uint32_t)pool->block_size;
+    stats->block_count = pool->block_count;
+    stats->gets = gets;
+    stats->in_use = gets > puts ? (uint32_t)(gets - puts) : 0;
+}
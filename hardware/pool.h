@@ -0,0 +1,59 @@
+#ifndef POOL_H
+#define POOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Fixed-size block pool for paths that must not reach malloc once warm.
+//
+// pool_create() reserves every block in one allocation; blocks are handed
+// out first from a free list and then by carving untouched space, so pages
+// a pool never needed are never faulted in. Each thread keeps up to
+// POOL_CACHE_BLOCKS free blocks of its own and trades them with the shared
+// free list POOL_CACHE_BATCH at a time under a lock, so a get or put is a
+// few plain loads and stores in the common case. A block may be put back
+// on any thread. Caches belong to thread slots, not threads: when a thread
+// exits, the next new thread adopts its slot and the blocks cached in it.
+//
+// pool_get() returns NULL when every block is out; the caller decides
+// whether to fall back to the heap or drop. Blocks idle in another
+// thread's cache count as out, so size a pool shared by several threads
+// with POOL_CACHE_BLOCKS per thread to spare.
+
+#define POOL_MAX_THREADS    128     // Threads past this go straight to the shared list
+#define POOL_CACHE_BLOCKS   32
+#define POOL_CACHE_BATCH    16
+
+typedef struct {
+    uint32_t block_size;         // Rounded up to 16 bytes
+    uint32_t block_count;
+    uint32_t in_use;
+    uint32_t carved;             // Blocks handed out at least once: the high-water mark
+    uint64_t gets;
+    uint64_t exhausted;          // pool_get() calls that found no block
+} pool_stats_t;
+
+typedef struct pool pool_t;
+
+pool_t* pool_create(size_t block_size, uint32_t block_count);
+void pool_destroy(pool_t* pool);
+
+void* pool_get(pool_t* pool);
+void pool_put(pool_t* pool, void* block);
+
+// True when block came from pool; any pointer may be asked about
+bool pool_owns(const pool_t* pool, const void* block);
+size_t pool_block_size(const pool_t* pool);
+
+void pool_get_stats(pool_t* pool, pool_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // POOL_H
@@ -14,6 +14,7 @@
 /* USER CODE END Header */
 
 #include "power_monitor.h"
+#include "thresholds.h"
 #include "stm32_interface.h"
 #include "sensor_library.h"
 #include "main.h"
@@ -23,19 +24,15 @@
 static voltage_divider_config_t voltage_sensors[MAX_POWER_MODULES];
 static acs712_config_t current_sensors[MAX_POWER_MODULES];
 static lm35_config_t temperature_sensors[MAX_POWER_MODULES];
-static uint16_t voltage_limits_min[MAX_POWER_MODULES];
-static uint16_t voltage_limits_max[MAX_POWER_MODULES];
-static uint16_t current_limits[MAX_POWER_MODULES];
-static uint8_t temperature_limits[MAX_POWER_MODULES];
 static bool power_modules_enabled[MAX_POWER_MODULES];
 
 /* Private function prototypes -----------------------------------------------*/
 static void read_power_module_data(uint8_t module_id, stm32_power_module_data_t* module);
 static void update_power_module_status(uint8_t module_id, stm32_power_module_data_t* module);
-static bool check_voltage_faults(uint8_t module_id, uint16_t voltage_mv);
-static bool check_current_faults(uint8_t module_id, uint16_t current_ma);
-static bool check_temperature_faults(uint8_t module_id, uint8_t temperature_c);
-static bool check_power_faults(uint8_t module_id, uint32_t power_mw);
+static bool check_voltage_faults(const thresholds_t* t, uint8_t module_id, uint16_t voltage_mv);
+static bool check_current_faults(const thresholds_t* t, uint8_t module_id, uint16_t current_ma);
+static bool check_temperature_faults(const thresholds_t* t, uint8_t module_id, uint8_t temperature_c);
+static bool check_power_faults(const thresholds_t* t, uint8_t module_id, uint32_t power_mw);
 
 /* USER CODE BEGIN 0 */
 
@@ -46,20 +43,16 @@ void power_monitor_init(void) {
     // Initialize voltage sensors (ADC channels 0-3)
     for (int i = 0; i < MAX_POWER_MODULES; i++) {
         voltage_divider_init(&voltage_sensors[i], ADC_CHANNEL_0 + i, 47000, 3300); // 53V range
-        voltage_limits_min[i] = VOLTAGE_MIN_MV;
-        voltage_limits_max[i] = VOLTAGE_MAX_MV;
     }
     
     // Initialize current sensors (ADC channels 9-12)
     for (int i = 0; i < MAX_POWER_MODULES; i++) {
         acs712_init(&current_sensors[i], ADC_CHANNEL_9 + i, ACS712_30A_SENSITIVITY);
-        current_limits[i] = CURRENT_MAX_MA;
     }
     
     // Initialize temperature sensors (ADC channels 11-14)
     for (int i = 0; i < MAX_POWER_MODULES; i++) {
         lm35_init(&temperature_sensors[i], ADC_CHANNEL_11 + i);
-        temperature_limits[i] = TEMPERATURE_MAX_C;
     }
     
     // Enable all power modules by default
@@ -92,27 +85,29 @@ void power_monitor_update_status(stm32_power_module_data_t* modules, uint8_t cou
 bool power_monitor_check_faults(stm32_power_module_data_t* module) {
     bool has_fault = false;
     module->fault_flags = 0;
+    // Limits come from one configuration for all four checks
+    const thresholds_t* t = thresholds_current();
     
     // Check voltage faults
-    if (check_voltage_faults(module->moduleId - 1, module->voltage)) {
+    if (check_voltage_faults(t, module->moduleId - 1, module->voltage)) {
         module->fault_flags |= FAULT_VOLTAGE_LOW | FAULT_VOLTAGE_HIGH;
         has_fault = true;
     }
     
     // Check current faults
-    if (check_current_faults(module->moduleId - 1, module->current)) {
+    if (check_current_faults(t, module->moduleId - 1, module->current)) {
         module->fault_flags |= FAULT_CURRENT_HIGH;
         has_fault = true;
     }
     
     // Check temperature faults
-    if (check_temperature_faults(module->moduleId - 1, module->temperature)) {
+    if (check_temperature_faults(t, module->moduleId - 1, module->temperature)) {
         module->fault_flags |= FAULT_TEMPERATURE_HIGH;
         has_fault = true;
     }
     
     // Check power faults
-    if (check_power_faults(module->moduleId - 1, module->power)) {
+    if (check_power_faults(t, module->moduleId - 1, module->power)) {
         module->fault_flags |= FAULT_POWER_OVERLOAD;
         has_fault = true;
     }
@@ -247,8 +242,11 @@ void power_monitor_calibrate_temperature(uint8_t module_id, uint8_t reference_c)
 void power_monitor_set_voltage_limits(uint8_t module_id, uint16_t min_mv, uint16_t max_mv) {
     if (module_id >= MAX_POWER_MODULES) return;
     
-    voltage_limits_min[module_id] = min_mv;
-    voltage_limits_max[module_id] = max_mv;
+    // Both limits switch together in one new configuration
+    thresholds_t next = *thresholds_current();
+    next.module_voltage_min_mv[module_id] = min_mv;
+    next.module_voltage_max_mv[module_id] = max_mv;
+    thresholds_publish(&next);
 }
 
 /**
@@ -257,7 +255,9 @@ void power_monitor_set_voltage_limits(uint8_t module_id, uint16_t min_mv, uint16
 void power_monitor_set_current_limit(uint8_t module_id, uint16_t max_ma) {
     if (module_id >= MAX_POWER_MODULES) return;
     
-    current_limits[module_id] = max_ma;
+    thresholds_t next = *thresholds_current();
+    next.module_current_max_ma[module_id] = max_ma;
+    thresholds_publish(&next);
 }
 
 /**
@@ -266,7 +266,9 @@ void power_monitor_set_current_limit(uint8_t module_id, uint16_t max_ma) {
 void power_monitor_set_temperature_limit(uint8_t module_id, uint8_t max_c) {
     if (module_id >= MAX_POWER_MODULES) return;
     
-    temperature_limits[module_id] = max_c;
+    thresholds_t next = *thresholds_current();
+    next.module_temperature_max_c[module_id] = max_c;
+    thresholds_publish(&next);
 }
 
 /* Private functions ---------------------------------------------------------*/
@@ -320,38 +322,38 @@ static void update_power_module_status(uint8_t module_id, stm32_power_module_dat
 /**
  * @brief Check voltage faults
  */
-static bool check_voltage_faults(uint8_t module_id, uint16_t voltage_mv) {
+static bool check_voltage_faults(const thresholds_t* t, uint8_t module_id, uint16_t voltage_mv) {
     if (module_id >= MAX_POWER_MODULES) return false;
     
-    return (voltage_mv < voltage_limits_min[module_id] || 
-            voltage_mv > voltage_limits_max[module_id]);
+    return (voltage_mv < t->module_voltage_min_mv[module_id] || 
+            voltage_mv > t->module_voltage_max_mv[module_id]);
 }
 
 /**
  * @brief Check current faults
  */
-static bool check_current_faults(uint8_t module_id, uint16_t current_ma) {
+static bool check_current_faults(const thresholds_t* t, uint8_t module_id, uint16_t current_ma) {
     if (module_id >= MAX_POWER_MODULES) return false;
     
-    return (current_ma > current_limits[module_id]);
+    return (current_ma > t->module_current_max_ma[module_id]);
 }
 
 /**
  * @brief Check temperature faults
  */
-static bool check_temperature_faults(uint8_t module_id, uint8_t temperature_c) {
+static bool check_temperature_faults(const thresholds_t* t, uint8_t module_id, uint8_t temperature_c) {
     if (module_id >= MAX_POWER_MODULES) return false;
     
-    return (temperature_c > temperature_limits[module_id]);
+    return (temperature_c > t->module_temperature_max_c[module_id]);
 }
 
 /**
  * @brief Check power faults
  */
-static bool check_power_faults(uint8_t module_id, uint32_t power_mw) {
+static bool check_power_faults(const thresholds_t* t, uint8_t module_id, uint32_t power_mw) {
     if (module_id >= MAX_POWER_MODULES) return false;
     
-    return (power_mw > POWER_MAX_MW);
+    return (power_mw > t->module_power_max_mw);
 }
 
 /* USER CODE END 0 */
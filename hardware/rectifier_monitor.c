@@ -8,8 +8,13 @@
 #include <winsock2.h>
 #include <windows.h>
 #include <time.h>
+#include "spool.h"
 #pragma comment(lib, "ws2_32.lib")
 
+#define SPOOL_DIRECTORY     "rectifier_spool"
+#define SPOOL_CATCHUP_RATE  50      // Yeniden bağlanınca saniyede gönderilecek kayıt
+#define SPOOL_MAX_MB        64
+
 // Rectifier veri yapısı
 typedef struct {
     int rectifier_id;
@@ -35,6 +40,7 @@ SOCKET server_socket;
 int is_running = 1;
 RectifierData rectifiers[10];  // Maksimum 10 rectifier
 SystemStatus system_status;
+spool_t* spool = NULL;         // Backend yokken verinin tutulduğu disk kuyruğu
 
 // Rectifier verisi oku (simülasyon - gerçekte donanım API'si kullanılacak)
 RectifierData read_rectifier_data(int rect_id) {
@@ -151,45 +157,113 @@ int start_tcp_server() {
     return 1;
 }
 
-// Ana veri gönderme döngüsü
-void data_sending_loop() {
-    SOCKET client_socket;
+// Backend bağlantısını en fazla timeout_ms kadar bekle
+SOCKET wait_for_backend(int timeout_ms) {
+    fd_set read_set;
+    struct timeval tv;
     struct sockaddr_in client;
     int c = sizeof(struct sockaddr_in);
+
+    FD_ZERO(&read_set);
+    FD_SET(server_socket, &read_set);
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    if (select(0, &read_set, NULL, NULL, &tv) <= 0) {
+        return INVALID_SOCKET;
+    }
+
+    SOCKET client_socket = accept(server_socket, (struct sockaddr *)&client, &c);
+    if (client_socket == INVALID_SOCKET) {
+        printf("Bağlantı kabul edilemedi. Hata: %d\n", WSAGetLastError());
+    }
+    return client_socket;
+}
+
+// Diskte biriken veriyi catch-up hızında backend'e gönder.
+// duration_ms boyunca çalışır; bağlantı koparsa 0 döner.
+int replay_spool(SOCKET client_socket, DWORD duration_ms) {
+    static char record[SPOOL_MAX_RECORD];
+    DWORD start = GetTickCount();
+    int ok = 1;
+
+    while (ok && GetTickCount() - start < duration_ms && !spool_is_empty(spool)) {
+        uint32_t budget = spool_replay_budget(spool, GetTickCount64());
+        uint32_t sent = 0;
+        uint32_t length;
+
+        while (sent < budget && spool_peek(spool, (uint8_t*)record, sizeof(record), &length) == HW_STATUS_OK) {
+            if (send(client_socket, record, (int)length, 0) == SOCKET_ERROR) {
+                ok = 0;
+                break;
+            }
+            spool_advance(spool);
+            sent++;
+        }
+        spool_consume_budget(spool, sent);
+        spool_commit(spool);
+        if (sent == 0) Sleep(50);
+    }
+
+    if (ok && spool_is_empty(spool)) {
+        printf("Diskte bekleyen veri gönderildi.\n");
+    }
+    return ok;
+}
+
+// Ana veri gönderme döngüsü.
+// Backend bağlı değilken veri okunmaya devam eder ve diske yazılır; bağlantı
+// gelince önce biriken veri, ardından canlı veri sırayla gönderilir.
+void data_sending_loop() {
+    SOCKET client_socket = INVALID_SOCKET;
     
     while (is_running) {
-        // Bağlantı kabul et
-        client_socket = accept(server_socket, (struct sockaddr *)&client, &c);
         if (client_socket == INVALID_SOCKET) {
-            printf("Bağlantı kabul edilemedi. Hata: %d\n", WSAGetLastError());
-            continue;
+            // 2 saniyelik bekleme aynı zamanda okuma periyodudur
+            client_socket = wait_for_backend(2000);
+            if (client_socket != INVALID_SOCKET) {
+                printf("Node.js backend bağlandı! Veri gönderiliyor...\n");
+            }
         }
         
-        printf("Node.js backend bağlandı! Veri gönderiliyor...\n");
+        // Rectifier verilerini oku
+        for (int i = 0; i < 4; i++) {
+            rectifiers[i] = read_rectifier_data(i + 1);
+        }
         
-        // Sürekli veri gönder
-        while (is_running) {
-            // Rectifier verilerini oku
-            for (int i = 0; i < 4; i++) {
-                rectifiers[i] = read_rectifier_data(i + 1);
-            }
-            
-            // Sistem durumunu güncelle
-            update_system_status();
-            
-            // JSON veriyi oluştur ve gönder
-            char* json_data = create_json_data();
-            int result = send(client_socket, json_data, strlen(json_data), 0);
-            
-            if (result == SOCKET_ERROR) {
-                printf("Veri gönderilemedi. Bağlantı koptu.\n");
-                break;
-            }
-            
+        // Sistem durumunu güncelle
+        update_system_status();
+        
+        // JSON veriyi oluştur
+        char* json_data = create_json_data();
+        uint32_t length = (uint32_t)strlen(json_data);
+        
+        if (client_socket == INVALID_SOCKET || !spool_is_empty(spool)) {
+            // Sıra bozulmasın: önce biriken veri gitmeli
+            spool_append(spool, (const uint8_t*)json_data, length);
+        } else if (send(client_socket, json_data, (int)length, 0) == SOCKET_ERROR) {
+            printf("Veri gönderilemedi. Bağlantı koptu, veri diske yazılıyor.\n");
+            spool_append(spool, (const uint8_t*)json_data, length);
+            closesocket(client_socket);
+            client_socket = INVALID_SOCKET;
+            continue;
+        } else {
             printf("Veri gönderildi: %s\n", json_data);
-            Sleep(2000);  // 2 saniyede bir güncelle
         }
         
+        if (client_socket != INVALID_SOCKET) {
+            if (!spool_is_empty(spool)) {
+                if (!replay_spool(client_socket, 2000)) {
+                    printf("Biriken veri gönderilirken bağlantı koptu.\n");
+                    closesocket(client_socket);
+                    client_socket = INVALID_SOCKET;
+                }
+            } else {
+                Sleep(2000);  // 2 saniyede bir güncelle
+            }
+        }
+    }
+    
+    if (client_socket != INVALID_SOCKET) {
         closesocket(client_socket);
     }
 }
@@ -198,6 +272,7 @@ void data_sending_loop() {
 void signal_handler(int sig) {
     printf("\nProgram durduruluyor...\n");
     is_running = 0;
+    spool_close(spool);
     closesocket(server_socket);
     WSACleanup();
     exit(0);
@@ -212,6 +287,18 @@ int main() {
     // Random seed
     srand(time(NULL));
     
+    // Disk kuyruğunu aç (önceki çalıştırmadan kalan veri de gönderilir)
+    spool_config_t spool_config;
+    spool_default_config(&spool_config, SPOOL_DIRECTORY);
+    spool_config.replay_rate = SPOOL_CATCHUP_RATE;
+    spool_config.max_bytes = (uint64_t)SPOOL_MAX_MB * 1024 * 1024;
+    spool_config.sync_on_append = true;  // 2 saniyede bir kayıt; fsync maliyeti önemsiz
+    spool = spool_open(&spool_config);
+    if (!spool) {
+        printf("Disk kuyruğu açılamadı: %s\n", SPOOL_DIRECTORY);
+        return 1;
+    }
+    
     // TCP sunucusu başlat
     if (!start_tcp_server()) {
         printf("TCP sunucusu başlatılamadı!\n");
@@ -221,5 +308,6 @@ int main() {
     // Ana döngü
     data_sending_loop();
     
+    spool_close(spool);
     return 0;
 }
@@ -14,6 +14,7 @@
 /* USER CODE END Header */
 
 #include "safety_system.h"
+#include "thresholds.h"
 #include "stm32_interface.h"
 #include "main.h"
 #include <string.h>
@@ -27,11 +28,6 @@ static uint32_t last_check_time = 0;
 static uint32_t uptime_start = 0;
 static bool last_check_results[6] = {true, true, true, true, true, true};
 static char last_warning_message[64] = "";
-static uint16_t voltage_min_mv = VOLTAGE_CRITICAL_LOW_MV;
-static uint16_t voltage_max_mv = VOLTAGE_CRITICAL_HIGH_MV;
-static uint16_t current_max_ma = CURRENT_CRITICAL_HIGH_MA;
-static uint8_t temperature_max_c = TEMP_CRITICAL_HIGH_C;
-static uint32_t power_max_mw = POWER_CRITICAL_HIGH_MW;
 
 /* Private function prototypes -----------------------------------------------*/
 static void update_safety_state(void);
@@ -57,12 +53,7 @@ void safety_system_init(void) {
     // Clear warning message
     memset(last_warning_message, 0, sizeof(last_warning_message));
     
-    // Set default safety thresholds
-    voltage_min_mv = VOLTAGE_CRITICAL_LOW_MV;
-    voltage_max_mv = VOLTAGE_CRITICAL_HIGH_MV;
-    current_max_ma = CURRENT_CRITICAL_HIGH_MA;
-    temperature_max_c = TEMP_CRITICAL_HIGH_C;
-    power_max_mw = POWER_CRITICAL_HIGH_MW;
+    // Safety thresholds live in the shared configuration (thresholds.h)
 }
 
 /**
@@ -149,6 +140,7 @@ void safety_system_reset(void) {
  * @brief Check voltage safety
  */
 bool safety_system_check_voltage(stm32_power_module_data_t* modules, uint8_t count) {
+    const thresholds_t* t = thresholds_current();
     if (modules == NULL || count == 0) {
         // Simulate voltage check for demo
         static uint16_t simulated_voltage = 53000; // 53V
@@ -159,7 +151,7 @@ bool safety_system_check_voltage(stm32_power_module_data_t* modules, uint8_t cou
             variation = -variation;
         }
         
-        bool safe = (simulated_voltage >= voltage_min_mv && simulated_voltage <= voltage_max_mv);
+        bool safe = (simulated_voltage >= t->safety_voltage_min_mv && simulated_voltage <= t->safety_voltage_max_mv);
         
         if (!safe) {
             char message[64];
@@ -172,7 +164,7 @@ bool safety_system_check_voltage(stm32_power_module_data_t* modules, uint8_t cou
     
     // Check actual module voltages
     for (int i = 0; i < count; i++) {
-        if (modules[i].voltage < voltage_min_mv || modules[i].voltage > voltage_max_mv) {
+        if (modules[i].voltage < t->safety_voltage_min_mv || modules[i].voltage > t->safety_voltage_max_mv) {
             char message[64];
             snprintf(message, sizeof(message), "Module %d voltage unsafe: %d mV", 
                     modules[i].moduleId, modules[i].voltage);
@@ -188,6 +180,7 @@ bool safety_system_check_voltage(stm32_power_module_data_t* modules, uint8_t cou
  * @brief Check current safety
  */
 bool safety_system_check_current(stm32_power_module_data_t* modules, uint8_t count) {
+    const thresholds_t* t = thresholds_current();
     if (modules == NULL || count == 0) {
         // Simulate current check for demo
         static uint16_t simulated_current = 25000; // 25A
@@ -198,7 +191,7 @@ bool safety_system_check_current(stm32_power_module_data_t* modules, uint8_t cou
             variation = -variation;
         }
         
-        bool safe = (simulated_current <= current_max_ma);
+        bool safe = (simulated_current <= t->safety_current_max_ma);
         
         if (!safe) {
             char message[64];
@@ -211,7 +204,7 @@ bool safety_system_check_current(stm32_power_module_data_t* modules, uint8_t cou
     
     // Check actual module currents
     for (int i = 0; i < count; i++) {
-        if (modules[i].current > current_max_ma) {
+        if (modules[i].current > t->safety_current_max_ma) {
             char message[64];
             snprintf(message, sizeof(message), "Module %d current too high: %d mA", 
                     modules[i].moduleId, modules[i].current);
@@ -227,6 +220,7 @@ bool safety_system_check_current(stm32_power_module_data_t* modules, uint8_t cou
  * @brief Check temperature safety
  */
 bool safety_system_check_temperature(stm32_power_module_data_t* modules, uint8_t count) {
+    const thresholds_t* t = thresholds_current();
     if (modules == NULL || count == 0) {
         // Simulate temperature check for demo
         static uint8_t simulated_temp = 45; // 45°C
@@ -237,7 +231,7 @@ bool safety_system_check_temperature(stm32_power_module_data_t* modules, uint8_t
             variation = -variation;
         }
         
-        bool safe = (simulated_temp <= temperature_max_c);
+        bool safe = (simulated_temp <= t->safety_temperature_max_c);
         
         if (!safe) {
             char message[64];
@@ -250,7 +244,7 @@ bool safety_system_check_temperature(stm32_power_module_data_t* modules, uint8_t
     
     // Check actual module temperatures
     for (int i = 0; i < count; i++) {
-        if (modules[i].temperature > temperature_max_c) {
+        if (modules[i].temperature > t->safety_temperature_max_c) {
             char message[64];
             snprintf(message, sizeof(message), "Module %d temperature too high: %d°C", 
                     modules[i].moduleId, modules[i].temperature);
@@ -266,6 +260,7 @@ bool safety_system_check_temperature(stm32_power_module_data_t* modules, uint8_t
  * @brief Check power safety
  */
 bool safety_system_check_power(stm32_power_module_data_t* modules, uint8_t count) {
+    const thresholds_t* t = thresholds_current();
     if (modules == NULL || count == 0) {
         // Simulate power check for demo
         static uint32_t simulated_power = 1200000; // 1.2kW
@@ -276,7 +271,7 @@ bool safety_system_check_power(stm32_power_module_data_t* modules, uint8_t count
             variation = -variation;
         }
         
-        bool safe = (simulated_power <= power_max_mw);
+        bool safe = (simulated_power <= t->safety_power_max_mw);
         
         if (!safe) {
             char message[64];
@@ -289,7 +284,7 @@ bool safety_system_check_power(stm32_power_module_data_t* modules, uint8_t count
     
     // Check actual module powers
     for (int i = 0; i < count; i++) {
-        if (modules[i].power > power_max_mw) {
+        if (modules[i].power > t->safety_power_max_mw) {
             char message[64];
             snprintf(message, sizeof(message), "Module %d power too high: %d mW", 
                     modules[i].moduleId, modules[i].power);
@@ -409,29 +404,37 @@ void safety_system_shutdown_all_modules(void) {
  * @brief Set voltage limits
  */
 void safety_system_set_voltage_limits(uint16_t min_mv, uint16_t max_mv) {
-    voltage_min_mv = min_mv;
-    voltage_max_mv = max_mv;
+    thresholds_t next = *thresholds_current();
+    next.safety_voltage_min_mv = min_mv;
+    next.safety_voltage_max_mv = max_mv;
+    thresholds_publish(&next);
 }
 
 /**
  * @brief Set current limit
  */
 void safety_system_set_current_limit(uint16_t max_ma) {
-    current_max_ma = max_ma;
+    thresholds_t next = *thresholds_current();
+    next.safety_current_max_ma = max_ma;
+    thresholds_publish(&next);
 }
 
 /**
  * @brief Set temperature limit
  */
 void safety_system_set_temperature_limit(uint8_t max_c) {
-    temperature_max_c = max_c;
+    thresholds_t next = *thresholds_current();
+    next.safety_temperature_max_c = max_c;
+    thresholds_publish(&next);
 }
 
 /**
  * @brief Set power limit
  */
 void safety_system_set_power_limit(uint32_t max_mw) {
-    power_max_mw = max_mw;
+    thresholds_t next = *thresholds_current();
+    next.safety_power_max_mw = max_mw;
+    thresholds_publish(&next);
 }
 
 /**
@@ -0,0 +1,644 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+#include "spool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#define PATH_SEP '\\'
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#define PATH_SEP '/'
+#endif
+
+// Record: [magic u16 'SP'][reserved u16][length u32][crc32 u32][payload]
+#define RECORD_MAGIC        0x5053
+#define RECORD_HEADER_SIZE  12
+#define OFFSET_FILE         "spool.offset"
+#define OFFSET_TEMP_FILE    "spool.offset.tmp"
+
+typedef struct {
+    uint64_t id;
+    uint64_t size;
+} spool_segment_t;
+
+struct spool {
+    spool_config_t config;
+    spool_segment_t* segments;     // Ascending by id; the last one is written
+    uint32_t segment_count;
+    uint32_t segment_capacity;
+    uint64_t total_bytes;
+
+    FILE* write_file;
+    bool write_dirty;              // Appended data not yet flushed to the OS
+
+    FILE* read_file;
+    uint64_t read_file_id;
+    uint64_t read_id;
+    uint64_t read_offset;
+    uint32_t peeked_size;          // Record size at the cursor after a peek
+
+    double tokens;
+    uint64_t last_refill_ms;
+    spool_stats_t stats;
+};
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xEDB88320); a constant table,
+// so spools opened from several threads share it without setup
+static const uint32_t crc_table[256] = {
+    0x00000000u, 0x77073096u, 0xEE0E612Cu, 0x990951BAu, 0x076DC419u, 0x706AF48Fu,
+    0xE963A535u, 0x9E6495A3u, 0x0EDB8832u, 0x79DCB8A4u, 0xE0D5E91Eu, 0x97D2D988u,
+    0x09B64C2Bu, 0x7EB17CBDu, 0xE7B82D07u, 0x90BF1D91u, 0x1DB71064u, 0x6AB020F2u,
+    0xF3B97148u, 0x84BE41DEu, 0x1ADAD47Du, 0x6DDDE4EBu, 0xF4D4B551u, 0x83D385C7u,
+    0x136C9856u, 0x646BA8C0u, 0xFD62F97Au, 0x8A65C9ECu, 0x14015C4Fu, 0x63066CD9u,
+    0xFA0F3D63u, 0x8D080DF5u, 0x3B6E20C8u, 0x4C69105Eu, 0xD56041E4u, 0xA2677172u,
+    0x3C03E4D1u, 0x4B04D447u, 0xD20D85FDu, 0xA50AB56Bu, 0x35B5A8FAu, 0x42B2986Cu,
+    0xDBBBC9D6u, 0xACBCF940u, 0x32D86CE3u, 0x45DF5C75u, 0xDCD60DCFu, 0xABD13D59u,
+    0x26D930ACu, 0x51DE003Au, 0xC8D75180u, 0xBFD06116u, 0x21B4F4B5u, 0x56B3C423u,
+    0xCFBA9599u, 0xB8BDA50Fu, 0x2802B89Eu, 0x5F058808u, 0xC60CD9B2u, 0xB10BE924u,
+    0x2F6F7C87u, 0x58684C11u, 0xC1611DABu, 0xB6662D3Du, 0x76DC4190u, 0x01DB7106u,
+    0x98D220BCu, 0xEFD5102Au, 0x71B18589u, 0x06B6B51Fu, 0x9FBFE4A5u, 0xE8B8D433u,
+    0x7807C9A2u, 0x0F00F934u, 0x9609A88Eu, 0xE10E9818u, 0x7F6A0DBBu, 0x086D3D2Du,
+    0x91646C97u, 0xE6635C01u, 0x6B6B51F4u, 0x1C6C6162u, 0x856530D8u, 0xF262004Eu,
+    0x6C0695EDu, 0x1B01A57Bu, 0x8208F4C1u, 0xF50FC457u, 0x65B0D9C6u, 0x12B7E950u,
+    0x8BBEB8EAu, 0xFCB9887Cu, 0x62DD1DDFu, 0x15DA2D49u, 0x8CD37CF3u, 0xFBD44C65u,
+    0x4DB26158u, 0x3AB551CEu, 0xA3BC0074u, 0xD4BB30E2u, 0x4ADFA541u, 0x3DD895D7u,
+    0xA4D1C46Du, 0xD3D6F4FBu, 0x4369E96Au, 0x346ED9FCu, 0xAD678846u, 0xDA60B8D0u,
+    0x44042D73u, 0x33031DE5u, 0xAA0A4C5Fu, 0xDD0D7CC9u, 0x5005713Cu, 0x270241AAu,
+    0xBE0B1010u, 0xC90C2086u, 0x5768B525u, 0x206F85B3u, 0xB966D409u, 0xCE61E49Fu,
+    0x5EDEF90Eu, 0x29D9C998u, 0xB0D09822u, 0xC7D7A8B4u, 0x59B33D17u, 0x2EB40D81u,
+    0xB7BD5C3Bu, 0xC0BA6CADu, 0xEDB88320u, 0x9ABFB3B6u, 0x03B6E20Cu, 0x74B1D29Au,
+    0xEAD54739u, 0x9DD277AFu, 0x04DB2615u, 0x73DC1683u, 0xE3630B12u, 0x94643B84u,
+    0x0D6D6A3Eu, 0x7A6A5AA8u, 0xE40ECF0Bu, 0x9309FF9Du, 0x0A00AE27u, 0x7D079EB1u,
+    0xF00F9344u, 0x8708A3D2u, 0x1E01F268u, 0x6906C2FEu, 0xF762575Du, 0x806567CBu,
+    0x196C3671u, 0x6E6B06E7u, 0xFED41B76u, 0x89D32BE0u, 0x10DA7A5Au, 0x67DD4ACCu,
+    0xF9B9DF6Fu, 0x8EBEEFF9u, 0x17B7BE43u, 0x60B08ED5u, 0xD6D6A3E8u, 0xA1D1937Eu,
+    0x38D8C2C4u, 0x4FDFF252u, 0xD1BB67F1u, 0xA6BC5767u, 0x3FB506DDu, 0x48B2364Bu,
+    0xD80D2BDAu, 0xAF0A1B4Cu, 0x36034AF6u, 0x41047A60u, 0xDF60EFC3u, 0xA867DF55u,
+    0x316E8EEFu, 0x4669BE79u, 0xCB61B38Cu, 0xBC66831Au, 0x256FD2A0u, 0x5268E236u,
+    0xCC0C7795u, 0xBB0B4703u, 0x220216B9u, 0x5505262Fu, 0xC5BA3BBEu, 0xB2BD0B28u,
+    0x2BB45A92u, 0x5CB36A04u, 0xC2D7FFA7u, 0xB5D0CF31u, 0x2CD99E8Bu, 0x5BDEAE1Du,
+    0x9B64C2B0u, 0xEC63F226u, 0x756AA39Cu, 0x026D930Au, 0x9C0906A9u, 0xEB0E363Fu,
+    0x72076785u, 0x05005713u, 0x95BF4A82u, 0xE2B87A14u, 0x7BB12BAEu, 0x0CB61B38u,
+    0x92D28E9Bu, 0xE5D5BE0Du, 0x7CDCEFB7u, 0x0BDBDF21u, 0x86D3D2D4u, 0xF1D4E242u,
+    0x68DDB3F8u, 0x1FDA836Eu, 0x81BE16CDu, 0xF6B9265Bu, 0x6FB077E1u, 0x18B74777u,
+    0x88085AE6u, 0xFF0F6A70u, 0x66063BCAu, 0x11010B5Cu, 0x8F659EFFu, 0xF862AE69u,
+    0x616BFFD3u, 0x166CCF45u, 0xA00AE278u, 0xD70DD2EEu, 0x4E048354u, 0x3903B3C2u,
+    0xA7672661u, 0xD06016F7u, 0x4969474Du, 0x3E6E77DBu, 0xAED16A4Au, 0xD9D65ADCu,
+    0x40DF0B66u, 0x37D83BF0u, 0xA9BCAE53u, 0xDEBB9EC5u, 0x47B2CF7Fu, 0x30B5FFE9u,
+    0xBDBDF21Cu, 0xCABAC28Au, 0x53B39330u, 0x24B4A3A6u, 0xBAD03605u, 0xCDD70693u,
+    0x54DE5729u, 0x23D967BFu, 0xB3667A2Eu, 0xC4614AB8u, 0x5D681B02u, 0x2A6F2B94u,
+    0xB40BBE37u, 0xC30C8EA1u, 0x5A05DF1Bu, 0x2D02EF8Du,
+};
+
+static uint32_t crc32_compute(const uint8_t* data, size_t length) {
+    uint32_t c = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        c = crc_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFFu;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Platform helpers
+static void make_directory(const char* path) {
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+static void file_sync(FILE* f) {
+    fflush(f);
+#ifdef _WIN32
+    _commit(_fileno(f));
+#else
+    fsync(fileno(f));
+#endif
+}
+
+static int file_truncate(const char* path, uint64_t size) {
+#ifdef _WIN32
+    FILE* f = fopen(path, "r+b");
+    if (!f) return -1;
+    int rc = _chsize_s(_fileno(f), (__int64)size);
+    fclose(f);
+    return rc;
+#else
+    return truncate(path, (off_t)size);
+#endif
+}
+
+static int file_replace(const char* from, const char* to) {
+#ifdef _WIN32
+    return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+    return rename(from, to);
+#endif
+}
+
+static void segment_path(const spool_t* spool, uint64_t id, char* out, size_t size) {
+    snprintf(out, size, "%s%c%016llx.seg", spool->config.directory, PATH_SEP, (unsigned long long)id);
+}
+
+static void spool_file_path(const spool_t* spool, const char* name, char* out, size_t size) {
+    snprintf(out, size, "%s%c%s", spool->config.directory, PATH_SEP, name);
+}
+
+static bool parse_segment_name(const char* name, uint64_t* id) {
+    size_t len = strlen(name);
+    if (len != 20 || strcmp(name + 16, ".seg") != 0) return false;
+    char* end = NULL;
+    unsigned long long value = strtoull(name, &end, 16);
+    if (end != name + 16) return false;
+    *id = value;
+    return true;
+}
+
+static bool add_segment(spool_t* spool, uint64_t id, uint64_t size) {
+    if (spool->segment_count == spool->segment_capacity) {
+        uint32_t capacity = spool->segment_capacity ? spool->segment_capacity * 2 : 16;
+        spool_segment_t* grown = realloc(spool->segments, capacity * sizeof(spool_segment_t));
+        if (!grown) return false;
+        spool->segments = grown;
+        spool->segment_capacity = capacity;
+    }
+    spool->segments[spool->segment_count].id = id;
+    spool->segments[spool->segment_count].size = size;
+    spool->segment_count++;
+    spool->total_bytes += size;
+    return true;
+}
+
+static int compare_segments(const void* a, const void* b) {
+    uint64_t x = ((const spool_segment_t*)a)->id, y = ((const spool_segment_t*)b)->id;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t file_size(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size > 0 ? (uint64_t)size : 0;
+}
+
+static bool list_segments(spool_t* spool) {
+    char path[SPOOL_PATH_MAX + 32];
+    uint64_t id;
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd;
+    snprintf(path, sizeof(path), "%s\\*.seg", spool->config.directory);
+    HANDLE h = FindFirstFileA(path, &fd);
+    if (h != INVALID_HANDLE_VALUE) {
+        do {
+            if (parse_segment_name(fd.cFileName, &id)) {
+                segment_path(spool, id, path, sizeof(path));
+                if (!add_segment(spool, id, file_size(path))) return false;
+            }
+        } while (FindNextFileA(h, &fd));
+        FindClose(h);
+    }
+#else
+    DIR* dir = opendir(spool->config.directory);
+    if (!dir) return false;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (parse_segment_name(entry->d_name, &id)) {
+            segment_path(spool, id, path, sizeof(path));
+            if (!add_segment(spool, id, file_size(path))) {
+                closedir(dir);
+                return false;
+            }
+        }
+    }
+    closedir(dir);
+#endif
+    qsort(spool->segments, spool->segment_count, sizeof(spool_segment_t), compare_segments);
+    return true;
+}
+
+// Reads and validates the record header at the current file position.
+// Returns the payload length, or -1 on a torn or corrupt record.
+static long read_record_header(FILE* f, uint32_t* crc) {
+    uint8_t header[RECORD_HEADER_SIZE];
+    if (fread(header, 1, RECORD_HEADER_SIZE, f) != RECORD_HEADER_SIZE) return -1;
+    if ((header[0] | (header[1] << 8)) != RECORD_MAGIC) return -1;
+    uint32_t length = get32(header + 4);
+    if (length > SPOOL_MAX_RECORD) return -1;
+    *crc = get32(header + 8);
+    return (long)length;
+}
+
+// Only the segment being written can hold a torn tail; cut it back to the
+// last complete record.
+static void recover_tail(spool_t* spool) {
+    if (spool->segment_count == 0) return;
+
+    spool_segment_t* seg = &spool->segments[spool->segment_count - 1];
+    char path[SPOOL_PATH_MAX + 32];
+    segment_path(spool, seg->id, path, sizeof(path));
+    FILE* f = fopen(path, "rb");
+    if (!f) return;
+
+    uint8_t* payload = malloc(SPOOL_MAX_RECORD);
+    uint64_t good = 0;
+    while (payload && good < seg->size) {
+        uint32_t crc;
+        long length = read_record_header(f, &crc);
+        if (length < 0 || fread(payload, 1, (size_t)length, f) != (size_t)length ||
+            crc32_compute(payload, (size_t)length) != crc) {
+            break;
+        }
+        good += RECORD_HEADER_SIZE + (uint64_t)length;
+    }
+    free(payload);
+    fclose(f);
+
+    if (good < seg->size) {
+        spool->stats.records_recovered_torn++;
+        file_truncate(path, good);
+        spool->total_bytes -= seg->size - good;
+        seg->size = good;
+    }
+}
+
+static void load_committed_offset(spool_t* spool) {
+    char path[SPOOL_PATH_MAX + 32];
+    uint8_t buf[20];
+    spool_file_path(spool, OFFSET_FILE, path, sizeof(path));
+
+    spool->read_id = spool->segment_count ? spool->segments[0].id : 1;
+    spool->read_offset = 0;
+
+    FILE* f = fopen(path, "rb");
+    if (!f) return;
+    size_t n = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    if (n != sizeof(buf) || crc32_compute(buf, 16) != get32(buf + 16)) return;
+
+    uint64_t id = (uint64_t)get32(buf) | ((uint64_t)get32(buf + 4) << 32);
+    uint64_t offset = (uint64_t)get32(buf + 8) | ((uint64_t)get32(buf + 12) << 32);
+    for (uint32_t i = 0; i < spool->segment_count; i++) {
+        if (spool->segments[i].id == id) {
+            spool->read_id = id;
+            spool->read_offset = offset <= spool->segments[i].size ? offset : spool->segments[i].size;
+            return;
+        }
+    }
+    // The committed segment was fully consumed and deleted; resume at the oldest one
+}
+
+void spool_default_config(spool_config_t* config, const char* directory) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    snprintf(config->directory, sizeof(config->directory), "%s", directory ? directory : "spool");
+    config->segment_bytes = SPOOL_DEFAULT_SEGMENT;
+    config->max_bytes = SPOOL_DEFAULT_MAX_BYTES;
+    config->drop_policy = SPOOL_DROP_OLDEST;
+    config->replay_rate = 0;
+    config->sync_on_append = false;
+}
+
+spool_t* spool_open(const spool_config_t* config) {
+    if (!config || !config->directory[0]) return NULL;
+
+    spool_t* spool = calloc(1, sizeof(spool_t));
+    if (!spool) return NULL;
+    spool->config = *config;
+    if (spool->config.segment_bytes < 4096) spool->config.segment_bytes = 4096;
+    if (spool->config.max_bytes < 2ull * spool->config.segment_bytes) {
+        spool->config.max_bytes = 2ull * spool->config.segment_bytes;
+    }
+
+    make_directory(spool->config.directory);
+    if (!list_segments(spool)) {
+        fprintf(stderr, "Spool: cannot read directory %s\n", spool->config.directory);
+        spool_close(spool);
+        return NULL;
+    }
+    recover_tail(spool);
+    load_committed_offset(spool);
+    return spool;
+}
+
+void spool_close(spool_t* spool) {
+    if (!spool) return;
+
+    if (spool->write_file) {
+        file_sync(spool->write_file);
+        fclose(spool->write_file);
+    }
+    if (spool->read_file) fclose(spool->read_file);
+    free(spool->segments);
+    free(spool);
+}
+
+static spool_segment_t* find_segment(spool_t* spool, uint64_t id) {
+    for (uint32_t i = 0; i < spool->segment_count; i++) {
+        if (spool->segments[i].id == id) return &spool->segments[i];
+    }
+    return NULL;
+}
+
+static void close_reader(spool_t* spool) {
+    if (spool->read_file) {
+        fclose(spool->read_file);
+        spool->read_file = NULL;
+    }
+    spool->peeked_size = 0;
+}
+
+// Counts unread records between the cursor and the end of a segment
+static uint64_t count_unread(spool_t* spool, const spool_segment_t* seg, uint64_t from) {
+    char path[SPOOL_PATH_MAX + 32];
+    segment_path(spool, seg->id, path, sizeof(path));
+    FILE* f = fopen(path, "rb");
+    if (!f) return 0;
+
+    uint64_t count = 0;
+    uint64_t pos = from;
+    fseek(f, (long)pos, SEEK_SET);
+    while (pos < seg->size) {
+        uint32_t crc;
+        long length = read_record_header(f, &crc);
+        if (length < 0) break;
+        pos += RECORD_HEADER_SIZE + (uint64_t)length;
+        fseek(f, (long)pos, SEEK_SET);
+        count++;
+    }
+    fclose(f);
+    return count;
+}
+
+static void drop_oldest_segment(spool_t* spool) {
+    spool_segment_t oldest = spool->segments[0];
+    char path[SPOOL_PATH_MAX + 32];
+
+    if (spool->read_id <= oldest.id) {
+        uint64_t from = spool->read_id == oldest.id ? spool->read_offset : 0;
+        spool->stats.records_dropped += count_unread(spool, &oldest, from);
+        close_reader(spool);
+        spool->read_id = spool->segments[1].id;
+        spool->read_offset = 0;
+    }
+
+    segment_path(spool, oldest.id, path, sizeof(path));
+    remove(path);
+    spool->total_bytes -= oldest.size;
+    memmove(spool->segments, spool->segments + 1, (spool->segment_count - 1) * sizeof(spool_segment_t));
+    spool->segment_count--;
+    spool->stats.segments_dropped++;
+}
+
+static bool roll_segment(spool_t* spool) {
+    uint64_t id = spool->segment_count ? spool->segments[spool->segment_count - 1].id + 1 : 1;
+    char path[SPOOL_PATH_MAX + 32];
+
+    if (spool->write_file) {
+        file_sync(spool->write_file);
+        fclose(spool->write_file);
+        spool->write_file = NULL;
+        spool->write_dirty = false;
+    }
+    segment_path(spool, id, path, sizeof(path));
+    spool->write_file = fopen(path, "ab");
+    if (!spool->write_file) return false;
+    if (spool->segment_count == 0) {
+        spool->read_id = id;
+        spool->read_offset = 0;
+    }
+    return add_segment(spool, id, 0);
+}
+
+hw_status_t spool_append(spool_t* spool, const uint8_t* data, uint32_t length) {
+    if (!spool || (!data && length) || length > SPOOL_MAX_RECORD) {
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    uint64_t record_size = RECORD_HEADER_SIZE + (uint64_t)length;
+    while (spool->total_bytes + record_size > spool->config.max_bytes) {
+        if (spool->config.drop_policy == SPOOL_DROP_NEWEST || spool->segment_count < 2) {
+            spool->stats.records_dropped++;
+            return HW_STATUS_ERROR;
+        }
+        drop_oldest_segment(spool);
+    }
+
+    spool_segment_t* tail = spool->segment_count ? &spool->segments[spool->segment_count - 1] : NULL;
+    if (!tail || (tail->size > 0 && tail->size + record_size > spool->config.segment_bytes)) {
+        if (!roll_segment(spool)) return HW_STATUS_ERROR;
+        tail = &spool->segments[spool->segment_count - 1];
+    } else if (!spool->write_file) {
+        char path[SPOOL_PATH_MAX + 32];
+        segment_path(spool, tail->id, path, sizeof(path));
+        spool->write_file = fopen(path, "ab");
+        if (!spool->write_file) return HW_STATUS_ERROR;
+    }
+
+    uint8_t header[RECORD_HEADER_SIZE];
+    header[0] = (uint8_t)(RECORD_MAGIC & 0xFF);
+    header[1] = (uint8_t)(RECORD_MAGIC >> 8);
+    header[2] = 0;
+    header[3] = 0;
+    put32(header + 4, length);
+    put32(header + 8, crc32_compute(data, length));
+    if (fwrite(header, 1, RECORD_HEADER_SIZE, spool->write_file) != RECORD_HEADER_SIZE ||
+        (length && fwrite(data, 1, length, spool->write_file) != length)) {
+        // Cut the partial record off so the next one starts at tail->size;
+        // failing that, seal the segment (readers stop at its size)
+        char path[SPOOL_PATH_MAX + 32];
+        fclose(spool->write_file);
+        spool->write_file = NULL;
+        spool->write_dirty = false;
+        segment_path(spool, tail->id, path, sizeof(path));
+        if (file_truncate(path, tail->size) != 0) roll_segment(spool);
+        return HW_STATUS_ERROR;
+    }
+
+    if (spool->config.sync_on_append) {
+        file_sync(spool->write_file);
+    } else {
+        spool->write_dirty = true;
+    }
+    tail->size += record_size;
+    spool->total_bytes += record_size;
+    spool->stats.records_appended++;
+    return HW_STATUS_OK;
+}
+
+void spool_flush(spool_t* spool) {
+    if (!spool || !spool->write_dirty) return;
+    fflush(spool->write_file);
+    spool->write_dirty = false;
+}
+
+bool spool_is_empty(const spool_t* spool) {
+    if (!spool || spool->segment_count == 0) return true;
+    const spool_segment_t* tail = &spool->segments[spool->segment_count - 1];
+    return spool->read_id == tail->id && spool->read_offset >= tail->size;
+}
+
+hw_status_t spool_peek(spool_t* spool, uint8_t* buffer, uint32_t capacity, uint32_t* length) {
+    if (!spool || !length) return HW_STATUS_INVALID_PARAM;
+
+    spool->peeked_size = 0;
+    for (;;) {
+        if (spool_is_empty(spool)) return HW_STATUS_TIMEOUT;
+
+        spool_segment_t* seg = find_segment(spool, spool->read_id);
+        if (!seg || spool->read_offset >= seg->size) {
+            // Segment exhausted (or vanished); move to the next one
+            close_reader(spool);
+            uint64_t next = 0;
+            for (uint32_t i = 0; i < spool->segment_count; i++) {
+                if (spool->segments[i].id > spool->read_id) {
+                    next = spool->segments[i].id;
+                    break;
+                }
+            }
+            if (!next) return HW_STATUS_TIMEOUT;
+            spool->read_id = next;
+            spool->read_offset = 0;
+            continue;
+        }
+
+        // Reading the live segment: make buffered appends visible first
+        if (seg == &spool->segments[spool->segment_count - 1]) spool_flush(spool);
+        if (!spool->read_file || spool->read_file_id != seg->id) {
+            char path[SPOOL_PATH_MAX + 32];
+            close_reader(spool);
+            segment_path(spool, seg->id, path, sizeof(path));
+            spool->read_file = fopen(path, "rb");
+            if (!spool->read_file) return HW_STATUS_ERROR;
+            spool->read_file_id = seg->id;
+        }
+
+        fseek(spool->read_file, (long)spool->read_offset, SEEK_SET);
+        uint32_t crc;
+        long record_length = read_record_header(spool->read_file, &crc);
+        if (record_length < 0) {
+            // Corrupt record: abandon the rest of this segment
+            spool->stats.records_dropped++;
+            spool->read_offset = seg->size;
+            continue;
+        }
+
+        *length = (uint32_t)record_length;
+        if (!buffer || capacity < (uint32_t)record_length) {
+            // Sized so spool_skip can move past it
+            spool->peeked_size = RECORD_HEADER_SIZE + (uint32_t)record_length;
+            return HW_STATUS_INVALID_PARAM;
+        }
+        if (fread(buffer, 1, (size_t)record_length, spool->read_file) != (size_t)record_length ||
+            crc32_compute(buffer, (size_t)record_length) != crc) {
+            spool->stats.records_dropped++;
+            spool->read_offset = seg->size;
+            continue;
+        }
+
+        spool->peeked_size = RECORD_HEADER_SIZE + (uint32_t)record_length;
+        return HW_STATUS_OK;
+    }
+}
+
+hw_status_t spool_advance(spool_t* spool) {
+    if (!spool || spool->peeked_size == 0) return HW_STATUS_INVALID_PARAM;
+
+    spool->read_offset += spool->peeked_size;
+    spool->peeked_size = 0;
+    spool->stats.records_replayed++;
+    return HW_STATUS_OK;
+}
+
+hw_status_t spool_skip(spool_t* spool) {
+    if (!spool || spool->peeked_size == 0) return HW_STATUS_INVALID_PARAM;
+
+    spool->read_offset += spool->peeked_size;
+    spool->peeked_size = 0;
+    spool->stats.records_dropped++;
+    return HW_STATUS_OK;
+}
+
+hw_status_t spool_commit(spool_t* spool) {
+    if (!spool) return HW_STATUS_INVALID_PARAM;
+
+    char path[SPOOL_PATH_MAX + 32], temp[SPOOL_PATH_MAX + 32];
+    uint8_t buf[20];
+    put32(buf, (uint32_t)spool->read_id);
+    put32(buf + 4, (uint32_t)(spool->read_id >> 32));
+    put32(buf + 8, (uint32_t)spool->read_offset);
+    put32(buf + 12, (uint32_t)(spool->read_offset >> 32));
+    put32(buf + 16, crc32_compute(buf, 16));
+
+    if (spool->write_file) {
+        file_sync(spool->write_file);
+        spool->write_dirty = false;
+    }
+    spool_file_path(spool, OFFSET_TEMP_FILE, temp, sizeof(temp));
+    spool_file_path(spool, OFFSET_FILE, path, sizeof(path));
+    FILE* f = fopen(temp, "wb");
+    if (!f) return HW_STATUS_ERROR;
+    bool ok = fwrite(buf, 1, sizeof(buf), f) == sizeof(buf);
+    file_sync(f);
+    fclose(f);
+    if (!ok || file_replace(temp, path) != 0) return HW_STATUS_ERROR;
+
+    // Segments behind the committed cursor are no longer needed
+    while (spool->segment_count > 1 && spool->segments[0].id < spool->read_id) {
+        char seg_path[SPOOL_PATH_MAX + 32];
+        segment_path(spool, spool->segments[0].id, seg_path, sizeof(seg_path));
+        remove(seg_path);
+        spool->total_bytes -= spool->segments[0].size;
+        memmove(spool->segments, spool->segments + 1, (spool->segment_count - 1) * sizeof(spool_segment_t));
+        spool->segment_count--;
+    }
+    return HW_STATUS_OK;
+}
+
+uint32_t spool_replay_budget(spool_t* spool, uint64_t now_ms) {
+    if (!spool) return 0;
+    if (spool->config.replay_rate == 0) return UINT32_MAX;
+
+    if (spool->last_refill_ms == 0) {
+        spool->last_refill_ms = now_ms;
+        spool->tokens = spool->config.replay_rate / 10.0;
+    } else if (now_ms > spool->last_refill_ms) {
+        spool->tokens += (double)(now_ms - spool->last_refill_ms) * spool->config.replay_rate / 1000.0;
+        spool->last_refill_ms = now_ms;
+    }
+    // Allow at most one second of burst
+    if (spool->tokens > spool->config.replay_rate) spool->tokens = spool->config.replay_rate;
+    return (uint32_t)spool->tokens;
+}
+
+void spool_consume_budget(spool_t* spool, uint32_t records) {
+    if (!spool || spool->config.replay_rate == 0) return;
+    spool->tokens -= records;
+    if (spool->tokens < 0) spool->tokens = 0;
+}
+
+void spool_get_stats(const spool_t* spool, spool_stats_t* stats) {
+    if (!spool || !stats) return;
+    *stats = spool->stats;
+    stats->bytes_on_disk = spool->total_bytes;
+    stats->segments = spool->segment_count;
+}
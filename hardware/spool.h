@@ -0,0 +1,80 @@
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware_interface.h"
+
+// Append-only, segment-based store-and-forward spool.
+//
+// Records are appended to fixed-size segment files while upstream is
+// unavailable and replayed in order once it returns. The read position is
+// committed to an offsets file with write-temp + rename, so a crash replays
+// at most the records sent since the last commit (at-least-once delivery).
+// A spool is not thread-safe; one thread owns it.
+
+#define SPOOL_PATH_MAX            256
+#define SPOOL_DEFAULT_SEGMENT     (4u * 1024u * 1024u)
+#define SPOOL_DEFAULT_MAX_BYTES   (256ull * 1024ull * 1024ull)
+#define SPOOL_MAX_RECORD          (1024u * 1024u)
+
+typedef enum {
+    SPOOL_DROP_OLDEST = 0,   // Delete the oldest segment to make room
+    SPOOL_DROP_NEWEST = 1    // Reject new records while the spool is full
+} spool_drop_policy_t;
+
+typedef struct {
+    char directory[SPOOL_PATH_MAX];
+    uint32_t segment_bytes;           // Segment roll size
+    uint64_t max_bytes;               // Disk budget across all segments
+    spool_drop_policy_t drop_policy;
+    uint32_t replay_rate;             // Catch-up records per second, 0 = unlimited
+    bool sync_on_append;              // fsync every append instead of at roll/commit
+} spool_config_t;
+
+typedef struct {
+    uint64_t bytes_on_disk;
+    uint32_t segments;
+    uint64_t records_appended;
+    uint64_t records_replayed;
+    uint64_t records_dropped;
+    uint64_t segments_dropped;
+    uint64_t records_recovered_torn;  // Trailing partial records discarded at open
+} spool_stats_t;
+
+typedef struct spool spool_t;
+
+void spool_default_config(spool_config_t* config, const char* directory);
+spool_t* spool_open(const spool_config_t* config);
+void spool_close(spool_t* spool);
+
+// Writer side. spool_flush hands buffered appends to the OS so they survive
+// a process crash; segments are fsynced at roll, commit and close.
+hw_status_t spool_append(spool_t* spool, const uint8_t* data, uint32_t length);
+void spool_flush(spool_t* spool);
+
+// Reader side: peek the record at the read cursor, then advance past it.
+// spool_peek returns HW_STATUS_TIMEOUT when the spool is empty and
+// HW_STATUS_INVALID_PARAM (with *length set) when the buffer is too small;
+// spool_skip then drops that record, counted in records_dropped.
+hw_status_t spool_peek(spool_t* spool, uint8_t* buffer, uint32_t capacity, uint32_t* length);
+hw_status_t spool_advance(spool_t* spool);
+hw_status_t spool_skip(spool_t* spool);
+hw_status_t spool_commit(spool_t* spool);
+bool spool_is_empty(const spool_t* spool);
+
+// Catch-up pacing: number of records that may be replayed now
+uint32_t spool_replay_budget(spool_t* spool, uint64_t now_ms);
+void spool_consume_budget(spool_t* spool, uint32_t records);
+
+void spool_get_stats(const spool_t* spool, spool_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // SPOOL_H
@@ -0,0 +1,425 @@
+#include "stm32_decoder.h"
+#include "hw_stats.h"
+#include <string.h>
+
+// Little-endian helpers; the wire layout is packed, so never memcpy structs
+static uint16_t rd16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t rd32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void wr16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void wr32(uint8_t* p, uint32_t v) {
+    p[0] = (uint8_t)(v & 0xFF);
+    p[1] = (uint8_t)((v >> 8) & 0xFF);
+    p[2] = (uint8_t)((v >> 16) & 0xFF);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint16_t clamp_u16(float v) {
+    if (v <= 0.0f) return 0;
+    if (v >= 65535.0f) return 65535;
+    return (uint16_t)(v + 0.5f);
+}
+
+static uint8_t clamp_u8(float v) {
+    if (v <= 0.0f) return 0;
+    if (v >= 255.0f) return 255;
+    return (uint8_t)(v + 0.5f);
+}
+
+// Length of a fixed-width text field, without the terminator
+static size_t text_length(const char* s, size_t max) {
+    size_t n = 0;
+    while (n < max && s[n]) n++;
+    return n;
+}
+
+void stm32_decoder_init(stm32_decoder_t* decoder) {
+    if (!decoder) return;
+    memset(decoder, 0, sizeof(*decoder));
+}
+
+void stm32_decoder_reset(stm32_decoder_t* decoder) {
+    if (!decoder) return;
+    decoder->fill = 0;
+}
+
+// Drop the leading byte of the buffer and move to the next header candidate
+static void decoder_resync(stm32_decoder_t* decoder) {
+    uint8_t* next = memchr(decoder->buffer + 1, STM32_HEADER_HIGH, decoder->fill - 1);
+    if (!next) {
+        decoder->fill = 0;
+        return;
+    }
+    decoder->fill = (uint8_t)(decoder->fill - (next - decoder->buffer));
+    memmove(decoder->buffer, next, decoder->fill);
+}
+
+size_t stm32_decoder_feed(stm32_decoder_t* decoder, const uint8_t* bytes, size_t length,
+                          stm32_frame_handler_t handler, void* user_data) {
+    HW_STATS_SCOPE(HW_OP_DECODE_STREAM);
+    if (!decoder || !bytes) return 0;
+
+    size_t pos = 0;
+    while (pos < length || decoder->fill >= 4) {
+        if (decoder->fill == 0) {
+            // Hunt for a header byte directly in the input
+            const uint8_t* start = memchr(bytes + pos, STM32_HEADER_HIGH, length - pos);
+            if (!start) {
+                if (pos < length) decoder->sync_errors++;
+                return length;
+            }
+            if (start != bytes + pos) decoder->sync_errors++;
+            pos = (size_t)(start - bytes);
+        }
+
+        // Gather the fixed header
+        while (decoder->fill < 4 && pos < length) {
+            decoder->buffer[decoder->fill++] = bytes[pos++];
+        }
+        if (decoder->fill < 4) return length;
+
+        if (decoder->buffer[1] != STM32_HEADER_LOW || decoder->buffer[3] > STM32_MAX_FRAME_DATA) {
+            decoder->sync_errors++;
+            decoder_resync(decoder);
+            continue;
+        }
+
+        uint8_t total = (uint8_t)(decoder->buffer[3] + STM32_FRAME_OVERHEAD);
+        size_t want = total - decoder->fill;
+        size_t avail = length - pos;
+        size_t take = want < avail ? want : avail;
+        memcpy(decoder->buffer + decoder->fill, bytes + pos, take);
+        decoder->fill = (uint8_t)(decoder->fill + take);
+        pos += take;
+        if (decoder->fill < total) return length;
+
+        if (stm32_calculate_checksum(decoder->buffer, (uint8_t)(total - 1)) != decoder->buffer[total - 1]) {
+            decoder->checksum_errors++;
+            decoder_resync(decoder);
+            continue;
+        }
+
+        stm32_frame_t frame;
+        frame.type = decoder->buffer[2];
+        frame.length = decoder->buffer[3];
+        memcpy(frame.data, decoder->buffer + 4, frame.length);
+        decoder->fill = 0;
+        decoder->frames_ok++;
+        if (handler) {
+            handler(&frame, user_data);
+        }
+    }
+
+    return length;
+}
+
+size_t stm32_encode_frame(uint8_t packet_type, const uint8_t* data, uint8_t length, uint8_t* out) {
+    if (!out || length > STM32_MAX_FRAME_DATA || (length && !data)) {
+        return 0;
+    }
+
+    out[0] = STM32_HEADER_HIGH;
+    out[1] = STM32_HEADER_LOW;
+    out[2] = packet_type;
+    out[3] = length;
+    if (length) {
+        memcpy(out + 4, data, length);
+    }
+    out[4 + length] = stm32_calculate_checksum(out, (uint8_t)(length + 4));
+    return (size_t)length + STM32_FRAME_OVERHEAD;
+}
+
+// Record decoding
+bool stm32_decode_power_module(const stm32_frame_t* frame, power_module_t* module) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !module || frame->type != PACKET_TYPE_POWER_MODULE ||
+        frame->length < STM32_WIRE_POWER_MODULE_SIZE) {
+        return false;
+    }
+
+    const uint8_t* d = frame->data;
+    module->module_id = d[0];
+    module->voltage = stm32_voltage_to_float(rd16(d + 1));
+    module->current = stm32_current_to_float(rd16(d + 3));
+    module->power = module->voltage * module->current / 1000.0f;
+    module->temperature = (float)d[7];
+    module->is_active = (d[8] & 0x01) != 0;
+    module->has_fault = d[9] != 0;
+    return true;
+}
+
+bool stm32_decode_battery(const stm32_frame_t* frame, battery_info_t* battery) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !battery || frame->type != PACKET_TYPE_BATTERY ||
+        frame->length < STM32_WIRE_BATTERY_SIZE) {
+        return false;
+    }
+
+    const uint8_t* d = frame->data;
+    battery->battery_id = d[0];
+    battery->voltage = stm32_voltage_to_float(rd16(d + 1));
+    battery->current = stm32_current_to_float(rd16(d + 3));
+    battery->temperature = (float)d[5];
+    battery->capacity_percent = d[6] > 100 ? 100 : d[6];
+    battery->is_charging = (d[7] & 0x01) != 0;
+    battery->test_in_progress = (d[8] & 0x01) != 0;
+    return true;
+}
+
+bool stm32_decode_ac_input(const stm32_frame_t* frame, ac_phase_t* phase) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !phase || frame->type != PACKET_TYPE_AC_INPUT ||
+        frame->length < STM32_WIRE_AC_INPUT_SIZE) {
+        return false;
+    }
+
+    const uint8_t* d = frame->data;
+    phase->phase_id = d[0];
+    phase->voltage = stm32_frequency_to_float(rd16(d + 1));
+    phase->current = stm32_frequency_to_float(rd16(d + 3));
+    phase->frequency = stm32_frequency_to_float(rd16(d + 5));
+    phase->power = phase->voltage * phase->current / 1000.0f;
+    phase->is_normal = (d[9] & 0x01) != 0;
+    return true;
+}
+
+bool stm32_decode_dc_output(const stm32_frame_t* frame, dc_circuit_t* circuit) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !circuit || frame->type != PACKET_TYPE_DC_OUTPUT ||
+        frame->length < STM32_WIRE_DC_OUTPUT_SIZE) {
+        return false;
+    }
+
+    const uint8_t* d = frame->data;
+    circuit->circuit_id = d[0];
+    circuit->voltage = stm32_voltage_to_float(rd16(d + 1));
+    circuit->current = stm32_current_to_float(rd16(d + 3));
+    circuit->power = circuit->voltage * circuit->current;
+    circuit->is_enabled = (d[7] & 0x01) != 0;
+    memset(circuit->load_name, 0, sizeof(circuit->load_name));
+    memcpy(circuit->load_name, d + 8, 6);
+    return true;
+}
+
+bool stm32_decode_alarm(const stm32_frame_t* frame, alarm_t* alarm) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !alarm || frame->type != PACKET_TYPE_ALARM ||
+        frame->length < STM32_WIRE_ALARM_SIZE) {
+        return false;
+    }
+
+    const uint8_t* d = frame->data;
+    alarm->alarm_id = rd32(d);
+    alarm->severity = d[4];
+    alarm->timestamp = rd32(d + 5);
+    alarm->is_active = (d[9] & 0x01) != 0;
+    memset(alarm->message, 0, sizeof(alarm->message));
+    memcpy(alarm->message, d + 10, 7);
+    return alarm->severity <= 2;
+}
+
+bool stm32_decode_system_status(const stm32_frame_t* frame, system_status_t* status) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !status || frame->type != PACKET_TYPE_SYSTEM_STATUS ||
+        frame->length < STM32_WIRE_SYSTEM_STATUS_SIZE) {
+        return false;
+    }
+
+    const uint8_t* d = frame->data;
+    status->mains_available = (d[0] & 0x01) != 0;
+    status->battery_backup = (d[1] & 0x01) != 0;
+    status->generator_running = (d[2] & 0x01) != 0;
+    status->operation_mode = d[3];
+    status->system_load = rd16(d + 4) / 10.0f;
+    status->uptime_seconds = rd16(d + 6);
+    return status->operation_mode <= 2;
+}
+
+static void read_command(const uint8_t* d, stm32_command_t* command) {
+    command->command_id = d[0];
+    command->target_id = d[1];
+    command->action = d[2];
+    command->parameter = d[3];
+    command->reserved = rd32(d + 4);
+}
+
+bool stm32_decode_command(const stm32_frame_t* frame, stm32_command_t* command) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !command || frame->type != PACKET_TYPE_COMMAND ||
+        frame->length < STM32_WIRE_COMMAND_SIZE) {
+        return false;
+    }
+
+    read_command(frame->data, command);
+    return true;
+}
+
+uint8_t stm32_decode_command_batch(const stm32_frame_t* frame, stm32_command_t* commands, uint8_t max) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !commands || frame->type != PACKET_TYPE_COMMAND_BATCH || frame->length < 1) {
+        return 0;
+    }
+
+    uint8_t count = frame->data[0];
+    if (count == 0 || frame->length < 1 + count * STM32_WIRE_COMMAND_SIZE) {
+        return 0;
+    }
+    if (count > max) count = max;
+    for (uint8_t i = 0; i < count; i++) {
+        read_command(frame->data + 1 + i * STM32_WIRE_COMMAND_SIZE, &commands[i]);
+    }
+    return count;
+}
+
+bool stm32_decode_resume(const stm32_frame_t* frame, stm32_resume_t* resume) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !resume || frame->type != PACKET_TYPE_RESUME ||
+        frame->length < STM32_WIRE_RESUME_SIZE) {
+        return false;
+    }
+
+    resume->session_id = rd32(frame->data);
+    resume->last_sequence = rd32(frame->data + 4);
+    resume->flags = frame->data[8];
+    return true;
+}
+
+bool stm32_decode_sync(const stm32_frame_t* frame, stm32_sync_t* sync) {
+    HW_STATS_SCOPE(HW_OP_DECODE_RECORD);
+    if (!frame || !sync || frame->type != PACKET_TYPE_SYNC ||
+        frame->length < STM32_WIRE_SYNC_SIZE) {
+        return false;
+    }
+
+    sync->session_id = rd32(frame->data);
+    sync->next_sequence = rd32(frame->data + 4);
+    sync->mode = frame->data[8];
+    return true;
+}
+
+// Record encoding
+uint8_t stm32_encode_power_module(const power_module_t* module, uint8_t* data) {
+    if (!module || !data) return 0;
+
+    memset(data, 0, STM32_WIRE_POWER_MODULE_SIZE);
+    data[0] = module->module_id;
+    wr16(data + 1, clamp_u16(module->voltage * 1000.0f));
+    wr16(data + 3, clamp_u16(module->current * 1000.0f));
+    wr16(data + 5, clamp_u16(module->power * 1000.0f));
+    data[7] = clamp_u8(module->temperature);
+    data[8] = module->is_active ? 0x01 : 0x00;
+    data[9] = module->has_fault ? 0x01 : 0x00;
+    return STM32_WIRE_POWER_MODULE_SIZE;
+}
+
+uint8_t stm32_encode_battery(const battery_info_t* battery, uint8_t* data) {
+    if (!battery || !data) return 0;
+
+    memset(data, 0, STM32_WIRE_BATTERY_SIZE);
+    data[0] = battery->battery_id;
+    wr16(data + 1, clamp_u16(battery->voltage * 1000.0f));
+    wr16(data + 3, clamp_u16(battery->current * 1000.0f));
+    data[5] = clamp_u8(battery->temperature);
+    data[6] = battery->capacity_percent;
+    data[7] = battery->is_charging ? 0x01 : 0x00;
+    data[8] = battery->test_in_progress ? 0x01 : 0x00;
+    return STM32_WIRE_BATTERY_SIZE;
+}
+
+uint8_t stm32_encode_ac_input(const ac_phase_t* phase, uint8_t* data) {
+    if (!phase || !data) return 0;
+
+    memset(data, 0, STM32_WIRE_AC_INPUT_SIZE);
+    data[0] = phase->phase_id;
+    wr16(data + 1, clamp_u16(phase->voltage * 10.0f));
+    wr16(data + 3, clamp_u16(phase->current * 10.0f));
+    wr16(data + 5, clamp_u16(phase->frequency * 10.0f));
+    wr16(data + 7, clamp_u16(phase->power * 1000.0f));
+    data[9] = phase->is_normal ? 0x01 : 0x00;
+    return STM32_WIRE_AC_INPUT_SIZE;
+}
+
+uint8_t stm32_encode_dc_output(const dc_circuit_t* circuit, uint8_t* data) {
+    if (!circuit || !data) return 0;
+
+    memset(data, 0, STM32_WIRE_DC_OUTPUT_SIZE);
+    data[0] = circuit->circuit_id;
+    wr16(data + 1, clamp_u16(circuit->voltage * 1000.0f));
+    wr16(data + 3, clamp_u16(circuit->current * 1000.0f));
+    wr16(data + 5, clamp_u16(circuit->power));
+    data[7] = circuit->is_enabled ? 0x01 : 0x00;
+    memcpy(data + 8, circuit->load_name, text_length(circuit->load_name, 6));
+    return STM32_WIRE_DC_OUTPUT_SIZE;
+}
+
+uint8_t stm32_encode_alarm(const alarm_t* alarm, uint8_t* data) {
+    if (!alarm || !data) return 0;
+
+    memset(data, 0, STM32_WIRE_ALARM_SIZE);
+    wr32(data, alarm->alarm_id);
+    data[4] = alarm->severity;
+    wr32(data + 5, alarm->timestamp);
+    data[9] = alarm->is_active ? 0x01 : 0x00;
+    memcpy(data + 10, alarm->message, text_length(alarm->message, 7));
+    return STM32_WIRE_ALARM_SIZE;
+}
+
+uint8_t stm32_encode_system_status(const system_status_t* status, uint8_t* data) {
+    if (!status || !data) return 0;
+
+    data[0] = status->mains_available ? 0x01 : 0x00;
+    data[1] = status->battery_backup ? 0x01 : 0x00;
+    data[2] = status->generator_running ? 0x01 : 0x00;
+    data[3] = status->operation_mode;
+    wr16(data + 4, clamp_u16(status->system_load * 10.0f));
+    wr16(data + 6, (uint16_t)(status->uptime_seconds & 0xFFFF));
+    return STM32_WIRE_SYSTEM_STATUS_SIZE;
+}
+
+uint8_t stm32_encode_command(const stm32_command_t* command, uint8_t* data) {
+    if (!command || !data) return 0;
+
+    data[0] = command->command_id;
+    data[1] = command->target_id;
+    data[2] = command->action;
+    data[3] = command->parameter;
+    wr32(data + 4, command->reserved);
+    return STM32_WIRE_COMMAND_SIZE;
+}
+
+uint8_t stm32_encode_command_batch(const stm32_command_t* commands, uint8_t count, uint8_t* data) {
+    if (!commands || !data || count == 0 || count > STM32_MAX_BATCH_COMMANDS) return 0;
+
+    data[0] = count;
+    for (uint8_t i = 0; i < count; i++) {
+        stm32_encode_command(&commands[i], data + 1 + i * STM32_WIRE_COMMAND_SIZE);
+    }
+    return (uint8_t)(1 + count * STM32_WIRE_COMMAND_SIZE);
+}
+
+uint8_t stm32_encode_resume(const stm32_resume_t* resume, uint8_t* data) {
+    if (!resume || !data) return 0;
+
+    wr32(data, resume->session_id);
+    wr32(data + 4, resume->last_sequence);
+    data[8] = resume->flags;
+    return STM32_WIRE_RESUME_SIZE;
+}
+
+uint8_t stm32_encode_sync(const stm32_sync_t* sync, uint8_t* data) {
+    if (!sync || !data) return 0;
+
+    wr32(data, sync->session_id);
+    wr32(data + 4, sync->next_sequence);
+    data[8] = sync->mode;
+    return STM32_WIRE_SYNC_SIZE;
+}
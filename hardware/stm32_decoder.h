@@ -0,0 +1,120 @@
+#ifndef STM32_DECODER_H
+#define STM32_DECODER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32_interface.h"
+#include "hardware_interface.h"
+
+// Wire framing: [0xAA][0x55][Type][Length][Data...][Checksum]
+// The checksum is the XOR of every byte before it and follows the data
+// directly, so a frame occupies exactly Length + 5 bytes on the wire.
+#define STM32_FRAME_OVERHEAD     5
+#define STM32_MAX_FRAME_DATA     (STM32_MAX_PACKET_SIZE - STM32_FRAME_OVERHEAD)
+
+// Packed little-endian record sizes as they appear on the wire
+// (these match the byte offsets used by server/stm32-bridge.ts)
+#define STM32_WIRE_POWER_MODULE_SIZE  14
+#define STM32_WIRE_BATTERY_SIZE       11
+#define STM32_WIRE_AC_INPUT_SIZE      12
+#define STM32_WIRE_DC_OUTPUT_SIZE     14
+#define STM32_WIRE_ALARM_SIZE         17
+#define STM32_WIRE_SYSTEM_STATUS_SIZE 8
+#define STM32_WIRE_COMMAND_SIZE       8
+#define STM32_WIRE_RESUME_SIZE        9
+#define STM32_WIRE_SYNC_SIZE          9
+
+// Commands per PACKET_TYPE_COMMAND_BATCH frame
+#define STM32_MAX_BATCH_COMMANDS      ((STM32_MAX_FRAME_DATA - 1) / STM32_WIRE_COMMAND_SIZE)
+
+// Link recovery. Every frame a device sends, except SYNC itself, carries
+// an implicit sequence number; a SYNC frame announces the sequence of the
+// frame that follows it. Devices emit a SYNC marker at the start of each
+// cycle. After (re)connecting, a consumer sends RESUME with the last
+// sequence it saw; the device answers with SYNC and then either the missed
+// frames from its replay ring or a full-state keyframe burst.
+#define STM32_RESUME_FLAG_KEYFRAME    0x01
+
+typedef enum {
+    STM32_SYNC_MARKER   = 0,   // Periodic marker, nothing special follows
+    STM32_SYNC_RESUMED  = 1,   // Missed frames follow, then live data
+    STM32_SYNC_KEYFRAME = 2    // Full device state follows, then live data
+} stm32_sync_mode_t;
+
+typedef struct {
+    uint32_t session_id;       // From the last SYNC seen, 0 if none
+    uint32_t last_sequence;    // Last sequence received
+    uint8_t flags;
+} stm32_resume_t;
+
+typedef struct {
+    uint32_t session_id;       // Changes whenever the device restarts
+    uint32_t next_sequence;    // Sequence of the next non-SYNC frame
+    uint8_t mode;              // stm32_sync_mode_t
+} stm32_sync_t;
+
+// A validated frame
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+    uint8_t data[STM32_MAX_FRAME_DATA];
+} stm32_frame_t;
+
+// Streaming decoder state; one per byte stream (device link)
+typedef struct {
+    uint8_t buffer[STM32_MAX_PACKET_SIZE];
+    uint8_t fill;
+    uint32_t frames_ok;
+    uint32_t checksum_errors;
+    uint32_t sync_errors;
+} stm32_decoder_t;
+
+typedef void (*stm32_frame_handler_t)(const stm32_frame_t* frame, void* user_data);
+
+// Decoder
+void stm32_decoder_init(stm32_decoder_t* decoder);
+void stm32_decoder_reset(stm32_decoder_t* decoder);
+size_t stm32_decoder_feed(stm32_decoder_t* decoder, const uint8_t* bytes, size_t length,
+                          stm32_frame_handler_t handler, void* user_data);
+
+// Encoder; out must hold STM32_MAX_PACKET_SIZE bytes. Returns the wire size or 0.
+size_t stm32_encode_frame(uint8_t packet_type, const uint8_t* data, uint8_t length, uint8_t* out);
+
+// Record decoding from frame payloads into hardware_interface.h types.
+// Power is derived from voltage and current because the 16-bit wire
+// power field saturates well below real module output.
+bool stm32_decode_power_module(const stm32_frame_t* frame, power_module_t* module);
+bool stm32_decode_battery(const stm32_frame_t* frame, battery_info_t* battery);
+bool stm32_decode_ac_input(const stm32_frame_t* frame, ac_phase_t* phase);
+bool stm32_decode_dc_output(const stm32_frame_t* frame, dc_circuit_t* circuit);
+bool stm32_decode_alarm(const stm32_frame_t* frame, alarm_t* alarm);
+bool stm32_decode_system_status(const stm32_frame_t* frame, system_status_t* status);
+bool stm32_decode_command(const stm32_frame_t* frame, stm32_command_t* command);
+bool stm32_decode_resume(const stm32_frame_t* frame, stm32_resume_t* resume);
+bool stm32_decode_sync(const stm32_frame_t* frame, stm32_sync_t* sync);
+// Returns how many commands the batch held (at most max), 0 if malformed
+uint8_t stm32_decode_command_batch(const stm32_frame_t* frame, stm32_command_t* commands, uint8_t max);
+
+// Record encoding into frame payloads; return the payload length
+uint8_t stm32_encode_power_module(const power_module_t* module, uint8_t* data);
+uint8_t stm32_encode_battery(const battery_info_t* battery, uint8_t* data);
+uint8_t stm32_encode_ac_input(const ac_phase_t* phase, uint8_t* data);
+uint8_t stm32_encode_dc_output(const dc_circuit_t* circuit, uint8_t* data);
+uint8_t stm32_encode_alarm(const alarm_t* alarm, uint8_t* data);
+uint8_t stm32_encode_system_status(const system_status_t* status, uint8_t* data);
+uint8_t stm32_encode_command(const stm32_command_t* command, uint8_t* data);
+uint8_t stm32_encode_resume(const stm32_resume_t* resume, uint8_t* data);
+uint8_t stm32_encode_sync(const stm32_sync_t* sync, uint8_t* data);
+// count is 1..STM32_MAX_BATCH_COMMANDS
+uint8_t stm32_encode_command_batch(const stm32_command_t* commands, uint8_t count, uint8_t* data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // STM32_DECODER_H
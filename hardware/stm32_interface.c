@@ -82,7 +82,7 @@ bool stm32_send_command(uint8_t command_id, uint8_t target_id, uint8_t action, u
     // Example: uart_send_data((uint8_t*)&cmd, sizeof(cmd));
     
     printf("STM32 Command: ID=%d, Target=%d, Action=%d, Param=%d\n", 
-           command_id, target_id, action, parameter);
+           cmd.command_id, cmd.target_id, cmd.action, cmd.parameter);
     
     return true;
 }
@@ -93,10 +93,9 @@ bool stm32_parse_power_module(const uint8_t* data, stm32_power_module_data_t* mo
     
     memcpy(module, data, sizeof(stm32_power_module_data_t));
     
-    // Validate data ranges
-    if (module->voltage > 100000 ||    // Max 100V
-        module->current > 100000 ||    // Max 100A
-        module->temperature > 150) {   // Max 150°C
+    // Validate data ranges; voltage and current fit their 16-bit fields
+    // (max 65.535 V / 65.535 A) and need no check
+    if (module->temperature > 150) {   // Max 150°C
         return false;
     }
     
@@ -126,11 +125,10 @@ bool stm32_parse_ac_input(const uint8_t* data, stm32_ac_input_data_t* ac_input)
     
     memcpy(ac_input, data, sizeof(stm32_ac_input_data_t));
     
-    // Validate data ranges
+    // Validate data ranges; power fits its 16-bit field (max 65.535 kW)
     if (ac_input->voltage > 5000 ||   // Max 500V
         ac_input->current > 1000 ||   // Max 100A
-        ac_input->frequency > 1000 || // Max 100Hz
-        ac_input->power > 100000) {   // Max 100kW
+        ac_input->frequency > 1000) { // Max 100Hz
         return false;
     }
     
@@ -143,12 +141,8 @@ bool stm32_parse_dc_output(const uint8_t* data, stm32_dc_output_data_t* dc_outpu
     
     memcpy(dc_output, data, sizeof(stm32_dc_output_data_t));
     
-    // Validate data ranges
-    if (dc_output->voltage > 100000 || // Max 100V
-        dc_output->current > 100000) { // Max 100A
-        return false;
-    }
-    
+    // Voltage and current fit their 16-bit fields (max 65.535 V / 65.535 A),
+    // so every value is in range
     return true;
 }
 
@@ -23,7 +23,10 @@ typedef enum {
     PACKET_TYPE_ALARM        = 0x05,
     PACKET_TYPE_SYSTEM_STATUS = 0x06,
     PACKET_TYPE_COMMAND      = 0x07,
-    PACKET_TYPE_RESPONSE     = 0x08
+    PACKET_TYPE_RESPONSE     = 0x08,
+    PACKET_TYPE_RESUME       = 0x09,   // Consumer -> device: resume or request keyframe
+    PACKET_TYPE_SYNC         = 0x0A,   // Device -> consumer: sequence marker
+    PACKET_TYPE_COMMAND_BATCH = 0x0B   // Consumer -> device: [count] + count commands, run in order
 } stm32_packet_type_t;
 
 // STM32 Packet Structure
@@ -109,6 +112,56 @@ typedef struct {
     uint32_t reserved;     // Future use
 } stm32_command_t;
 
+// Sampling rate control: command_id STM32_CMD_SET_RATE with action
+// STM32_CMD_ACTION_RATE asks the device to send one category (target_id =
+// packet type, 0 = every category) every parameter * STM32_RATE_UNIT_MS.
+// Alarms are sent as they occur regardless. Firmware that predates rate
+// control ignores the action.
+#define STM32_CMD_SET_RATE       0x20
+#define STM32_CMD_ACTION_RATE    4
+#define STM32_RATE_UNIT_MS       100
+
+// Threshold tuning: command_id STM32_CMD_THRESHOLD. Action SET stages
+// target_id (an STM32_THRESHOLD_* key) = reserved into a draft; parameter
+// picks the power module of per-module keys (0: every module). Action
+// COMMIT switches the device to the whole draft at once, reserved carrying
+// the sender's version; keys the set left out take the device defaults. A
+// new consumer link (RESUME) drops an uncommitted draft, so a set cut
+// short by a link failure never half applies.
+#define STM32_CMD_THRESHOLD      0x21
+#define STM32_CMD_ACTION_COMMIT  5
+#define STM32_THRESHOLD_MODULE_VOLTAGE_MIN    1    // mV, per module
+#define STM32_THRESHOLD_MODULE_VOLTAGE_MAX    2    // mV, per module
+#define STM32_THRESHOLD_MODULE_CURRENT_MAX    3    // mA, per module
+#define STM32_THRESHOLD_MODULE_TEMP_MAX       4    // °C, per module
+#define STM32_THRESHOLD_MODULE_POWER_MAX      5    // mW
+#define STM32_THRESHOLD_ALARM_VOLTAGE_LOW     6    // mV
+#define STM32_THRESHOLD_ALARM_VOLTAGE_HIGH    7    // mV
+#define STM32_THRESHOLD_ALARM_CURRENT_HIGH    8    // mA
+#define STM32_THRESHOLD_ALARM_TEMP_HIGH       9    // °C
+#define STM32_THRESHOLD_ALARM_POWER_OVERLOAD  10   // mW
+#define STM32_THRESHOLD_ALARM_BATTERY_LOW     11   // mV
+#define STM32_THRESHOLD_SAFETY_VOLTAGE_MIN    12   // mV
+#define STM32_THRESHOLD_SAFETY_VOLTAGE_MAX    13   // mV
+#define STM32_THRESHOLD_SAFETY_CURRENT_MAX    14   // mA
+#define STM32_THRESHOLD_SAFETY_TEMP_MAX       15   // °C
+#define STM32_THRESHOLD_SAFETY_POWER_MAX      16   // mW
+#define STM32_THRESHOLD_KEY_COUNT             16
+
+// Control commands: command_id says what target_id names, action is one
+// of STM32_CMD_ACTION_*. Numbering as server/hardware-bridge.ts sends it.
+// Values that do not fit parameter travel in reserved: the target voltage
+// in mV (target_id 0: every module) and the full alarm id.
+#define STM32_CMD_POWER_MODULE   0x01
+#define STM32_CMD_BATTERY        0x02
+#define STM32_CMD_DC_CIRCUIT     0x03
+#define STM32_CMD_ALARM          0x04
+#define STM32_CMD_SYSTEM         0x05
+#define STM32_CMD_ACTION_GET     0
+#define STM32_CMD_ACTION_SET     1
+#define STM32_CMD_ACTION_START   2
+#define STM32_CMD_ACTION_STOP    3
+
 // Function Declarations
 
 // Packet handling
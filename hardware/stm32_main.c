@@ -32,6 +32,7 @@
 #include "battery_monitor.h"
 #include "ac_monitor.h"
 #include "alarm_system.h"
+#include "thresholds.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -98,7 +99,14 @@ static uint16_t rx_index = 0;
 static uint8_t packet_ready = 0;
 
 // Timers
-static uint32_t last_data_send = 0;
+// Per-category send periods, changed by the gateway with STM32_CMD_SET_RATE
+static const uint8_t data_categories[4] = {
+    PACKET_TYPE_POWER_MODULE, PACKET_TYPE_BATTERY, PACKET_TYPE_AC_INPUT, PACKET_TYPE_DC_OUTPUT
+};
+static uint32_t data_send_period[4] = {
+    DATA_SEND_INTERVAL_MS, DATA_SEND_INTERVAL_MS, DATA_SEND_INTERVAL_MS, DATA_SEND_INTERVAL_MS
+};
+static uint32_t last_data_send[4] = {0};
 static uint32_t last_heartbeat = 0;
 static uint32_t last_status_update = 0;
 
@@ -114,6 +122,8 @@ static void Read_Batteries(void);
 static void Read_AC_Inputs(void);
 static void Read_DC_Outputs(void);
 static void Update_System_Status(void);
+static void Execute_Command(const stm32_command_t* cmd);
+static bool Apply_Threshold_Command(const stm32_command_t* cmd);
 static void Process_Commands(void);
 static void Send_Data_Packet(uint8_t packet_type);
 static void Send_Heartbeat(void);
@@ -392,6 +402,58 @@ static void Update_System_Status(void)
     system_status.operation_mode = system_mode;
 }
 
+/**
+ * @brief  Execute one control command
+ * @param  cmd: Command to execute
+ * @retval None
+ */
+static void Execute_Command(const stm32_command_t* cmd)
+{
+    // Process command based on target
+    switch (cmd->target_id) {
+        case 1: // Power module control
+            if (cmd->action == 1) { // Set
+                if (cmd->parameter == 1) {
+                    HAL_GPIO_WritePin(RECTIFIER_ENABLE_PORT, RECTIFIER_1_ENABLE_PIN, GPIO_PIN_SET);
+                } else {
+                    HAL_GPIO_WritePin(RECTIFIER_ENABLE_PORT, RECTIFIER_1_ENABLE_PIN, GPIO_PIN_RESET);
+                }
+            }
+            break;
+            
+        case 2: // Battery control
+            if (cmd->action == 2) { // Start test
+                batteries[0].test_status = 1;
+                Handle_Alarm(6000, 0, "BAT_TEST");
+            }
+            break;
+            
+        case 3: // System control
+            if (cmd->action == 1) { // Set mode
+                system_mode = cmd->parameter;
+            }
+            break;
+    }
+}
+
+/**
+ * @brief  Stage or commit a threshold update
+ * @param  cmd: Command to check
+ * @retval true if cmd was threshold traffic (no response is sent for it)
+ */
+static bool Apply_Threshold_Command(const stm32_command_t* cmd)
+{
+    if (cmd->command_id != STM32_CMD_THRESHOLD) return false;
+    
+    if (cmd->action == STM32_CMD_ACTION_SET) {
+        // A refused key also refuses the commit that follows
+        (void)thresholds_stage(cmd->target_id, cmd->parameter, cmd->reserved);
+    } else if (cmd->action == STM32_CMD_ACTION_COMMIT) {
+        thresholds_commit(cmd->reserved);
+    }
+    return true;
+}
+
 /**
  * @brief  Process incoming commands
  * @param  None
@@ -407,34 +469,47 @@ static void Process_Commands(void)
             stm32_command_t cmd;
             memcpy(&cmd, packet.data, sizeof(stm32_command_t));
             
-            // Process command based on target
-            switch (cmd.target_id) {
-                case 1: // Power module control
-                    if (cmd.action == 1) { // Set
-                        if (cmd.parameter == 1) {
-                            HAL_GPIO_WritePin(RECTIFIER_ENABLE_PORT, RECTIFIER_1_ENABLE_PIN, GPIO_PIN_SET);
-                        } else {
-                            HAL_GPIO_WritePin(RECTIFIER_ENABLE_PORT, RECTIFIER_1_ENABLE_PIN, GPIO_PIN_RESET);
-                        }
+            // Rate changes are link housekeeping; no response
+            if (cmd.command_id == STM32_CMD_SET_RATE && cmd.action == STM32_CMD_ACTION_RATE) {
+                for (uint8_t i = 0; i < 4; i++) {
+                    if (cmd.parameter != 0 && (cmd.target_id == 0 || cmd.target_id == data_categories[i])) {
+                        data_send_period[i] = (uint32_t)cmd.parameter * STM32_RATE_UNIT_MS;
                     }
-                    break;
-                    
-                case 2: // Battery control
-                    if (cmd.action == 2) { // Start test
-                        batteries[0].test_status = 1;
-                        Handle_Alarm(6000, 0, "BAT_TEST");
-                    }
-                    break;
-                    
-                case 3: // System control
-                    if (cmd.action == 1) { // Set mode
-                        system_mode = cmd.parameter;
-                    }
-                    break;
+                }
+                packet_ready = 0;
+                rx_index = 0;
+                return;
+            }
+            
+            if (Apply_Threshold_Command(&cmd)) {
+                packet_ready = 0;
+                rx_index = 0;
+                return;
             }
             
+            Execute_Command(&cmd);
+            
             // Send response
             Send_Data_Packet(PACKET_TYPE_RESPONSE);
+        } else if (packet.packet_type == PACKET_TYPE_COMMAND_BATCH) {
+            // [count] + count commands, in order; one response for all,
+            // none when the batch only carried threshold updates
+            uint8_t count = packet.data[0];
+            bool respond = false;
+            for (uint8_t i = 0; i < count && 1 + (i + 1) * sizeof(stm32_command_t) <= packet.length; i++) {
+                stm32_command_t cmd;
+                memcpy(&cmd, packet.data + 1 + i * sizeof(stm32_command_t), sizeof(stm32_command_t));
+                if (!Apply_Threshold_Command(&cmd)) {
+                    Execute_Command(&cmd);
+                    respond = true;
+                }
+            }
+            if (respond) {
+                Send_Data_Packet(PACKET_TYPE_RESPONSE);
+            }
+        } else if (packet.packet_type == PACKET_TYPE_RESUME) {
+            // New consumer link: a threshold set it did not commit never applies
+            thresholds_discard();
         }
     }
     
@@ -595,6 +670,7 @@ int main(void)
 
   /* USER CODE BEGIN 2 */
   // Initialize system
+  thresholds_init();
   SystemInit_Config();
   GPIO_Init_Config();
   
@@ -625,13 +701,12 @@ int main(void)
       Toggle_Status_LED();
     }
     
-    // Send data every 2 seconds
-    if (current_time - last_data_send >= DATA_SEND_INTERVAL_MS) {
-      Send_Data_Packet(PACKET_TYPE_POWER_MODULE);
-      Send_Data_Packet(PACKET_TYPE_BATTERY);
-      Send_Data_Packet(PACKET_TYPE_AC_INPUT);
-      Send_Data_Packet(PACKET_TYPE_DC_OUTPUT);
-      last_data_send = current_time;
+    // Send each category on its own period (every 2 seconds by default)
+    for (uint8_t i = 0; i < 4; i++) {
+      if (current_time - last_data_send[i] >= data_send_period[i]) {
+        Send_Data_Packet(data_categories[i]);
+        last_data_send[i] = current_time;
+      }
     }
     
     // Send heartbeat every 5 seconds
@@ -1,3 +1,4 @@
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,97 +6,48 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
 #include <time.h>
 #include <math.h>
 
-// STM32 Packet Structure
-#define STM32_HEADER_HIGH    0xAA
-#define STM32_HEADER_LOW     0x55
-#define STM32_MAX_PACKET_SIZE 64
-
-typedef enum {
-    PACKET_TYPE_POWER_MODULE = 0x01,
-    PACKET_TYPE_BATTERY      = 0x02,
-    PACKET_TYPE_AC_INPUT     = 0x03,
-    PACKET_TYPE_DC_OUTPUT    = 0x04,
-    PACKET_TYPE_ALARM        = 0x05,
-    PACKET_TYPE_SYSTEM_STATUS = 0x06,
-    PACKET_TYPE_COMMAND      = 0x07,
-    PACKET_TYPE_RESPONSE     = 0x08
-} stm32_packet_type_t;
+#include "stm32_decoder.h"
+#include "thresholds.h"
 
-typedef struct {
-    uint8_t header_high;
-    uint8_t header_low;
-    uint8_t packet_type;
-    uint8_t length;
-    uint8_t data[STM32_MAX_PACKET_SIZE - 5];
-    uint8_t checksum;
-} stm32_packet_t;
+#define SIMULATOR_PORT       9000
+#define STEP_INTERVAL_MS     1000
+#define CYCLE_MS             (6 * STEP_INTERVAL_MS)   // Default period of every category
+#define RESUME_WAIT_MS       100     // How long a new consumer has to send RESUME
+#define REPLAY_RING_SIZE     512     // Recent frames kept for session resumption
+#define KEYFRAME_ALARMS      8
 
-// Data structures
-typedef struct {
-    uint8_t module_id;
-    uint16_t voltage;      // mV
-    uint16_t current;      // mA
-    uint16_t power;        // mW
-    uint8_t temperature;   // Celsius
-    uint8_t status;        // Bit flags
-    uint8_t fault_flags;   // Bit flags
-    uint8_t reserved[4];   // Future use
-} stm32_power_module_data_t;
-
-typedef struct {
-    uint8_t battery_id;
-    uint16_t voltage;      // mV
-    uint16_t current;      // mA
-    uint8_t temperature;   // Celsius
-    uint8_t capacity;      // Percentage
-    uint8_t charging;      // 0=Not charging, 1=Charging
-    uint8_t test_status;   // 0=No test, 1=Test in progress
-    uint8_t reserved[2];   // Future use
-} stm32_battery_data_t;
+// The device keeps sampling while no consumer is connected; frames sent
+// then only land in the replay ring so a reconnecting consumer can resume.
+static int consumer_fd = -1;
+static bool awaiting_resume = false;
+static uint64_t resume_deadline_ms = 0;
+static stm32_decoder_t command_decoder;
 
-typedef struct {
-    uint8_t phase_id;
-    uint16_t voltage;      // V * 10
-    uint16_t current;      // A * 10
-    uint16_t frequency;    // Hz * 10
-    uint16_t power;        // W
-    uint8_t status;        // Bit flags
-    uint8_t reserved[2];   // Future use
-} stm32_ac_input_data_t;
+static uint32_t session_id;
+static uint32_t next_sequence = 0;
 
 typedef struct {
-    uint8_t circuit_id;
-    uint16_t voltage;      // mV
-    uint16_t current;      // mA
-    uint16_t power;        // mW
-    uint8_t enabled;       // 0=Disabled, 1=Enabled
-    uint8_t load_name[6];  // Load name (6 chars max)
-} stm32_dc_output_data_t;
+    uint32_t sequence;
+    uint8_t length;
+    uint8_t wire[STM32_MAX_PACKET_SIZE];
+} ring_entry_t;
 
-typedef struct {
-    uint32_t alarm_id;
-    uint8_t severity;      // 0=Info, 1=Warning, 2=Critical
-    uint32_t timestamp;    // Unix timestamp
-    uint8_t is_active;     // 0=Inactive, 1=Active
-    uint8_t message[7];   // Message (7 chars max)
-} stm32_alarm_data_t;
+static ring_entry_t replay_ring[REPLAY_RING_SIZE];
+static uint32_t ring_count = 0;
 
-typedef struct {
-    uint8_t mains_available;    // 0=No, 1=Yes
-    uint8_t battery_backup;     // 0=No, 1=Yes
-    uint8_t generator_running;  // 0=No, 1=Yes
-    uint8_t operation_mode;     // 0=Auto, 1=Manual, 2=Test
-    uint16_t system_load;       // Percentage * 10
-    uint16_t uptime_seconds;    // Uptime in seconds
-} stm32_system_status_t;
+// Last alarms raised, re-sent in every keyframe
+static alarm_t recent_alarms[KEYFRAME_ALARMS];
+static uint32_t recent_alarm_count = 0;
 
 // Function prototypes
-uint8_t calculate_checksum(const uint8_t* data, uint8_t length);
-void create_packet(uint8_t packet_type, const uint8_t* data, uint8_t data_length, stm32_packet_t* packet);
-void send_packet(int client_socket, const stm32_packet_t* packet);
+void send_frame(int client_socket, uint8_t packet_type, const uint8_t* data, uint8_t data_length);
+void send_sync(uint8_t mode, uint32_t sequence);
+void send_keyframe(void);
 void simulate_power_modules(int client_socket);
 void simulate_batteries(int client_socket);
 void simulate_ac_inputs(int client_socket);
@@ -103,10 +55,183 @@ void simulate_dc_outputs(int client_socket);
 void simulate_alarms(int client_socket);
 void simulate_system_status(int client_socket);
 
-int main() {
-    int server_socket, client_socket;
-    struct sockaddr_in server_addr, client_addr;
+// Per-category sampling schedule; the gateway changes periods with
+// STM32_CMD_SET_RATE commands. Categories start staggered one step apart.
+typedef struct {
+    uint8_t type;
+    void (*sample)(int client_socket);
+    uint32_t period_ms;
+    uint64_t next_ms;
+} category_t;
+
+static category_t categories[] = {
+    {PACKET_TYPE_POWER_MODULE,  simulate_power_modules, CYCLE_MS, 0},
+    {PACKET_TYPE_BATTERY,       simulate_batteries,     CYCLE_MS, 1 * STEP_INTERVAL_MS},
+    {PACKET_TYPE_AC_INPUT,      simulate_ac_inputs,     CYCLE_MS, 2 * STEP_INTERVAL_MS},
+    {PACKET_TYPE_DC_OUTPUT,     simulate_dc_outputs,    CYCLE_MS, 3 * STEP_INTERVAL_MS},
+    {PACKET_TYPE_SYSTEM_STATUS, simulate_system_status, CYCLE_MS, 4 * STEP_INTERVAL_MS},
+};
+#define CATEGORY_COUNT (sizeof(categories) / sizeof(categories[0]))
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000ull + (uint64_t)ts.tv_nsec / 1000000ull;
+}
+
+static void drop_consumer(const char* reason) {
+    if (consumer_fd < 0) return;
+    printf("STM32 Simulator: Consumer disconnected (%s), still sampling\n", reason);
+    close(consumer_fd);
+    consumer_fd = -1;
+    awaiting_resume = false;
+}
+
+static void send_raw(const uint8_t* wire, size_t length) {
+    if (consumer_fd < 0) return;
+    if (send(consumer_fd, wire, length, MSG_NOSIGNAL) != (ssize_t)length) {
+        drop_consumer("send failed");
+    }
+}
+
+static void handle_resume(const stm32_resume_t* resume) {
+    uint32_t first = resume->last_sequence + 1;
+    uint32_t missed = next_sequence - first;
+    awaiting_resume = false;
+
+    if (!(resume->flags & STM32_RESUME_FLAG_KEYFRAME) && resume->session_id == session_id &&
+        missed <= ring_count) {
+        printf("STM32 Simulator: Resuming session, replaying %u frames\n", missed);
+        send_sync(STM32_SYNC_RESUMED, first);
+        for (uint32_t seq = first; seq != next_sequence; seq++) {
+            ring_entry_t* e = &replay_ring[seq % REPLAY_RING_SIZE];
+            send_raw(e->wire, e->length);
+        }
+    } else {
+        printf("STM32 Simulator: Sending keyframe\n");
+        send_keyframe();
+    }
+}
+
+static void set_rate(uint8_t target, uint8_t units) {
+    if (units == 0) return;
+    uint32_t period = (uint32_t)units * STM32_RATE_UNIT_MS;
+    uint64_t now = now_ms();
+    for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+        category_t* c = &categories[i];
+        if (target != 0 && target != c->type) continue;
+        if (c->period_ms == period) continue;
+        printf("STM32 Simulator: Category %u every %u ms\n", c->type, period);
+        c->period_ms = period;
+        // A faster rate starts now rather than after the old, longer period
+        if (c->next_ms > now + period) c->next_ms = now + period;
+    }
+}
+
+static void on_command(const stm32_command_t* command) {
+    if (command->command_id == STM32_CMD_SET_RATE && command->action == STM32_CMD_ACTION_RATE) {
+        set_rate(command->target_id, command->parameter);
+        return;
+    }
+    if (command->command_id == STM32_CMD_THRESHOLD) {
+        if (command->action == STM32_CMD_ACTION_SET) {
+            if (!thresholds_stage(command->target_id, command->parameter, command->reserved)) {
+                printf("STM32 Simulator: Threshold key %u (index %u) = %u rejected\n",
+                       command->target_id, command->parameter, command->reserved);
+            }
+        } else if (command->action == STM32_CMD_ACTION_COMMIT) {
+            bool applied = thresholds_commit(command->reserved);
+            printf("STM32 Simulator: Thresholds version %u %s\n",
+                   command->reserved, applied ? "applied" : "rejected");
+        }
+        return;
+    }
+    printf("STM32 Simulator: Command %u for target %u (action %u)\n",
+           command->command_id, command->target_id, command->action);
+}
+
+static void on_consumer_frame(const stm32_frame_t* frame, void* user_data) {
+    (void)user_data;
+    stm32_resume_t resume;
+    stm32_command_t commands[STM32_MAX_BATCH_COMMANDS];
+
+    if (stm32_decode_resume(frame, &resume)) {
+        handle_resume(&resume);
+    } else if (stm32_decode_command(frame, &commands[0])) {
+        on_command(&commands[0]);
+    } else if (frame->type == PACKET_TYPE_COMMAND_BATCH) {
+        uint8_t count = stm32_decode_command_batch(frame, commands, STM32_MAX_BATCH_COMMANDS);
+        for (uint8_t i = 0; i < count; i++) {
+            on_command(&commands[i]);
+        }
+    }
+}
+
+static void accept_consumer(int server_socket) {
+    struct sockaddr_in client_addr;
     socklen_t client_len = sizeof(client_addr);
+    int fd = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
+    if (fd < 0) return;
+
+    // One consumer at a time; the newest connection wins
+    drop_consumer("replaced");
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    consumer_fd = fd;
+    stm32_decoder_reset(&command_decoder);
+    thresholds_discard();
+    awaiting_resume = true;
+    resume_deadline_ms = now_ms() + RESUME_WAIT_MS;
+
+    printf("STM32 Simulator: Client connected from %s:%d\n",
+           inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
+}
+
+static void read_consumer(void) {
+    uint8_t buffer[512];
+    ssize_t n = recv(consumer_fd, buffer, sizeof(buffer), 0);
+    if (n <= 0) {
+        drop_consumer(n == 0 ? "closed" : "read error");
+        return;
+    }
+    stm32_decoder_feed(&command_decoder, buffer, (size_t)n, on_consumer_frame, NULL);
+}
+
+// Runs everything that is due and returns when the next thing is. The
+// SYNC marker and the alarm check keep the fixed cycle; alarms are never
+// rate limited.
+static uint64_t run_due(uint64_t now, uint64_t* cycle_ms) {
+    if (now >= *cycle_ms) {
+        send_sync(STM32_SYNC_MARKER, next_sequence);
+        // Send alarms occasionally
+        if (rand() % 10 == 0) { // 10% chance
+            simulate_alarms(consumer_fd);
+        }
+        *cycle_ms += CYCLE_MS;
+        if (*cycle_ms <= now) *cycle_ms = now + CYCLE_MS;
+    }
+    uint64_t next = *cycle_ms;
+    for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+        category_t* c = &categories[i];
+        if (now >= c->next_ms) {
+            c->sample(consumer_fd);
+            c->next_ms += c->period_ms;
+            if (c->next_ms <= now) c->next_ms = now + c->period_ms;
+        }
+        if (c->next_ms < next) next = c->next_ms;
+    }
+    return next;
+}
+
+int main() {
+    int server_socket;
+    struct sockaddr_in server_addr;
+    
+    srand((unsigned)time(NULL));
+    session_id = ((uint32_t)rand() << 16) ^ (uint32_t)rand() ^ (uint32_t)getpid();
+    if (session_id == 0) session_id = 1;
+    stm32_decoder_init(&command_decoder);
+    thresholds_init();
     
     // Create socket
     server_socket = socket(AF_INET, SOCK_STREAM, 0);
@@ -125,7 +250,7 @@ int main() {
     // Configure server address
     server_addr.sin_family = AF_INET;
     server_addr.sin_addr.s_addr = INADDR_ANY;
-    server_addr.sin_port = htons(9000);
+    server_addr.sin_port = htons(SIMULATOR_PORT);
     
     // Bind socket
     if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
@@ -139,249 +264,234 @@ int main() {
         exit(EXIT_FAILURE);
     }
     
-    printf("STM32 Simulator: Listening on port 9000...\n");
+    printf("STM32 Simulator: Listening on port %d (session %08x)...\n", SIMULATOR_PORT, session_id);
     
-    // Accept client connection
-    client_socket = accept(server_socket, (struct sockaddr*)&client_addr, &client_len);
-    if (client_socket < 0) {
-        perror("Accept failed");
-        exit(EXIT_FAILURE);
+    // Main simulation loop: sample each category on its schedule, serve
+    // consumers in between
+    uint64_t start = now_ms();
+    uint64_t cycle_ms = start + 5 * STEP_INTERVAL_MS;
+    for (size_t i = 0; i < CATEGORY_COUNT; i++) {
+        categories[i].next_ms += start;
     }
-    
-    printf("STM32 Simulator: Client connected from %s:%d\n", 
-           inet_ntoa(client_addr.sin_addr), ntohs(client_addr.sin_port));
-    
-    // Main simulation loop
     while (1) {
-        // Send different types of data periodically
-        simulate_power_modules(client_socket);
-        usleep(1000000); // 1 second
-        
-        simulate_batteries(client_socket);
-        usleep(1000000); // 1 second
-        
-        simulate_ac_inputs(client_socket);
-        usleep(1000000); // 1 second
-        
-        simulate_dc_outputs(client_socket);
-        usleep(1000000); // 1 second
+        uint64_t now = now_ms();
+        if (awaiting_resume && now >= resume_deadline_ms) {
+            // Consumer without resume support: full state straight away
+            awaiting_resume = false;
+            send_keyframe();
+        }
+        uint64_t next_due = run_due(now, &cycle_ms);
+        now = now_ms();
+        if (next_due <= now) continue;
         
-        simulate_system_status(client_socket);
-        usleep(1000000); // 1 second
+        uint64_t deadline = next_due;
+        if (awaiting_resume && resume_deadline_ms < deadline) deadline = resume_deadline_ms;
+        if (deadline <= now) continue;
+        struct timeval tv;
+        tv.tv_sec = (time_t)((deadline - now) / 1000);
+        tv.tv_usec = (suseconds_t)(((deadline - now) % 1000) * 1000);
         
-        // Send alarms occasionally
-        if (rand() % 10 == 0) { // 10% chance
-            simulate_alarms(client_socket);
+        fd_set read_set;
+        FD_ZERO(&read_set);
+        FD_SET(server_socket, &read_set);
+        int max_fd = server_socket;
+        if (consumer_fd >= 0) {
+            FD_SET(consumer_fd, &read_set);
+            if (consumer_fd > max_fd) max_fd = consumer_fd;
         }
+        if (select(max_fd + 1, &read_set, NULL, NULL, &tv) <= 0) continue;
         
-        usleep(1000000); // 1 second
+        if (consumer_fd >= 0 && FD_ISSET(consumer_fd, &read_set)) {
+            read_consumer();
+        }
+        if (FD_ISSET(server_socket, &read_set)) {
+            accept_consumer(server_socket);
+        }
     }
     
-    close(client_socket);
     close(server_socket);
     return 0;
 }
 
-uint8_t calculate_checksum(const uint8_t* data, uint8_t length) {
-    uint8_t checksum = 0;
-    for (uint8_t i = 0; i < length; i++) {
-        checksum ^= data[i];
-    }
-    return checksum;
+// Frames use the packed wire layout shared with the gateway and the Node bridge.
+// Every frame is numbered and kept in the replay ring, connected or not.
+void send_frame(int client_socket, uint8_t packet_type, const uint8_t* data, uint8_t data_length) {
+    (void)client_socket;
+    ring_entry_t* e = &replay_ring[next_sequence % REPLAY_RING_SIZE];
+    e->sequence = next_sequence++;
+    e->length = (uint8_t)stm32_encode_frame(packet_type, data, data_length, e->wire);
+    if (ring_count < REPLAY_RING_SIZE) ring_count++;
+    send_raw(e->wire, e->length);
 }
 
-void create_packet(uint8_t packet_type, const uint8_t* data, uint8_t data_length, stm32_packet_t* packet) {
-    packet->header_high = STM32_HEADER_HIGH;
-    packet->header_low = STM32_HEADER_LOW;
-    packet->packet_type = packet_type;
-    packet->length = data_length;
-    
-    // Copy data
-    memcpy(packet->data, data, data_length);
-    
-    // Calculate and set checksum
-    packet->checksum = calculate_checksum((uint8_t*)packet, data_length + 4);
+// SYNC frames are not numbered and never replayed
+void send_sync(uint8_t mode, uint32_t sequence) {
+    stm32_sync_t sync;
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    uint8_t wire[STM32_MAX_PACKET_SIZE];
+    sync.session_id = session_id;
+    sync.next_sequence = sequence;
+    sync.mode = mode;
+    send_raw(wire, stm32_encode_frame(PACKET_TYPE_SYNC, data, stm32_encode_sync(&sync, data), wire));
 }
 
-void send_packet(int client_socket, const stm32_packet_t* packet) {
-    int total_size = 5 + packet->length; // header + type + length + data + checksum
-    send(client_socket, packet, total_size, 0);
+// Full device state in one burst
+void send_keyframe(void) {
+    uint8_t data[STM32_MAX_FRAME_DATA];
+
+    send_sync(STM32_SYNC_KEYFRAME, next_sequence);
+    simulate_power_modules(consumer_fd);
+    simulate_batteries(consumer_fd);
+    simulate_ac_inputs(consumer_fd);
+    simulate_dc_outputs(consumer_fd);
+    simulate_system_status(consumer_fd);
+    for (uint32_t i = 0; i < recent_alarm_count; i++) {
+        send_frame(consumer_fd, PACKET_TYPE_ALARM, data, stm32_encode_alarm(&recent_alarms[i], data));
+    }
 }
 
 void simulate_power_modules(int client_socket) {
-    stm32_packet_t packet;
-    stm32_power_module_data_t module_data;
+    power_module_t module;
+    uint8_t data[STM32_MAX_FRAME_DATA];
     
     // Simulate 4 power modules
     for (int i = 0; i < 4; i++) {
+        module.module_id = i + 1;
         if (i < 3) { // Active modules
-            module_data.module_id = i + 1;
-            module_data.voltage = 53500 + (rand() % 200) - 100; // 53.5V ± 0.1V
-            module_data.current = 45200 + (rand() % 4000) - 2000; // 45.2A ± 2A
-            module_data.power = module_data.voltage * module_data.current / 1000; // mW
-            module_data.temperature = 42 + (rand() % 8) - 4; // 42°C ± 4°C
-            module_data.status = 0x01; // Active
-            module_data.fault_flags = 0x00; // No faults
+            module.voltage = (53500 + (rand() % 200) - 100) / 1000.0f; // 53.5V ± 0.1V
+            module.current = (45200 + (rand() % 4000) - 2000) / 1000.0f; // 45.2A ± 2A
+            module.temperature = 42 + (rand() % 8) - 4; // 42°C ± 4°C
+            module.is_active = true;
         } else { // Inactive module
-            module_data.module_id = i + 1;
-            module_data.voltage = 0;
-            module_data.current = 0;
-            module_data.power = 0;
-            module_data.temperature = 25;
-            module_data.status = 0x00; // Inactive
-            module_data.fault_flags = 0x00; // No faults
+            module.voltage = 0;
+            module.current = 0;
+            module.temperature = 25;
+            module.is_active = false;
         }
+        module.power = module.voltage * module.current / 1000.0f; // kW
+        module.has_fault = false;
         
-        memset(module_data.reserved, 0, sizeof(module_data.reserved));
-        
-        create_packet(PACKET_TYPE_POWER_MODULE, (uint8_t*)&module_data, sizeof(module_data), &packet);
-        send_packet(client_socket, &packet);
+        send_frame(client_socket, PACKET_TYPE_POWER_MODULE, data, stm32_encode_power_module(&module, data));
         
-        printf("Sent power module %d data: %.2fV, %.2fA, %.2fW, %d°C\n", 
-               module_data.module_id,
-               module_data.voltage / 1000.0f,
-               module_data.current / 1000.0f,
-               module_data.power / 1000.0f,
-               module_data.temperature);
+        printf("Sent power module %d data: %.2fV, %.2fA, %.2fkW, %.0f°C\n", 
+               module.module_id, module.voltage, module.current, module.power, module.temperature);
     }
 }
 
 void simulate_batteries(int client_socket) {
-    stm32_packet_t packet;
-    stm32_battery_data_t battery_data;
+    battery_info_t battery;
+    uint8_t data[STM32_MAX_FRAME_DATA];
     
     // Simulate 4 batteries
     for (int i = 0; i < 4; i++) {
-        battery_data.battery_id = i + 1;
-        battery_data.voltage = 12600 + (rand() % 200) - 100; // 12.6V ± 0.1V
-        battery_data.current = 100 + (rand() % 100) - 50; // 0.1A ± 0.05A
-        battery_data.temperature = 24 + (rand() % 4) - 2; // 24°C ± 2°C
-        battery_data.capacity = 85 + (rand() % 8) - 4; // 85% ± 4%
-        battery_data.charging = (rand() % 10 == 0); // 10% chance of charging
-        battery_data.test_status = 0; // No test in progress
+        battery.battery_id = i + 1;
+        battery.voltage = (12600 + (rand() % 200) - 100) / 1000.0f; // 12.6V ± 0.1V
+        battery.current = (100 + (rand() % 100) - 50) / 1000.0f; // 0.1A ± 0.05A
+        battery.temperature = 24 + (rand() % 4) - 2; // 24°C ± 2°C
+        battery.capacity_percent = 85 + (rand() % 8) - 4; // 85% ± 4%
+        battery.is_charging = (rand() % 10 == 0); // 10% chance of charging
+        battery.test_in_progress = false; // No test in progress
         
-        memset(battery_data.reserved, 0, sizeof(battery_data.reserved));
+        send_frame(client_socket, PACKET_TYPE_BATTERY, data, stm32_encode_battery(&battery, data));
         
-        create_packet(PACKET_TYPE_BATTERY, (uint8_t*)&battery_data, sizeof(battery_data), &packet);
-        send_packet(client_socket, &packet);
-        
-        printf("Sent battery %d data: %.2fV, %.2fA, %d°C, %d%%, charging: %s\n", 
-               battery_data.battery_id,
-               battery_data.voltage / 1000.0f,
-               battery_data.current / 1000.0f,
-               battery_data.temperature,
-               battery_data.capacity,
-               battery_data.charging ? "Yes" : "No");
+        printf("Sent battery %d data: %.2fV, %.2fA, %.0f°C, %d%%, charging: %s\n", 
+               battery.battery_id, battery.voltage, battery.current, battery.temperature,
+               battery.capacity_percent, battery.is_charging ? "Yes" : "No");
     }
 }
 
 void simulate_ac_inputs(int client_socket) {
-    stm32_packet_t packet;
-    stm32_ac_input_data_t ac_data;
+    ac_phase_t phase;
+    uint8_t data[STM32_MAX_FRAME_DATA];
     
     // Simulate 3 AC phases
     for (int i = 0; i < 3; i++) {
-        ac_data.phase_id = i + 1;
-        ac_data.voltage = 2305 + (rand() % 40) - 20; // 230.5V ± 2V
-        ac_data.current = 123 + (rand() % 20) - 10; // 12.3A ± 1A
-        ac_data.frequency = 500; // 50.0Hz (fixed)
-        ac_data.power = ac_data.voltage * ac_data.current / 10; // W
-        ac_data.status = 0x01; // Normal
-        
-        memset(ac_data.reserved, 0, sizeof(ac_data.reserved));
+        phase.phase_id = i + 1;
+        phase.voltage = (2305 + (rand() % 40) - 20) / 10.0f; // 230.5V ± 2V
+        phase.current = (123 + (rand() % 20) - 10) / 10.0f; // 12.3A ± 1A
+        phase.frequency = 50.0f; // 50.0Hz (fixed)
+        phase.power = phase.voltage * phase.current / 1000.0f; // kW
+        phase.is_normal = true;
         
-        create_packet(PACKET_TYPE_AC_INPUT, (uint8_t*)&ac_data, sizeof(ac_data), &packet);
-        send_packet(client_socket, &packet);
+        send_frame(client_socket, PACKET_TYPE_AC_INPUT, data, stm32_encode_ac_input(&phase, data));
         
-        printf("Sent AC phase %d data: %.1fV, %.1fA, %.1fHz, %.1fW\n", 
-               ac_data.phase_id,
-               ac_data.voltage / 10.0f,
-               ac_data.current / 10.0f,
-               ac_data.frequency / 10.0f,
-               ac_data.power);
+        printf("Sent AC phase %d data: %.1fV, %.1fA, %.1fHz, %.2fkW\n", 
+               phase.phase_id, phase.voltage, phase.current, phase.frequency, phase.power);
     }
 }
 
 void simulate_dc_outputs(int client_socket) {
-    stm32_packet_t packet;
-    stm32_dc_output_data_t dc_data;
+    dc_circuit_t circuit;
+    uint8_t data[STM32_MAX_FRAME_DATA];
     const char* load_names[] = {"Telecom", "Secur", "Netwk", "Light", "Spare", "Spare"};
     
     // Simulate 6 DC circuits
     for (int i = 0; i < 6; i++) {
-        dc_data.circuit_id = i + 1;
+        memset(&circuit, 0, sizeof(circuit));
+        circuit.circuit_id = i + 1;
         
         if (i < 4) { // Active circuits
-            dc_data.voltage = 53500 + (rand() % 200) - 100; // 53.5V ± 0.1V
-            dc_data.current = 6000 + (rand() % 10000); // 6-16A
-            dc_data.power = dc_data.voltage * dc_data.current / 1000; // mW
-            dc_data.enabled = 1; // Enabled
-        } else { // Spare circuits
-            dc_data.voltage = 0;
-            dc_data.current = 0;
-            dc_data.power = 0;
-            dc_data.enabled = 0; // Disabled
+            circuit.voltage = (53500 + (rand() % 200) - 100) / 1000.0f; // 53.5V ± 0.1V
+            circuit.current = (6000 + (rand() % 10000)) / 1000.0f; // 6-16A
+            circuit.power = circuit.voltage * circuit.current; // W
+            circuit.is_enabled = true;
         }
         
-        strncpy((char*)dc_data.load_name, load_names[i], 6);
+        snprintf(circuit.load_name, sizeof(circuit.load_name), "%s", load_names[i]);
         
-        create_packet(PACKET_TYPE_DC_OUTPUT, (uint8_t*)&dc_data, sizeof(dc_data), &packet);
-        send_packet(client_socket, &packet);
+        send_frame(client_socket, PACKET_TYPE_DC_OUTPUT, data, stm32_encode_dc_output(&circuit, data));
         
         printf("Sent DC circuit %d data: %.2fV, %.2fA, %.2fW, enabled: %s, load: %s\n", 
-               dc_data.circuit_id,
-               dc_data.voltage / 1000.0f,
-               dc_data.current / 1000.0f,
-               dc_data.power / 1000.0f,
-               dc_data.enabled ? "Yes" : "No",
-               dc_data.load_name);
+               circuit.circuit_id, circuit.voltage, circuit.current, circuit.power,
+               circuit.is_enabled ? "Yes" : "No", circuit.load_name);
     }
 }
 
 void simulate_alarms(int client_socket) {
-    stm32_packet_t packet;
-    stm32_alarm_data_t alarm_data;
+    alarm_t alarm;
+    uint8_t data[STM32_MAX_FRAME_DATA];
     static uint32_t alarm_counter = 100;
     
     // Random alarm generation
     if (rand() % 20 == 0) { // 5% chance
-        alarm_data.alarm_id = alarm_counter++;
-        alarm_data.severity = rand() % 3; // 0=Info, 1=Warning, 2=Critical
-        alarm_data.timestamp = time(NULL);
-        alarm_data.is_active = 1;
+        memset(&alarm, 0, sizeof(alarm));
+        alarm.alarm_id = alarm_counter++;
+        alarm.severity = rand() % 3; // 0=Info, 1=Warning, 2=Critical
+        alarm.timestamp = time(NULL);
+        alarm.is_active = true;
         
         const char* messages[] = {"HighTemp", "LowVolt", "OverCur", "Fault", "Warning", "Info"};
-        strncpy((char*)alarm_data.message, messages[rand() % 6], 7);
+        snprintf(alarm.message, sizeof(alarm.message), "%s", messages[rand() % 6]);
         
-        create_packet(PACKET_TYPE_ALARM, (uint8_t*)&alarm_data, sizeof(alarm_data), &packet);
-        send_packet(client_socket, &packet);
+        send_frame(client_socket, PACKET_TYPE_ALARM, data, stm32_encode_alarm(&alarm, data));
+        recent_alarms[recent_alarm_count % KEYFRAME_ALARMS] = alarm;
+        if (recent_alarm_count < KEYFRAME_ALARMS) recent_alarm_count++;
         
-        printf("Sent alarm: ID=%d, Severity=%d, Message=%s\n", 
-               alarm_data.alarm_id, alarm_data.severity, alarm_data.message);
+        printf("Sent alarm: ID=%u, Severity=%d, Message=%s\n", 
+               alarm.alarm_id, alarm.severity, alarm.message);
     }
 }
 
 void simulate_system_status(int client_socket) {
-    stm32_packet_t packet;
-    stm32_system_status_t status_data;
+    system_status_t status;
+    uint8_t data[STM32_MAX_FRAME_DATA];
     static uint32_t uptime = 0;
     
-    status_data.mains_available = 1; // Mains available
-    status_data.battery_backup = 1; // Battery backup active
-    status_data.generator_running = 0; // Generator not running
-    status_data.operation_mode = 0; // Auto mode
-    status_data.system_load = 750 + (rand() % 200) - 100; // 75% ± 10%
-    status_data.uptime_seconds = uptime;
+    status.mains_available = true; // Mains available
+    status.battery_backup = true; // Battery backup active
+    status.generator_running = false; // Generator not running
+    status.operation_mode = 0; // Auto mode
+    status.system_load = (750 + (rand() % 200) - 100) / 10.0f; // 75% ± 10%
+    status.uptime_seconds = uptime;
     
     uptime += 1; // Increment uptime
     
-    create_packet(PACKET_TYPE_SYSTEM_STATUS, (uint8_t*)&status_data, sizeof(status_data), &packet);
-    send_packet(client_socket, &packet);
+    send_frame(client_socket, PACKET_TYPE_SYSTEM_STATUS, data, stm32_encode_system_status(&status, data));
     
-    printf("Sent system status: Mains=%s, Battery=%s, Generator=%s, Load=%.1f%%, Uptime=%ds\n", 
-           status_data.mains_available ? "Yes" : "No",
-           status_data.battery_backup ? "Yes" : "No",
-           status_data.generator_running ? "Yes" : "No",
-           status_data.system_load / 10.0f,
-           status_data.uptime_seconds);
+    printf("Sent system status: Mains=%s, Battery=%s, Generator=%s, Load=%.1f%%, Uptime=%us\n", 
+           status.mains_available ? "Yes" : "No",
+           status.battery_backup ? "Yes" : "No",
+           status.generator_running ? "Yes" : "No",
+           status.system_load,
+           status.uptime_seconds);
 }
@@ -0,0 +1,2097 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <zlib.h>
+#include "gateway.h"
+#include "gateway_stream.h"
+#include "gateway_http.h"
+#include "gateway_multicast.h"
+#include "gateway_uplink.h"
+#include "spool.h"
+#include "backoff.h"
+#include "conflate.h"
+#include "pool.h"
+#include "alloc_guard.h"
+
+#define TEST_DEVICES   16
+#define TEST_ROUNDS    20
+#define FRAMES_PER_ROUND 18   // 4 power + 4 battery + 3 AC + 6 DC + 1 status
+
+static int failures = 0;
+
+#define CHECK(cond, msg)                                   \
+    do {                                                   \
+        if (cond) {                                        \
+            printf("✓ %s\n", msg);                         \
+        } else {                                           \
+            printf("✗ %s\n", msg);                         \
+            failures++;                                    \
+        }                                                  \
+    } while (0)
+
+// Fake controller
+typedef struct {
+    int listen_fd;
+    uint16_t port;
+    uint16_t device_id;
+    pthread_t thread;
+} fake_device_t;
+
+static volatile int devices_stop = 0;
+
+static size_t build_round(uint16_t device_id, uint8_t* out) {
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    size_t n = 0;
+
+    for (int i = 0; i < 4; i++) {
+        power_module_t m = {(uint8_t)(i + 1), 53.5f, 45.0f + device_id % 10, 0, 42.0f, true, false};
+        n += stm32_encode_frame(PACKET_TYPE_POWER_MODULE, data, stm32_encode_power_module(&m, data), out + n);
+    }
+    for (int i = 0; i < 4; i++) {
+        battery_info_t b = {(uint8_t)(i + 1), 12.6f, 0.1f, 24.0f, 85, false, false};
+        n += stm32_encode_frame(PACKET_TYPE_BATTERY, data, stm32_encode_battery(&b, data), out + n);
+    }
+    for (int i = 0; i < 3; i++) {
+        ac_phase_t p = {(uint8_t)(i + 1), 230.5f, 12.3f, 50.0f, 2.8f, true};
+        n += stm32_encode_frame(PACKET_TYPE_AC_INPUT, data, stm32_encode_ac_input(&p, data), out + n);
+    }
+    for (int i = 0; i < 6; i++) {
+        dc_circuit_t c = {(uint8_t)(i + 1), 53.5f, 6.0f, 321.0f, i < 4, "Load"};
+        n += stm32_encode_frame(PACKET_TYPE_DC_OUTPUT, data, stm32_encode_dc_output(&c, data), out + n);
+    }
+    system_status_t st = {true, true, false, 0, 75.0f, 1000};
+    n += stm32_encode_frame(PACKET_TYPE_SYSTEM_STATUS, data, stm32_encode_system_status(&st, data), out + n);
+    return n;
+}
+
+static void* fake_device_main(void* arg) {
+    fake_device_t* dev = arg;
+    int fd = accept(dev->listen_fd, NULL, NULL);
+    if (fd < 0) return NULL;
+
+    uint8_t round[FRAMES_PER_ROUND * STM32_MAX_PACKET_SIZE];
+    size_t len = build_round(dev->device_id, round);
+    for (int r = 0; r < TEST_ROUNDS && !devices_stop; r++) {
+        if (send(fd, round, len, MSG_NOSIGNAL) < 0) break;
+        usleep(5000);
+    }
+    while (!devices_stop) usleep(10000);
+    close(fd);
+    return NULL;
+}
+
+static int open_listener(uint16_t* port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        return -1;
+    }
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr*)&addr, &len);
+    *port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// Sink that records per-device counts and ingest-to-publish latency
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t frames[TEST_DEVICES + 1];
+    uint32_t last_sequence[TEST_DEVICES + 1];
+    uint32_t out_of_order;
+    uint64_t latencies[TEST_DEVICES * TEST_ROUNDS * FRAMES_PER_ROUND];
+    uint32_t latency_count;
+} counting_sink_t;
+
+static void counting_sink(const gw_tagged_frame_t* frame, void* user_data) {
+    counting_sink_t* sink = user_data;
+    uint64_t latency = gw_monotonic_ns() - frame->ingest_ns;
+
+    pthread_mutex_lock(&sink->lock);
+    if (frame->device_id >= 1 && frame->device_id <= TEST_DEVICES) {
+        uint32_t* count = &sink->frames[frame->device_id];
+        if (*count > 0 && frame->sequence != sink->last_sequence[frame->device_id] + 1) {
+            sink->out_of_order++;
+        }
+        sink->last_sequence[frame->device_id] = frame->sequence;
+        (*count)++;
+    }
+    if (sink->latency_count < sizeof(sink->latencies) / sizeof(sink->latencies[0])) {
+        sink->latencies[sink->latency_count++] = latency;
+    }
+    pthread_mutex_unlock(&sink->lock);
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void test_decoder_resync(void) {
+    printf("\n=== Testing Stream Decoder ===\n");
+
+    uint8_t stream[512];
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    size_t n = 0;
+    battery_info_t b = {2, 12.6f, 0.1f, 24.0f, 85, true, false};
+    uint8_t len = stm32_encode_battery(&b, data);
+
+    stream[n++] = 0x13;                         // Line noise
+    stream[n++] = STM32_HEADER_HIGH;            // False start
+    n += stm32_encode_frame(PACKET_TYPE_BATTERY, data, len, stream + n);
+    n += stm32_encode_frame(PACKET_TYPE_BATTERY, data, len, stream + n);
+    stream[n - 1] ^= 0xFF;                      // Corrupt checksum
+    n += stm32_encode_frame(PACKET_TYPE_BATTERY, data, len, stream + n);
+
+    stm32_decoder_t decoder;
+    stm32_decoder_init(&decoder);
+    // Feed in awkward 3-byte pieces to exercise partial frames
+    for (size_t pos = 0; pos < n; pos += 3) {
+        size_t chunk = n - pos < 3 ? n - pos : 3;
+        stm32_decoder_feed(&decoder, stream + pos, chunk, NULL, NULL);
+    }
+    CHECK(decoder.frames_ok == 2, "Two valid frames recovered around noise and corruption");
+    CHECK(decoder.checksum_errors >= 1, "Corrupted frame rejected by checksum");
+
+    stm32_frame_t frame;
+    frame.type = PACKET_TYPE_BATTERY;
+    frame.length = len;
+    memcpy(frame.data, data, len);
+    battery_info_t decoded;
+    CHECK(stm32_decode_battery(&frame, &decoded) && decoded.battery_id == 2 &&
+          decoded.capacity_percent == 85 && decoded.is_charging,
+          "Battery record round-trips through the packed wire layout");
+}
+
+static void remove_spool_dir(const char* dir) {
+    char command[300];
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    if (system(command) != 0) {
+        // Leftovers only affect the next run
+    }
+}
+
+static void test_spool(void) {
+    printf("\n=== Testing Store-and-Forward Spool ===\n");
+
+    char dir[] = "/tmp/netmon_spool_XXXXXX";
+    if (!mkdtemp(dir)) {
+        CHECK(0, "Create spool directory");
+        return;
+    }
+
+    spool_config_t config;
+    spool_default_config(&config, dir);
+    config.segment_bytes = 4096;
+    config.max_bytes = 64 * 1024;
+
+    uint8_t record[64], out[64];
+    uint32_t length;
+    spool_t* spool = spool_open(&config);
+    for (uint32_t i = 0; i < 1000; i++) {
+        memset(record, (int)(i & 0xFF), sizeof(record));
+        memcpy(record, &i, sizeof(i));
+        spool_append(spool, record, sizeof(record));
+    }
+    spool_stats_t stats;
+    spool_get_stats(spool, &stats);
+    CHECK(stats.bytes_on_disk <= config.max_bytes && stats.segments_dropped > 0,
+          "Disk budget enforced by dropping oldest segments");
+
+    // Oldest surviving record is the first one after the dropped segments
+    uint32_t first = 0, expected, replayed = 0;
+    bool ordered = true;
+    for (int i = 0; i < 100 && spool_peek(spool, out, sizeof(out), &length) == HW_STATUS_OK; i++) {
+        memcpy(&expected, out, sizeof(expected));
+        if (i == 0) first = expected;
+        else if (expected != first + (uint32_t)i) ordered = false;
+        spool_advance(spool);
+        replayed++;
+    }
+    CHECK(first > 0 && ordered && replayed == 100, "Records replay in append order");
+    spool_commit(spool);
+
+    // A read that is never committed
+    spool_peek(spool, out, sizeof(out), &length);
+    spool_advance(spool);
+    spool_close(spool);
+
+    // Find the newest segment and leave a half-written record behind
+    char path[300] = "", candidate[300];
+    for (unsigned long long id = 1; id < 1000; id++) {
+        snprintf(candidate, sizeof(candidate), "%s/%016llx.seg", dir, id);
+        if (access(candidate, F_OK) == 0) memcpy(path, candidate, sizeof(path));
+    }
+    FILE* newest = fopen(path, "ab");
+    if (newest) {
+        fwrite("\x53\x50\x00\x00\x40\x00\x00\x00", 1, 8, newest);   // Header cut short
+        fclose(newest);
+    }
+
+    spool = spool_open(&config);
+    spool_get_stats(spool, &stats);
+    CHECK(stats.records_recovered_torn == 1, "Torn tail truncated on reopen");
+    CHECK(spool_peek(spool, out, sizeof(out), &length) == HW_STATUS_OK &&
+          memcpy(&expected, out, sizeof(expected)) && expected == first + 100,
+          "Replay resumes at the committed offset after restart");
+
+    while (spool_peek(spool, out, sizeof(out), &length) == HW_STATUS_OK) {
+        spool_advance(spool);
+    }
+    memcpy(&expected, out, sizeof(expected));
+    CHECK(expected == 999 && spool_is_empty(spool), "Spool drains to the newest record");
+
+    // A record larger than the reader's buffer is skipped, not peeked forever
+    uint8_t large[128];
+    memset(large, 0xAB, sizeof(large));
+    spool_append(spool, large, sizeof(large));
+    spool_append(spool, record, sizeof(record));
+    spool_get_stats(spool, &stats);
+    uint64_t dropped = stats.records_dropped;
+    bool skipped = spool_peek(spool, out, sizeof(out), &length) == HW_STATUS_INVALID_PARAM &&
+                   length == sizeof(large) && spool_skip(spool) == HW_STATUS_OK;
+    spool_get_stats(spool, &stats);
+    CHECK(skipped && stats.records_dropped == dropped + 1 &&
+          spool_peek(spool, out, sizeof(out), &length) == HW_STATUS_OK && length == sizeof(record),
+          "An oversized record is skipped and the next one is read");
+    spool_advance(spool);
+    spool_commit(spool);
+    spool_close(spool);
+
+    // Replay pacing
+    config.replay_rate = 1000;
+    spool = spool_open(&config);
+    uint32_t budget = spool_replay_budget(spool, 10000);
+    spool_consume_budget(spool, budget);
+    uint32_t after = spool_replay_budget(spool, 10050);
+    CHECK(budget == 100 && after >= 49 && after <= 51, "Token bucket paces catch-up at the configured rate");
+    spool_close(spool);
+    remove_spool_dir(dir);
+
+    // An append cut short (file size limit) leaves no partial record ahead
+    // of the next one
+    char short_dir[] = "/tmp/netmon_spool_XXXXXX";
+    if (!mkdtemp(short_dir)) {
+        CHECK(0, "Create spool directory");
+        return;
+    }
+    spool_default_config(&config, short_dir);
+    spool = spool_open(&config);
+    static uint8_t big[5000], big_out[5000];
+    memset(big, 1, sizeof(big));
+    spool_append(spool, big, sizeof(big));
+    memset(big, 2, sizeof(big));
+    spool_append(spool, big, sizeof(big));
+    spool_flush(spool);
+    signal(SIGXFSZ, SIG_IGN);
+    struct rlimit saved, limited;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    limited = saved;
+    limited.rlim_cur = 12000;   // Room for two records and part of a third
+    setrlimit(RLIMIT_FSIZE, &limited);
+    memset(big, 3, sizeof(big));
+    hw_status_t cut = spool_append(spool, big, sizeof(big));
+    setrlimit(RLIMIT_FSIZE, &saved);
+    memset(big, 4, sizeof(big));
+    spool_append(spool, big, sizeof(big));
+
+    uint8_t seen[4] = {0};
+    int count = 0;
+    while (count < 4 && spool_peek(spool, big_out, sizeof(big_out), &length) == HW_STATUS_OK) {
+        seen[count++] = big_out[0];
+        spool_advance(spool);
+    }
+    CHECK(cut == HW_STATUS_ERROR && count == 3 && seen[0] == 1 && seen[1] == 2 && seen[2] == 4,
+          "A short write is cut off and later records stay readable");
+    spool_close(spool);
+    remove_spool_dir(short_dir);
+}
+
+static void test_backoff(void) {
+    printf("\n=== Testing Reconnect Backoff ===\n");
+
+    backoff_t b;
+    backoff_init(&b, 50, 2000, 12345);
+    uint32_t first = backoff_next(&b);
+    CHECK(first >= 25 && first <= 50, "First retry lands within the initial window");
+
+    uint32_t last = 0;
+    bool bounded = true;
+    for (int i = 0; i < 20; i++) {
+        last = backoff_next(&b);
+        if (last > 2000) bounded = false;
+    }
+    CHECK(bounded && last >= 1000, "Window doubles up to the cap");
+
+    backoff_reset(&b);
+    CHECK(backoff_next(&b) <= 50, "Reset returns to fast retries");
+}
+
+// Fake controller that speaks the RESUME/SYNC handshake
+typedef struct {
+    int listen_fd;
+    uint16_t port;
+    pthread_t thread;
+    stm32_resume_t resumes[2];
+    uint64_t reconnect_gap_ns;
+} resume_device_t;
+
+static bool read_resume(int fd, stm32_resume_t* resume) {
+    uint8_t buf[64];
+    stm32_frame_t frame;
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    if (n < STM32_FRAME_OVERHEAD) return false;
+    frame.type = buf[2];
+    frame.length = buf[3];
+    memcpy(frame.data, buf + 4, frame.length);
+    return stm32_decode_resume(&frame, resume);
+}
+
+static size_t put_sync(uint8_t* out, uint8_t mode, uint32_t next_sequence) {
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    stm32_sync_t sync = {0xABCD, next_sequence, mode};
+    return stm32_encode_frame(PACKET_TYPE_SYNC, data, stm32_encode_sync(&sync, data), out);
+}
+
+static size_t put_battery(uint8_t* out, uint8_t id) {
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    battery_info_t b = {id, 12.6f, 0.1f, 24.0f, 85, false, false};
+    return stm32_encode_frame(PACKET_TYPE_BATTERY, data, stm32_encode_battery(&b, data), out);
+}
+
+static void* resume_device_main(void* arg) {
+    resume_device_t* dev = arg;
+    uint8_t out[512];
+    size_t n = 0;
+
+    // First link: no session yet, so the gateway must ask for a keyframe
+    int fd = accept(dev->listen_fd, NULL, NULL);
+    if (fd < 0 || !read_resume(fd, &dev->resumes[0])) return NULL;
+    n += put_sync(out + n, STM32_SYNC_KEYFRAME, 100);
+    for (uint8_t i = 1; i <= 3; i++) n += put_battery(out + n, i);   // Sequences 100..102
+    send(fd, out, n, MSG_NOSIGNAL);
+    usleep(50000);
+    close(fd);
+    uint64_t dropped = gw_monotonic_ns();
+
+    // Second link: the gateway should resume after sequence 102
+    fd = accept(dev->listen_fd, NULL, NULL);
+    dev->reconnect_gap_ns = gw_monotonic_ns() - dropped;
+    if (fd < 0 || !read_resume(fd, &dev->resumes[1])) return NULL;
+    n = put_sync(out, STM32_SYNC_RESUMED, 103);
+    n += put_battery(out + n, 4);
+    send(fd, out, n, MSG_NOSIGNAL);
+    while (!devices_stop) usleep(10000);
+    close(fd);
+    return NULL;
+}
+
+static void test_link_recovery(void) {
+    printf("\n=== Testing Link Recovery ===\n");
+
+    resume_device_t dev;
+    memset(&dev, 0, sizeof(dev));
+    dev.listen_fd = open_listener(&dev.port);
+    devices_stop = 0;
+    pthread_create(&dev.thread, NULL, resume_device_main, &dev);
+
+    gw_config_t config;
+    gateway_default_config(&config);
+    config.thread_count = 1;
+    gateway_t* gw = gateway_create(&config);
+    gw_device_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.device_id = 1;
+    cfg.link_type = GW_LINK_TCP;
+    strcpy(cfg.address, "127.0.0.1");
+    cfg.port = dev.port;
+    gateway_add_device(gw, &cfg);
+
+    counting_sink_t* sink = calloc(1, sizeof(counting_sink_t));
+    pthread_mutex_init(&sink->lock, NULL);
+    gateway_add_sink(gw, counting_sink, sink);
+    gateway_start(gw);
+
+    gw_stats_t stats;
+    for (int wait = 0; wait < 200; wait++) {
+        gateway_get_stats(gw, &stats);
+        if (stats.resumes > 0 && sink->frames[1] >= 4) break;
+        usleep(5000);
+    }
+
+    CHECK(dev.resumes[0].flags & STM32_RESUME_FLAG_KEYFRAME, "First connect requests a keyframe");
+    CHECK(dev.resumes[1].session_id == 0xABCD && dev.resumes[1].last_sequence == 102 &&
+          !(dev.resumes[1].flags & STM32_RESUME_FLAG_KEYFRAME),
+          "Reconnect resumes after the last device sequence");
+    printf("  Reconnect after drop: %.1f ms\n", dev.reconnect_gap_ns / 1e6);
+    CHECK(dev.reconnect_gap_ns < 200000000ull, "Link re-established within 200 ms");
+    CHECK(stats.keyframes == 1 && stats.resumes == 1, "Keyframe and resume both counted");
+    CHECK(sink->frames[1] == 4, "SYNC frames stay on the link, data frames reach sinks");
+
+    devices_stop = 1;
+    pthread_join(dev.thread, NULL);
+    close(dev.listen_fd);
+    gateway_destroy(gw);
+    pthread_mutex_destroy(&sink->lock);
+    free(sink);
+    devices_stop = 0;
+}
+
+// Out of descriptors partway through gateway_start(): the workers set up so
+// far are unwound and nothing else (stdin included) is closed
+static void test_start_failure(void) {
+    printf("\n=== Testing Gateway Start Failure ===\n");
+
+    if (fcntl(0, F_GETFD) < 0) open("/dev/null", O_RDONLY);
+    int next = open("/dev/null", O_RDONLY);
+    close(next);
+    struct rlimit saved, limited;
+    getrlimit(RLIMIT_NOFILE, &saved);
+    limited = saved;
+    limited.rlim_cur = (rlim_t)next + 3;   // Worker 0 and worker 1's epoll fd
+
+    gw_config_t config;
+    gateway_default_config(&config);
+    config.thread_count = 4;
+    gateway_t* gw = gateway_create(&config);
+    setrlimit(RLIMIT_NOFILE, &limited);
+    hw_status_t status = gateway_start(gw);
+    setrlimit(RLIMIT_NOFILE, &saved);
+    CHECK(status == HW_STATUS_ERROR, "Start fails when workers cannot get descriptors");
+    gateway_destroy(gw);
+
+    int after = open("/dev/null", O_RDONLY);
+    close(after);
+    CHECK(fcntl(0, F_GETFD) >= 0 && after == next, "Partial start is unwound without closing other fds");
+}
+
+static void test_multi_device_gateway(void) {
+    printf("\n=== Testing Multi-Device Gateway ===\n");
+
+    fake_device_t devices[TEST_DEVICES];
+    gw_config_t config;
+    gateway_default_config(&config);
+    config.thread_count = 4;
+    config.reconnect_interval_ms = 100;
+    gateway_t* gw = gateway_create(&config);
+
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        devices[i].device_id = (uint16_t)(i + 1);
+        devices[i].listen_fd = open_listener(&devices[i].port);
+        pthread_create(&devices[i].thread, NULL, fake_device_main, &devices[i]);
+
+        gw_device_config_t dev;
+        memset(&dev, 0, sizeof(dev));
+        dev.device_id = devices[i].device_id;
+        dev.link_type = GW_LINK_TCP;
+        strcpy(dev.address, "127.0.0.1");
+        dev.port = devices[i].port;
+        gateway_add_device(gw, &dev);
+    }
+
+    counting_sink_t* sink = calloc(1, sizeof(counting_sink_t));
+    pthread_mutex_init(&sink->lock, NULL);
+    gateway_add_sink(gw, counting_sink, sink);
+
+    gw_stream_server_t* stream = gw_stream_create(0);
+    gw_stream_start(stream);
+    gateway_add_sink(gw, gw_stream_sink, stream);
+
+    // Downstream consumer of the merged stream
+    int consumer = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(gw_stream_port(stream));
+    CHECK(connect(consumer, (struct sockaddr*)&addr, sizeof(addr)) == 0, "Consumer connected to merged stream");
+    usleep(50000);
+
+    CHECK(gateway_start(gw) == HW_STATUS_OK, "Gateway started with 4 event-loop threads");
+
+    uint32_t expected = TEST_DEVICES * TEST_ROUNDS * FRAMES_PER_ROUND;
+    for (int wait = 0; wait < 300; wait++) {
+        pthread_mutex_lock(&sink->lock);
+        uint32_t got = sink->latency_count;
+        pthread_mutex_unlock(&sink->lock);
+        if (got >= expected) break;
+        usleep(10000);
+    }
+
+    gw_stats_t stats;
+    gateway_get_stats(gw, &stats);
+    CHECK(stats.devices_connected == TEST_DEVICES, "All devices connected");
+    CHECK(stats.frames_in == expected, "Every frame ingested");
+    CHECK(stats.checksum_errors == 0, "No checksum errors");
+
+    int complete = 1;
+    for (int i = 1; i <= TEST_DEVICES; i++) {
+        if (sink->frames[i] != TEST_ROUNDS * FRAMES_PER_ROUND) complete = 0;
+    }
+    CHECK(complete, "Each device delivered its own full frame count");
+    CHECK(sink->out_of_order == 0, "Per-device sequences are gapless");
+
+    gw_device_state_t* state = malloc(sizeof(gw_device_state_t));
+    gateway_get_device_state(gw, 7, state);
+    CHECK(state->power_module_count == 4 && state->battery_count == 4 &&
+          state->ac_phase_count == 3 && state->dc_circuit_count == 6,
+          "Device 7 model holds 4/4/3/6 records");
+    CHECK(state->power_modules[0].current > 51.9f && state->power_modules[0].current < 52.1f,
+          "Device 7 state decoded from its own stream");
+    free(state);
+
+    // Merged stream must carry every frame, each tagged with its device
+    size_t want = (size_t)expected;
+    size_t got_frames = 0;
+    uint8_t buf[65536];
+    size_t fill = 0;
+    struct timeval tv = {1, 0};
+    setsockopt(consumer, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    int bad_tags = 0;
+    while (got_frames < want) {
+        ssize_t n = recv(consumer, buf + fill, sizeof(buf) - fill, 0);
+        if (n <= 0) break;
+        fill += (size_t)n;
+        size_t pos = 0;
+        for (;;) {
+            uint16_t id;
+            size_t used = gateway_decode_tagged(buf + pos, fill - pos, &id, NULL, NULL);
+            if (!used) break;
+            if (id < 1 || id > TEST_DEVICES) bad_tags++;
+            got_frames++;
+            pos += used;
+        }
+        memmove(buf, buf + pos, fill - pos);
+        fill -= pos;
+    }
+    CHECK(got_frames == want && bad_tags == 0, "Merged output stream carries all device-tagged frames");
+
+    qsort(sink->latencies, sink->latency_count, sizeof(uint64_t), compare_u64);
+    if (sink->latency_count) {
+        uint64_t p99 = sink->latencies[sink->latency_count * 99 / 100];
+        printf("  Ingest-to-sink latency p99: %.1f us\n", p99 / 1000.0);
+        CHECK(p99 < 5000000ull, "p99 ingest-to-publish under 5 ms");
+    }
+
+    devices_stop = 1;
+    for (int i = 0; i < TEST_DEVICES; i++) {
+        pthread_join(devices[i].thread, NULL);
+        close(devices[i].listen_fd);
+    }
+    close(consumer);
+    gateway_destroy(gw);
+    gw_stream_destroy(stream);
+    pthread_mutex_destroy(&sink->lock);
+    free(sink);
+}
+
+// Minimal HTTP/WebSocket client for the embedded endpoint
+static int http_connect(uint16_t port, const char* request) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    struct timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        send(fd, request, strlen(request), MSG_NOSIGNAL) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Reads up to and including the blank line that ends the response head
+static size_t read_head(int fd, char* out, size_t capacity) {
+    size_t n = 0;
+    while (n + 1 < capacity && recv(fd, out + n, 1, 0) == 1) {
+        n++;
+        if (n >= 4 && memcmp(out + n - 4, "\r\n\r\n", 4) == 0) break;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static bool read_exact(int fd, uint8_t* out, size_t length) {
+    size_t got = 0;
+    while (got < length) {
+        ssize_t n = recv(fd, out + got, length - got, 0);
+        if (n <= 0) return false;
+        got += (size_t)n;
+    }
+    return true;
+}
+
+// Returns the payload length, or -1; *flags receives the first header byte
+static long read_ws_message(int fd, uint8_t* flags, uint8_t* out, size_t capacity) {
+    uint8_t h[10];
+    if (!read_exact(fd, h, 2)) return -1;
+    uint64_t length = h[1] & 0x7F;
+    if (length == 126) {
+        if (!read_exact(fd, h + 2, 2)) return -1;
+        length = ((uint64_t)h[2] << 8) | h[3];
+    } else if (length == 127) {
+        if (!read_exact(fd, h + 2, 8)) return -1;
+        length = 0;
+        for (int i = 0; i < 8; i++) length = (length << 8) | h[2 + i];
+    }
+    if (length > capacity || !read_exact(fd, out, (size_t)length)) return -1;
+    *flags = h[0];
+    return (long)length;
+}
+
+// Sends one frame with a 16-bit length; masked as clients must unless mask is false
+static void send_ws_frame(int fd, uint8_t opcode, const uint8_t* payload, size_t length, bool mask) {
+    static uint8_t frame[8 + 65536];
+    static const uint8_t key[4] = {0x12, 0x34, 0x56, 0x78};
+    size_t n = 0;
+    frame[n++] = (uint8_t)(0x80 | opcode);
+    if (length < 126) {
+        frame[n++] = (uint8_t)((mask ? 0x80 : 0) | length);
+    } else {
+        frame[n++] = (uint8_t)((mask ? 0x80 : 0) | 126);
+        frame[n++] = (uint8_t)(length >> 8);
+        frame[n++] = (uint8_t)length;
+    }
+    if (mask) {
+        memcpy(frame + n, key, 4);
+        n += 4;
+    }
+    for (size_t i = 0; i < length; i++) frame[n + i] = payload[i] ^ (mask ? key[i & 3] : 0);
+    if (send(fd, frame, n + length, MSG_NOSIGNAL) < 0) {
+        // The server may already have failed the connection
+    }
+}
+
+// True once the server has closed the connection
+static bool ws_closed(int fd) {
+    uint8_t byte;
+    ssize_t n = recv(fd, &byte, 1, 0);
+    return n == 0 || (n < 0 && errno == ECONNRESET);
+}
+
+static long inflate_message(const uint8_t* in, size_t length, uint8_t* out, size_t capacity) {
+    uint8_t tail[] = {0x00, 0x00, 0xFF, 0xFF};
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, -15) != Z_OK) return -1;
+    z.next_out = out;
+    z.avail_out = (uInt)capacity;
+    z.next_in = (Bytef*)in;
+    z.avail_in = (uInt)length;
+    int rc = inflate(&z, Z_SYNC_FLUSH);
+    z.next_in = tail;
+    z.avail_in = sizeof(tail);
+    if (rc == Z_OK) rc = inflate(&z, Z_SYNC_FLUSH);
+    long produced = (long)(capacity - z.avail_out);
+    inflateEnd(&z);
+    return rc == Z_OK || rc == Z_BUF_ERROR ? produced : -1;
+}
+
+static void test_http_endpoint(void) {
+    printf("\n=== Testing HTTP/WebSocket Endpoint ===\n");
+
+    gw_config_t config;
+    gateway_default_config(&config);
+    config.thread_count = 1;
+    gateway_t* gw = gateway_create(&config);
+    gw_http_server_t* http = gw_http_create(gw, 0);
+    CHECK(http && gw_http_start(http) == HW_STATUS_OK, "HTTP endpoint starts on an ephemeral port");
+    uint16_t port = gw_http_port(http);
+
+    char head[1024];
+    static uint8_t body[65536];
+    int fd = http_connect(port, "GET /api/snapshot HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    read_head(fd, head, sizeof(head));
+    ssize_t n = recv(fd, body, sizeof(body) - 1, MSG_WAITALL);
+    body[n > 0 ? n : 0] = '\0';
+    close(fd);
+    CHECK(strncmp(head, "HTTP/1.1 200", 12) == 0 && strstr((char*)body, "\"type\":\"snapshot\"") != NULL,
+          "GET /api/snapshot returns the JSON snapshot");
+
+    fd = http_connect(port, "GET /nope HTTP/1.1\r\n\r\n");
+    read_head(fd, head, sizeof(head));
+    close(fd);
+    CHECK(strncmp(head, "HTTP/1.1 404", 12) == 0, "Unknown paths return 404");
+
+    // RFC 6455 section 1.3 sample key
+    const char* upgrade =
+        "GET /ws HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n%s\r\n";
+    char request[512];
+    snprintf(request, sizeof(request), upgrade, "");
+    int plain = http_connect(port, request);
+    read_head(plain, head, sizeof(head));
+    CHECK(strncmp(head, "HTTP/1.1 101", 12) == 0 &&
+          strstr(head, "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") != NULL,
+          "WebSocket handshake computes the RFC 6455 accept key");
+
+    snprintf(request, sizeof(request), upgrade, "Sec-WebSocket-Extensions: permessage-deflate\r\n");
+    int compressed = http_connect(port, request);
+    read_head(compressed, head, sizeof(head));
+    CHECK(strstr(head, "permessage-deflate") != NULL, "permessage-deflate is negotiated when offered");
+
+    int second = http_connect(port, request);
+    read_head(second, head, sizeof(head));
+
+    uint8_t flags;
+    long len = read_ws_message(plain, &flags, body, sizeof(body) - 1);
+    body[len > 0 ? len : 0] = '\0';
+    CHECK(len > 0 && (flags & 0x0F) == 0x1 && strstr((char*)body, "\"snapshot\"") != NULL,
+          "WebSocket clients get a snapshot on connect");
+    read_ws_message(compressed, &flags, body, sizeof(body));
+    read_ws_message(second, &flags, body, sizeof(body));
+
+    gw_http_stats_t stats;
+    for (int wait = 0; wait < 100; wait++) {
+        gw_http_get_stats(http, &stats);
+        if (stats.websocket_clients == 3) break;
+        usleep(5000);
+    }
+
+    // One batch of frames from a device, fed straight into the sink
+    uint64_t serialized_before = stats.messages_serialized;
+    uint64_t sent_before = stats.messages_sent;
+    uint8_t wire[GW_MAX_TAGGED_SIZE];
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    stm32_frame_t frame;
+    for (uint8_t i = 1; i <= 8; i++) {
+        battery_info_t b = {i, 12.6f, 0.1f, 24.0f, 85, false, false};
+        frame.type = PACKET_TYPE_BATTERY;
+        frame.length = (uint8_t)stm32_encode_battery(&b, data);
+        memcpy(frame.data, data, frame.length);
+        gw_tagged_frame_t tagged = {7, i, gw_monotonic_ns(), &frame, wire, 0};
+        tagged.wire_length = gateway_encode_tagged(7, i, &frame, wire);
+        gw_http_sink(&tagged, http);
+    }
+
+    len = read_ws_message(plain, &flags, body, sizeof(body) - 1);
+    body[len > 0 ? len : 0] = '\0';
+    CHECK(len > 0 && strstr((char*)body, "\"type\":\"update\"") != NULL &&
+          strstr((char*)body, "\"type\":\"battery\"") != NULL && strstr((char*)body, "\"device\":7") != NULL,
+          "Live frames arrive as a JSON update batch");
+
+    static uint8_t inflated[65536];
+    len = read_ws_message(compressed, &flags, body, sizeof(body));
+    long plain_len = len;
+    len = len > 0 && (flags & 0x40) ? inflate_message(body, (size_t)len, inflated, sizeof(inflated) - 1) : -1;
+    inflated[len > 0 ? len : 0] = '\0';
+    CHECK(len > plain_len && strstr((char*)inflated, "\"type\":\"update\"") != NULL,
+          "Deflate clients receive compressed frames (RSV1) that inflate to the update");
+    read_ws_message(second, &flags, body, sizeof(body));
+
+    // The sink may have been drained in more than one batch; every batch
+    // reaches three clients but is encoded only for the two variants
+    gw_http_get_stats(http, &stats);
+    uint64_t encoded = stats.messages_serialized - serialized_before;
+    uint64_t sent = stats.messages_sent - sent_before;
+    printf("  Messages encoded: %llu, sent: %llu\n", (unsigned long long)encoded, (unsigned long long)sent);
+    CHECK(encoded > 0 && encoded * 3 == sent * 2, "Each batch is encoded once per variant, not once per client");
+
+    // Client frames. The input buffer holds 8191 bytes, so a frame with a
+    // 16-bit length and a mask key (8 header bytes) carries at most 8183.
+    snprintf(request, sizeof(request), upgrade, "");
+    int client[4];
+    for (int i = 0; i < 4; i++) {
+        client[i] = http_connect(port, request);
+        read_head(client[i], head, sizeof(head));
+        read_ws_message(client[i], &flags, body, sizeof(body));
+    }
+    static uint8_t filler[8184];
+    send_ws_frame(client[0], 0x2, filler, 8183, true);
+    send_ws_frame(client[0], 0x9, (const uint8_t*)"hi", 2, true);
+    len = read_ws_message(client[0], &flags, body, sizeof(body));
+    CHECK(len == 2 && (flags & 0x0F) == 0xA && memcmp(body, "hi", 2) == 0,
+          "A frame filling the input buffer is accepted and a masked ping is answered");
+    send_ws_frame(client[1], 0x2, filler, 8184, true);
+    CHECK(ws_closed(client[1]), "A frame larger than the input buffer fails the connection");
+    send_ws_frame(client[2], 0x9, (const uint8_t*)"hi", 2, false);
+    CHECK(ws_closed(client[2]), "An unmasked client frame fails the connection");
+    // A 64-bit length that would wrap a header + length sum
+    const uint8_t huge[14] = {0x82, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFA, 1, 2, 3, 4};
+    send(client[3], huge, sizeof(huge), MSG_NOSIGNAL);
+    CHECK(ws_closed(client[3]), "A 64-bit frame length is refused without overflowing");
+    for (int i = 0; i < 4; i++) close(client[i]);
+
+    close(plain);
+    close(compressed);
+    close(second);
+    gw_http_destroy(http);
+    gateway_destroy(gw);
+}
+
+// A spooled record too large to be a tagged frame must not wedge replay
+static void test_stream_replay_skip(void) {
+    printf("\n=== Testing Stream Replay Past Oversized Records ===\n");
+
+    char dir[] = "/tmp/netmon_spool_XXXXXX";
+    if (!mkdtemp(dir)) {
+        CHECK(0, "Create spool directory");
+        return;
+    }
+    spool_config_t config;
+    spool_default_config(&config, dir);
+    spool_t* spool = spool_open(&config);
+
+    static uint8_t oversized[GW_MAX_TAGGED_SIZE + 1];
+    uint8_t wire[GW_MAX_TAGGED_SIZE];
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    stm32_frame_t frame;
+    battery_info_t b = {1, 12.6f, 0.1f, 24.0f, 85, false, false};
+    frame.type = PACKET_TYPE_BATTERY;
+    frame.length = (uint8_t)stm32_encode_battery(&b, data);
+    memcpy(frame.data, data, frame.length);
+    size_t wire_length = gateway_encode_tagged(3, 1, &frame, wire);
+    spool_append(spool, oversized, sizeof(oversized));
+    spool_append(spool, wire, (uint32_t)wire_length);
+
+    gw_stream_server_t* stream = gw_stream_create(0);
+    gw_stream_set_spool(stream, spool);
+    gw_stream_start(stream);
+
+    int consumer = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(gw_stream_port(stream));
+    struct timeval tv = {2, 0};
+    setsockopt(consumer, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    uint8_t got[GW_MAX_TAGGED_SIZE];
+    bool received = connect(consumer, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+                    read_exact(consumer, got, wire_length) && memcmp(got, wire, wire_length) == 0;
+    gw_stream_stats_t stats;
+    gw_stream_get_stats(stream, &stats);
+    CHECK(received && stats.frames_replayed == 1, "Replay skips the oversized record and sends the next frame");
+
+    close(consumer);
+    gw_stream_destroy(stream);
+    spool_close(spool);
+    remove_spool_dir(dir);
+}
+
+// Receiver-side sink: checks per-device order and counts frames
+typedef struct {
+    uint32_t frames;
+    uint32_t out_of_order;
+    uint32_t last_sequence;
+} mcast_sink_t;
+
+static void mcast_counting_sink(const gw_tagged_frame_t* frame, void* user_data) {
+    mcast_sink_t* sink = user_data;
+    if (sink->frames > 0 && frame->sequence <= sink->last_sequence) sink->out_of_order++;
+    sink->last_sequence = frame->sequence;
+    sink->frames++;
+}
+
+static void publish_batteries(gw_mcast_publisher_t* pub, uint32_t first, uint32_t count) {
+    uint8_t wire[GW_MAX_TAGGED_SIZE];
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    stm32_frame_t frame;
+    for (uint32_t i = 0; i < count; i++) {
+        battery_info_t b = {(uint8_t)(i % 4 + 1), 12.6f, 0.1f, 24.0f, 85, false, false};
+        frame.type = PACKET_TYPE_BATTERY;
+        frame.length = (uint8_t)stm32_encode_battery(&b, data);
+        memcpy(frame.data, data, frame.length);
+        gw_tagged_frame_t tagged = {3, first + i, gw_monotonic_ns(), &frame, wire, 0};
+        tagged.wire_length = gateway_encode_tagged(3, first + i, &frame, wire);
+        gw_mcast_sink(&tagged, pub);
+        if (i % 50 == 49) usleep(1000);   // Spread over several batches
+    }
+}
+
+static void poll_receivers(gw_mcast_receiver_t** rx, mcast_sink_t* sinks, int count, uint32_t expected) {
+    for (int wait = 0; wait < 300; wait++) {
+        bool done = true;
+        for (int i = 0; i < count; i++) {
+            gw_mcast_receiver_poll(rx[i], 5, mcast_counting_sink, &sinks[i]);
+            if (sinks[i].last_sequence < expected) done = false;
+        }
+        if (done) break;
+    }
+}
+
+static void test_multicast(void) {
+    printf("\n=== Testing UDP Multicast Distribution ===\n");
+    const uint32_t frames = 2000;
+
+    gw_mcast_config_t config;
+    gw_mcast_default_config(&config);
+    snprintf(config.group, sizeof(config.group), "239.255.77.1");
+    config.port = 19277;
+    snprintf(config.interface_addr, sizeof(config.interface_addr), "127.0.0.1");
+    config.heartbeat_ms = 20;
+
+    gw_mcast_receiver_config_t rx_config;
+    gw_mcast_receiver_default_config(&rx_config);
+    snprintf(rx_config.group, sizeof(rx_config.group), "%s", config.group);
+    rx_config.port = config.port;
+    snprintf(rx_config.interface_addr, sizeof(rx_config.interface_addr), "127.0.0.1");
+    rx_config.nack_interval_ms = 5;
+
+    // Three listeners, one of which loses every 3rd datagram
+    gw_mcast_receiver_t* rx[3];
+    mcast_sink_t sinks[3];
+    memset(sinks, 0, sizeof(sinks));
+    for (int i = 0; i < 3; i++) {
+        rx_config.loss_every = i == 2 ? 3 : 0;
+        rx[i] = gw_mcast_receiver_open(&rx_config);
+    }
+    gw_mcast_publisher_t* pub = gw_mcast_publisher_create(&config);
+    CHECK(rx[0] && rx[1] && rx[2] && pub && gw_mcast_publisher_start(pub) == HW_STATUS_OK,
+          "Publisher and receivers join the group over loopback");
+    if (!rx[0] || !rx[1] || !rx[2] || !pub) return;
+
+    // Let the receivers sync on a heartbeat before data flows
+    for (int i = 0; i < 10; i++) {
+        for (int r = 0; r < 3; r++) gw_mcast_receiver_poll(rx[r], 5, mcast_counting_sink, &sinks[r]);
+    }
+    publish_batteries(pub, 1, frames);
+    poll_receivers(rx, sinks, 3, frames);
+
+    gw_mcast_publisher_stats_t pub_stats;
+    gw_mcast_receiver_stats_t rx_stats[3];
+    gw_mcast_publisher_get_stats(pub, &pub_stats);
+    for (int i = 0; i < 3; i++) gw_mcast_receiver_get_stats(rx[i], &rx_stats[i]);
+
+    printf("  Datagrams sent: %llu for %u frames, NACKs: %llu, retransmits: %llu\n",
+           (unsigned long long)pub_stats.datagrams_sent, frames,
+           (unsigned long long)pub_stats.nacks_received, (unsigned long long)pub_stats.retransmits);
+    CHECK(pub_stats.datagrams_sent > 1 && pub_stats.datagrams_sent < frames / 10,
+          "Frames are packed into MTU-sized datagrams");
+    CHECK(sinks[0].frames == frames && sinks[1].frames == frames && sinks[0].out_of_order == 0,
+          "Every listener receives every frame from one send");
+    CHECK(rx_stats[2].gaps > 0 && rx_stats[2].recovered > 0 && rx_stats[2].lost == 0,
+          "Lossy listener recovers its gaps through NACKs");
+    CHECK(sinks[2].frames == frames && sinks[2].out_of_order == 0, "Recovered frames are delivered in order");
+    CHECK(pub_stats.retransmits == rx_stats[2].recovered + rx_stats[2].duplicates,
+          "Retransmits go only to the listener that asked");
+
+    // A publisher with little history answers GONE; the listener skips ahead
+    gw_mcast_publisher_destroy(pub);
+    config.history = 4;
+    pub = gw_mcast_publisher_create(&config);
+    gw_mcast_publisher_start(pub);
+    for (int i = 0; i < 3; i++) memset(&sinks[i], 0, sizeof(sinks[i]));
+    for (int i = 0; i < 10; i++) {
+        for (int r = 0; r < 3; r++) gw_mcast_receiver_poll(rx[r], 5, mcast_counting_sink, &sinks[r]);
+    }
+    publish_batteries(pub, 1, frames);
+    usleep(20000);
+    poll_receivers(rx, sinks, 3, frames);
+
+    gw_mcast_publisher_get_stats(pub, &pub_stats);
+    gw_mcast_receiver_get_stats(rx[2], &rx_stats[2]);
+    CHECK(rx_stats[2].session_changes == 1, "Listener follows a restarted publisher");
+    CHECK(pub_stats.gone > 0 && rx_stats[2].lost > 0 && sinks[2].last_sequence == frames &&
+          sinks[2].out_of_order == 0,
+          "Unrecoverable gaps are reported as lost and delivery continues");
+
+    for (int i = 0; i < 3; i++) gw_mcast_receiver_close(rx[i]);
+    gw_mcast_publisher_destroy(pub);
+}
+
+static void test_conflate(void) {
+    printf("\n=== Testing Conflating Queue ===\n");
+
+    conflate_queue_t* q = conflate_create(4, 2, 16);
+    uint8_t out[16];
+    uint32_t length;
+    CHECK(q && conflate_pop(q, out, sizeof(out), &length) == HW_STATUS_TIMEOUT, "Empty queue pops nothing");
+
+    // Key 1 is updated three times before the consumer reads
+    conflate_push(q, 1, false, (const uint8_t*)"a1", 2);
+    conflate_push(q, 2, false, (const uint8_t*)"b1", 2);
+    conflate_push(q, 1, false, (const uint8_t*)"a2", 2);
+    conflate_push(q, 1, false, (const uint8_t*)"a3", 2);
+    conflate_stats_t stats;
+    conflate_get_stats(q, &stats);
+    CHECK(stats.depth == 2 && stats.conflated == 2, "Repeated keys replace the queued value");
+    conflate_pop(q, out, sizeof(out), &length);
+    CHECK(length == 2 && memcmp(out, "a3", 2) == 0, "Conflated value keeps its queue position, latest wins");
+
+    // An alarm seals the values queued before it
+    conflate_push(q, 9, true, (const uint8_t*)"ALARM", 5);
+    conflate_push(q, 2, false, (const uint8_t*)"b2", 2);
+    conflate_push(q, 9, true, (const uint8_t*)"ALARM2", 6);
+    bool lossless_full = conflate_push(q, 9, true, (const uint8_t*)"ALARM3", 6) == HW_STATUS_ERROR;
+    const char* expected[] = {"b1", "ALARM", "b2", "ALARM2"};
+    bool ordered = true;
+    for (int i = 0; i < 4; i++) {
+        if (conflate_pop(q, out, sizeof(out), &length) != HW_STATUS_OK ||
+            length != strlen(expected[i]) || memcmp(out, expected[i], length) != 0) {
+            ordered = false;
+        }
+    }
+    CHECK(ordered, "Alarms are never conflated and newer values queue behind them");
+    CHECK(lossless_full, "Lossless backlog is bounded");
+
+    for (uint64_t k = 0; k < 4; k++) conflate_push(q, 100 + k, false, (const uint8_t*)"x", 1);
+    CHECK(conflate_push(q, 200, false, (const uint8_t*)"y", 1) == HW_STATUS_ERROR &&
+          conflate_push(q, 101, false, (const uint8_t*)"z", 1) == HW_STATUS_OK,
+          "Key budget is bounded; known keys still update");
+    conflate_destroy(q);
+
+    // Alarms between every update use up the entries; a queued key is
+    // still taken, a new one is not
+    q = conflate_create(2, 4, 16);
+    const char* values[] = {"a1", "a2", "a3", "a4"};
+    for (int i = 0; i < 4; i++) {
+        conflate_push(q, 1, false, (const uint8_t*)values[i], 2);
+        conflate_push(q, 9, true, (const uint8_t*)"ALARM", 5);
+    }
+    CHECK(conflate_push(q, 1, false, (const uint8_t*)"a5", 2) == HW_STATUS_OK &&
+          conflate_push(q, 2, false, (const uint8_t*)"b1", 2) == HW_STATUS_ERROR,
+          "A full queue still takes a queued key and refuses a new one");
+    const char* drained[] = {"a1", "ALARM", "a2", "ALARM", "a3", "ALARM", "a5", "ALARM"};
+    ordered = true;
+    for (int i = 0; i < 8; i++) {
+        if (conflate_pop(q, out, sizeof(out), &length) != HW_STATUS_OK ||
+            length != strlen(drained[i]) || memcmp(out, drained[i], length) != 0) {
+            ordered = false;
+        }
+    }
+    CHECK(ordered && conflate_is_empty(q), "The newest value replaces the last queued one in place");
+    conflate_destroy(q);
+}
+
+// Pool worker: stamps every block it gets, swaps it through a shared stash
+// so most blocks are put back by a different thread than the one that got them
+#define POOL_STASH      16
+#define POOL_WORKERS    4
+#define POOL_ROUNDS     20000
+
+typedef struct {
+    pool_t* pool;
+    pthread_mutex_t lock;
+    void* stash[POOL_STASH];
+    uint32_t stash_count;
+    atomic_uint misses;
+    atomic_uint double_handouts;
+} pool_shared_t;
+
+static void* pool_worker_main(void* arg) {
+    pool_shared_t* shared = arg;
+    for (int r = 0; r < POOL_ROUNDS; r++) {
+        uint64_t* block = pool_get(shared->pool);
+        if (!block) {
+            atomic_fetch_add(&shared->misses, 1);
+            continue;
+        }
+        // The free list owns the first word; the stamp lives in the second
+        if (block[1] != 0) atomic_fetch_add(&shared->double_handouts, 1);
+        block[1] = 0xB10C;
+
+        pthread_mutex_lock(&shared->lock);
+        if (shared->stash_count < POOL_STASH) {
+            shared->stash[shared->stash_count++] = block;
+            block = NULL;
+        }
+        uint64_t* other = shared->stash_count > POOL_STASH / 2 ? shared->stash[--shared->stash_count] : NULL;
+        pthread_mutex_unlock(&shared->lock);
+
+        if (block) {
+            block[1] = 0;
+            pool_put(shared->pool, block);
+        }
+        if (other) {
+            other[1] = 0;
+            pool_put(shared->pool, other);
+        }
+    }
+    return NULL;
+}
+
+static void test_pool(void) {
+    printf("\n=== Testing Block Pool ===\n");
+
+    pool_t* pool = pool_create(100, 64);
+    CHECK(pool && pool_block_size(pool) == 112, "Block size rounds up to 16 bytes");
+
+    void* blocks[64];
+    bool distinct = true, owned = true;
+    for (int i = 0; i < 64; i++) {
+        blocks[i] = pool_get(pool);
+        owned = owned && pool_owns(pool, blocks[i]);
+        for (int j = 0; j < i; j++) {
+            if (blocks[j] == blocks[i]) distinct = false;
+        }
+    }
+    CHECK(distinct && owned, "Every block is handed out once and belongs to the pool");
+    int local;
+    CHECK(pool_get(pool) == NULL && !pool_owns(pool, &local), "An exhausted pool returns NULL");
+
+    pool_stats_t stats;
+    pool_get_stats(pool, &stats);
+    CHECK(stats.in_use == 64 && stats.carved == 64 && stats.exhausted == 1, "Stats count blocks out and misses");
+    for (int i = 0; i < 64; i++) pool_put(pool, blocks[i]);
+    void* again = pool_get(pool);
+    pool_get_stats(pool, &stats);
+    CHECK(again == blocks[63] && stats.in_use == 1, "A put block is the next one handed out");
+    pool_put(pool, again);
+    pool_destroy(pool);
+
+    // Blocks cross threads; per-thread caches must never hand one out twice
+    pool_shared_t shared;
+    memset(&shared, 0, sizeof(shared));
+    shared.pool = pool_create(64, POOL_WORKERS * POOL_CACHE_BLOCKS + POOL_STASH + POOL_WORKERS * 2);
+    pthread_mutex_init(&shared.lock, NULL);
+    pthread_t workers[POOL_WORKERS];
+    for (int i = 0; i < POOL_WORKERS; i++) pthread_create(&workers[i], NULL, pool_worker_main, &shared);
+    for (int i = 0; i < POOL_WORKERS; i++) pthread_join(workers[i], NULL);
+    for (uint32_t i = 0; i < shared.stash_count; i++) {
+        ((uint64_t*)shared.stash[i])[1] = 0;
+        pool_put(shared.pool, shared.stash[i]);
+    }
+    pool_get_stats(shared.pool, &stats);
+    CHECK(atomic_load(&shared.double_handouts) == 0, "No block is handed to two threads at once");
+    CHECK(atomic_load(&shared.misses) == 0 && stats.in_use == 0 &&
+          stats.gets == POOL_WORKERS * POOL_ROUNDS,
+          "Cross-thread puts return every block");
+    pthread_mutex_destroy(&shared.lock);
+    pool_destroy(shared.pool);
+}
+
+static size_t put_tagged_battery(uint8_t* out, uint16_t device_id, uint8_t id, float voltage, uint32_t sequence) {
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    stm32_frame_t frame;
+    battery_info_t b = {id, voltage, 0.1f, 24.0f, 85, false, false};
+    frame.type = PACKET_TYPE_BATTERY;
+    frame.length = (uint8_t)stm32_encode_battery(&b, data);
+    memcpy(frame.data, data, frame.length);
+    return gateway_encode_tagged(device_id, sequence, &frame, out);
+}
+
+static size_t put_tagged_alarm(uint8_t* out, uint32_t alarm_id, uint32_t sequence) {
+    uint8_t data[STM32_MAX_FRAME_DATA];
+    stm32_frame_t frame;
+    alarm_t a;
+    memset(&a, 0, sizeof(a));
+    a.alarm_id = alarm_id;
+    a.severity = 2;
+    a.is_active = true;
+    strcpy(a.message, "Test");
+    frame.type = PACKET_TYPE_ALARM;
+    frame.length = (uint8_t)stm32_encode_alarm(&a, data);
+    memcpy(frame.data, data, frame.length);
+    return gateway_encode_tagged(5, sequence, &frame, out);
+}
+
+static void test_slow_consumer(void) {
+    printf("\n=== Testing Slow Consumer Conflation ===\n");
+
+    gw_stream_server_t* stream = gw_stream_create(0);
+    gw_stream_start(stream);
+
+    // Consumer with a tiny receive window that does not read for a while
+    int consumer = socket(AF_INET, SOCK_STREAM, 0);
+    int small = 4096;
+    setsockopt(consumer, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(gw_stream_port(stream));
+    connect(consumer, (struct sockaddr*)&addr, sizeof(addr));
+    gw_stream_stats_t stats;
+    for (int wait = 0; wait < 100; wait++) {
+        gw_stream_get_stats(stream, &stats);
+        if (stats.clients == 1) break;
+        usleep(5000);
+    }
+
+    // 4 batteries updated 100k times each, one alarm every 10k frames
+    const uint32_t rounds = 100000;
+    uint8_t wire[GW_MAX_TAGGED_SIZE];
+    stm32_frame_t frame;
+    uint32_t sequence = 0, alarms = 0;
+    uint64_t started = gw_monotonic_ns();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (uint8_t id = 1; id <= 4; id++) {
+            float voltage = 10.0f + (float)(r % 5000) / 1000.0f;
+            size_t n = put_tagged_battery(wire, 5, id, voltage, ++sequence);
+            gw_tagged_frame_t tagged = {5, sequence, 0, &frame, wire, n};
+            gw_stream_sink(&tagged, stream);
+        }
+        if (r % 2500 == 0) {
+            size_t n = put_tagged_alarm(wire, ++alarms, ++sequence);
+            gw_tagged_frame_t tagged = {5, sequence, 0, &frame, wire, n};
+            gw_stream_sink(&tagged, stream);
+        }
+    }
+    double per_frame_ns = (double)(gw_monotonic_ns() - started) / sequence;
+    usleep(50000);
+    gw_stream_get_stats(stream, &stats);
+    printf("  %u frames published at %.0f ns/frame, %llu conflated\n", sequence, per_frame_ns,
+           (unsigned long long)stats.frames_conflated);
+    CHECK(stats.clients == 1 && stats.clients_dropped == 0, "Slow consumer stays connected");
+    CHECK(stats.frames_conflated > 0, "Frames for the slow consumer are conflated");
+
+    // Now drain: every alarm must arrive, in order, and the last values must be current
+    static uint8_t buffer[1 << 16];
+    size_t have = 0;
+    uint32_t alarms_seen = 0, alarm_order_errors = 0, frames_seen = 0;
+    uint32_t last_sequence[5] = {0}, last_alarm_sequence = 0, sequence_regressions = 0;
+    float last_voltage[5] = {0};
+    struct timeval tv = {0, 200000};
+    setsockopt(consumer, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    for (;;) {
+        ssize_t n = recv(consumer, buffer + have, sizeof(buffer) - have, 0);
+        if (n <= 0) break;
+        have += (size_t)n;
+        size_t pos = 0;
+        for (;;) {
+            uint16_t device_id;
+            uint32_t seq;
+            size_t used = gateway_decode_tagged(buffer + pos, have - pos, &device_id, &seq, &frame);
+            if (!used) break;
+            // Conflation reorders records against each other, never against
+            // an earlier alarm or against older values of the same record
+            if (seq <= last_alarm_sequence) sequence_regressions++;
+            frames_seen++;
+            if (frame.type == PACKET_TYPE_ALARM) {
+                alarm_t a;
+                stm32_decode_alarm(&frame, &a);
+                if (a.alarm_id != alarms_seen + 1) alarm_order_errors++;
+                alarms_seen++;
+                last_alarm_sequence = seq;
+            } else {
+                battery_info_t b;
+                if (stm32_decode_battery(&frame, &b) && b.battery_id <= 4) {
+                    if (seq <= last_sequence[b.battery_id]) sequence_regressions++;
+                    last_sequence[b.battery_id] = seq;
+                    last_voltage[b.battery_id] = b.voltage;
+                }
+            }
+            pos += used;
+        }
+        memmove(buffer, buffer + pos, have - pos);
+        have -= pos;
+    }
+    printf("  Consumer read %u of %u frames\n", frames_seen, sequence);
+    float final_voltage = 10.0f + (float)((rounds - 1) % 5000) / 1000.0f;
+    CHECK(alarms_seen == alarms && alarm_order_errors == 0, "Every alarm delivered, in order");
+    CHECK(sequence_regressions == 0, "Per-record and alarm ordering preserved");
+    CHECK(last_voltage[1] > final_voltage - 0.01f && last_voltage[4] > final_voltage - 0.01f,
+          "Consumer ends with the latest value of every record");
+
+    close(consumer);
+    gw_stream_destroy(stream);
+}
+
+// Central-side sink for the uplink test: per-channel frames, bytes and order
+typedef struct {
+    uint32_t frames[256];
+    uint32_t bytes[256];
+    uint32_t last_sequence[256];
+    uint32_t out_of_order;
+} uplink_sink_t;
+
+static void uplink_counting_sink(const gw_tagged_frame_t* frame, void* user_data) {
+    uplink_sink_t* sink = user_data;
+    uint8_t c = (uint8_t)frame->device_id;
+    if (sink->frames[c] > 0 && frame->sequence <= sink->last_sequence[c]) sink->out_of_order++;
+    sink->last_sequence[c] = frame->sequence;
+    sink->frames[c]++;
+    sink->bytes[c] += (uint32_t)frame->wire_length;
+}
+
+static void test_uplink(void) {
+    printf("\n=== Testing Multiplexed Uplink ===\n");
+
+    gw_uplink_server_t* central = gw_uplink_server_open(0);
+    CHECK(central != NULL, "Central uplink listener opens");
+    if (!central) return;
+
+    gw_uplink_config_t config;
+    gw_uplink_default_config(&config);
+    config.port = gw_uplink_server_port(central);
+    config.window = 4096;
+    config.channel_queue = 1024 * 1024;
+    gw_uplink_t* uplink = gw_uplink_create(&config);
+    CHECK(uplink && gw_uplink_start(uplink) == HW_STATUS_OK, "Uplink starts");
+
+    // Channel 7's consumer is stuck; 50 quiet sites share the link with it
+    static uplink_sink_t sink;
+    memset(&sink, 0, sizeof(sink));
+    gw_uplink_server_pause(central, 7, true);
+
+    const uint32_t quiet_frames = 20, noisy_frames = 3000;
+    uint8_t wire[GW_MAX_TAGGED_SIZE];
+    stm32_frame_t frame;
+    for (uint32_t i = 0; i < noisy_frames; i++) {
+        size_t n = put_tagged_battery(wire, 7, 1, 12.0f, i + 1);
+        gw_tagged_frame_t tagged = {7, i + 1, 0, &frame, wire, n};
+        gw_uplink_sink(&tagged, uplink);
+        if (i < quiet_frames) {
+            for (uint16_t site = 100; site < 150; site++) {
+                n = put_tagged_battery(wire, site, 1, 12.0f, i + 1);
+                gw_tagged_frame_t quiet = {site, i + 1, 0, &frame, wire, n};
+                gw_uplink_sink(&quiet, uplink);
+            }
+        }
+    }
+
+    bool quiet_done = false;
+    for (int wait = 0; wait < 200 && !quiet_done; wait++) {
+        gw_uplink_server_poll(central, 10, uplink_counting_sink, &sink);
+        quiet_done = true;
+        for (int site = 100; site < 150; site++) {
+            if (sink.frames[site] != quiet_frames) quiet_done = false;
+        }
+    }
+    gw_uplink_server_poll(central, 50, uplink_counting_sink, &sink);
+    gw_uplink_stats_t stats;
+    gw_uplink_get_stats(uplink, &stats);
+    printf("  %llu frames in %llu writes over one connection, %u channels\n",
+           (unsigned long long)stats.frames_sent, (unsigned long long)stats.writes, stats.channels);
+    CHECK(quiet_done, "Quiet channels are delivered while a noisy one is stuck");
+    CHECK(sink.bytes[7] <= config.window && sink.frames[7] < noisy_frames,
+          "Stuck channel stops at its credit window");
+    CHECK(stats.channels == 51 && stats.channels_blocked == 1 && stats.connects == 1,
+          "One connection carries every channel; only the stuck one is blocked");
+    CHECK(stats.writes * 10 < stats.frames_sent, "Small frames are coalesced into large writes");
+
+    // Consumer recovers: the owed credit releases the backlog
+    gw_uplink_server_pause(central, 7, false);
+    for (int wait = 0; wait < 300 && sink.frames[7] < noisy_frames; wait++) {
+        gw_uplink_server_poll(central, 10, uplink_counting_sink, &sink);
+    }
+    gw_uplink_get_stats(uplink, &stats);
+    CHECK(sink.frames[7] == noisy_frames && stats.frames_dropped == 0, "Backlog drains once credit returns");
+    CHECK(sink.out_of_order == 0, "Every channel stays in order");
+
+    gw_uplink_destroy(uplink);
+    gw_uplink_server_close(central);
+}
+
+// Fake controller that records the rate commands it is sent
+typedef struct {
+    int fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    uint8_t period_units[PACKET_TYPE_SYSTEM_STATUS + 1];   // Indexed by packet type
+    uint32_t commands;
+    volatile bool stop;
+} rate_device_t;
+
+static void rate_device_on_frame(const stm32_frame_t* frame, void* user_data) {
+    rate_device_t* dev = user_data;
+    stm32_command_t command;
+    if (!stm32_decode_command(frame, &command) || command.command_id != STM32_CMD_SET_RATE) return;
+
+    pthread_mutex_lock(&dev->lock);
+    for (uint8_t type = 1; type <= PACKET_TYPE_SYSTEM_STATUS; type++) {
+        if (command.target_id == 0 || command.target_id == type) dev->period_units[type] = command.parameter;
+    }
+    dev->commands++;
+    pthread_mutex_unlock(&dev->lock);
+}
+
+static void* rate_device_main(void* arg) {
+    rate_device_t* dev = arg;
+    stm32_decoder_t decoder;
+    stm32_decoder_init(&decoder);
+    struct timeval tv = {0, 50000};
+    setsockopt(dev->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    uint8_t buf[256];
+    while (!dev->stop) {
+        ssize_t n = recv(dev->fd, buf, sizeof(buf), 0);
+        if (n == 0) break;
+        if (n > 0) stm32_decoder_feed(&decoder, buf, (size_t)n, rate_device_on_frame, dev);
+    }
+    return NULL;
+}
+
+static bool wait_rate(rate_device_t* dev, uint8_t type, uint8_t units) {
+    for (int wait = 0; wait < 100; wait++) {
+        pthread_mutex_lock(&dev->lock);
+        bool done = dev->period_units[type] == units;
+        pthread_mutex_unlock(&dev->lock);
+        if (done) return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+static void send_alarm(int fd, uint32_t alarm_id, bool active) {
+    uint8_t data[STM32_MAX_FRAME_DATA], wire[STM32_MAX_PACKET_SIZE];
+    alarm_t a;
+    memset(&a, 0, sizeof(a));
+    a.alarm_id = alarm_id;
+    a.severity = 2;
+    a.is_active = active;
+    size_t n = stm32_encode_frame(PACKET_TYPE_ALARM, data, stm32_encode_alarm(&a, data), wire);
+    if (send(fd, wire, n, MSG_NOSIGNAL) != (ssize_t)n) {
+        printf("  (alarm frame not sent)\n");
+    }
+}
+
+static void test_demand_rates(void) {
+    printf("\n=== Testing Demand-Driven Rates ===\n");
+
+    uint16_t port;
+    int listen_fd = open_listener(&port);
+    gw_config_t config;
+    gateway_default_config(&config);
+    config.thread_count = 1;
+    config.fast_period_ms = 100;
+    config.background_period_ms = 5000;
+    gateway_t* gw = gateway_create(&config);
+    gw_device_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.device_id = 1;
+    cfg.link_type = GW_LINK_TCP;
+    snprintf(cfg.address, sizeof(cfg.address), "127.0.0.1");
+    cfg.port = port;
+    gateway_add_device(gw, &cfg);
+    gateway_start(gw);
+
+    static rate_device_t dev;
+    memset(&dev, 0, sizeof(dev));
+    pthread_mutex_init(&dev.lock, NULL);
+    dev.fd = accept(listen_fd, NULL, NULL);
+    pthread_create(&dev.thread, NULL, rate_device_main, &dev);
+
+    CHECK(wait_rate(&dev, PACKET_TYPE_POWER_MODULE, 50) && wait_rate(&dev, PACKET_TYPE_SYSTEM_STATUS, 50) &&
+          dev.commands == 1, "Unwatched device gets one background-rate command for every category");
+
+    gateway_watch(gw, 1, PACKET_TYPE_BATTERY, true);
+    gateway_watch(gw, 1, PACKET_TYPE_BATTERY, true);
+    CHECK(wait_rate(&dev, PACKET_TYPE_BATTERY, 1) && dev.period_units[PACKET_TYPE_POWER_MODULE] == 50,
+          "Watched category goes fast, the rest stay in the background");
+    CHECK(gateway_get_rate(gw, 1, PACKET_TYPE_BATTERY) == 100 &&
+          gateway_get_rate(gw, 1, PACKET_TYPE_AC_INPUT) == 5000, "Applied rates are reported");
+
+    gateway_watch(gw, 1, PACKET_TYPE_BATTERY, false);
+    usleep(50000);
+    CHECK(dev.period_units[PACKET_TYPE_BATTERY] == 1, "Watches are counted; one viewer left keeps it fast");
+
+    send_alarm(dev.fd, 77, true);
+    CHECK(wait_rate(&dev, PACKET_TYPE_POWER_MODULE, 1) && wait_rate(&dev, PACKET_TYPE_DC_OUTPUT, 1),
+          "Active alarm puts every category of the site on the fast rate");
+
+    gateway_watch(gw, 1, PACKET_TYPE_BATTERY, false);
+    send_alarm(dev.fd, 77, false);
+    CHECK(wait_rate(&dev, PACKET_TYPE_BATTERY, 50) && wait_rate(&dev, PACKET_TYPE_POWER_MODULE, 50),
+          "Cleared alarm and no viewers return the site to the background rate");
+
+    gw_stats_t stats;
+    gateway_get_stats(gw, &stats);
+    CHECK(stats.rate_commands == dev.commands, "Every rate change is one command on the link");
+    CHECK(gateway_watch(gw, 99, 0, true) == HW_STATUS_INVALID_PARAM &&
+          gateway_watch(gw, 1, PACKET_TYPE_ALARM, true) == HW_STATUS_INVALID_PARAM,
+          "Unknown devices and alarm category are refused");
+
+    dev.stop = true;
+    gateway_destroy(gw);
+    pthread_join(dev.thread, NULL);
+    close(dev.fd);
+    close(listen_fd);
+    pthread_mutex_destroy(&dev.lock);
+}
+
+// Controller that applies threshold sets the way the firmware does: SETs
+// build a draft, COMMIT switches to it, RESUME drops an uncommitted draft
+typedef struct {
+    int listen_fd;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    uint32_t staged;
+    uint32_t committed_version;
+    uint32_t committed_count;     // SETs that preceded the last commit
+    uint32_t temp_high;           // ALARM_TEMP_HIGH in the committed set
+    uint32_t draft_temp_high;
+    uint32_t commits;
+    uint32_t links;
+    volatile bool drop;
+    volatile bool stop;
+} threshold_device_t;
+
+static void threshold_device_on_frame(const stm32_frame_t* frame, void* user_data) {
+    threshold_device_t* dev = user_data;
+    stm32_resume_t resume;
+    stm32_command_t commands[STM32_MAX_BATCH_COMMANDS];
+
+    pthread_mutex_lock(&dev->lock);
+    if (stm32_decode_resume(frame, &resume)) {
+        dev->staged = 0;
+    } else if (frame->type == PACKET_TYPE_COMMAND_BATCH) {
+        uint8_t count = stm32_decode_command_batch(frame, commands, STM32_MAX_BATCH_COMMANDS);
+        for (uint8_t i = 0; i < count; i++) {
+            if (commands[i].command_id != STM32_CMD_THRESHOLD) continue;
+            if (commands[i].action == STM32_CMD_ACTION_SET) {
+                if (dev->staged++ == 0) dev->draft_temp_high = 0;
+                if (commands[i].target_id == STM32_THRESHOLD_ALARM_TEMP_HIGH) {
+                    dev->draft_temp_high = commands[i].reserved;
+                }
+            } else if (commands[i].action == STM32_CMD_ACTION_COMMIT) {
+                dev->committed_version = commands[i].reserved;
+                dev->committed_count = dev->staged;
+                dev->temp_high = dev->staged ? dev->draft_temp_high : 0;
+                dev->staged = 0;
+                dev->commits++;
+            }
+        }
+    }
+    pthread_mutex_unlock(&dev->lock);
+}
+
+static void* threshold_device_main(void* arg) {
+    threshold_device_t* dev = arg;
+    stm32_decoder_t decoder;
+    stm32_decoder_init(&decoder);
+
+    while (!dev->stop) {
+        int fd = accept(dev->listen_fd, NULL, NULL);
+        if (fd < 0) break;
+        pthread_mutex_lock(&dev->lock);
+        dev->links++;
+        pthread_mutex_unlock(&dev->lock);
+        stm32_decoder_reset(&decoder);
+        struct timeval tv = {0, 2000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+        // Keeps streaming while sets arrive, so ingest can be seen running
+        uint8_t buf[1024], wire[STM32_MAX_PACKET_SIZE];
+        size_t len = put_battery(wire, 1);
+        while (!dev->stop && !dev->drop) {
+            ssize_t n = recv(fd, buf, sizeof(buf), 0);
+            if (n == 0) break;
+            if (n > 0) stm32_decoder_feed(&decoder, buf, (size_t)n, threshold_device_on_frame, dev);
+            if (send(fd, wire, len, MSG_NOSIGNAL) < 0) break;
+        }
+        dev->drop = false;
+        close(fd);
+    }
+    return NULL;
+}
+
+static bool wait_committed(threshold_device_t* dev, uint32_t version, uint32_t commits) {
+    for (int wait = 0; wait < 200; wait++) {
+        pthread_mutex_lock(&dev->lock);
+        bool done = dev->committed_version == version && dev->commits >= commits;
+        pthread_mutex_unlock(&dev->lock);
+        if (done) return true;
+        usleep(5000);
+    }
+    return false;
+}
+
+static void test_threshold_reload(void) {
+    printf("\n=== Testing Threshold Hot Reload ===\n");
+
+    static threshold_device_t dev;
+    memset(&dev, 0, sizeof(dev));
+    pthread_mutex_init(&dev.lock, NULL);
+    uint16_t port;
+    dev.listen_fd = open_listener(&port);
+
+    pthread_create(&dev.thread, NULL, threshold_device_main, &dev);
+
+    gw_config_t config;
+    gateway_default_config(&config);
+    config.thread_count = 1;
+    config.background_period_ms = 0;
+    gateway_t* gw = gateway_create(&config);
+    gw_device_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.device_id = 1;
+    cfg.link_type = GW_LINK_TCP;
+    snprintf(cfg.address, sizeof(cfg.address), "127.0.0.1");
+    cfg.port = port;
+    gateway_add_device(gw, &cfg);
+
+    // Ten entries need two batch frames; the commit must still come last
+    gw_threshold_t items[10];
+    for (uint8_t i = 0; i < 10; i++) {
+        items[i].key = STM32_THRESHOLD_MODULE_CURRENT_MAX;
+        items[i].index = (uint8_t)(i % 4 + 1);
+        items[i].value = 20000u + i;
+    }
+    items[9].key = STM32_THRESHOLD_ALARM_TEMP_HIGH;
+    items[9].index = 0;
+    items[9].value = 58;
+    CHECK(gateway_set_thresholds(gw, items, 10) == 1, "A set published before start is version 1");
+    gateway_start(gw);
+
+    CHECK(wait_committed(&dev, 1, 1) && dev.committed_count == 10 && dev.temp_high == 58,
+          "Connecting device gets the whole set, committed after its last entry");
+    CHECK(gateway_get_thresholds_version(gw, 1) == 1, "Version sent on the link is reported");
+
+    // Twenty reloads while the device streams; ingest must not stall
+    gw_stats_t before, after;
+    gateway_get_stats(gw, &before);
+    uint32_t version = 0;
+    for (uint32_t r = 0; r < 20; r++) {
+        gw_threshold_t set[3] = {
+            {STM32_THRESHOLD_ALARM_TEMP_HIGH, 0, 50 + r},
+            {STM32_THRESHOLD_ALARM_VOLTAGE_LOW, 0, 44000},
+            {STM32_THRESHOLD_ALARM_VOLTAGE_HIGH, 0, 56000},
+        };
+        version = gateway_set_thresholds(gw, set, 3);
+        usleep(5000);
+    }
+    CHECK(version == 21 && wait_committed(&dev, 21, 2) && dev.committed_count == 3 && dev.temp_high == 69,
+          "Device ends on the newest set");
+    gateway_get_stats(gw, &after);
+    CHECK(after.frames_in > before.frames_in + 10, "Frames kept flowing during the reloads");
+    printf("  %u pushes for 20 reloads, %llu frames ingested meanwhile\n", dev.commits,
+           (unsigned long long)(after.frames_in - before.frames_in));
+
+    // A new link starts from the device's point of view with no set sent
+    uint32_t commits = dev.commits;
+    dev.drop = true;
+    CHECK(wait_committed(&dev, 21, commits + 1) && dev.links == 2,
+          "Set is sent again after a reconnect");
+
+    char path[] = "/tmp/netmon_thresholds_XXXXXX";
+    int fd = mkstemp(path);
+    const char* good = "# fleet limits\nalarm_temp_high_c 55\nmodule_voltage_max_mv 2 57000\nsafety_power_max_mw 3000000\n";
+    CHECK(fd >= 0 && write(fd, good, strlen(good)) == (ssize_t)strlen(good), "Threshold file written");
+    close(fd);
+    CHECK(gateway_load_thresholds(gw, path) == HW_STATUS_OK &&
+          wait_committed(&dev, 22, commits + 2) && dev.committed_count == 3 && dev.temp_high == 55,
+          "Threshold file is loaded and pushed as one set");
+
+    FILE* f = fopen(path, "w");
+    fputs("alarm_temp_high_c 40\nalarm_temp_high_c 1 40\n", f);
+    fclose(f);
+    hw_status_t status = gateway_load_thresholds(gw, path);
+    gateway_get_stats(gw, &after);
+    CHECK(status == HW_STATUS_INVALID_PARAM && after.thresholds_version == 22,
+          "A malformed file leaves the current set in force");
+
+    // Entries the device would refuse: too wide, no such module, min >= max
+    const char* refused[] = {
+        "safety_temp_max_c 300\n",
+        "module_current_max_ma 9 1000\n",
+        "safety_voltage_min_mv 61000\n",
+    };
+    bool all_refused = true;
+    for (size_t i = 0; i < sizeof(refused) / sizeof(refused[0]); i++) {
+        f = fopen(path, "w");
+        fputs(refused[i], f);
+        fclose(f);
+        all_refused &= gateway_load_thresholds(gw, path) == HW_STATUS_INVALID_PARAM;
+    }
+    gateway_get_stats(gw, &after);
+    CHECK(all_refused && after.thresholds_version == 22, "Files the device would refuse are refused");
+    unlink(path);
+
+    gw_threshold_t bad = {99, 0, 1};
+    CHECK(gateway_set_thresholds(gw, &bad, 1) == 0, "Unknown keys are refused");
+    gw_threshold_t inverted[2] = {
+        {STM32_THRESHOLD_MODULE_VOLTAGE_MIN, 3, 54000},
+        {STM32_THRESHOLD_MODULE_VOLTAGE_MAX, 3, 53000},
+    };
+    gw_threshold_t wide = {STM32_THRESHOLD_MODULE_VOLTAGE_MAX, 0, 70000};
+    CHECK(gateway_set_thresholds(gw, inverted, 2) == 0 && gateway_set_thresholds(gw, &wide, 1) == 0,
+          "Sets with a minimum above its maximum or a value too wide are refused");
+
+    usleep(20000);
+    gateway_get_stats(gw, &after);
+    CHECK(after.threshold_pushes == dev.commits, "Every push is one commit on the link");
+
+    dev.stop = true;
+    gateway_destroy(gw);
+    shutdown(dev.listen_fd, SHUT_RDWR);
+    pthread_join(dev.thread, NULL);
+    close(dev.listen_fd);
+    pthread_mutex_destroy(&dev.lock);
+}
+
+// A serial line the device stopped draining fills up; sets published
+// meanwhile meet a full buffer, and the newest must arrive once it drains
+static void test_threshold_full_link(void) {
+    printf("\n=== Testing Threshold Push on a Full Link ===\n");
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        CHECK(0, "Open a pseudo-terminal as the serial line");
+        return;
+    }
+    gw_config_t config;
+    gateway_default_config(&config);
+    config.thread_count = 1;
+    config.background_period_ms = 0;
+    config.reconnect_initial_ms = 50;
+    gateway_t* gw = gateway_create(&config);
+    gw_device_config_t cfg;
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.device_id = 1;
+    cfg.link_type = GW_LINK_SERIAL;
+    snprintf(cfg.address, sizeof(cfg.address), "%s", ptsname(master));
+    cfg.baud_rate = 115200;
+    gateway_add_device(gw, &cfg);
+    gateway_start(gw);
+
+    gw_threshold_t items[GW_MAX_THRESHOLDS];
+    for (uint32_t i = 0; i < GW_MAX_THRESHOLDS; i++) {
+        items[i].key = STM32_THRESHOLD_MODULE_CURRENT_MAX;
+        items[i].index = (uint8_t)(i % 4 + 1);
+        items[i].value = 30000u + i;
+    }
+    items[GW_MAX_THRESHOLDS - 1].key = STM32_THRESHOLD_ALARM_TEMP_HIGH;
+    items[GW_MAX_THRESHOLDS - 1].index = 0;
+
+    // Publish until one is not sent: the line's buffer is full
+    uint32_t version = 0;
+    bool full = false;
+    for (uint32_t r = 0; r < 2000 && !full; r++) {
+        items[GW_MAX_THRESHOLDS - 1].value = r;
+        version = gateway_set_thresholds(gw, items, GW_MAX_THRESHOLDS);
+        full = true;
+        for (int wait = 0; wait < 20 && full; wait++) {
+            usleep(1000);
+            full = gateway_get_thresholds_version(gw, 1) != version;
+        }
+    }
+    CHECK(full, "Sets back up while the device does not read");
+    // A write cut short drops the link. The reopened line is still full, so
+    // reconnects keep failing until the device reads; the RESUME must then
+    // clear the cut-off draft, or stale entries would commit with the set
+    usleep(200000);
+
+    static threshold_device_t dev;
+    memset(&dev, 0, sizeof(dev));
+    pthread_mutex_init(&dev.lock, NULL);
+    stm32_decoder_t decoder;
+    stm32_decoder_init(&decoder);
+    fcntl(master, F_SETFL, O_NONBLOCK);
+    uint8_t buf[4096];
+    for (int wait = 0; wait < 3000 && dev.committed_version != version; wait++) {
+        ssize_t n;
+        while ((n = read(master, buf, sizeof(buf))) > 0) {
+            stm32_decoder_feed(&decoder, buf, (size_t)n, threshold_device_on_frame, &dev);
+        }
+        usleep(1000);
+    }
+    CHECK(dev.committed_version == version && dev.committed_count == GW_MAX_THRESHOLDS,
+          "The newest set arrives once the line drains");
+
+    gateway_destroy(gw);
+    close(master);
+    pthread_mutex_destroy(&dev.lock);
+}
+
+// Controller streaming rounds until told to stop
+static atomic_bool streaming;
+
+static void* streaming_device_main(void* arg) {
+    fake_device_t* dev = arg;
+    int fd = accept(dev->listen_fd, NULL, NULL);
+    if (fd < 0) return NULL;
+
+    uint8_t round[FRAMES_PER_ROUND * STM32_MAX_PACKET_SIZE];
+    size_t len = build_round(dev->device_id, round);
+    while (atomic_load(&streaming)) {
+        if (send(fd, round, len, MSG_NOSIGNAL) < 0) break;
+        usleep(2000);
+    }
+    close(fd);
+    return NULL;
+}
+
+// Reads and discards until the socket closes
+static void* drain_main(void* arg) {
+    int fd = (int)(intptr_t)arg;
+    static _Thread_local uint8_t buffer[65536];
+    while (recv(fd, buffer, sizeof(buffer), 0) != 0) {
+        if (!atomic_load(&streaming)) break;
+    }
+    return NULL;
+}
+
+// Once warm, ingest, the TCP stream and WebSocket output (JSON, binary
+// and deflate) must run without one heap allocation
+static void test_steady_state_allocations(void) {
+    printf("\n=== Testing Steady-State Allocations ===\n");
+
+    enum { DEVICES = 4, DRAINS = 4 };
+    fake_device_t devices[DEVICES];
+    gw_config_t config;
+    gateway_default_config(&config);
+    config.thread_count = 2;
+    gateway_t* gw = gateway_create(&config);
+    atomic_store(&streaming, true);
+    for (int i = 0; i < DEVICES; i++) {
+        devices[i].device_id = (uint16_t)(i + 1);
+        devices[i].listen_fd = open_listener(&devices[i].port);
+        pthread_create(&devices[i].thread, NULL, streaming_device_main, &devices[i]);
+
+        gw_device_config_t dev;
+        memset(&dev, 0, sizeof(dev));
+        dev.device_id = devices[i].device_id;
+        dev.link_type = GW_LINK_TCP;
+        strcpy(dev.address, "127.0.0.1");
+        dev.port = devices[i].port;
+        gateway_add_device(gw, &dev);
+    }
+
+    gw_stream_server_t* stream = gw_stream_create(0);
+    gw_stream_start(stream);
+    gateway_add_sink(gw, gw_stream_sink, stream);
+    gw_http_server_t* http = gw_http_create(gw, 0);
+    gw_http_start(http);
+    gateway_add_sink(gw, gw_http_sink, http);
+
+    int fds[DRAINS];
+    pthread_t drains[DRAINS];
+    fds[0] = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(gw_stream_port(stream));
+    connect(fds[0], (struct sockaddr*)&addr, sizeof(addr));
+    const char* upgrades[] = {"/ws", "/ws?format=binary", "/ws"};
+    for (int i = 1; i < DRAINS; i++) {
+        char request[512], head[1024];
+        snprintf(request, sizeof(request),
+                 "GET %s HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                 "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n%s\r\n",
+                 upgrades[i - 1], i == DRAINS - 1 ? "Sec-WebSocket-Extensions: permessage-deflate\r\n" : "");
+        fds[i] = http_connect(gw_http_port(http), request);
+        read_head(fds[i], head, sizeof(head));
+    }
+    for (int i = 0; i < DRAINS; i++) {
+        struct timeval tv = {0, 100000};
+        setsockopt(fds[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        pthread_create(&drains[i], NULL, drain_main, (void*)(intptr_t)fds[i]);
+    }
+
+    // Warm-up: links up, buffers grown, pools and stats blocks claimed
+    gateway_start(gw);
+    usleep(500000);
+
+    gw_stats_t before, after;
+    gw_http_stats_t http_before, http_after;
+    gateway_get_stats(gw, &before);
+    gw_http_get_stats(http, &http_before);
+    alloc_guard_arm(false);
+    usleep(500000);
+    uint64_t allocations = alloc_guard_disarm();
+    gateway_get_stats(gw, &after);
+    gw_http_get_stats(http, &http_after);
+
+    uint64_t frames = after.frames_in - before.frames_in;
+    printf("  %llu frames, %llu WebSocket messages, %llu heap allocations\n", (unsigned long long)frames,
+           (unsigned long long)(http_after.messages_sent - http_before.messages_sent),
+           (unsigned long long)allocations);
+    CHECK(frames > 1000 && http_after.messages_sent > http_before.messages_sent,
+          "Frames flow to the stream and WebSocket clients");
+    CHECK(allocations == 0, "No heap allocation after warm-up");
+
+    atomic_store(&streaming, false);
+    for (int i = 0; i < DEVICES; i++) {
+        pthread_join(devices[i].thread, NULL);
+        close(devices[i].listen_fd);
+    }
+    for (int i = 0; i < DRAINS; i++) {
+        pthread_join(drains[i], NULL);
+        close(fds[i]);
+    }
+    gateway_destroy(gw);
+    gw_http_destroy(http);
+    gw_stream_destroy(stream);
+}
+
+// Controller that answers only after a handshake delay, recording how
+// many links were waiting at once and in which order it was reached
+#define STARTUP_DEVICES 12
+
+typedef struct {
+    int listen_fd;
+    uint16_t port;
+    uint16_t device_id;
+    bool alarm;
+    int order;
+    pthread_t thread;
+} startup_device_t;
+
+static atomic_int startup_waiting;
+static atomic_int startup_max_waiting;
+static atomic_int startup_accepts;
+
+static void* startup_device_main(void* arg) {
+    startup_device_t* dev = arg;
+    int fd = accept(dev->listen_fd, NULL, NULL);
+    if (fd < 0) return NULL;
+    dev->order = atomic_fetch_add(&startup_accepts, 1);
+    int waiting = atomic_fetch_add(&startup_waiting, 1) + 1;
+    int max = atomic_load(&startup_max_waiting);
+    while (waiting > max && !atomic_compare_exchange_weak(&startup_max_waiting, &max, waiting)) {
+    }
+    usleep(20000);
+
+    atomic_fetch_sub(&startup_waiting, 1);
+    uint8_t round[FRAMES_PER_ROUND * STM32_MAX_PACKET_SIZE];
+    size_t len = build_round(dev->device_id, round);
+    send(fd, round, len, MSG_NOSIGNAL);
+    if (dev->alarm) send_alarm(fd, 500 + dev->device_id, true);
+    while (!devices_stop) usleep(10000);
+    close(fd);
+    return NULL;
+}
+
+static gateway_t* startup_gateway(startup_device_t* devices, uint32_t parallelism, uint32_t threads) {
+    atomic_store(&startup_waiting, 0);
+    atomic_store(&startup_max_waiting, 0);
+    atomic_store(&startup_accepts, 0);
+    devices_stop = 0;
+
+    gw_config_t config;
+    gateway_default_config(&config);
+    config.thread_count = threads;
+    config.connect_parallelism = parallelism;
+    config.background_period_ms = 0;
+    gateway_t* gw = gateway_create(&config);
+    for (int i = 0; i < STARTUP_DEVICES; i++) {
+        startup_device_t* dev = &devices[i];
+        dev->device_id = (uint16_t)(i + 1);
+        dev->order = -1;
+        dev->listen_fd = open_listener(&dev->port);
+        pthread_create(&dev->thread, NULL, startup_device_main, dev);
+
+        gw_device_config_t cfg;
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.device_id = dev->device_id;
+        cfg.link_type = GW_LINK_TCP;
+        snprintf(cfg.address, sizeof(cfg.address), "127.0.0.1");
+        cfg.port = dev->port;
+        gateway_add_device(gw, &cfg);
+    }
+    return gw;
+}
+
+static bool wait_all_live(gateway_t* gw, gw_stats_t* stats) {
+    for (int wait = 0; wait < 300; wait++) {
+        gateway_get_stats(gw, stats);
+        if (stats->startup_ms) return true;
+        usleep(10000);
+    }
+    return false;
+}
+
+static void stop_startup_devices(startup_device_t* devices) {
+    devices_stop = 1;
+    for (int i = 0; i < STARTUP_DEVICES; i++) {
+        pthread_join(devices[i].thread, NULL);
+        close(devices[i].listen_fd);
+    }
+    devices_stop = 0;
+}
+
+static void test_warm_start(void) {
+    printf("\n=== Testing Paced Startup and Warm Start ===\n");
+
+    const char* path = "/tmp/netmon_test_snapshot.bin";
+    unlink(path);
+    startup_device_t devices[STARTUP_DEVICES];
+    memset(devices, 0, sizeof(devices));
+    // The last three sites raise an alarm once connected
+    for (int i = STARTUP_DEVICES - 3; i < STARTUP_DEVICES; i++) devices[i].alarm = true;
+
+    // Cold start: no snapshot yet, so nothing is restored
+    gateway_t* gw = startup_gateway(devices, 3, 2);
+    CHECK(gateway_load_snapshot(gw, path) == HW_STATUS_OK, "Missing snapshot is a normal cold start");
+    gateway_start(gw);
+    gw_stats_t stats;
+    CHECK(wait_all_live(gw, &stats) && stats.devices_connected == STARTUP_DEVICES,
+          "Every device live after a paced cold start");
+    printf("  Cold start: %llu ms, at most %d handshakes at once\n",
+           (unsigned long long)stats.startup_ms, atomic_load(&startup_max_waiting));
+    CHECK(atomic_load(&startup_max_waiting) <= 3, "No more handshakes in flight than the parallelism limit");
+    // Saved once every alarming site has reported its alarm
+    for (int wait = 0; wait < 100; wait++) {
+        gw_device_state_t* site = malloc(sizeof(gw_device_state_t));
+        bool done = true;
+        for (uint16_t id = STARTUP_DEVICES - 2; id <= STARTUP_DEVICES; id++) {
+            done &= gateway_get_device_state(gw, id, site) == HW_STATUS_OK && site->alarm_count == 1;
+        }
+        free(site);
+        if (done) break;
+        usleep(10000);
+    }
+    CHECK(gateway_save_snapshot(gw, path) == HW_STATUS_OK, "Snapshot saved while running");
+    gateway_destroy(gw);
+    stop_startup_devices(devices);
+
+    // Warm start: state is served before any device answers, alarming sites connect first
+    gw = startup_gateway(devices, 2, 1);
+    CHECK(gateway_load_snapshot(gw, path) == HW_STATUS_OK, "Snapshot loaded before start");
+    gateway_start(gw);
+    gw_device_state_t* state = malloc(sizeof(gw_device_state_t));
+    gateway_get_device_state(gw, 5, state);
+    gateway_get_stats(gw, &stats);
+    CHECK(state->restored && state->battery_count == 4 && state->dc_circuit_count == 6 &&
+          state->frames_received == FRAMES_PER_ROUND,
+          "Queries answer from the snapshot immediately after start");
+    CHECK(stats.devices_restored == STARTUP_DEVICES, "Every configured device restored");
+
+    CHECK(wait_all_live(gw, &stats) && stats.devices_restored == 0, "Live frames replace restored state");
+    int first_alarming = 1;
+    for (int i = STARTUP_DEVICES - 3; i < STARTUP_DEVICES; i++) {
+        if (devices[i].order < 0 || devices[i].order >= 3) first_alarming = 0;
+    }
+    CHECK(first_alarming, "Sites restored with active alarms are connected first");
+    gateway_get_device_state(gw, 5, state);
+    CHECK(!state->restored && state->frames_received == FRAMES_PER_ROUND * 2, "Restored device now live");
+    free(state);
+    gateway_destroy(gw);
+    stop_startup_devices(devices);
+
+    FILE* f = fopen(path, "wb");
+    fputs("not a snapshot", f);
+    fclose(f);
+    gw = gateway_create(NULL);
+    CHECK(gateway_load_snapshot(gw, path) == HW_STATUS_ERROR, "Foreign files are refused");
+    gateway_destroy(gw);
+    unlink(path);
+}
+
+int main() {
+    printf("NetMon Gateway Test Program\n");
+    printf("===========================\n");
+
+    test_decoder_resync();
+    test_spool();
+    test_backoff();
+    test_conflate();
+    test_pool();
+    test_link_recovery();
+    test_start_failure();
+    test_multi_device_gateway();
+    test_http_endpoint();
+    test_stream_replay_skip();
+    test_multicast();
+    test_slow_consumer();
+    test_demand_rates();
+    test_threshold_reload();
+    test_threshold_full_link();
+    test_uplink();
+    test_warm_start();
+    test_steady_state_allocations();
+
+    printf("\n=== Test Summary ===\n");
+    printf("%s\n", failures ? "Some tests FAILED" : "All tests passed!");
+    return failures ? 1 : 0;
+}
@@ -1,7 +1,1282 @@
+#define _DEFAULT_SOURCE
 #include "hardware_interface.h"
+#include "hw_stats.h"
+#include "stm32_decoder.h"
+#include "gorilla.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <math.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define HANDLE_THREADS      4
+#define HANDLE_ITERATIONS   20000
+
+typedef struct {
+    hw_device_t* device;
+    int torn;
+    int failed;
+} handle_worker_t;
+
+// Readers check every module copy is internally consistent while the last
+// thread keeps toggling module 4; a torn copy shows up as power that does
+// not match voltage * current.
+static void* handle_worker(void* arg) {
+    handle_worker_t* w = arg;
+    for (int i = 0; i < HANDLE_ITERATIONS; i++) {
+        power_module_t modules[4];
+        uint8_t count = 4;
+        if (hw_dev_get_power_modules(w->device, modules, &count) != HW_STATUS_OK || count != 4) {
+            w->failed++;
+            continue;
+        }
+        for (int m = 0; m < 4; m++) {
+            float expected = modules[m].voltage * modules[m].current / 1000.0f;
+            if (fabsf(modules[m].power - expected) > 0.001f) w->torn++;
+        }
+        hw_dev_set_power_module_state(w->device, 4, (i & 1) != 0);
+    }
+    return NULL;
+}
+
+static int test_device_handles(void) {
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 1234;
+
+    hw_device_t* a = hw_open(&config);
+    hw_device_t* b = hw_open(&config);
+    if (!a || !b) {
+        printf("Failed to open device handles\n");
+        return 1;
+    }
+
+    // Same seed, same simulated site; state changes stay on their handle
+    power_module_t ma[4], mb[4];
+    uint8_t ca = 4, cb = 4;
+    hw_dev_get_power_modules(a, ma, &ca);
+    hw_dev_get_power_modules(b, mb, &cb);
+    if (memcmp(ma, mb, sizeof(ma)) != 0) {
+        printf("Handles with the same seed diverged\n");
+        return 1;
+    }
+
+    hw_dev_set_operation_mode(a, 2);
+    hw_dev_set_dc_circuit_state(a, 1, false);
+    system_status_t sa, sb;
+    dc_circuit_t cir[6];
+    uint8_t circuit_count = 6;
+    hw_dev_get_system_status(a, &sa);
+    hw_dev_get_system_status(b, &sb);
+    hw_dev_get_dc_outputs(b, cir, &circuit_count);
+    if (sa.operation_mode != 2 || sb.operation_mode != 0 || !cir[0].is_enabled) {
+        printf("State leaked between handles\n");
+        return 1;
+    }
+    printf("Two handles are independent.\n");
+
+    // Many threads on one handle
+    pthread_t threads[HANDLE_THREADS];
+    handle_worker_t workers[HANDLE_THREADS];
+    for (int i = 0; i < HANDLE_THREADS; i++) {
+        workers[i].device = a;
+        workers[i].torn = 0;
+        workers[i].failed = 0;
+        pthread_create(&threads[i], NULL, handle_worker, &workers[i]);
+    }
+    int torn = 0, failed = 0;
+    for (int i = 0; i < HANDLE_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        torn += workers[i].torn;
+        failed += workers[i].failed;
+    }
+    printf("%d threads x %d reads: %d torn, %d failed\n", HANDLE_THREADS, HANDLE_ITERATIONS, torn, failed);
+
+    hw_close(a);
+    hw_close(b);
+
+    // The default-device shim refuses calls outside hw_init()/hw_cleanup()
+    power_module_t modules[4];
+    uint8_t count = 4;
+    if (hw_get_power_modules(modules, &count) != HW_STATUS_INVALID_PARAM) {
+        printf("Shim accepted a call after cleanup\n");
+        return 1;
+    }
+    return (torn || failed) ? 1 : 0;
+}
+
+static int test_snapshot(void) {
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 99;
+    config.update_ms = 60000;       // No simulated drift during the test
+
+    hw_device_t* dev = hw_open(&config);
+    if (!dev) return 1;
+
+    hw_snapshot_t snap;
+    memset(&snap, 0, sizeof(snap));
+    if (hw_dev_get_snapshot(dev, &snap) != HW_STATUS_OK || snap.version == 0 ||
+        snap.power_module_count != config.power_modules || snap.dc_circuit_count != config.dc_circuits) {
+        printf("First snapshot not filled in\n");
+        return 1;
+    }
+
+    // Unchanged device: nothing copied
+    uint64_t version = snap.version;
+    snap.status.operation_mode = 0xEE;
+    if (hw_dev_get_snapshot(dev, &snap) != HW_STATUS_NOT_MODIFIED || snap.status.operation_mode != 0xEE) {
+        printf("Unchanged snapshot was copied\n");
+        return 1;
+    }
+
+    // A change bumps the version and the next call copies everything again
+    hw_dev_set_power_module_state(dev, 2, false);
+    if (hw_dev_get_snapshot(dev, &snap) != HW_STATUS_OK || snap.version <= version ||
+        snap.power_modules[1].is_active || snap.status.operation_mode != 0) {
+        printf("Changed snapshot not refreshed\n");
+        return 1;
+    }
+
+    // Category getters agree with the snapshot they just changed
+    power_module_t modules[4];
+    uint8_t count = 4;
+    hw_dev_get_power_modules(dev, modules, &count);
+    hw_dev_get_snapshot(dev, &snap);
+    if (memcmp(modules, snap.power_modules, sizeof(modules)) != 0) {
+        printf("Snapshot disagrees with hw_dev_get_power_modules\n");
+        return 1;
+    }
+    printf("Snapshot version %llu, timestamp %u\n", (unsigned long long)snap.version, snap.timestamp);
+
+    hw_close(dev);
+    return 0;
+}
+
+typedef struct {
+    hw_device_t* device;
+    atomic_bool* stop;
+    long ops;
+    int torn;
+} reader_t;
+
+// set_target_voltage() moves every active module at once; a torn read shows
+// active modules at different voltages
+static void* reader_fn(void* arg) {
+    reader_t* r = arg;
+    hw_snapshot_t snap;
+    while (!atomic_load(r->stop)) {
+        snap.version = 0;
+        hw_dev_get_snapshot(r->device, &snap);
+        for (int m = 0; m < 4; m++) {
+            const power_module_t* pm = &snap.power_modules[m];
+            if (!pm->is_active) continue;
+            if (pm->voltage != snap.power_modules[0].voltage ||
+                fabsf(pm->power - pm->voltage * pm->current / 1000.0f) > 0.001f) r->torn++;
+        }
+        r->ops++;
+    }
+    return NULL;
+}
+
+static void* voltage_writer_fn(void* arg) {
+    reader_t* w = arg;
+    for (long i = 0; !atomic_load(w->stop); i++) {
+        hw_dev_set_target_voltage(w->device, (i & 1) ? 50.0f : 56.0f);
+        w->ops++;
+    }
+    return NULL;
+}
+
+static int run_readers(hw_device_t* dev, int threads, long* reads_out) {
+    atomic_bool stop = false;
+    pthread_t writer_thread, reader_threads[8];
+    reader_t writer = {dev, &stop, 0, 0};
+    reader_t readers[8];
+
+    pthread_create(&writer_thread, NULL, voltage_writer_fn, &writer);
+    for (int i = 0; i < threads; i++) {
+        readers[i] = (reader_t){dev, &stop, 0, 0};
+        pthread_create(&reader_threads[i], NULL, reader_fn, &readers[i]);
+    }
+    usleep(300000);
+    atomic_store(&stop, true);
+    pthread_join(writer_thread, NULL);
+
+    long reads = 0;
+    int torn = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(reader_threads[i], NULL);
+        reads += readers[i].ops;
+        torn += readers[i].torn;
+    }
+    printf("%d readers: %ld snapshots in 300 ms against %ld writes, %d torn\n",
+           threads, reads, writer.ops, torn);
+    *reads_out = reads;
+    return torn;
+}
+
+static int test_concurrent_readers(void) {
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 3;
+    config.update_ms = 1;           // Readers keep stepping the simulation too
+
+    hw_device_t* dev = hw_open(&config);
+    long one = 0, four = 0;
+    int torn = run_readers(dev, 1, &one) + run_readers(dev, 4, &four);
+    hw_close(dev);
+    return (torn || one == 0 || four == 0) ? 1 : 0;
+}
+
+typedef struct {
+    atomic_int ok;
+    atomic_int timed_out;
+    atomic_int cancelled;
+    atomic_int superseded;
+    atomic_int other;
+} command_tally_t;
+
+static void command_fn(hw_device_t* device, hw_token_t token, hw_status_t result, void* user_data) {
+    (void)device;
+    (void)token;
+    command_tally_t* t = user_data;
+    if (result == HW_STATUS_OK) atomic_fetch_add(&t->ok, 1);
+    else if (result == HW_STATUS_TIMEOUT) atomic_fetch_add(&t->timed_out, 1);
+    else if (result == HW_STATUS_CANCELLED) atomic_fetch_add(&t->cancelled, 1);
+    else if (result == HW_STATUS_SUPERSEDED) atomic_fetch_add(&t->superseded, 1);
+    else atomic_fetch_add(&t->other, 1);
+}
+
+static int test_async_commands(void) {
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 11;
+    config.update_ms = 60000;
+    config.command_latency_ms = 50;
+    hw_device_t* dev = hw_open(&config);
+    command_tally_t tally = {0, 0, 0, 0, 0};
+
+    // One thread puts 300 commands in flight without waiting on any; while
+    // queued they coalesce to the last voltage and one state per circuit (1, 3, 5)
+    for (int i = 0; i < 300; i++) {
+        hw_token_t token = (i % 2)
+            ? hw_dev_set_target_voltage_async(dev, 50.0f + (i % 50) * 0.1f, 0, command_fn, &tally)
+            : hw_dev_set_dc_circuit_state_async(dev, 1 + i % 6, true, 0, command_fn, &tally);
+        if (!token) {
+            printf("Submit %d refused\n", i);
+            return 1;
+        }
+    }
+    // Timed out on the link, and cancelled before it was sent
+    hw_dev_set_power_module_state_async(dev, 1, false, 10, command_fn, &tally);
+    hw_token_t doomed = hw_dev_start_battery_test_async(dev, 2, 1, 0, command_fn, &tally);
+    if (hw_dev_cancel(dev, doomed) != HW_STATUS_OK || hw_dev_cancel(dev, doomed) != HW_STATUS_INVALID_PARAM) {
+        printf("Cancel wrong\n");
+        return 1;
+    }
+    usleep(300000);
+    printf("302 commands: %d ok, %d superseded, %d timed out, %d cancelled, %d other\n",
+           atomic_load(&tally.ok), atomic_load(&tally.superseded), atomic_load(&tally.timed_out),
+           atomic_load(&tally.cancelled), atomic_load(&tally.other));
+    if (atomic_load(&tally.ok) != 4 || atomic_load(&tally.superseded) != 296 || atomic_load(&tally.timed_out) != 1 ||
+        atomic_load(&tally.cancelled) != 1 || atomic_load(&tally.other) != 0) {
+        return 1;
+    }
+    battery_info_t batteries[4];
+    uint8_t count = 4;
+    hw_dev_get_battery_info(dev, batteries, &count);
+    if (batteries[1].test_in_progress) {
+        printf("Cancelled command still ran\n");
+        return 1;
+    }
+
+    // Without a callback: completions wait behind a pollable fd
+    int marker = 0;
+    hw_token_t good = hw_dev_set_power_module_state_async(dev, 4, true, 0, NULL, &marker);
+    hw_token_t bad = hw_dev_set_power_module_state_async(dev, 9, true, 0, NULL, &marker);
+    int fd = hw_dev_command_fd(dev);
+    if (fd >= 0) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 1000) != 1) {
+            printf("Command fd never became readable\n");
+            return 1;
+        }
+    }
+    hw_completion_t done[4];
+    int n = 0;
+    for (int tries = 0; n < 2 && tries < 100; tries++) {
+        n += hw_dev_poll_completions(dev, done + n, 4 - n);
+        if (n < 2) usleep(10000);
+    }
+    if (n != 2 || done[0].token != good || done[0].result != HW_STATUS_OK ||
+        done[1].token != bad || done[1].result != HW_STATUS_INVALID_PARAM || done[0].user_data != &marker) {
+        printf("Polled completions wrong\n");
+        return 1;
+    }
+    hw_close(dev);
+
+    // The queue is bounded
+    config.max_commands = 4;
+    dev = hw_open(&config);
+    for (int i = 0; i < 4; i++) hw_dev_start_battery_test_async(dev, 1 + i, 0, 0, command_fn, &tally);
+    if (hw_dev_set_target_voltage_async(dev, 52.0f, 0, command_fn, &tally) != 0) {
+        printf("Full queue accepted a command\n");
+        return 1;
+    }
+    hw_close(dev);
+    return 0;
+}
+
+typedef struct {
+    int calls;
+    uint32_t changed;
+    float voltage;
+    bool power_module_2;
+} probe_result_t;
+
+typedef struct {
+    pthread_mutex_t lock;
+    probe_result_t seen;
+    _Atomic(hw_subscription_t*) self;
+} sub_probe_t;
+
+static void probe_fn(hw_device_t* device, uint32_t changed, const hw_snapshot_t* snapshot, void* user_data) {
+    (void)device;
+    sub_probe_t* p = user_data;
+    pthread_mutex_lock(&p->lock);
+    p->seen.calls++;
+    p->seen.changed |= changed;
+    p->seen.voltage = snapshot->power_modules[0].voltage;
+    p->seen.power_module_2 = snapshot->power_modules[1].is_active;
+    pthread_mutex_unlock(&p->lock);
+}
+
+static void once_fn(hw_device_t* device, uint32_t changed, const hw_snapshot_t* snapshot, void* user_data) {
+    sub_probe_t* p = user_data;
+    // The first call can beat hw_dev_subscribe() returning the handle
+    hw_subscription_t* self;
+    while (!(self = atomic_load(&p->self))) sched_yield();
+    probe_fn(device, changed, snapshot, user_data);
+    hw_unsubscribe(self);
+}
+
+static probe_result_t probe_take(sub_probe_t* p) {
+    pthread_mutex_lock(&p->lock);
+    probe_result_t seen = p->seen;
+    p->seen.calls = 0;
+    p->seen.changed = 0;
+    pthread_mutex_unlock(&p->lock);
+    return seen;
+}
+
+static int test_subscriptions(void) {
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 7;
+    config.update_ms = 60000;       // Only our own changes
+
+    hw_device_t* dev = hw_open(&config);
+    sub_probe_t power = {PTHREAD_MUTEX_INITIALIZER, {0, 0, 0, false}, NULL};
+    sub_probe_t limited = {PTHREAD_MUTEX_INITIALIZER, {0, 0, 0, false}, NULL};
+    sub_probe_t once = {PTHREAD_MUTEX_INITIALIZER, {0, 0, 0, false}, NULL};
+
+    hw_subscription_t* a = hw_dev_subscribe(dev, HW_CHANGE_POWER, 0, probe_fn, &power);
+    hw_subscription_t* b = hw_dev_subscribe(dev, HW_CHANGE_ALL, 200, probe_fn, &limited);
+    hw_subscription_t* c = hw_dev_subscribe(dev, HW_CHANGE_ALL, 0, once_fn, &once);
+    atomic_store(&once.self, c);
+    if (!a || !b || !c) {
+        printf("Subscribe failed\n");
+        return 1;
+    }
+    usleep(100000);
+
+    // Every subscription starts with one call carrying its whole mask
+    probe_result_t got = probe_take(&power);
+    if (got.calls != 1 || got.changed != HW_CHANGE_POWER) {
+        printf("Initial call wrong: %d calls, changed 0x%02x\n", got.calls, got.changed);
+        return 1;
+    }
+    probe_take(&limited);
+
+    // Other categories do not wake a power subscriber
+    hw_dev_start_battery_test(dev, 1, 0);
+    usleep(100000);
+    if (probe_take(&power).calls != 0) {
+        printf("Battery change reached a power-only subscriber\n");
+        return 1;
+    }
+    hw_dev_set_power_module_state(dev, 2, false);
+    usleep(100000);
+    got = probe_take(&power);
+    if (got.calls != 1 || got.changed != HW_CHANGE_POWER || got.power_module_2) {
+        printf("Power change not delivered\n");
+        return 1;
+    }
+
+    // 500 changes in ~1 s against a 200 ms limit: a handful of calls, and
+    // the last one carries the final value
+    probe_take(&limited);
+    float voltage = 48.0f;
+    for (int i = 0; i < 500; i++) {
+        voltage = 48.0f + (i % 100) * 0.1f;
+        hw_dev_set_target_voltage(dev, voltage);
+        usleep(2000);
+    }
+    usleep(400000);
+    got = probe_take(&limited);
+    printf("500 changes -> %d rate-limited calls\n", got.calls);
+    if (got.calls < 2 || got.calls > 9 || fabsf(got.voltage - voltage) > 0.001f) {
+        printf("Rate limit or coalescing wrong (last voltage %.1f, want %.1f)\n", got.voltage, voltage);
+        return 1;
+    }
+
+    // A callback that unsubscribes itself is never called again
+    if (probe_take(&once).calls != 1) {
+        printf("Self-unsubscribed callback called again\n");
+        return 1;
+    }
+
+    hw_unsubscribe(a);
+    probe_take(&power);
+    hw_dev_set_power_module_state(dev, 2, true);
+    usleep(100000);
+    if (probe_take(&power).calls != 0) {
+        printf("Unsubscribed callback still called\n");
+        return 1;
+    }
+    hw_unsubscribe(b);
+    hw_close(dev);
+    return 0;
+}
+
+// A large site: bulk reads and range scans agree with a plain loop over the
+// same version
+static int test_bulk_access(void) {
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 5;
+    config.update_ms = 60000;       // No simulated drift during the test
+    config.power_modules = 60;
+    config.batteries = 24;
+    config.dc_circuits = 200;
+
+    hw_device_t* dev = hw_open(&config);
+    if (!dev || hw_dev_unit_count(dev, HW_BANK_POWER_MODULES) != 60 ||
+        hw_dev_unit_count(dev, HW_BANK_DC_CIRCUITS) != 200 || hw_dev_unit_count(dev, HW_BANK_AC_PHASES) != 3) {
+        printf("Configured counts not applied\n");
+        return 1;
+    }
+
+    hw_snapshot_t snap;
+    memset(&snap, 0, sizeof(snap));
+    hw_dev_get_snapshot(dev, &snap);
+    if (snap.power_module_count != 60 || snap.battery_count != 24 || snap.dc_circuit_count != 200 ||
+        snap.dc_circuits[199].circuit_id != 200 || !snap.power_modules[58].is_active ||
+        snap.power_modules[59].is_active) {
+        printf("Snapshot of a large site wrong\n");
+        return 1;
+    }
+
+    // Stopped modules cool to 25 °C; running ones sit at 40-49 °C
+    hw_dev_set_power_module_state(dev, 10, false);
+    hw_dev_set_power_module_state(dev, 20, false);
+    float temperatures[60];
+    if (hw_dev_read_field(dev, HW_BANK_POWER_MODULES, HW_FIELD_TEMPERATURE, 1, 60, temperatures) != HW_STATUS_OK) {
+        printf("Bulk read failed\n");
+        return 1;
+    }
+    uint8_t ids[60];
+    int found = hw_dev_find_units(dev, HW_BANK_POWER_MODULES, HW_FIELD_TEMPERATURE, 45.0f, INFINITY, ids, 60);
+    int expected = 0;
+    for (int i = 0; i < 60; i++) {
+        if (temperatures[i] >= 45.0f) {
+            if (expected >= found || ids[expected] != i + 1) {
+                printf("Range scan disagrees with a loop at module %d\n", i + 1);
+                return 1;
+            }
+            expected++;
+        }
+    }
+    if (found != expected || found == 0) {
+        printf("Range scan found %d modules, loop %d\n", found, expected);
+        return 1;
+    }
+    printf("%d of 60 modules at or over 45 C\n", found);
+
+    // More matches than room: the total still comes back
+    found = hw_dev_find_units(dev, HW_BANK_POWER_MODULES, HW_FIELD_TEMPERATURE, -INFINITY, 30.0f, ids, 1);
+    if (found != 2 || ids[0] != 10) {
+        printf("Truncated scan wrong\n");
+        return 1;
+    }
+
+    // Fields a bank lacks and ids past the end are refused
+    if (hw_dev_find_units(dev, HW_BANK_DC_CIRCUITS, HW_FIELD_TEMPERATURE, 0.0f, 1.0f, ids, 60) != -1 ||
+        hw_dev_read_field(dev, HW_BANK_POWER_MODULES, HW_FIELD_VOLTAGE, 59, 3, temperatures) != HW_STATUS_INVALID_PARAM ||
+        hw_dev_set_power_module_state(dev, 61, true) != HW_STATUS_INVALID_PARAM) {
+        printf("Out-of-range access accepted\n");
+        return 1;
+    }
+
+    // Category getters fill no more than the caller has room for
+    power_module_t modules[4];
+    uint8_t count = 4;
+    if (hw_dev_get_power_modules(dev, modules, &count) != HW_STATUS_OK || count != 4 || modules[3].module_id != 4) {
+        printf("Getter ignored the caller's capacity\n");
+        return 1;
+    }
+
+    hw_close(dev);
+    return 0;
+}
+
+#define STATS_THREADS       4
+#define STATS_CALLS         10000
+
+static void* stats_worker(void* arg) {
+    hw_device_t* dev = arg;
+    system_status_t status;
+    for (int i = 0; i < STATS_CALLS; i++) hw_dev_get_system_status(dev, &status);
+    return NULL;
+}
+
+static void count_frame(const stm32_frame_t* frame, void* user_data) {
+    power_module_t module;
+    if (stm32_decode_power_module(frame, &module)) (*(int*)user_data)++;
+}
+
+// Calls from threads that have exited still count, and the merged
+// percentiles are ordered
+static int test_call_stats(void) {
+    hw_stats_t before, after;
+    hw_get_stats(&before);
+
+    hw_device_t* dev = hw_open(NULL);
+    for (int round = 0; round < 2; round++) {
+        pthread_t threads[STATS_THREADS];
+        for (int i = 0; i < STATS_THREADS; i++) pthread_create(&threads[i], NULL, stats_worker, dev);
+        for (int i = 0; i < STATS_THREADS; i++) pthread_join(threads[i], NULL);
+    }
+
+    // A frame through the decoder
+    power_module_t module = {1, 53.5f, 40.0f, 2.14f, 41.0f, true, false};
+    uint8_t data[STM32_MAX_FRAME_DATA], wire[STM32_MAX_PACKET_SIZE];
+    uint8_t length = stm32_encode_power_module(&module, data);
+    size_t size = stm32_encode_frame(PACKET_TYPE_POWER_MODULE, data, length, wire);
+    stm32_decoder_t decoder;
+    stm32_decoder_init(&decoder);
+    int decoded = 0;
+    stm32_decoder_feed(&decoder, wire, size, count_frame, &decoded);
+    hw_close(dev);
+
+    hw_get_stats(&after);
+    const hw_op_stats_t* s = &after.ops[HW_OP_GET_SYSTEM_STATUS];
+    uint64_t calls = s->calls - before.ops[HW_OP_GET_SYSTEM_STATUS].calls;
+    printf("%s: %llu calls, p50 %llu ns, p99 %llu ns, p999 %llu ns, max %llu ns\n",
+           hw_op_name(HW_OP_GET_SYSTEM_STATUS), (unsigned long long)calls,
+           (unsigned long long)s->p50_ns, (unsigned long long)s->p99_ns,
+           (unsigned long long)s->p999_ns, (unsigned long long)s->max_ns);
+    if (calls != 2 * STATS_THREADS * STATS_CALLS || s->p50_ns > s->p99_ns ||
+        s->p99_ns > s->p999_ns || s->p999_ns > s->max_ns) {
+        printf("Merged statistics wrong\n");
+        return 1;
+    }
+    if (decoded != 1 || after.ops[HW_OP_DECODE_STREAM].calls <= before.ops[HW_OP_DECODE_STREAM].calls ||
+        after.ops[HW_OP_DECODE_RECORD].calls <= before.ops[HW_OP_DECODE_RECORD].calls ||
+        after.ops[HW_OP_OPEN].calls != before.ops[HW_OP_OPEN].calls + 1) {
+        printf("Decoder or open not recorded\n");
+        return 1;
+    }
+
+    // What recording costs on this machine
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (int i = 0; i < 1000000; i++) hw_stats_record(HW_OP_ALARM_EVALUATION, hw_stats_now());
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double ns = ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e6;
+    printf("Recording costs %.1f ns per call\n", ns);
+    return 0;
+}
+
+static void result_fn(hw_device_t* device, hw_token_t token, hw_status_t result, void* user_data) {
+    (void)device;
+    (void)token;
+    atomic_store((atomic_int*)user_data, result);
+}
+
+// Queued setpoints for the same setting coalesce, never across a command
+// whose order matters
+static int test_command_coalescing(void) {
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 5;
+    config.update_ms = 60000;
+    config.command_latency_ms = 50;
+    hw_device_t* dev = hw_open(&config);
+
+    atomic_int results[11];
+    for (int i = 0; i < 11; i++) atomic_init(&results[i], 99);
+    hw_dev_set_dc_circuit_state_async(dev, 2, false, 0, result_fn, &results[0]);
+    hw_dev_start_battery_test_async(dev, 1, 0, 0, result_fn, &results[1]);
+    hw_dev_set_dc_circuit_state_async(dev, 2, true, 0, result_fn, &results[2]);        // Behind a test
+    hw_dev_set_power_module_state_async(dev, 1, false, 0, result_fn, &results[3]);
+    hw_dev_set_target_voltage_async(dev, 50.0f, 0, result_fn, &results[4]);
+    hw_dev_set_power_module_state_async(dev, 1, true, 0, result_fn, &results[5]);      // Behind a voltage
+    hw_dev_set_dc_circuit_state_async(dev, 3, false, 0, result_fn, &results[6]);
+    hw_dev_set_dc_circuit_state_async(dev, 3, true, 0, result_fn, &results[7]);        // Replaces 6
+    hw_dev_set_target_voltage_async(dev, 55.0f, 0, result_fn, &results[8]);            // Behind a module
+    hw_dev_set_target_voltage_async(dev, 54.5f, 0, result_fn, &results[9]);            // Replaces 8
+    hw_dev_set_target_voltage_async(dev, 99.0f, 0, result_fn, &results[10]);           // Invalid, replaces nothing
+
+    const int expected[11] = {
+        HW_STATUS_OK, HW_STATUS_OK, HW_STATUS_OK, HW_STATUS_OK, HW_STATUS_OK, HW_STATUS_OK,
+        HW_STATUS_SUPERSEDED, HW_STATUS_OK, HW_STATUS_SUPERSEDED, HW_STATUS_OK, HW_STATUS_INVALID_PARAM,
+    };
+    for (int tries = 0; tries < 100 && atomic_load(&results[9]) == 99; tries++) usleep(10000);
+    usleep(20000);
+    for (int i = 0; i < 11; i++) {
+        if (atomic_load(&results[i]) != expected[i]) {
+            printf("Command %d completed with %d, expected %d\n", i, atomic_load(&results[i]), expected[i]);
+            return 1;
+        }
+    }
+
+    static hw_snapshot_t snap;
+    hw_dev_get_snapshot(dev, &snap);
+    if (!snap.dc_circuits[1].is_enabled || !snap.dc_circuits[2].is_enabled || !snap.power_modules[0].is_active ||
+        fabsf(snap.power_modules[0].voltage - 54.5f) > 0.01f || !snap.batteries[0].test_in_progress) {
+        printf("Coalesced commands left the wrong state\n");
+        return 1;
+    }
+    printf("11 commands: 2 superseded, module 1 at %.1fV\n", snap.power_modules[0].voltage);
+    hw_close(dev);
+
+    // Batch frames round trip
+    stm32_command_t batch[STM32_MAX_BATCH_COMMANDS], back[STM32_MAX_BATCH_COMMANDS];
+    for (int i = 0; i < STM32_MAX_BATCH_COMMANDS; i++) {
+        batch[i] = (stm32_command_t){STM32_CMD_DC_CIRCUIT, (uint8_t)(i + 1), STM32_CMD_ACTION_START, 0, 1000u * i};
+    }
+    stm32_frame_t frame = {PACKET_TYPE_COMMAND_BATCH, 0, {0}};
+    frame.length = stm32_encode_command_batch(batch, STM32_MAX_BATCH_COMMANDS, frame.data);
+    if (frame.length > STM32_MAX_FRAME_DATA ||
+        stm32_decode_command_batch(&frame, back, STM32_MAX_BATCH_COMMANDS) != STM32_MAX_BATCH_COMMANDS ||
+        back[6].target_id != 7 || back[6].reserved != 6000 ||
+        stm32_encode_command_batch(batch, STM32_MAX_BATCH_COMMANDS + 1, frame.data) != 0) {
+        printf("Batch frame round trip failed\n");
+        return 1;
+    }
+    return 0;
+}
+
+// Replica side of the change feed, for the fields setters touch
+static bool apply_change(hw_snapshot_t* s, const hw_change_t* c) {
+    int i = c->unit_id - 1;
+    float v = c->value;
+    if (c->record == HW_BANK_POWER_MODULES) {
+        power_module_t* m = &s->power_modules[i];
+        switch (c->field) {
+        case HW_FIELD_VOLTAGE: m->voltage = v; return true;
+        case HW_FIELD_CURRENT: m->current = v; return true;
+        case HW_FIELD_POWER: m->power = v; return true;
+        case HW_FIELD_TEMPERATURE: m->temperature = v; return true;
+        case HW_FIELD_ACTIVE: m->is_active = v != 0.0f; return true;
+        }
+    } else if (c->record == HW_BANK_DC_CIRCUITS) {
+        dc_circuit_t* d = &s->dc_circuits[i];
+        switch (c->field) {
+        case HW_FIELD_VOLTAGE: d->voltage = v; return true;
+        case HW_FIELD_CURRENT: d->current = v; return true;
+        case HW_FIELD_POWER: d->power = v; return true;
+        case HW_FIELD_ACTIVE: d->is_enabled = v != 0.0f; return true;
+        }
+    } else if (c->record == HW_RECORD_SYSTEM && c->field == HW_FIELD_OPERATION_MODE) {
+        s->status.operation_mode = (uint8_t)v;
+        return true;
+    }
+    return false;
+}
+
+static bool replica_matches(const hw_snapshot_t* a, const hw_snapshot_t* b) {
+    for (int i = 0; i < a->power_module_count; i++) {
+        const power_module_t* x = &a->power_modules[i];
+        const power_module_t* y = &b->power_modules[i];
+        if (x->voltage != y->voltage || x->current != y->current || x->power != y->power ||
+            x->temperature != y->temperature || x->is_active != y->is_active) return false;
+    }
+    for (int i = 0; i < a->dc_circuit_count; i++) {
+        const dc_circuit_t* x = &a->dc_circuits[i];
+        const dc_circuit_t* y = &b->dc_circuits[i];
+        if (x->voltage != y->voltage || x->current != y->current || x->power != y->power ||
+            x->is_enabled != y->is_enabled) return false;
+    }
+    return a->status.operation_mode == b->status.operation_mode;
+}
+
+static atomic_bool feed_written;
+
+static void* feed_writer(void* arg) {
+    hw_device_t* dev = arg;
+    for (int i = 0; i < 3000; i++) {
+        switch (i % 4) {
+        case 0: hw_dev_set_dc_circuit_state(dev, 1 + i % 6, (i / 4) % 2); break;
+        case 1: hw_dev_set_target_voltage(dev, 50.0f + (i % 40) * 0.1f); break;
+        case 2: hw_dev_set_power_module_state(dev, 1 + i % 4, (i / 8) % 2); break;
+        case 3: hw_dev_set_operation_mode(dev, (uint8_t)(i % 3)); break;
+        }
+        if (i % 16 == 0) usleep(100);
+    }
+    atomic_store(&feed_written, true);
+    return NULL;
+}
+
+static int test_change_feed(void) {
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 9;
+    config.update_ms = 60000;
+    config.change_log = 64;
+    hw_device_t* dev = hw_open(&config);
+
+    static hw_snapshot_t replica, snap;
+    hw_dev_get_snapshot(dev, &replica);
+    hw_change_t changes[64];
+    uint32_t count = 64;
+    uint64_t version;
+    if (hw_dev_get_changes_since(dev, replica.version, changes, &count, &version) != HW_STATUS_NOT_MODIFIED ||
+        hw_dev_get_changes_since(dev, 0, changes, &count, &version) != HW_STATUS_TOO_OLD) {
+        printf("Feed of an unchanged device wrong\n");
+        return 1;
+    }
+
+    // Two versions: a circuit switched off (4 fields), then the mode
+    hw_dev_set_dc_circuit_state(dev, 2, false);
+    hw_dev_set_operation_mode(dev, 1);
+    count = 3;
+    if (hw_dev_get_changes_since(dev, replica.version, changes, &count, &version) != HW_STATUS_TOO_OLD) {
+        printf("Part of a version returned\n");
+        return 1;
+    }
+    count = 4;
+    if (hw_dev_get_changes_since(dev, replica.version, changes, &count, &version) != HW_STATUS_OK ||
+        count != 4 || version != replica.version + 1 || changes[0].record != HW_BANK_DC_CIRCUITS ||
+        changes[0].unit_id != 2) {
+        printf("Truncated feed wrong: %u changes up to %llu\n", count, (unsigned long long)version);
+        return 1;
+    }
+    for (uint32_t i = 0; i < count; i++) apply_change(&replica, &changes[i]);
+    replica.version = version;
+    count = 64;
+    if (hw_dev_get_changes_since(dev, replica.version, changes, &count, &version) != HW_STATUS_OK || count != 1 ||
+        changes[0].record != HW_RECORD_SYSTEM || changes[0].field != HW_FIELD_OPERATION_MODE ||
+        changes[0].value != 1.0f) {
+        printf("Mode change missing\n");
+        return 1;
+    }
+
+    // Far enough behind that the ring wrapped
+    for (int i = 0; i < 40; i++) hw_dev_set_dc_circuit_state(dev, 3, i % 2);
+    count = 64;
+    if (hw_dev_get_changes_since(dev, replica.version, changes, &count, &version) != HW_STATUS_TOO_OLD) {
+        printf("Dropped changes not reported\n");
+        return 1;
+    }
+
+    hw_close(dev);
+
+    // A replica kept current from the feed alone while a writer runs
+    config.change_log = 1024;
+    dev = hw_open(&config);
+    replica.version = 0;
+    hw_dev_get_snapshot(dev, &replica);
+    pthread_t writer;
+    atomic_store(&feed_written, false);
+    pthread_create(&writer, NULL, feed_writer, dev);
+    int polls = 0, resyncs = 0, applied = 0;
+    bool done = false;
+    while (!done) {
+        done = atomic_load(&feed_written);
+        count = 64;
+        hw_status_t status;
+        while ((status = hw_dev_get_changes_since(dev, replica.version, changes, &count, &version)) == HW_STATUS_OK) {
+            for (uint32_t i = 0; i < count; i++) {
+                if (!apply_change(&replica, &changes[i])) {
+                    printf("Unexpected change %u/%u\n", changes[i].record, changes[i].field);
+                    return 1;
+                }
+            }
+            applied += count;
+            replica.version = version;
+            count = 64;
+        }
+        if (status == HW_STATUS_TOO_OLD) {
+            replica.version = 0;
+            hw_dev_get_snapshot(dev, &replica);
+            resyncs++;
+        }
+        polls++;
+        usleep(100);
+    }
+    pthread_join(writer, NULL);
+    snap.version = 0;
+    hw_dev_get_snapshot(dev, &snap);
+    printf("%d polls, %d changes applied, %d resyncs, replica at %llu of %llu\n", polls, applied, resyncs,
+           (unsigned long long)replica.version, (unsigned long long)snap.version);
+    if (replica.version != snap.version || !replica_matches(&replica, &snap)) {
+        printf("Replica diverged\n");
+        return 1;
+    }
+    hw_close(dev);
+    return 0;
+}
+
+// Three days of 1 s points charted in 100 buckets: 15 min rollups, three
+// to a bucket, must agree with the points themselves
+static int check_summary(hw_device_t* dev, uint32_t base, uint32_t points) {
+    static hw_history_bucket_t buckets[100];
+    uint32_t count = 100, resolution = 0;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    hw_dev_get_history_summary(dev, "load_current", base, base + points - 1, buckets, &count, &resolution);
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    printf("%u buckets of %u s in %.0f us\n", count, resolution,
+           ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e3);
+    if (count != points / 2700 || resolution != 2700) return 1;
+
+    for (uint32_t b = 0; b < count; b++) {
+        hw_history_bucket_t expected = {base + b * 2700, 0, 1e9f, -1e9f, 0, 0, 0};
+        for (uint32_t i = b * 2700; i < (b + 1) * 2700; i++) {
+            float v = (float)(i % 1000);
+            if (expected.count++ == 0) expected.first = v;
+            if (v < expected.min) expected.min = v;
+            if (v > expected.max) expected.max = v;
+            expected.last = v;
+            expected.sum += v;
+        }
+        const hw_history_bucket_t* got = &buckets[b];
+        if (got->start != expected.start || got->count != expected.count || got->min != expected.min ||
+            got->max != expected.max || got->first != expected.first || got->last != expected.last ||
+            got->sum != expected.sum) {
+            printf("Bucket %u: %u points from %u, min %.0f max %.0f sum %.0f\n", b, got->count, got->start,
+                   got->min, got->max, got->sum);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Charts read rollups kept at ingest, across a reopen and after the
+// rollups are lost, and fall back to the points for short ranges
+static int test_history_summary(void) {
+    char dir[] = "/tmp/netmon_rollup_XXXXXX";
+    if (!mkdtemp(dir)) {
+        printf("Cannot create history directory\n");
+        return 1;
+    }
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 12;
+    config.update_ms = 60000;
+    config.history_dir = dir;
+    hw_device_t* dev = hw_open(&config);
+    const uint32_t base = 1700000000u - 1700000000u % 86400u, points = 3 * 86400;
+    for (uint32_t i = 0; i < points; i++) hw_dev_log_data_point(dev, "load_current", (float)(i % 1000), base + i);
+
+    int failed = check_summary(dev, base, points);
+    hw_history_bucket_t buckets[100];
+    uint32_t count = 100, resolution = 0;
+    hw_dev_get_history_summary(dev, "load_current", base + 1000, base + 1599, buckets, &count, &resolution);
+    if (!failed && (count != 100 || resolution != 6 || buckets[0].start != base + 1000 || buckets[0].count != 6 ||
+                    buckets[0].min != 0.0f || buckets[0].sum != 15.0f || buckets[99].last != 599.0f)) {
+        printf("Short range not summarized from points: %u buckets of %u s\n", count, resolution);
+        failed = 1;
+    }
+    count = 100;
+    hw_dev_get_history_summary(dev, "ac_voltage", base, base + points, buckets, &count, &resolution);
+    if (!failed && count != 0) {
+        printf("Unknown series summarized\n");
+        failed = 1;
+    }
+    hw_close(dev);
+
+    // Reopened, then with the rollups gone
+    char command[96];
+    for (int pass = 0; pass < 2 && !failed; pass++) {
+        dev = hw_open(&config);
+        failed = check_summary(dev, base, points);
+        hw_close(dev);
+        snprintf(command, sizeof(command), "rm -f %s/load_current/*.rollup", dir);
+        if (system(command) != 0) failed = 1;
+    }
+    if (failed) printf("Summary wrong after reopen\n");
+
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    if (system(command) != 0) {
+        // Leftovers only take space in /tmp
+    }
+    return failed;
+}
+
+// Every interval and bit pattern survives the codec, and an encoder
+// rebuilt from a stream continues it exactly
+static int test_gorilla(void) {
+    enum { POINTS = 4000 };
+    static uint32_t times[POINTS], out_times[POINTS];
+    static float values[POINTS], out_values[POINTS];
+    static uint8_t stream[POINTS * 11 + GORILLA_POINT_ROOM], again[POINTS * 11 + GORILLA_POINT_ROOM];
+    const uint32_t gaps[] = {1, 1, 1, 0, 2, 60, 1, 300, 3600, 1, 100000, 1u << 31, 1};
+    const uint32_t patterns[] = {0x7FC00000u, 0x7F800000u, 0x80000000u, 0xFF800000u, 0x00000001u, 0xFFFFFFFFu};
+    uint32_t seed = 17, t = 5;
+    for (int i = 0; i < POINTS; i++) {
+        seed = seed * 1103515245u + 12345u;
+        t += i % 7 ? 1 : gaps[(seed >> 8) % 13];
+        if (t < times[i ? i - 1 : 0]) t = times[i - 1];
+        times[i] = t;
+        uint32_t bits;
+        if (i % 97 == 0) {
+            bits = patterns[(seed >> 4) % 6];
+        } else if (i % 5 == 0) {
+            bits = seed;
+        } else {
+            float v = 53.5f + (float)((seed >> 16) % 50) * 0.001f;
+            memcpy(&bits, &v, sizeof(bits));
+        }
+        memcpy(&values[i], &bits, sizeof(bits));
+    }
+
+    gorilla_encoder_t encoder;
+    gorilla_init(&encoder);
+    memset(stream, 0, sizeof(stream));
+    for (int i = 0; i < POINTS; i++) gorilla_append(&encoder, stream, times[i], values[i]);
+    size_t bytes = gorilla_bytes(&encoder);
+    uint32_t n = gorilla_decode(stream, bytes, POINTS, 0, UINT32_MAX, out_times, out_values, POINTS);
+    if (n != POINTS || memcmp(out_times, times, sizeof(times)) != 0 ||
+        memcmp(out_values, values, sizeof(values)) != 0) {
+        printf("Round trip wrong: %u points\n", n);
+        return 1;
+    }
+
+    // A range from the middle, cut off by room
+    n = gorilla_decode(stream, bytes, POINTS, times[1000], times[3000], NULL, out_values, 10);
+    if (n != 10 || memcmp(out_values, &values[1000], 10 * sizeof(float)) != 0 ||
+        gorilla_decode(stream, bytes, POINTS, times[POINTS - 1] + 1, UINT32_MAX, NULL, out_values, 10) != 0) {
+        printf("Range decode wrong\n");
+        return 1;
+    }
+
+    // Resume halfway and continue; a stream cut short resumes before the cut
+    gorilla_encoder_t resumed;
+    if (gorilla_resume(&resumed, stream, bytes, POINTS / 2) != POINTS / 2) {
+        printf("Resume found too few points\n");
+        return 1;
+    }
+    memset(again, 0, sizeof(again));
+    memcpy(again, stream, gorilla_bytes(&resumed));
+    if (resumed.bits % 8) again[resumed.bits / 8] &= (uint8_t)(0xFF00u >> (resumed.bits % 8));
+    for (int i = POINTS / 2; i < POINTS; i++) gorilla_append(&resumed, again, times[i], values[i]);
+    if (resumed.bits != encoder.bits || memcmp(again, stream, bytes) != 0 ||
+        gorilla_resume(&resumed, stream, bytes / 2, POINTS) >= POINTS / 2 + POINTS / 4) {
+        printf("Resumed stream differs\n");
+        return 1;
+    }
+    printf("%d points in %zu bytes (%.2f bits/point)\n", POINTS, bytes, bytes * 8.0 / POINTS);
+    return 0;
+}
+
+// Logged points come back by range from the store, in memory and on disk
+// across a reopen
+static int test_history(void) {
+    hw_config_t config;
+    hw_default_config(&config);
+    config.seed = 11;
+    config.update_ms = 60000;
+    hw_device_t* dev = hw_open(&config);
+
+    float values[16];
+    uint32_t count = 16;
+    for (uint32_t t = 1000; t < 1010; t++) hw_dev_log_data_point(dev, "dc_voltage", 48.0f + (t - 1000) * 0.1f, t);
+    if (hw_dev_log_data_point(dev, "dc_voltage", 1.0f, 999) != HW_STATUS_INVALID_PARAM ||
+        hw_dev_get_historical_data(dev, "dc_voltage", 1003, 1005, values, &count) != HW_STATUS_OK || count != 3 ||
+        fabsf(values[0] - 48.3f) > 0.001f || fabsf(values[2] - 48.5f) > 0.001f) {
+        printf("In-memory history wrong: %u points\n", count);
+        return 1;
+    }
+    count = 4;
+    hw_dev_get_historical_data(dev, "dc_voltage", 0, 5000, values, &count);
+    uint32_t unknown = 16;
+    hw_dev_get_historical_data(dev, "ac_voltage", 0, 5000, values + 4, &unknown);
+    if (count != 4 || values[0] != 48.0f || unknown != 0) {
+        printf("Truncated or unknown range wrong\n");
+        return 1;
+    }
+    hw_close(dev);
+
+    // Three daily partitions of 1 s points, then a reopen
+    char dir[] = "/tmp/netmon_history_XXXXXX";
+    if (!mkdtemp(dir)) {
+        printf("Cannot create history directory\n");
+        return 1;
+    }
+    config.history_dir = dir;
+    dev = hw_open(&config);
+    const uint32_t base = 1700000000u - 1700000000u % 86400u, points = 3 * 86400;
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    for (uint32_t i = 0; i < points; i++) {
+        if (hw_dev_log_data_point(dev, "load_current", (float)(i % 1000), base + i) != HW_STATUS_OK) {
+            printf("Append %u failed\n", i);
+            return 1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("%u points logged, %.1f M points/s\n", points, points / seconds / 1e6);
+
+    static float day[86400 + 1];
+    int failed = 0;
+    for (int pass = 0; pass < 2 && !failed; pass++) {
+        // A day that straddles two partitions
+        count = 86400 + 1;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        hw_dev_get_historical_data(dev, "load_current", base + 43200, base + 43200 + 86399, day, &count);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        printf("%s: 24 h read in %.0f us\n", pass ? "Reopened" : "Open",
+               ((t1.tv_sec - t0.tv_sec) * 1e9 + (t1.tv_nsec - t0.tv_nsec)) / 1e3);
+        if (count != 86400 || day[0] != (float)(43200 % 1000) || day[86399] != (float)((43200 + 86399) % 1000)) {
+            printf("24 h range wrong: %u points\n", count);
+            failed = 1;
+        }
+        hw_close(dev);
+        dev = hw_open(&config);
+        // The newest point survives the reopen, so going back is still refused
+        if (hw_dev_log_data_point(dev, "load_current", 0.0f, base + points - 2) != HW_STATUS_INVALID_PARAM) {
+            printf("Order lost across reopen\n");
+            failed = 1;
+        }
+    }
+    count = 2;
+    if (!failed && (hw_dev_log_data_point(dev, "load_current", 7.0f, base + points) != HW_STATUS_OK ||
+                    hw_dev_get_historical_data(dev, "load_current", base + points - 1, base + points + 10, values,
+                                               &count) != HW_STATUS_OK ||
+                    count != 2 || values[0] != (float)((points - 1) % 1000) || values[1] != 7.0f)) {
+        printf("Append after reopen wrong\n");
+        failed = 1;
+    }
+    hw_close(dev);
+
+    char command[64];
+    snprintf(command, sizeof(command), "rm -rf %s", dir);
+    if (system(command) != 0) {
+        // Leftovers only take space in /tmp
+    }
+    return failed;
+}
+
+// A fake device on loopback: frames it sends become state, setters
+// become command frames, and a reconnect resumes the session
+typedef struct {
+    stm32_decoder_t decoder;
+    stm32_frame_t frames[8];
+    int count;
+} fake_rx_t;
+
+static void fake_collect(const stm32_frame_t* frame, void* user_data) {
+    fake_rx_t* rx = user_data;
+    if (rx->count < 8) rx->frames[rx->count++] = *frame;
+}
+
+static bool fake_receive(int fd, fake_rx_t* rx, stm32_frame_t* frame) {
+    while (rx->count == 0) {
+        struct pollfd p = {fd, POLLIN, 0};
+        uint8_t buffer[256];
+        if (poll(&p, 1, 2000) <= 0) return false;
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) return false;
+        stm32_decoder_feed(&rx->decoder, buffer, (size_t)n, fake_collect, rx);
+    }
+    *frame = rx->frames[0];
+    memmove(&rx->frames[0], &rx->frames[1], --rx->count * sizeof(stm32_frame_t));
+    return true;
+}
+
+static int fake_accept(int server) {
+    struct pollfd p = {server, POLLIN, 0};
+    return poll(&p, 1, 2000) == 1 ? accept(server, NULL, NULL) : -1;
+}
+
+static size_t fake_frame(uint8_t* wire, uint8_t type, const uint8_t* data, uint8_t length) {
+    return stm32_encode_frame(type, data, length, wire);
+}
+
+static bool wait_for_version(hw_device_t* dev, hw_snapshot_t* snapshot, uint64_t after) {
+    for (int i = 0; i < 2000; i++) {
+        snapshot->version = 0;
+        hw_dev_get_snapshot(dev, snapshot);
+        if (snapshot->version > after) return true;
+        usleep(1000);
+    }
+    return false;
+}
+
+static int test_stm32_link(void) {
+    int server = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof(addr);
+    if (bind(server, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(server, 1) < 0 ||
+        getsockname(server, (struct sockaddr*)&addr, &addr_len) < 0) {
+        printf("Cannot listen\n");
+        return 1;
+    }
+    char link[32];
+    snprintf(link, sizeof(link), "127.0.0.1:%u", ntohs(addr.sin_port));
+
+    hw_config_t config;
+    hw_default_config(&config);
+    config.link = link;
+    hw_device_t* dev = hw_open(&config);
+    int fd = dev ? fake_accept(server) : -1;
+    fake_rx_t rx = {0};
+    stm32_decoder_init(&rx.decoder);
+    stm32_frame_t frame;
+    stm32_resume_t resume;
+    if (fd < 0 || !fake_receive(fd, &rx, &frame) || !stm32_decode_resume(&frame, &resume) ||
+        !(resume.flags & STM32_RESUME_FLAG_KEYFRAME)) {
+        printf("No keyframe request\n");
+        return 1;
+    }
+
+    // Keyframe: SYNC, then one record of each kind and one out of range
+    uint8_t data[STM32_MAX_FRAME_DATA], wire[1024];
+    size_t size = 0;
+    stm32_sync_t sync = {7, 100, STM32_SYNC_KEYFRAME};
+    power_module_t module = {2, 53.5f, 40.0f, 2.14f, 41.0f, true, true};
+    power_module_t stray = {99, 50.0f, 1.0f, 0.05f, 30.0f, true, false};
+    battery_info_t battery = {1, 12.7f, 0.2f, 25.0f, 91, true, false};
+    ac_phase_t phase = {3, 231.0f, 12.0f, 50.0f, 2.77f, true};
+    dc_circuit_t circuit = {3, 53.5f, 6.0f, 0.32f, true, "TEL"};
+    alarm_t alarm = {42, 2, 1700000000, true, "MAINS"};
+    system_status_t sys = {false, true, true, 1, 42.5f, 3600};
+    size += fake_frame(wire + size, PACKET_TYPE_SYNC, data, stm32_encode_sync(&sync, data));
+    size += fake_frame(wire + size, PACKET_TYPE_POWER_MODULE, data, stm32_encode_power_module(&module, data));
+    size += fake_frame(wire + size, PACKET_TYPE_POWER_MODULE, data, stm32_encode_power_module(&stray, data));
+    size += fake_frame(wire + size, PACKET_TYPE_BATTERY, data, stm32_encode_battery(&battery, data));
+    size += fake_frame(wire + size, PACKET_TYPE_AC_INPUT, data, stm32_encode_ac_input(&phase, data));
+    size += fake_frame(wire + size, PACKET_TYPE_DC_OUTPUT, data, stm32_encode_dc_output(&circuit, data));
+    size += fake_frame(wire + size, PACKET_TYPE_ALARM, data, stm32_encode_alarm(&alarm, data));
+    size += fake_frame(wire + size, PACKET_TYPE_SYSTEM_STATUS, data, stm32_encode_system_status(&sys, data));
+    if (write(fd, wire, size) != (ssize_t)size) return 1;
+
+    static hw_snapshot_t snap;
+    bool complete = false;
+    for (int i = 0; i < 2000 && !complete; i++) {
+        wait_for_version(dev, &snap, 1);
+        complete = snap.alarm_count == 1 && snap.status.operation_mode == 1;
+        if (!complete) usleep(1000);
+    }
+    const power_module_t* m = &snap.power_modules[1];
+    if (!complete || fabsf(m->voltage - 53.5f) > 0.01f || !m->is_active || !m->has_fault ||
+        snap.batteries[0].capacity_percent != 91 || !snap.batteries[0].is_charging ||
+        fabsf(snap.ac_phases[2].voltage - 231.0f) > 0.1f || !snap.dc_circuits[2].is_enabled ||
+        snap.alarms[0].alarm_id != 42 || snap.status.mains_available || snap.power_module_count != 4) {
+        printf("Device frames not reflected in the state\n");
+        return 1;
+    }
+    printf("Keyframe applied: module 2 %.1fV, alarm %u, version %llu\n",
+           m->voltage, snap.alarms[0].alarm_id, (unsigned long long)snap.version);
+
+    // Setters are command frames
+    stm32_command_t command;
+    if (hw_dev_set_dc_circuit_state(dev, 3, false) != HW_STATUS_OK ||
+        !fake_receive(fd, &rx, &frame) || !stm32_decode_command(&frame, &command) ||
+        command.command_id != STM32_CMD_DC_CIRCUIT || command.target_id != 3 ||
+        command.action != STM32_CMD_ACTION_STOP) {
+        printf("DC circuit command wrong\n");
+        return 1;
+    }
+    if (hw_dev_set_target_voltage(dev, 54.0f) != HW_STATUS_OK ||
+        !fake_receive(fd, &rx, &frame) || !stm32_decode_command(&frame, &command) ||
+        command.command_id != STM32_CMD_POWER_MODULE || command.reserved != 54000) {
+        printf("Target voltage command wrong\n");
+        return 1;
+    }
+    // Commands due together leave in one write, as batch frames
+    atomic_int queued[3];
+    for (int i = 0; i < 3; i++) atomic_init(&queued[i], 99);
+    hw_dev_set_power_module_state_async(dev, 1, true, 0, result_fn, &queued[0]);
+    hw_dev_set_dc_circuit_state_async(dev, 1, true, 0, result_fn, &queued[1]);
+    hw_dev_set_dc_circuit_state_async(dev, 2, false, 0, result_fn, &queued[2]);
+    stm32_command_t received[3];
+    int got = 0, frames = 0;
+    while (got < 3 && fake_receive(fd, &rx, &frame)) {
+        frames++;
+        if (frame.type == PACKET_TYPE_COMMAND && stm32_decode_command(&frame, &received[got])) {
+            got++;
+        } else {
+            got += stm32_decode_command_batch(&frame, received + got, (uint8_t)(3 - got));
+        }
+    }
+    if (got != 3 || received[0].command_id != STM32_CMD_POWER_MODULE || received[1].target_id != 1 ||
+        received[2].target_id != 2 || received[2].action != STM32_CMD_ACTION_STOP) {
+        printf("Queued commands not sent in order\n");
+        return 1;
+    }
+    printf("3 queued commands in %d frame(s)\n", frames);
+
+    // The device says so; until then the state is what it last reported
+    if (hw_dev_get_snapshot(dev, &snap) != HW_STATUS_NOT_MODIFIED) {
+        printf("A command changed the state by itself\n");
+        return 1;
+    }
+
+    // An inactive alarm clears it
+    alarm.is_active = false;
+    size = fake_frame(wire, PACKET_TYPE_ALARM, data, stm32_encode_alarm(&alarm, data));
+    uint64_t version = snap.version;
+    if (write(fd, wire, size) != (ssize_t)size || !wait_for_version(dev, &snap, version) || snap.alarm_count != 0) {
+        printf("Alarm not cleared\n");
+        return 1;
+    }
+
+    // Link down: commands fail, the last values stay readable
+    close(fd);
+    hw_status_t result = HW_STATUS_OK;
+    for (int i = 0; i < 2000 && result == HW_STATUS_OK; i++) {
+        result = hw_dev_set_operation_mode(dev, 0);
+        if (result == HW_STATUS_OK) usleep(1000);
+    }
+    power_module_t modules[4];
+    uint8_t count = 4;
+    hw_dev_get_power_modules(dev, modules, &count);
+    if (result != HW_STATUS_NOT_CONNECTED || fabsf(modules[1].voltage - 53.5f) > 0.01f) {
+        printf("Link loss handled wrong: %d\n", result);
+        return 1;
+    }
+
+    // Reconnect resumes after the 8 frames seen since the SYNC
+    fd = fake_accept(server);
+    rx.count = 0;
+    stm32_decoder_reset(&rx.decoder);
+    if (fd < 0 || !fake_receive(fd, &rx, &frame) || !stm32_decode_resume(&frame, &resume) ||
+        resume.flags != 0 || resume.session_id != 7 || resume.last_sequence != 107) {
+        printf("Reconnect did not resume\n");
+        return 1;
+    }
+    printf("Resumed session %u after sequence %u\n", resume.session_id, resume.last_sequence);
+
+    hw_close(dev);
+    close(fd);
+    close(server);
+    return 0;
+}
 
 int main() {
     printf("NetMon Hardware Interface Test\n");
@@ -202,6 +1477,110 @@ int main() {
     } else {
         printf("Hardware cleanup failed: %d\n", status);
     }
+    printf("\n");
+
+    // Test device handles
+    printf("12. Testing device handles...\n");
+    if (test_device_handles() != 0) {
+        printf("Device handle test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test snapshot
+    printf("13. Testing system snapshot...\n");
+    if (test_snapshot() != 0) {
+        printf("Snapshot test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test subscriptions
+    printf("14. Testing change subscriptions...\n");
+    if (test_subscriptions() != 0) {
+        printf("Subscription test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test concurrent readers
+    printf("15. Testing lock-free readers...\n");
+    if (test_concurrent_readers() != 0) {
+        printf("Concurrent reader test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test async commands
+    printf("16. Testing asynchronous commands...\n");
+    if (test_async_commands() != 0) {
+        printf("Async command test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test bulk access
+    printf("17. Testing bulk field access...\n");
+    if (test_bulk_access() != 0) {
+        printf("Bulk access test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test call statistics
+    printf("18. Testing call statistics...\n");
+    if (test_call_stats() != 0) {
+        printf("Call statistics test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test the STM32 backend
+    printf("19. Testing the STM32 link backend...\n");
+    if (test_stm32_link() != 0) {
+        printf("STM32 link test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test command coalescing
+    printf("20. Testing command coalescing...\n");
+    if (test_command_coalescing() != 0) {
+        printf("Command coalescing test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test the change feed
+    printf("21. Testing the change feed...\n");
+    if (test_change_feed() != 0) {
+        printf("Change feed test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test the history store
+    printf("22. Testing the history store...\n");
+    if (test_history() != 0) {
+        printf("History test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test the history codec
+    printf("23. Testing Gorilla compression...\n");
+    if (test_gorilla() != 0) {
+        printf("Gorilla test failed.\n");
+        return 1;
+    }
+    printf("\n");
+
+    // Test history summaries
+    printf("24. Testing history rollups...\n");
+    if (test_history_summary() != 0) {
+        printf("History rollup test failed.\n");
+        return 1;
+    }
 
     printf("\nTest completed.\n");
     return 0;
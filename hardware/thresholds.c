@@ -0,0 +1,214 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file           : thresholds.c
+  * @brief          : NetmonDashboard v3 - Threshold Configuration
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2024 NetmonDashboard Team
+  * All rights reserved.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#include "thresholds.h"
+#include "safety_system.h"
+#include <string.h>
+
+/* Private variables ---------------------------------------------------------*/
+static thresholds_t buffers[2];
+static const thresholds_t* active = NULL;
+static thresholds_t draft;
+static bool draft_open = false;
+static bool draft_rejected = false;   // A staged key was refused
+
+/* USER CODE BEGIN 0 */
+
+/**
+ * @brief Built-in limits, as the monitors used before tuning existed
+ */
+void thresholds_defaults(thresholds_t* out) {
+    memset(out, 0, sizeof(*out));
+    for (int i = 0; i < MAX_POWER_MODULES; i++) {
+        out->module_voltage_min_mv[i] = VOLTAGE_MIN_MV;
+        out->module_voltage_max_mv[i] = VOLTAGE_MAX_MV;
+        out->module_current_max_ma[i] = CURRENT_MAX_MA;
+        out->module_temperature_max_c[i] = TEMPERATURE_MAX_C;
+    }
+    out->module_power_max_mw = POWER_MAX_MW;
+
+    out->alarm_voltage_low_mv = 45000;      // 45V
+    out->alarm_voltage_high_mv = 55000;     // 55V
+    out->alarm_current_high_ma = 50000;     // 50A
+    out->alarm_temperature_high_c = 60;     // 60°C
+    out->alarm_power_overload_mw = 2400000; // 2.4kW
+    out->alarm_battery_low_mv = 10000;      // 10V
+
+    out->safety_voltage_min_mv = VOLTAGE_CRITICAL_LOW_MV;
+    out->safety_voltage_max_mv = VOLTAGE_CRITICAL_HIGH_MV;
+    out->safety_current_max_ma = CURRENT_CRITICAL_HIGH_MA;
+    out->safety_temperature_max_c = TEMP_CRITICAL_HIGH_C;
+    out->safety_power_max_mw = POWER_CRITICAL_HIGH_MW;
+}
+
+/**
+ * @brief Start from the defaults; call before any monitor is initialised
+ */
+void thresholds_init(void) {
+    thresholds_defaults(&buffers[0]);
+    draft_open = false;
+    draft_rejected = false;
+    __atomic_store_n(&active, &buffers[0], __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Configuration in force; load once per evaluation pass
+ */
+const thresholds_t* thresholds_current(void) {
+    return __atomic_load_n(&active, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * @brief Set a per-module key for one module
+ */
+static bool thresholds_set_module(thresholds_t* config, uint8_t key, uint8_t module, uint32_t value) {
+    switch (key) {
+        case STM32_THRESHOLD_MODULE_VOLTAGE_MIN:
+            if (value > UINT16_MAX) return false;
+            config->module_voltage_min_mv[module] = (uint16_t)value;
+            return true;
+        case STM32_THRESHOLD_MODULE_VOLTAGE_MAX:
+            if (value > UINT16_MAX) return false;
+            config->module_voltage_max_mv[module] = (uint16_t)value;
+            return true;
+        case STM32_THRESHOLD_MODULE_CURRENT_MAX:
+            config->module_current_max_ma[module] = value;
+            return true;
+        case STM32_THRESHOLD_MODULE_TEMP_MAX:
+            if (value > UINT8_MAX) return false;
+            config->module_temperature_max_c[module] = (uint8_t)value;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Set one key in a configuration being built
+ */
+bool thresholds_set(thresholds_t* config, uint8_t key, uint8_t index, uint32_t value) {
+    if (config == NULL) return false;
+
+    switch (key) {
+        case STM32_THRESHOLD_MODULE_VOLTAGE_MIN:
+        case STM32_THRESHOLD_MODULE_VOLTAGE_MAX:
+        case STM32_THRESHOLD_MODULE_CURRENT_MAX:
+        case STM32_THRESHOLD_MODULE_TEMP_MAX:
+            // Modules are 1-based; 0 sets every module
+            if (index > MAX_POWER_MODULES) return false;
+            for (uint8_t i = index ? index - 1 : 0; i < (index ? index : MAX_POWER_MODULES); i++) {
+                if (!thresholds_set_module(config, key, i, value)) return false;
+            }
+            return true;
+        case STM32_THRESHOLD_MODULE_POWER_MAX:     config->module_power_max_mw = value; return true;
+        case STM32_THRESHOLD_ALARM_VOLTAGE_LOW:    config->alarm_voltage_low_mv = value; return true;
+        case STM32_THRESHOLD_ALARM_VOLTAGE_HIGH:   config->alarm_voltage_high_mv = value; return true;
+        case STM32_THRESHOLD_ALARM_CURRENT_HIGH:   config->alarm_current_high_ma = value; return true;
+        case STM32_THRESHOLD_ALARM_TEMP_HIGH:      config->alarm_temperature_high_c = value; return true;
+        case STM32_THRESHOLD_ALARM_POWER_OVERLOAD: config->alarm_power_overload_mw = value; return true;
+        case STM32_THRESHOLD_ALARM_BATTERY_LOW:    config->alarm_battery_low_mv = value; return true;
+        case STM32_THRESHOLD_SAFETY_VOLTAGE_MIN:
+            if (value > UINT16_MAX) return false;
+            config->safety_voltage_min_mv = (uint16_t)value;
+            return true;
+        case STM32_THRESHOLD_SAFETY_VOLTAGE_MAX:
+            if (value > UINT16_MAX) return false;
+            config->safety_voltage_max_mv = (uint16_t)value;
+            return true;
+        case STM32_THRESHOLD_SAFETY_CURRENT_MAX:   config->safety_current_max_ma = value; return true;
+        case STM32_THRESHOLD_SAFETY_TEMP_MAX:
+            if (value > UINT8_MAX) return false;
+            config->safety_temperature_max_c = (uint8_t)value;
+            return true;
+        case STM32_THRESHOLD_SAFETY_POWER_MAX:     config->safety_power_max_mw = value; return true;
+        default:
+            return false;
+    }
+}
+
+/**
+ * @brief Ranges must stay ranges
+ */
+bool thresholds_valid(const thresholds_t* config) {
+    for (int i = 0; i < MAX_POWER_MODULES; i++) {
+        if (config->module_voltage_min_mv[i] >= config->module_voltage_max_mv[i]) return false;
+    }
+    return config->alarm_voltage_low_mv < config->alarm_voltage_high_mv &&
+           config->safety_voltage_min_mv < config->safety_voltage_max_mv;
+}
+
+/**
+ * @brief Copy into the idle buffer, then swap it in with one store
+ */
+static bool thresholds_swap(const thresholds_t* config, uint32_t version) {
+    if (config == NULL || !thresholds_valid(config)) return false;
+
+    const thresholds_t* current = thresholds_current();
+    thresholds_t* next = (current == &buffers[0]) ? &buffers[1] : &buffers[0];
+    *next = *config;
+    next->version = version;
+    __atomic_store_n(&active, next, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * @brief Publish a whole configuration under the next version
+ */
+bool thresholds_publish(const thresholds_t* config) {
+    return thresholds_swap(config, thresholds_current()->version + 1);
+}
+
+/**
+ * @brief Stage one key for the next commit
+ */
+bool thresholds_stage(uint8_t key, uint8_t index, uint32_t value) {
+    // A staged set is complete: keys it leaves out take their defaults, so
+    // the same set always yields the same configuration
+    if (!draft_open) {
+        thresholds_defaults(&draft);
+        draft_open = true;
+        draft_rejected = false;
+    }
+    // A refused key would leave its default in the set; refuse the commit
+    if (!thresholds_set(&draft, key, index, value)) {
+        draft_rejected = true;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Publish the staged draft; an empty commit restores the defaults
+ */
+bool thresholds_commit(uint32_t version) {
+    if (!draft_open) {
+        thresholds_defaults(&draft);
+        draft_rejected = false;
+    }
+    bool rejected = draft_rejected;
+    draft_open = false;
+    draft_rejected = false;
+    return !rejected && thresholds_swap(&draft, version);
+}
+
+/**
+ * @brief Drop staged keys that were never committed
+ */
+void thresholds_discard(void) {
+    draft_open = false;
+    draft_rejected = false;
+}
+
+/* USER CODE END 0 */
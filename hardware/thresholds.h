@@ -0,0 +1,90 @@
+/* USER CODE BEGIN Header */
+/**
+  ******************************************************************************
+  * @file    thresholds.h
+  * @brief   Immutable, atomically replaced threshold configuration
+  ******************************************************************************
+  * @attention
+  *
+  * Copyright (c) 2024 NetmonDashboard Team
+  * All rights reserved.
+  *
+  ******************************************************************************
+  */
+/* USER CODE END Header */
+
+#ifndef THRESHOLDS_H
+#define THRESHOLDS_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "stm32_interface.h"
+#include "power_monitor.h"
+
+// Every limit the monitors evaluate against. A published configuration is
+// never written again: changes are made to a copy and swapped in whole, so
+// an evaluation that reads thresholds_current() once sees one consistent
+// set without locking, from the main loop or an interrupt.
+//
+// Only the main loop publishes (thresholds_publish, thresholds_commit).
+// Two buffers suffice: interrupts finish before the main loop resumes, so
+// no reader can still hold the buffer the next publish overwrites.
+typedef struct {
+    uint32_t version;                                   // 0 = built-in defaults
+
+    // Power module fault limits (power_monitor), per module
+    uint16_t module_voltage_min_mv[MAX_POWER_MODULES];
+    uint16_t module_voltage_max_mv[MAX_POWER_MODULES];
+    uint32_t module_current_max_ma[MAX_POWER_MODULES];
+    uint8_t module_temperature_max_c[MAX_POWER_MODULES];
+    uint32_t module_power_max_mw;
+
+    // Alarm levels (alarm_system)
+    uint32_t alarm_voltage_low_mv;
+    uint32_t alarm_voltage_high_mv;
+    uint32_t alarm_current_high_ma;
+    uint32_t alarm_temperature_high_c;
+    uint32_t alarm_power_overload_mw;
+    uint32_t alarm_battery_low_mv;
+
+    // Critical limits (safety_system)
+    uint16_t safety_voltage_min_mv;
+    uint16_t safety_voltage_max_mv;
+    uint32_t safety_current_max_ma;
+    uint8_t safety_temperature_max_c;
+    uint32_t safety_power_max_mw;
+} thresholds_t;
+
+void thresholds_init(void);
+const thresholds_t* thresholds_current(void);
+void thresholds_defaults(thresholds_t* out);
+
+// Sets one STM32_THRESHOLD_* key in a configuration being built. index
+// picks the power module for per-module keys (0: every module). False for
+// unknown keys and values that do not fit.
+bool thresholds_set(thresholds_t* config, uint8_t key, uint8_t index, uint32_t value);
+
+// True if every minimum is below its maximum
+bool thresholds_valid(const thresholds_t* config);
+
+// Publishes a copy of config with the next version. Refused, leaving the
+// current configuration in force, if any minimum is not below its maximum.
+bool thresholds_publish(const thresholds_t* config);
+
+// Staged updates from STM32_CMD_THRESHOLD commands: stage builds a draft on
+// top of the defaults, commit publishes it under the sender's version,
+// discard drops it (a new consumer link). A key stage refuses makes the
+// next commit fail too, so a set applies whole or not at all.
+bool thresholds_stage(uint8_t key, uint8_t index, uint32_t value);
+bool thresholds_commit(uint32_t version);
+void thresholds_discard(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // THRESHOLDS_H
@@ -0,0 +1,1089 @@
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+#include "tsdb.h"
+#include "gorilla.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#define PATH_SEP '\\'
+typedef CRITICAL_SECTION tsdb_lock_t;
+#define lock_init(l)     InitializeCriticalSection(l)
+#define lock_destroy(l)  DeleteCriticalSection(l)
+#define lock(l)          EnterCriticalSection(l)
+#define unlock(l)        LeaveCriticalSection(l)
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#define PATH_SEP '/'
+typedef pthread_mutex_t tsdb_lock_t;
+#define lock_init(l)     pthread_mutex_init(l, NULL)
+#define lock_destroy(l)  pthread_mutex_destroy(l)
+#define lock(l)          pthread_mutex_lock(l)
+#define unlock(l)        pthread_mutex_unlock(l)
+#endif
+
+// Partition file: [header, 64 bytes][block]...
+// Block: [first u32][last u32][count u32][bytes u32][gorilla stream]
+// bytes is the block's length, set when the block is sealed; the newest
+// block has 0 and ends where its count points end. Sealed blocks are
+// 8-byte aligned. The file grows in steps; a block with count 0 ends the
+// data.
+#define PARTITION_MAGIC         0x53544D4Eu   // "NMTS"
+#define PARTITION_FORMAT        2
+#define PARTITION_HEADER_SIZE   64
+#define BLOCK_HEADER_SIZE       16
+#define INITIAL_BYTES           (64 * 1024)
+#define MAX_BLOCK_POINTS        65536
+
+// Rollup file, one per resolution: [header, 64 bytes][record]...
+// Records are in bucket order; the newest is the bucket still filling and
+// is updated in place. A record with count 0 ends the data.
+#define ROLLUP_MAGIC            0x55524D4Eu   // "NMRU"
+#define ROLLUP_FORMAT           1
+#define ROLLUP_INITIAL_RECORDS  256
+#define SCAN_POINTS             65536
+
+static const uint32_t rollup_seconds[TSDB_ROLLUPS] = {60, 900, 3600, 86400};
+static const char* rollup_names[TSDB_ROLLUPS] = {"1m", "15m", "1h", "1d"};
+
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t header_size;
+    uint32_t block_points;
+    uint32_t start;
+    uint32_t seconds;
+    uint8_t reserved[PARTITION_HEADER_SIZE - 20];
+} partition_header_t;
+
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+    uint32_t count;
+    uint32_t bytes;
+} block_header_t;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t format;
+    uint16_t header_size;
+    uint32_t seconds;
+    uint8_t reserved[PARTITION_HEADER_SIZE - 12];
+} rollup_header_t;
+
+typedef struct {
+    uint32_t start;
+    uint32_t count;
+    float min;
+    float max;
+    float first;
+    float last;
+    double sum;
+} rollup_record_t;
+
+// A mapping of a whole file, or of anonymous memory
+typedef struct {
+    uint8_t* base;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+} region_t;
+
+// In-memory block index; binary-searched by time
+typedef struct {
+    uint32_t first;
+    uint32_t last;
+    uint32_t count;
+    uint32_t bytes;              // Stream length
+    uint64_t offset;
+} block_index_t;
+
+typedef struct {
+    region_t region;
+    uint32_t start;
+    uint32_t block_points;
+    block_index_t* blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+    bool open;                   // The last block takes appends through head
+    gorilla_encoder_t head;
+    uint64_t used;               // Bytes up to the end of the last block
+} partition_t;
+
+typedef struct {
+    region_t region;
+    uint32_t records;            // Including the bucket still filling
+} rollup_t;
+
+typedef struct {
+    uint32_t start;
+    partition_t* mapped;         // The newest always; older ones only in memory stores
+} partition_ref_t;
+
+typedef struct {
+    char name[TSDB_NAME_MAX];
+    uint32_t hash;
+    tsdb_lock_t lock;
+    partition_ref_t* parts;      // Ascending by start
+    uint32_t part_count;
+    uint32_t part_capacity;
+    bool has_points;
+    uint32_t newest;
+    bool rolling;                // rollups open and current
+    rollup_t rollups[TSDB_ROLLUPS];
+} series_t;
+
+struct tsdb {
+    tsdb_config_t config;
+    bool in_memory;
+    tsdb_lock_t lock;            // Series table
+    series_t** table;            // Open addressing, power-of-two size
+    uint32_t table_size;
+    uint32_t series_count;
+    atomic_uint_fast64_t points_appended;
+    atomic_uint_fast64_t points_rejected;
+    atomic_uint_fast64_t partitions_created;
+    atomic_uint_fast64_t bytes_stored;
+};
+
+// Platform helpers
+static void make_directory(const char* path) {
+#ifdef _WIN32
+    _mkdir(path);
+#else
+    mkdir(path, 0755);
+#endif
+}
+
+#ifdef _WIN32
+static bool region_map(region_t* r, size_t size) {
+    r->mapping = CreateFileMappingA(r->file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+    if (!r->mapping) return false;
+    r->base = MapViewOfFile(r->mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!r->base) {
+        CloseHandle(r->mapping);
+        r->mapping = NULL;
+        return false;
+    }
+    r->size = size;
+    return true;
+}
+
+static void region_unmap(region_t* r) {
+    if (r->base) UnmapViewOfFile(r->base);
+    if (r->mapping) CloseHandle(r->mapping);
+    r->base = NULL;
+    r->mapping = NULL;
+}
+
+// path NULL: anonymous memory of size bytes. Otherwise the existing file,
+// or with create a new, empty one
+static bool region_open(region_t* r, const char* path, bool create, size_t size) {
+    memset(r, 0, sizeof(*r));
+    r->file = INVALID_HANDLE_VALUE;
+    if (!path) return region_map(r, size);
+
+    r->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                          create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (r->file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER length;
+    if (!create && GetFileSizeEx(r->file, &length)) size = (size_t)length.QuadPart;
+    if (size && region_map(r, size)) return true;
+    CloseHandle(r->file);
+    r->file = INVALID_HANDLE_VALUE;
+    return false;
+}
+
+static bool region_resize(region_t* r, size_t size) {
+    if (r->file == INVALID_HANDLE_VALUE) {
+        region_t grown = *r;
+        if (!region_map(&grown, size)) return false;
+        memcpy(grown.base, r->base, r->size);
+        region_unmap(r);
+        *r = grown;
+        return true;
+    }
+    region_unmap(r);
+    return region_map(r, size);
+}
+
+static void region_sync(region_t* r) {
+    if (r->file == INVALID_HANDLE_VALUE || !r->base) return;
+    FlushViewOfFile(r->base, r->size);
+    FlushFileBuffers(r->file);
+}
+
+// keep: file length to leave behind; 0 leaves the file as mapped
+static void region_close(region_t* r, uint64_t keep) {
+    region_unmap(r);
+    if (r->file == INVALID_HANDLE_VALUE) return;
+    if (keep) {
+        LARGE_INTEGER end;
+        end.QuadPart = (LONGLONG)keep;
+        if (SetFilePointerEx(r->file, end, NULL, FILE_BEGIN)) SetEndOfFile(r->file);
+    }
+    CloseHandle(r->file);
+    r->file = INVALID_HANDLE_VALUE;
+}
+#else
+static bool region_map(region_t* r, size_t size) {
+    int flags = r->fd >= 0 ? MAP_SHARED : MAP_PRIVATE | MAP_ANONYMOUS;
+    void* base = mmap(NULL, size, PROT_READ | PROT_WRITE, flags, r->fd, 0);
+    if (base == MAP_FAILED) return false;
+    r->base = base;
+    r->size = size;
+    return true;
+}
+
+static bool region_open(region_t* r, const char* path, bool create, size_t size) {
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+    if (!path) return region_map(r, size);
+
+    r->fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_TRUNC : 0), 0644);
+    if (r->fd < 0) return false;
+    struct stat st;
+    if (!create && fstat(r->fd, &st) == 0) size = (size_t)st.st_size;
+    if (size && (!create || ftruncate(r->fd, (off_t)size) == 0) && region_map(r, size)) return true;
+    close(r->fd);
+    r->fd = -1;
+    return false;
+}
+
+static bool region_resize(region_t* r, size_t size) {
+    if (r->fd < 0) {
+        region_t grown = *r;
+        if (!region_map(&grown, size)) return false;
+        memcpy(grown.base, r->base, r->size);
+        munmap(r->base, r->size);
+        *r = grown;
+        return true;
+    }
+    // The file grows sparse; pages are only allocated as blocks fill them
+    if (ftruncate(r->fd, (off_t)size) != 0) return false;
+    munmap(r->base, r->size);
+    r->base = NULL;
+    return region_map(r, size);
+}
+
+static void region_sync(region_t* r) {
+    if (r->fd >= 0 && r->base) msync(r->base, r->size, MS_SYNC);
+}
+
+static void region_close(region_t* r, uint64_t keep) {
+    if (r->base) munmap(r->base, r->size);
+    r->base = NULL;
+    if (r->fd < 0) return;
+    if (keep && ftruncate(r->fd, (off_t)keep) != 0) {
+        // The file keeps its unused tail; reopening ignores it
+    }
+    close(r->fd);
+    r->fd = -1;
+}
+#endif
+
+// Names
+static uint32_t hash_name(const char* name) {
+    uint32_t h = 2166136261u;
+    for (const char* p = name; *p; p++) {
+        h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+    return h;
+}
+
+// One directory per series; characters unsafe in file names are %-escaped
+static void series_directory(const tsdb_t* db, const char* name, char* out, size_t size) {
+    size_t n = (size_t)snprintf(out, size, "%s%c", db->config.directory, PATH_SEP);
+    for (const char* p = name; *p && n + 4 < size; p++) {
+        char c = *p;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+            c == '_' || c == '-' || (c == '.' && p != name)) {
+            out[n++] = c;
+        } else {
+            n += (size_t)snprintf(out + n, size - n, "%%%02X", (uint8_t)c);
+        }
+    }
+    out[n] = '\0';
+}
+
+static void partition_path(const tsdb_t* db, const char* name, uint32_t start, char* out, size_t size) {
+    char dir[TSDB_PATH_MAX + 3 * TSDB_NAME_MAX];
+    series_directory(db, name, dir, sizeof(dir));
+    snprintf(out, size, "%s%c%010u.ts", dir, PATH_SEP, start);
+}
+
+static bool parse_partition_name(const char* name, uint32_t* start) {
+    if (strlen(name) != 13 || strcmp(name + 10, ".ts") != 0) return false;
+    char* end = NULL;
+    unsigned long value = strtoul(name, &end, 10);
+    if (end != name + 10 || value > UINT32_MAX) return false;
+    *start = (uint32_t)value;
+    return true;
+}
+
+// Partitions
+static block_header_t* block_header(const partition_t* p, const block_index_t* b) {
+    return (block_header_t*)(p->region.base + b->offset);
+}
+
+static uint8_t* block_stream(const partition_t* p, const block_index_t* b) {
+    return p->region.base + b->offset + BLOCK_HEADER_SIZE;
+}
+
+static bool index_push(partition_t* p, const block_index_t* b) {
+    if (p->block_count == p->block_capacity) {
+        uint32_t capacity = p->block_capacity ? p->block_capacity * 2 : 64;
+        block_index_t* grown = realloc(p->blocks, capacity * sizeof(block_index_t));
+        if (!grown) return false;
+        p->blocks = grown;
+        p->block_capacity = capacity;
+    }
+    p->blocks[p->block_count++] = *b;
+    return true;
+}
+
+static void partition_free(partition_t* p, bool trim) {
+    if (!p) return;
+    uint64_t keep = p->used + GORILLA_PADDING;
+    region_close(&p->region, trim && keep < p->region.size ? keep : 0);
+    free(p->blocks);
+    free(p);
+}
+
+// path NULL: a partition in anonymous memory
+static partition_t* partition_create(const tsdb_t* db, const char* path, uint32_t start) {
+    partition_t* p = calloc(1, sizeof(partition_t));
+    if (!p) return NULL;
+    p->start = start;
+    p->block_points = db->config.block_points;
+    p->used = PARTITION_HEADER_SIZE;
+    if (!region_open(&p->region, path, true, PARTITION_HEADER_SIZE + INITIAL_BYTES)) {
+        free(p);
+        return NULL;
+    }
+
+    partition_header_t* h = (partition_header_t*)p->region.base;
+    memset(h, 0, sizeof(*h));
+    h->format = PARTITION_FORMAT;
+    h->header_size = PARTITION_HEADER_SIZE;
+    h->block_points = p->block_points;
+    h->start = start;
+    h->seconds = db->config.partition_seconds;
+    // Magic last: a file cut short before this is not taken for a partition
+    atomic_thread_fence(memory_order_release);
+    h->magic = PARTITION_MAGIC;
+    return p;
+}
+
+// Maps an existing partition file and rebuilds its block index
+static partition_t* partition_load(const char* path, uint32_t start) {
+    partition_t* p = calloc(1, sizeof(partition_t));
+    if (!p) return NULL;
+    if (!region_open(&p->region, path, false, 0)) {
+        free(p);
+        return NULL;
+    }
+
+    const partition_header_t* h = (const partition_header_t*)p->region.base;
+    if (p->region.size < PARTITION_HEADER_SIZE || h->magic != PARTITION_MAGIC || h->format != PARTITION_FORMAT ||
+        h->start != start || h->block_points == 0 || h->block_points > MAX_BLOCK_POINTS) {
+        fprintf(stderr, "TSDB: %s is not a partition of this store, ignoring it\n", path);
+        partition_free(p, false);
+        return NULL;
+    }
+    p->start = start;
+    p->block_points = h->block_points;
+    p->used = h->header_size;
+
+    while (p->used + BLOCK_HEADER_SIZE + GORILLA_PADDING <= p->region.size) {
+        block_header_t* bh = (block_header_t*)(p->region.base + p->used);
+        if (bh->count == 0 || bh->count > p->block_points) break;
+        block_index_t b = {bh->first, bh->last, bh->count, 0, p->used};
+        size_t room = p->region.size - p->used - BLOCK_HEADER_SIZE - GORILLA_PADDING;
+        if (bh->bytes) {
+            if (bh->bytes < BLOCK_HEADER_SIZE + 8 || bh->bytes - BLOCK_HEADER_SIZE > room) break;
+            b.bytes = bh->bytes - BLOCK_HEADER_SIZE;
+        } else {
+            // The newest block: where its stream ends is where appends go on.
+            // Points cut short by a crash are dropped.
+            uint32_t found = gorilla_resume(&p->head, block_stream(p, &b), room, bh->count);
+            if (found == 0) break;
+            b.count = found;
+            b.last = p->head.timestamp;
+            b.bytes = (uint32_t)gorilla_bytes(&p->head);
+            p->open = true;
+        }
+        if (!index_push(p, &b)) {
+            partition_free(p, false);
+            return NULL;
+        }
+        p->used += BLOCK_HEADER_SIZE + b.bytes;
+        if (p->open) break;
+    }
+    return p;
+}
+
+// Makes a loaded partition ready for appends
+static void partition_reopen(partition_t* p) {
+    if (!p->open) return;
+    block_index_t* b = &p->blocks[p->block_count - 1];
+    block_header_t* h = block_header(p, b);
+    h->count = b->count;
+    h->last = b->last;
+
+    // The stream is extended by ORing bits in, so whatever an interrupted
+    // append left past its end must go
+    uint8_t* stream = block_stream(p, b);
+    size_t end = (size_t)(p->head.bits / 8);
+    size_t clear = p->region.size - (size_t)(stream - p->region.base) - end;
+    if (clear > GORILLA_POINT_ROOM) clear = GORILLA_POINT_ROOM;
+    if (p->head.bits % 8) {
+        stream[end] &= (uint8_t)(0xFF00u >> (p->head.bits % 8));
+        end++;
+        clear--;
+    }
+    memset(stream + end, 0, clear);
+}
+
+static bool partition_room(partition_t* p, uint64_t needed) {
+    if (needed <= p->region.size) return true;
+    size_t size = p->region.size * 2;
+    if (size < needed) size = (size_t)needed;
+    return region_resize(&p->region, size);
+}
+
+static bool partition_append(partition_t* p, uint32_t timestamp, float value) {
+    block_index_t* b = p->block_count ? &p->blocks[p->block_count - 1] : NULL;
+    if (!p->open || b->count == p->block_points) {
+        if (p->open) {
+            // Seal the full block; the next starts 8-byte aligned after it
+            uint32_t bytes = (BLOCK_HEADER_SIZE + b->bytes + 7u) & ~7u;
+            b->bytes = bytes - BLOCK_HEADER_SIZE;
+            block_header(p, b)->bytes = bytes;
+            p->used = b->offset + bytes;
+        }
+        if (!partition_room(p, p->used + BLOCK_HEADER_SIZE + GORILLA_POINT_ROOM)) return false;
+        block_index_t fresh = {timestamp, timestamp, 0, 0, p->used};
+        if (!index_push(p, &fresh)) return false;
+        b = &p->blocks[p->block_count - 1];
+        block_header(p, b)->first = timestamp;
+        gorilla_init(&p->head);
+        p->open = true;
+    } else if (!partition_room(p, b->offset + BLOCK_HEADER_SIZE + b->bytes + GORILLA_POINT_ROOM)) {
+        return false;
+    }
+
+    gorilla_append(&p->head, block_stream(p, b), timestamp, value);
+    block_header_t* h = block_header(p, b);
+    h->last = timestamp;
+    // Count last: the point is only part of the block once it is whole
+    atomic_thread_fence(memory_order_release);
+    h->count = ++b->count;
+    b->last = timestamp;
+    b->bytes = (uint32_t)gorilla_bytes(&p->head);
+    p->used = b->offset + BLOCK_HEADER_SIZE + b->bytes;
+    return true;
+}
+
+static uint32_t partition_read(const partition_t* p, uint32_t start, uint32_t end,
+                               uint32_t* timestamps, float* values, uint32_t room) {
+    // First block that ends at or after start
+    uint32_t lo = 0, hi = p->block_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (p->blocks[mid].last < start) lo = mid + 1; else hi = mid;
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = lo; i < p->block_count && n < room && p->blocks[i].first <= end; i++) {
+        const block_index_t* b = &p->blocks[i];
+        n += gorilla_decode(block_stream(p, b), b->bytes, b->count, start, end,
+                            timestamps ? timestamps + n : NULL, values + n, room - n);
+    }
+    return n;
+}
+
+// Series
+static bool series_add_partition(series_t* s, uint32_t start, partition_t* mapped) {
+    if (s->part_count == s->part_capacity) {
+        uint32_t capacity = s->part_capacity ? s->part_capacity * 2 : 8;
+        partition_ref_t* grown = realloc(s->parts, capacity * sizeof(partition_ref_t));
+        if (!grown) return false;
+        s->parts = grown;
+        s->part_capacity = capacity;
+    }
+    s->parts[s->part_count].start = start;
+    s->parts[s->part_count].mapped = mapped;
+    s->part_count++;
+    return true;
+}
+
+static int compare_refs(const void* a, const void* b) {
+    uint32_t x = ((const partition_ref_t*)a)->start, y = ((const partition_ref_t*)b)->start;
+    return x < y ? -1 : x > y;
+}
+
+// Finds the series' partitions on disk and maps the newest
+static bool series_load(tsdb_t* db, series_t* s) {
+    char path[TSDB_PATH_MAX + 4 * TSDB_NAME_MAX];
+    uint32_t start;
+    series_directory(db, s->name, path, sizeof(path));
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd;
+    size_t n = strlen(path);
+    snprintf(path + n, sizeof(path) - n, "\\*.ts");
+    HANDLE h = FindFirstFileA(path, &fd);
+    if (h != INVALID_HANDLE_VALUE) {
+        do {
+            if (parse_partition_name(fd.cFileName, &start) && !series_add_partition(s, start, NULL)) {
+                FindClose(h);
+                return false;
+            }
+        } while (FindNextFileA(h, &fd));
+        FindClose(h);
+    }
+#else
+    DIR* dir = opendir(path);
+    if (!dir) return true;   // Nothing logged yet
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (parse_partition_name(entry->d_name, &start) && !series_add_partition(s, start, NULL)) {
+            closedir(dir);
+            return false;
+        }
+    }
+    closedir(dir);
+#endif
+    if (s->part_count == 0) return true;
+    qsort(s->parts, s->part_count, sizeof(partition_ref_t), compare_refs);
+
+    partition_ref_t* newest = &s->parts[s->part_count - 1];
+    partition_path(db, s->name, newest->start, path, sizeof(path));
+    newest->mapped = partition_load(path, newest->start);
+    if (newest->mapped) partition_reopen(newest->mapped);
+    if (newest->mapped && newest->mapped->block_count) {
+        s->has_points = true;
+        s->newest = newest->mapped->blocks[newest->mapped->block_count - 1].last;
+    } else {
+        // Appends may still not go back past the newest partition
+        s->has_points = true;
+        s->newest = newest->start;
+    }
+    return true;
+}
+
+static void rollups_close(tsdb_t* db, series_t* s) {
+    for (int i = 0; i < TSDB_ROLLUPS; i++) {
+        rollup_t* r = &s->rollups[i];
+        uint64_t keep = PARTITION_HEADER_SIZE + (uint64_t)r->records * sizeof(rollup_record_t);
+        if (r->region.base) region_close(&r->region, !db->in_memory && keep < r->region.size ? keep : 0);
+        r->records = 0;
+    }
+    s->rolling = false;
+}
+
+static void series_free(tsdb_t* db, series_t* s) {
+    rollups_close(db, s);
+    for (uint32_t i = 0; i < s->part_count; i++) {
+        partition_free(s->parts[i].mapped, !db->in_memory);
+    }
+    free(s->parts);
+    lock_destroy(&s->lock);
+    free(s);
+}
+
+static bool valid_name(const char* name) {
+    return name && name[0] && strlen(name) < TSDB_NAME_MAX;
+}
+
+static bool table_grow(tsdb_t* db) {
+    uint32_t size = db->table_size ? db->table_size * 2 : 64;
+    series_t** table = calloc(size, sizeof(series_t*));
+    if (!table) return false;
+    for (uint32_t i = 0; i < db->table_size; i++) {
+        series_t* s = db->table[i];
+        if (!s) continue;
+        uint32_t slot = s->hash & (size - 1);
+        while (table[slot]) slot = (slot + 1) & (size - 1);
+        table[slot] = s;
+    }
+    free(db->table);
+    db->table = table;
+    db->table_size = size;
+    return true;
+}
+
+// Series are created on first use and live until the store closes
+static series_t* series_find(tsdb_t* db, const char* name, bool create) {
+    uint32_t hash = hash_name(name);
+    lock(&db->lock);
+    if (db->table_size) {
+        for (uint32_t slot = hash & (db->table_size - 1); db->table[slot]; slot = (slot + 1) & (db->table_size - 1)) {
+            series_t* s = db->table[slot];
+            if (s->hash == hash && strcmp(s->name, name) == 0) {
+                unlock(&db->lock);
+                return s;
+            }
+        }
+    }
+    if (!create) {
+        // Series written by an earlier run are opened by their first read too
+        create = !db->in_memory;
+    }
+
+    series_t* s = NULL;
+    if (create && ((db->series_count + 1) * 2 <= db->table_size || table_grow(db))) {
+        s = calloc(1, sizeof(series_t));
+    }
+    if (s) {
+        snprintf(s->name, sizeof(s->name), "%s", name);
+        s->hash = hash;
+        lock_init(&s->lock);
+        if (!db->in_memory && !series_load(db, s)) {
+            series_free(db, s);
+            s = NULL;
+        }
+    }
+    if (s) {
+        uint32_t slot = hash & (db->table_size - 1);
+        while (db->table[slot]) slot = (slot + 1) & (db->table_size - 1);
+        db->table[slot] = s;
+        db->series_count++;
+    }
+    unlock(&db->lock);
+    return s;
+}
+
+// Starts the partition at start as the series' newest. Called with s->lock held.
+static partition_t* series_roll(tsdb_t* db, series_t* s, uint32_t start) {
+    partition_t* p;
+    if (db->in_memory) {
+        p = partition_create(db, NULL, start);
+    } else {
+        char path[TSDB_PATH_MAX + 4 * TSDB_NAME_MAX];
+        series_directory(db, s->name, path, sizeof(path));
+        make_directory(path);
+        partition_path(db, s->name, start, path, sizeof(path));
+        p = partition_create(db, path, start);
+    }
+    if (!p) return NULL;
+
+    partition_ref_t* newest = s->part_count ? &s->parts[s->part_count - 1] : NULL;
+    if (newest && newest->start == start) {
+        // The newest file was unreadable and has been replaced
+        partition_free(newest->mapped, false);
+        newest->mapped = p;
+    } else {
+        if (newest && !db->in_memory) {
+            partition_free(newest->mapped, true);
+            newest->mapped = NULL;
+        }
+        if (!series_add_partition(s, start, p)) {
+            partition_free(p, false);
+            return NULL;
+        }
+    }
+    atomic_fetch_add_explicit(&db->partitions_created, 1, memory_order_relaxed);
+    return p;
+}
+
+// Points of [start, end] across partitions, oldest first. Called with
+// s->lock held.
+static uint32_t series_read(tsdb_t* db, series_t* s, uint32_t start, uint32_t end,
+                            uint32_t* timestamps, float* values, uint32_t room) {
+    // Newest partition that starts at or before start; later ones follow in order
+    uint32_t lo = 0, hi = s->part_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (s->parts[mid].start <= start) lo = mid + 1; else hi = mid;
+    }
+    uint32_t n = 0;
+    for (uint32_t i = lo ? lo - 1 : 0; i < s->part_count && s->parts[i].start <= end && n < room; i++) {
+        partition_t* p = s->parts[i].mapped;
+        if (!p) {
+            char path[TSDB_PATH_MAX + 4 * TSDB_NAME_MAX];
+            partition_path(db, s->name, s->parts[i].start, path, sizeof(path));
+            p = partition_load(path, s->parts[i].start);
+            if (!p) continue;
+        }
+        n += partition_read(p, start, end, timestamps ? timestamps + n : NULL, values + n, room - n);
+        if (p != s->parts[i].mapped) partition_free(p, false);
+    }
+    return n;
+}
+
+typedef void (*scan_fn)(const uint32_t* times, const float* values, uint32_t count, void* context);
+
+// Hands every point of [start, end] to fn, in chunks. Called with s->lock held.
+static bool series_scan(tsdb_t* db, series_t* s, uint32_t start, uint32_t end, scan_fn fn, void* context) {
+    uint32_t* times = malloc(SCAN_POINTS * sizeof(uint32_t));
+    float* values = malloc(SCAN_POINTS * sizeof(float));
+    bool ok = times && values;
+    while (ok && start <= end) {
+        uint32_t n = series_read(db, s, start, end, times, values, SCAN_POINTS);
+        if (n < SCAN_POINTS) {
+            fn(times, values, n, context);
+            break;
+        }
+        // Points sharing the last timestamp may go on past this chunk, so
+        // they are read again with the next one
+        uint32_t last = times[n - 1], keep = n;
+        while (keep > 0 && times[keep - 1] == last) keep--;
+        if (keep == 0 || last == UINT32_MAX) {
+            fn(times, values, n, context);
+            if (last == UINT32_MAX) break;
+            start = last + 1;
+        } else {
+            fn(times, values, keep, context);
+            start = last;
+        }
+    }
+    free(times);
+    free(values);
+    return ok;
+}
+
+// Rollups
+static rollup_record_t* rollup_records(const rollup_t* r) {
+    return (rollup_record_t*)(r->region.base + PARTITION_HEADER_SIZE);
+}
+
+static size_t rollup_capacity(const rollup_t* r) {
+    return (r->region.size - PARTITION_HEADER_SIZE) / sizeof(rollup_record_t);
+}
+
+static void rollup_path(const tsdb_t* db, const char* name, int level, char* out, size_t size) {
+    char dir[TSDB_PATH_MAX + 3 * TSDB_NAME_MAX];
+    series_directory(db, name, dir, sizeof(dir));
+    snprintf(out, size, "%s%c%s.rollup", dir, PATH_SEP, rollup_names[level]);
+}
+
+// Maps the rollup file of a level, if it is one
+static bool rollup_load(rollup_t* r, const char* path, int level) {
+    if (!region_open(&r->region, path, false, 0)) return false;
+    const rollup_header_t* h = (const rollup_header_t*)r->region.base;
+    if (r->region.size < PARTITION_HEADER_SIZE || h->magic != ROLLUP_MAGIC || h->format != ROLLUP_FORMAT ||
+        h->header_size != PARTITION_HEADER_SIZE || h->seconds != rollup_seconds[level]) {
+        fprintf(stderr, "TSDB: %s is not a rollup of this store, rebuilding it\n", path);
+        region_close(&r->region, 0);
+        return false;
+    }
+    const rollup_record_t* records = rollup_records(r);
+    size_t capacity = rollup_capacity(r);
+    r->records = 0;
+    while (r->records < capacity && records[r->records].count) r->records++;
+    return true;
+}
+
+// path NULL: in memory
+static bool rollup_create(rollup_t* r, const char* path, int level) {
+    if (!region_open(&r->region, path, true,
+                     PARTITION_HEADER_SIZE + ROLLUP_INITIAL_RECORDS * sizeof(rollup_record_t))) {
+        return false;
+    }
+    rollup_header_t* h = (rollup_header_t*)r->region.base;
+    h->format = ROLLUP_FORMAT;
+    h->header_size = PARTITION_HEADER_SIZE;
+    h->seconds = rollup_seconds[level];
+    atomic_thread_fence(memory_order_release);
+    h->magic = ROLLUP_MAGIC;
+    r->records = 0;
+    return true;
+}
+
+static bool rollup_add(rollup_t* r, uint32_t seconds, uint32_t timestamp, float value) {
+    uint32_t start = timestamp - timestamp % seconds;
+    rollup_record_t* last = r->records ? &rollup_records(r)[r->records - 1] : NULL;
+    if (last && last->start == start) {
+        if (value < last->min) last->min = value;
+        if (value > last->max) last->max = value;
+        last->last = value;
+        last->sum += value;
+        last->count++;
+        return true;
+    }
+
+    if (r->records == rollup_capacity(r) && !region_resize(&r->region, r->region.size * 2)) return false;
+    rollup_record_t* next = &rollup_records(r)[r->records++];
+    next->start = start;
+    next->min = next->max = next->first = next->last = value;
+    next->sum = value;
+    // Count last: a record with count 0 ends the file
+    atomic_thread_fence(memory_order_release);
+    next->count = 1;
+    return true;
+}
+
+static void rollups_feed(const uint32_t* times, const float* values, uint32_t count, void* context) {
+    series_t* s = context;
+    for (uint32_t i = 0; i < count; i++) {
+        for (int level = 0; level < TSDB_ROLLUPS; level++) {
+            rollup_add(&s->rollups[level], rollup_seconds[level], times[i], values[i]);
+        }
+    }
+}
+
+// Opens the series' rollups. Missing or unreadable ones are rebuilt from
+// the stored points (a series logged before rollups existed); a series
+// with neither gets them only with create. Called with s->lock held.
+static bool rollups_ready(tsdb_t* db, series_t* s, bool create) {
+    if (s->rolling) return true;
+    if (!create && s->part_count == 0) return false;
+
+    char path[TSDB_PATH_MAX + 4 * TSDB_NAME_MAX];
+    bool loaded = !db->in_memory;
+    for (int level = 0; level < TSDB_ROLLUPS && loaded; level++) {
+        rollup_path(db, s->name, level, path, sizeof(path));
+        loaded = rollup_load(&s->rollups[level], path, level);
+    }
+    if (!loaded) {
+        rollups_close(db, s);
+        if (!db->in_memory) {
+            series_directory(db, s->name, path, sizeof(path));
+            make_directory(path);
+        }
+        for (int level = 0; level < TSDB_ROLLUPS; level++) {
+            if (!db->in_memory) rollup_path(db, s->name, level, path, sizeof(path));
+            if (!rollup_create(&s->rollups[level], db->in_memory ? NULL : path, level)) {
+                rollups_close(db, s);
+                return false;
+            }
+        }
+        if (s->part_count && !series_scan(db, s, 0, UINT32_MAX, rollups_feed, s)) {
+            rollups_close(db, s);
+            return false;
+        }
+    }
+    s->rolling = true;
+    return true;
+}
+
+void tsdb_default_config(tsdb_config_t* config, const char* directory) {
+    if (!config) return;
+    memset(config, 0, sizeof(*config));
+    snprintf(config->directory, sizeof(config->directory), "%s", directory ? directory : "");
+    config->partition_seconds = TSDB_DEFAULT_PARTITION;
+    config->block_points = TSDB_DEFAULT_BLOCK_POINTS;
+}
+
+tsdb_t* tsdb_open(const tsdb_config_t* config) {
+    tsdb_t* db = calloc(1, sizeof(tsdb_t));
+    if (!db) return NULL;
+
+    if (config) {
+        db->config = *config;
+    } else {
+        tsdb_default_config(&db->config, NULL);
+    }
+    db->config.directory[sizeof(db->config.directory) - 1] = '\0';
+    if (db->config.partition_seconds == 0) db->config.partition_seconds = TSDB_DEFAULT_PARTITION;
+    if (db->config.block_points == 0) db->config.block_points = TSDB_DEFAULT_BLOCK_POINTS;
+    if (db->config.block_points > MAX_BLOCK_POINTS) db->config.block_points = MAX_BLOCK_POINTS;
+    db->in_memory = db->config.directory[0] == '\0';
+    if (!db->in_memory) make_directory(db->config.directory);
+    lock_init(&db->lock);
+    return db;
+}
+
+void tsdb_close(tsdb_t* db) {
+    if (!db) return;
+
+    for (uint32_t i = 0; i < db->table_size; i++) {
+        if (db->table[i]) series_free(db, db->table[i]);
+    }
+    free(db->table);
+    lock_destroy(&db->lock);
+    free(db);
+}
+
+hw_status_t tsdb_append(tsdb_t* db, const char* name, uint32_t timestamp, float value) {
+    if (!db || !valid_name(name)) return HW_STATUS_INVALID_PARAM;
+    series_t* s = series_find(db, name, true);
+    if (!s) return HW_STATUS_ERROR;
+
+    lock(&s->lock);
+    uint32_t start = timestamp - timestamp % db->config.partition_seconds;
+    partition_ref_t* newest = s->part_count ? &s->parts[s->part_count - 1] : NULL;
+    if ((s->has_points && timestamp < s->newest) || (newest && start < newest->start)) {
+        unlock(&s->lock);
+        atomic_fetch_add_explicit(&db->points_rejected, 1, memory_order_relaxed);
+        return HW_STATUS_INVALID_PARAM;
+    }
+
+    // Rollups first: rebuilding them must not count this point twice
+    bool rolling = rollups_ready(db, s, true);
+    partition_t* p = newest && newest->start == start ? newest->mapped : NULL;
+    if (!p) p = series_roll(db, s, start);
+    uint64_t used = p ? p->used : 0;
+    if (!p || !partition_append(p, timestamp, value)) {
+        unlock(&s->lock);
+        return HW_STATUS_ERROR;
+    }
+    s->has_points = true;
+    s->newest = timestamp;
+    for (int level = 0; level < TSDB_ROLLUPS && rolling; level++) {
+        if (!rollup_add(&s->rollups[level], rollup_seconds[level], timestamp, value)) {
+            // Rebuilt from the points on next use
+            rollups_close(db, s);
+            if (!db->in_memory) {
+                char path[TSDB_PATH_MAX + 4 * TSDB_NAME_MAX];
+                rollup_path(db, s->name, level, path, sizeof(path));
+                remove(path);
+            }
+            rolling = false;
+        }
+    }
+    used = p->used - used;
+    unlock(&s->lock);
+    atomic_fetch_add_explicit(&db->points_appended, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&db->bytes_stored, used, memory_order_relaxed);
+    return HW_STATUS_OK;
+}
+
+hw_status_t tsdb_query(tsdb_t* db, const char* name, uint32_t start, uint32_t end,
+                       uint32_t* timestamps, float* values, uint32_t* count) {
+    if (!db || !valid_name(name) || !values || !count) return HW_STATUS_INVALID_PARAM;
+    uint32_t room = *count;
+    *count = 0;
+    if (start > end) return HW_STATUS_OK;
+    series_t* s = series_find(db, name, false);
+    if (!s) return HW_STATUS_OK;
+
+    lock(&s->lock);
+    *count = series_read(db, s, start, end, timestamps, values, room);
+    unlock(&s->lock);
+    return HW_STATUS_OK;
+}
+
+// Output of a summary query: width-wide buckets from first
+typedef struct {
+    hw_history_bucket_t* buckets;
+    uint32_t room;
+    uint32_t count;
+    uint32_t first;
+    uint64_t width;
+} summary_t;
+
+static void summary_add(summary_t* out, const rollup_record_t* r) {
+    uint32_t start = (uint32_t)(out->first + (r->start - out->first) / out->width * out->width);
+    hw_history_bucket_t* b = out->count ? &out->buckets[out->count - 1] : NULL;
+    if (b && b->start == start) {
+        if (r->min < b->min) b->min = r->min;
+        if (r->max > b->max) b->max = r->max;
+        b->last = r->last;
+        b->sum += r->sum;
+        b->count += r->count;
+    } else if (out->count < out->room) {
+        b = &out->buckets[out->count++];
+        b->start = start;
+        b->count = r->count;
+        b->min = r->min;
+        b->max = r->max;
+        b->first = r->first;
+        b->last = r->last;
+        b->sum = r->sum;
+    }
+}
+
+static void summary_points(const uint32_t* times, const float* values, uint32_t count, void* context) {
+    for (uint32_t i = 0; i < count; i++) {
+        rollup_record_t r = {times[i], 1, values[i], values[i], values[i], values[i], values[i]};
+        summary_add(context, &r);
+    }
+}
+
+hw_status_t tsdb_query_summary(tsdb_t* db, const char* name, uint32_t start, uint32_t end,
+                               hw_history_bucket_t* buckets, uint32_t* count, uint32_t* width) {
+    if (!db || !valid_name(name) || !buckets || !count) return HW_STATUS_INVALID_PARAM;
+    summary_t out = {buckets, *count, 0, start, 1};
+    *count = 0;
+    if (width) *width = 0;
+    if (start > end || out.room == 0) return HW_STATUS_OK;
+
+    // The coarsest rollup still at least as fine as the chart needs; below
+    // a minute per bucket the raw points are summarized instead
+    uint64_t needed = ((uint64_t)end - start + out.room) / out.room;
+    int level = TSDB_ROLLUPS - 1;
+    while (level >= 0 && rollup_seconds[level] > needed) level--;
+    uint32_t unit = level >= 0 ? rollup_seconds[level] : 1;
+    out.first = start - start % unit;
+    needed = ((uint64_t)end - out.first + out.room) / out.room;
+    out.width = (needed + unit - 1) / unit * unit;
+    if (width) *width = (uint32_t)(out.width < UINT32_MAX ? out.width : UINT32_MAX);
+
+    series_t* s = series_find(db, name, false);
+    if (!s) return HW_STATUS_OK;
+    lock(&s->lock);
+    if (level < 0) {
+        series_scan(db, s, start, end, summary_points, &out);
+    } else if (rollups_ready(db, s, false)) {
+        const rollup_t* r = &s->rollups[level];
+        const rollup_record_t* records = rollup_records(r);
+        uint32_t lo = 0, hi = r->records;
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+            if (records[mid].start < out.first) lo = mid + 1; else hi = mid;
+        }
+        for (uint32_t i = lo; i < r->records && records[i].start <= end; i++) summary_add(&out, &records[i]);
+    }
+    unlock(&s->lock);
+    *count = out.count;
+    return HW_STATUS_OK;
+}
+
+void tsdb_flush(tsdb_t* db) {
+    if (!db || db->in_memory) return;
+
+    lock(&db->lock);
+    for (uint32_t i = 0; i < db->table_size; i++) {
+        series_t* s = db->table[i];
+        if (!s) continue;
+        lock(&s->lock);
+        if (s->part_count && s->parts[s->part_count - 1].mapped) {
+            region_sync(&s->parts[s->part_count - 1].mapped->region);
+        }
+        for (int level = 0; level < TSDB_ROLLUPS && s->rolling; level++) {
+            region_sync(&s->rollups[level].region);
+        }
+        unlock(&s->lock);
+    }
+    unlock(&db->lock);
+}
+
+void tsdb_get_stats(tsdb_t* db, tsdb_stats_t* stats) {
+    if (!db || !stats) return;
+
+    memset(stats, 0, sizeof(*stats));
+    lock(&db->lock);
+    stats->series = db->series_count;
+    for (uint32_t i = 0; i < db->table_size; i++) {
+        series_t* s = db->table[i];
+        if (!s) continue;
+        lock(&s->lock);
+        for (uint32_t k = 0; k < s->part_count; k++) {
+            if (s->parts[k].mapped) stats->bytes_mapped += s->parts[k].mapped->region.size;
+        }
+        unlock(&s->lock);
+    }
+    unlock(&db->lock);
+    stats->points_appended = atomic_load_explicit(&db->points_appended, memory_order_relaxed);
+    stats->points_rejected = atomic_load_explicit(&db->points_rejected, memory_order_relaxed);
+    stats->partitions_created = atomic_load_explicit(&db->partitions_created, memory_order_relaxed);
+    stats->bytes_stored = atomic_load_explicit(&db->bytes_stored, memory_order_relaxed);
+}
@@ -0,0 +1,94 @@
+#ifndef TSDB_H
+#define TSDB_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "hardware_interface.h"
+
+// Embedded, append-only time-series store for logged parameters.
+//
+// Every series (a parameter name) is split into time partitions of
+// partition_seconds. A partition is one file of blocks of up to
+// block_points points, each a Gorilla stream (gorilla.h): delta-of-delta
+// timestamps and XORed values, a few bits per point for regular samples of
+// slowly varying readings. Appends encode straight into the memory-mapped
+// file, which grows in steps; a range read binary-searches the partition's
+// block index for the first block that can hold the start time and decodes
+// from there.
+//
+// Timestamps are Unix seconds and must not go backwards within a series;
+// equal timestamps are kept. A point is visible once its block's count
+// covers it, so a crash loses at most the append in progress. Only the
+// newest partition of each series stays mapped; older ones are mapped
+// for the duration of a read. With an empty directory the store lives in
+// anonymous memory and is gone at close.
+//
+// Each series also keeps 1 min, 15 min, 1 h and 1 day rollups (count,
+// min, max, sum, first, last per bucket), updated as points are appended
+// and stored next to its partitions, so a chart over months reads a few
+// thousand records instead of millions of points. Rollups missing from a
+// directory are rebuilt from the points on first use.
+//
+// All calls are thread-safe. Each series has its own lock, so appends to
+// and reads of different series never contend.
+
+#define TSDB_PATH_MAX               256
+#define TSDB_NAME_MAX               64
+#define TSDB_DEFAULT_PARTITION      (24u * 3600u)
+#define TSDB_DEFAULT_BLOCK_POINTS   1024
+#define TSDB_ROLLUPS                4     // 1 min, 15 min, 1 h, 1 day
+
+typedef struct {
+    char directory[TSDB_PATH_MAX];   // "" keeps the store in memory
+    uint32_t partition_seconds;
+    uint32_t block_points;           // New partitions; bounds what a read decodes to reach its start
+} tsdb_config_t;
+
+typedef struct {
+    uint32_t series;
+    uint64_t points_appended;
+    uint64_t points_rejected;        // Older than the newest point of their series
+    uint64_t partitions_created;
+    uint64_t bytes_stored;           // Encoded blocks, headers included
+    uint64_t bytes_mapped;           // Newest partitions, as mapped now
+} tsdb_stats_t;
+
+typedef struct tsdb tsdb_t;
+
+void tsdb_default_config(tsdb_config_t* config, const char* directory);
+tsdb_t* tsdb_open(const tsdb_config_t* config);
+void tsdb_close(tsdb_t* db);
+
+// HW_STATUS_INVALID_PARAM for a bad name or a timestamp older than the
+// series' newest point
+hw_status_t tsdb_append(tsdb_t* db, const char* series, uint32_t timestamp, float value);
+
+// Points with start <= timestamp <= end, oldest first. count is the room
+// in values (and timestamps, which may be NULL) on entry and the number
+// returned on exit; a longer range is cut off at the oldest count points.
+// An unknown series returns no points.
+hw_status_t tsdb_query(tsdb_t* db, const char* series, uint32_t start, uint32_t end,
+                       uint32_t* timestamps, float* values, uint32_t* count);
+
+// Summaries of [start, end] for a chart of at most *count points, oldest
+// first: one per non-empty bucket of *width seconds, buckets starting at
+// start rounded down to the resolution read. The planner reads the
+// coarsest rollup at least as fine as the chart needs and merges its
+// buckets up to the width; short ranges summarize the raw points.
+hw_status_t tsdb_query_summary(tsdb_t* db, const char* series, uint32_t start, uint32_t end,
+                               hw_history_bucket_t* buckets, uint32_t* count, uint32_t* width);
+
+// Writes the mapped partitions and rollups through to disk
+void tsdb_flush(tsdb_t* db);
+
+void tsdb_get_stats(tsdb_t* db, tsdb_stats_t* stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // TSDB_H
@@ -3,6 +3,7 @@ import { EventEmitter } from 'events';
 import path from 'path';
 import net from 'net'; // TCP client için ekleme
 import { STM32Bridge } from './stm32-bridge';
+import { NativeHardware } from './native-hardware';
 
 export interface PowerModule {
   moduleId: number;
@@ -71,6 +72,7 @@ class HardwareBridge extends EventEmitter {
   private tcpBuffer: string = '';
   private hasLoggedTcpError: boolean = false;
   private stm32Bridge: STM32Bridge | null = null; // STM32 bridge referansı
+  private native: NativeHardware | null = null; // libnetmon_hw Node-API eklentisi
   private reconnectAttempts = 0;
   private reconnectTimer: NodeJS.Timeout | null = null;
   private lastUpdateTs: number = 0;
@@ -84,6 +86,7 @@ class HardwareBridge extends EventEmitter {
     // Default: production'da true, development'ta false
     return process.env.NODE_ENV === 'production';
   })();
+  private readonly nativeEnabled: boolean = process.env.HARDWARE_NATIVE === 'true';
 
   constructor() {
     super();
@@ -92,7 +95,9 @@ class HardwareBridge extends EventEmitter {
 
   private async initializeHardware(): Promise<void> {
     try {
-      if (this.hardwareEnabled) {
+      if (this.nativeEnabled && this.attachNative()) {
+        // libnetmon_hw süreç içinde: TCP/JSON turu yok
+      } else if (this.hardwareEnabled) {
         // STM32 bridge'i başlat
         this.initializeSTM32Bridge();
         // Donanım TCP sunucusuna bağlan
@@ -113,6 +118,24 @@ class HardwareBridge extends EventEmitter {
     }
   }
 
+  /**
+   * libnetmon_hw eklentisini yükler; değişiklikleri 'snapshot' olayı olarak yayınlar
+   */
+  private attachNative(): boolean {
+    this.native = NativeHardware.open();
+    if (!this.native) {
+      console.warn('HARDWARE_NATIVE=true but netmon_hw.node is not built; falling back');
+      return false;
+    }
+    this.native.onChange((changed, snapshot) => {
+      this.lastUpdateTs = Date.now();
+      this.emit('snapshot', changed, snapshot);
+    });
+    this.realHardwareConnected = true;
+    this.isSimulationMode = false;
+    return true;
+  }
+
   /**
    * STM32 bridge'i başlatır ve event listener'ları ayarlar
    */
@@ -531,6 +554,7 @@ class HardwareBridge extends EventEmitter {
 
   // Gerçek donanım entegrasyonu metodları
   private async getRealPowerModulesData(): Promise<PowerModule[]> {
+    if (this.native) return this.native.powerModules();
     // TODO: Gerçek C kütüphanesi çağrısı
     // Bu metodda gerçek güç modüllerinden voltaj, akım, güç verilerini alacak
     console.log('Getting real power module data from hardware...');
@@ -538,6 +562,7 @@ class HardwareBridge extends EventEmitter {
   }
 
   private async getRealBatteryInfoData(): Promise<BatteryInfo[]> {
+    if (this.native) return this.native.batteries();
     // TODO: Gerçek pil verilerini al
     // Pil voltajı, akımı, sıcaklığı, kapasite yüzdesi
     console.log('Getting real battery data from hardware...');
@@ -545,6 +570,7 @@ class HardwareBridge extends EventEmitter {
   }
 
   private async getRealACInputsData(): Promise<ACPhase[]> {
+    if (this.native) return this.native.acPhases();
     // TODO: Gerçek AC giriş verilerini al
     // AC voltaj, akım, frekans verileri
     console.log('Getting real AC input data from hardware...');
@@ -552,6 +578,7 @@ class HardwareBridge extends EventEmitter {
   }
 
   private async getRealDCOutputsData(): Promise<DCCircuit[]> {
+    if (this.native) return this.native.dcCircuits();
     // TODO: Gerçek DC çıkış verilerini al
     // DC voltaj, akım, güç verileri
     console.log('Getting real DC output data from hardware...');
@@ -559,6 +586,7 @@ class HardwareBridge extends EventEmitter {
   }
 
   private async getRealActiveAlarmsData(): Promise<AlarmData[]> {
+    if (this.native) return this.native.alarms();
     // TODO: Gerçek alarm verilerini al
     // Sistem alarmları ve uyarıları
     console.log('Getting real alarm data from hardware...');
@@ -566,6 +594,7 @@ class HardwareBridge extends EventEmitter {
   }
 
   private async getRealSystemStatusData(): Promise<SystemStatus> {
+    if (this.native) return this.native.systemStatus();
     // TODO: Gerçek sistem durumunu al
     // Şebeke durumu, pil yedekleme, jeneratör durumu
     console.log('Getting real system status from hardware...');
@@ -619,7 +648,9 @@ class HardwareBridge extends EventEmitter {
         return { success: true, message: `Power module ${moduleId} ${enabled ? 'enabled' : 'disabled'} (simulation)` };
       } else {
         // Gerçek donanım komutu gönder
-        const success = this.sendSTM32Command(1, moduleId, enabled ? 2 : 3, 0);
+        const success = this.native
+          ? await this.native.setPowerModuleState(moduleId, enabled)
+          : this.sendSTM32Command(1, moduleId, enabled ? 2 : 3, 0);
         return { success, message: success ? `Power module ${moduleId} ${enabled ? 'enabled' : 'disabled'}` : 'Command failed' };
       }
     } catch (error) {
@@ -641,7 +672,9 @@ class HardwareBridge extends EventEmitter {
         return { success: true, message: `Battery ${batteryId} test started (simulation)` };
       } else {
         // Gerçek donanım komutu gönder
-        const success = this.sendSTM32Command(2, batteryId, 2, testType);
+        const success = this.native
+          ? await this.native.startBatteryTest(batteryId, testType)
+          : this.sendSTM32Command(2, batteryId, 2, testType);
         return { success, message: success ? `Battery ${batteryId} test started` : 'Command failed' };
       }
     } catch (error) {
@@ -671,7 +704,9 @@ class HardwareBridge extends EventEmitter {
         return { success: true, message: `DC circuit ${circuitId} ${enabled ? 'enabled' : 'disabled'} (simulation)` };
       } else {
         // Gerçek donanım komutu gönder
-        const success = this.sendSTM32Command(3, circuitId, enabled ? 2 : 3, 0);
+        const success = this.native
+          ? await this.native.setDCCircuitState(circuitId, enabled)
+          : this.sendSTM32Command(3, circuitId, enabled ? 2 : 3, 0);
         return { success, message: success ? `DC circuit ${circuitId} ${enabled ? 'enabled' : 'disabled'}` : 'Command failed' };
       }
     } catch (error) {
@@ -724,6 +759,11 @@ class HardwareBridge extends EventEmitter {
   }
 
   cleanup(): void {
+    if (this.native) {
+      this.native.close();
+      this.native = null;
+    }
+
     if (this.hwProcess) {
       this.hwProcess.kill();
       this.hwProcess = null;
@@ -0,0 +1,229 @@
+import { createRequire } from 'module';
+import path from 'path';
+import type { PowerModule, BatteryInfo, ACPhase, DCCircuit, AlarmData, SystemStatus } from './hardware-bridge';
+
+// hardware/node altındaki Node-API eklentisi (netmon_hw.node) için ince sarmalayıcı.
+// Ölçümler JSON yerine tip dizileri (Float32Array/Uint8Array) olarak gelir;
+// kimlikler dizi indeksi + 1'dir.
+
+export interface NativeSnapshot {
+  version: number;
+  timestamp: number;
+  powerModules: {
+    voltage: Float32Array; current: Float32Array; power: Float32Array; temperature: Float32Array;
+    active: Uint8Array; fault: Uint8Array;
+  };
+  batteries: {
+    voltage: Float32Array; current: Float32Array; temperature: Float32Array;
+    capacityPercent: Uint8Array; charging: Uint8Array; testInProgress: Uint8Array;
+  };
+  acPhases: {
+    voltage: Float32Array; current: Float32Array; frequency: Float32Array; power: Float32Array;
+    normal: Uint8Array;
+  };
+  dcCircuits: {
+    voltage: Float32Array; current: Float32Array; power: Float32Array;
+    enabled: Uint8Array; loadNames: string[];
+  };
+  alarms: AlarmData[];
+  status: SystemStatus;
+}
+
+// Son sürümden bu yana değişen alanlar; paralel diziler, her değişiklik
+// (sürüm, kayıt, birim, alan, yeni değer). record 0-3 banka (BANK_*),
+// RECORD_SYSTEM sistem durumu ve alarm listesidir.
+export interface NativeChanges {
+  version: number;
+  changes: {
+    version: Float64Array; record: Uint8Array; unitId: Uint8Array; field: Uint8Array; value: Float32Array;
+  };
+}
+
+export interface NativeOpStats {
+  calls: number;
+  p50: number;
+  p99: number;
+  p999: number;
+  max: number;
+}
+
+type Handle = object;
+
+interface NetmonHwAddon {
+  open(config?: {
+    seed?: number; updateMs?: number; commandLatencyMs?: number; maxCommands?: number; changeLog?: number;
+    powerModules?: number; batteries?: number; acPhases?: number; dcCircuits?: number;
+    link?: string; linkBaud?: number;
+  }): Handle;
+  close(device: Handle): void;
+  getSnapshot(device: Handle, sinceVersion?: number): NativeSnapshot | null;
+  getChangesSince(device: Handle, since: number, max?: number): NativeChanges | null | false;
+  subscribe(device: Handle, mask: number, minIntervalMs: number,
+            fn: (changed: number, snapshot: NativeSnapshot) => void): Handle;
+  unsubscribe(subscription: Handle): void;
+  setPowerModuleState(device: Handle, moduleId: number, enable: boolean, timeoutMs?: number): Promise<number>;
+  setTargetVoltage(device: Handle, voltage: number, timeoutMs?: number): Promise<number>;
+  startBatteryTest(device: Handle, batteryId: number, testType: number, timeoutMs?: number): Promise<number>;
+  setDcCircuitState(device: Handle, circuitId: number, enable: boolean, timeoutMs?: number): Promise<number>;
+  readField(device: Handle, bank: number, field: number): Float32Array;
+  findUnits(device: Handle, bank: number, field: number, min: number, max: number): Uint8Array;
+  getStats(): Record<string, NativeOpStats>;
+  STATUS_OK: number;
+  STATUS_SUPERSEDED: number;
+  CHANGE_ALL: number;
+}
+
+const COMMAND_TIMEOUT_MS = 2000;
+
+function loadAddon(): NetmonHwAddon | null {
+  const require = createRequire(import.meta.url);
+  const candidates = [
+    process.env.NETMON_HW_ADDON,
+    path.resolve(import.meta.dirname, '..', 'hardware', 'node', 'build', 'Release', 'netmon_hw.node'),
+  ];
+  for (const candidate of candidates) {
+    if (!candidate) continue;
+    try {
+      return require(candidate) as NetmonHwAddon;
+    } catch (error) {
+      // Derlenmemiş eklenti sessizce atlanır; ABI uyuşmazlığı gibi gerçek
+      // yükleme hataları loglanır. Her iki durumda sonraki aday denenir.
+      if ((error as NodeJS.ErrnoException).code !== 'MODULE_NOT_FOUND') {
+        console.error(`netmon_hw.node yüklenemedi (${candidate}):`, error);
+      }
+    }
+  }
+  return null;
+}
+
+export class NativeHardware {
+  private latest: NativeSnapshot;
+  private subscription: Handle | null = null;
+
+  private constructor(private readonly addon: NetmonHwAddon, private readonly device: Handle) {
+    this.latest = addon.getSnapshot(device)!;
+  }
+
+  // Eklenti derlenmemişse null döner; çağıran simülasyona/TCP'ye düşer.
+  // NETMON_HW_LINK verilmişse ("/dev/ttyUSB0" veya "host:port") durum
+  // simülasyon yerine STM32 bağlantısından gelir.
+  static open(): NativeHardware | null {
+    const addon = loadAddon();
+    if (!addon) return null;
+    return new NativeHardware(addon, addon.open({ link: process.env.NETMON_HW_LINK }));
+  }
+
+  // Değişiklikler dispatch thread'inden gelir; olay döngüsü meşgulken biriken
+  // değişiklikler tek çağrıda birleştirilir
+  onChange(fn: (changed: number, snapshot: NativeSnapshot) => void, minIntervalMs = 0): void {
+    if (this.subscription) this.addon.unsubscribe(this.subscription);
+    this.subscription = this.addon.subscribe(this.device, this.addon.CHANGE_ALL, minIntervalMs, (changed, snapshot) => {
+      this.latest = snapshot;
+      fn(changed, snapshot);
+    });
+  }
+
+  snapshot(): NativeSnapshot {
+    const next = this.addon.getSnapshot(this.device, this.latest.version);
+    if (next) this.latest = next;
+    return this.latest;
+  }
+
+  // since sürümünden bu yana yalnızca değişenler. null: since güncel;
+  // false: aradaki değişiklikler düştü, snapshot() ile baştan alınmalı.
+  // Dönen version since olarak tekrar verilerek kalanlar istenir.
+  changesSince(since: number, max?: number): NativeChanges | null | false {
+    return this.addon.getChangesSince(this.device, since, max);
+  }
+
+  powerModules(): PowerModule[] {
+    const m = this.snapshot().powerModules;
+    return Array.from(m.voltage, (voltage, i) => ({
+      moduleId: i + 1,
+      voltage,
+      current: m.current[i],
+      power: m.power[i],
+      temperature: m.temperature[i],
+      isActive: m.active[i] !== 0,
+      hasFault: m.fault[i] !== 0,
+    }));
+  }
+
+  batteries(): BatteryInfo[] {
+    const b = this.snapshot().batteries;
+    return Array.from(b.voltage, (voltage, i) => ({
+      batteryId: i + 1,
+      voltage,
+      current: b.current[i],
+      temperature: b.temperature[i],
+      capacityPercent: b.capacityPercent[i],
+      isCharging: b.charging[i] !== 0,
+      testInProgress: b.testInProgress[i] !== 0,
+    }));
+  }
+
+  acPhases(): ACPhase[] {
+    const p = this.snapshot().acPhases;
+    return Array.from(p.voltage, (voltage, i) => ({
+      phaseId: i + 1,
+      voltage,
+      current: p.current[i],
+      frequency: p.frequency[i],
+      power: p.power[i],
+      isNormal: p.normal[i] !== 0,
+    }));
+  }
+
+  dcCircuits(): DCCircuit[] {
+    const c = this.snapshot().dcCircuits;
+    return Array.from(c.voltage, (voltage, i) => ({
+      circuitId: i + 1,
+      voltage,
+      current: c.current[i],
+      power: c.power[i],
+      isEnabled: c.enabled[i] !== 0,
+      loadName: c.loadNames[i],
+    }));
+  }
+
+  alarms(): AlarmData[] {
+    return this.snapshot().alarms;
+  }
+
+  systemStatus(): SystemStatus {
+    return this.snapshot().status;
+  }
+
+  // Komutlar hw_status_t döndürür; 0 (STATUS_OK) başarıdır. Kuyrukta aynı
+  // ayar için daha yeni bir komut gelirse eskisi STATUS_SUPERSEDED ile
+  // sonuçlanır; istenen değer yeni komutla gittiği için bu da başarı sayılır.
+  private accepted(status: number): boolean {
+    return status === this.addon.STATUS_OK || status === this.addon.STATUS_SUPERSEDED;
+  }
+
+  async setPowerModuleState(moduleId: number, enabled: boolean): Promise<boolean> {
+    return this.accepted(await this.addon.setPowerModuleState(this.device, moduleId, enabled, COMMAND_TIMEOUT_MS));
+  }
+
+  async setTargetVoltage(voltage: number): Promise<boolean> {
+    return this.accepted(await this.addon.setTargetVoltage(this.device, voltage, COMMAND_TIMEOUT_MS));
+  }
+
+  async startBatteryTest(batteryId: number, testType: number): Promise<boolean> {
+    return this.accepted(await this.addon.startBatteryTest(this.device, batteryId, testType, COMMAND_TIMEOUT_MS));
+  }
+
+  async setDCCircuitState(circuitId: number, enabled: boolean): Promise<boolean> {
+    return this.accepted(await this.addon.setDcCircuitState(this.device, circuitId, enabled, COMMAND_TIMEOUT_MS));
+  }
+
+  stats(): Record<string, NativeOpStats> {
+    return this.addon.getStats();
+  }
+
+  // Bekleyen komutlar STATUS_CANCELLED ile sonuçlanır
+  close(): void {
+    this.subscription = null;
+    this.addon.close(this.device);
+  }
+}
@@ -10,9 +10,22 @@ enum STM32PacketType {
     ALARM = 0x05,
     SYSTEM_STATUS = 0x06,
     COMMAND = 0x07,
-    RESPONSE = 0x08
+    RESPONSE = 0x08,
+    RESUME = 0x09,
+    SYNC = 0x0A
 }
 
+// SYNC modes (from stm32_decoder.h)
+enum STM32SyncMode {
+    MARKER = 0,
+    RESUMED = 1,
+    KEYFRAME = 2
+}
+
+const RESUME_FLAG_KEYFRAME = 0x01;
+const RECONNECT_INITIAL_MS = 50;
+const RECONNECT_MAX_MS = 5000;
+
 // STM32 Packet Structure
 interface STM32Packet {
     headerHigh: number;    // 0xAA
@@ -141,8 +154,15 @@ class STM32Bridge extends EventEmitter {
     private buffer = Buffer.alloc(0);
     private readonly host: string;
     private readonly port: number;
-    private reconnectInterval: NodeJS.Timeout | null = null;
+    private reconnectTimer: NodeJS.Timeout | null = null;
+    private reconnectWindowMs = RECONNECT_INITIAL_MS;
     private heartbeatInterval: NodeJS.Timeout | null = null;
+    private stopped = false;
+
+    // Device sequence tracking for session resumption
+    private sessionId = 0;
+    private nextSequence = 0;
+    private synced = false;
 
     constructor(host: string = '127.0.0.1', port: number = 9000) {
         super();
@@ -153,48 +173,85 @@ class STM32Bridge extends EventEmitter {
     }
 
     private connect(): void {
-        this.tcpClient = new net.Socket();
+        const socket = new net.Socket();
+        this.tcpClient = socket;
+        this.buffer = Buffer.alloc(0);
+        socket.setNoDelay(true);
         
-        this.tcpClient.on('connect', () => {
+        socket.on('connect', () => {
             console.log(`STM32 Bridge: Connected to ${this.host}:${this.port}`);
             this.isConnected = true;
+            this.sendResume();
             this.emit('connected');
-            this.stopReconnect();
         });
 
-        this.tcpClient.on('data', (data: Buffer) => {
+        socket.on('data', (data: Buffer) => {
+            // The link is healthy once data flows; the next drop retries fast again
+            this.reconnectWindowMs = RECONNECT_INITIAL_MS;
             this.handleIncomingData(data);
         });
 
-        this.tcpClient.on('close', () => {
-            console.log('STM32 Bridge: Connection closed');
-            this.isConnected = false;
-            this.emit('disconnected');
-            this.startReconnect();
+        socket.on('close', () => {
+            if (this.tcpClient !== socket) return;
+            if (this.isConnected) {
+                console.log('STM32 Bridge: Connection closed');
+                this.isConnected = false;
+                this.emit('disconnected');
+            }
+            this.tcpClient = null;
+            this.scheduleReconnect();
         });
 
-        this.tcpClient.on('error', (error) => {
-            console.error('STM32 Bridge: TCP error:', error);
-            this.isConnected = false;
+        socket.on('error', (error) => {
+            console.error('STM32 Bridge: TCP error:', error.message);
             this.emit('error', error);
         });
 
-        this.tcpClient.connect(this.port, this.host);
+        socket.connect(this.port, this.host);
     }
 
-    private startReconnect(): void {
-        if (this.reconnectInterval) return;
+    // Jittered exponential backoff: the first retry comes within tens of
+    // milliseconds, later ones spread out up to RECONNECT_MAX_MS
+    private scheduleReconnect(): void {
+        if (this.stopped || this.reconnectTimer) return;
+        
+        const window = this.reconnectWindowMs;
+        const delay = window / 2 + Math.random() * (window / 2);
+        this.reconnectWindowMs = Math.min(window * 2, RECONNECT_MAX_MS);
         
-        this.reconnectInterval = setInterval(() => {
+        this.reconnectTimer = setTimeout(() => {
+            this.reconnectTimer = null;
             console.log('STM32 Bridge: Attempting to reconnect...');
             this.connect();
-        }, 5000);
+        }, delay);
     }
 
-    private stopReconnect(): void {
-        if (this.reconnectInterval) {
-            clearInterval(this.reconnectInterval);
-            this.reconnectInterval = null;
+    // Ask the device to replay what we missed, or for a full-state keyframe
+    // when we have no session yet
+    private sendResume(): void {
+        const data = Buffer.alloc(9);
+        data.writeUInt32LE(this.synced ? this.sessionId : 0, 0);
+        data.writeUInt32LE((this.nextSequence - 1) >>> 0, 4);
+        data[8] = this.synced ? 0 : RESUME_FLAG_KEYFRAME;
+        this.sendData(this.createPacket(STM32PacketType.RESUME, data));
+    }
+
+    private handleSync(data: Buffer): void {
+        if (data.length < 9) return;
+        
+        const sessionId = data.readUInt32LE(0);
+        const mode = data[8];
+        if (this.synced && sessionId !== this.sessionId) {
+            console.log('STM32 Bridge: Device restarted, new session');
+        }
+        this.sessionId = sessionId;
+        this.nextSequence = data.readUInt32LE(4);
+        this.synced = true;
+        
+        if (mode === STM32SyncMode.KEYFRAME) {
+            this.emit('keyframe');
+        } else if (mode === STM32SyncMode.RESUMED) {
+            this.emit('resumed');
         }
     }
 
@@ -290,6 +347,14 @@ class STM32Bridge extends EventEmitter {
     }
 
     private processPacket(packet: STM32Packet): void {
+        if (packet.packetType === STM32PacketType.SYNC) {
+            this.handleSync(packet.data);
+            return;
+        }
+        if (this.synced) {
+            this.nextSequence = (this.nextSequence + 1) >>> 0;
+        }
+        
         try {
             switch (packet.packetType) {
                 case STM32PacketType.POWER_MODULE:
@@ -555,9 +620,10 @@ class STM32Bridge extends EventEmitter {
     }
 
     public disconnect(): void {
-        if (this.reconnectInterval) {
-            clearInterval(this.reconnectInterval);
-            this.reconnectInterval = null;
+        this.stopped = true;
+        if (this.reconnectTimer) {
+            clearTimeout(this.reconnectTimer);
+            this.reconnectTimer = null;
         }
         
         if (this.heartbeatInterval) {
@@ -574,7 +640,7 @@ class STM32Bridge extends EventEmitter {
     }
 }
 
-export { STM32Bridge, STM32PacketType };
+export { STM32Bridge, STM32PacketType, STM32SyncMode };
 export type { 
     PowerModule, BatteryInfo, ACPhase, DCCircuit, AlarmData, SystemStatus,
     STM32Packet, STM32PowerModuleData, STM32BatteryData, STM32ACInputData,